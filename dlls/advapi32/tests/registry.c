@@ -2361,6 +2361,104 @@ static void test_rw_order(void)
     ok(!RegDeleteKeyA(HKEY_CURRENT_USER, keyname), "Failed to delete key\n");
 }
 
+static void test_large_key(void)
+{
+    /* enough entries to use the hash index, the large sizes are only for benchmarking */
+    DWORD count = winetest_interactive ? 100000 : 2000;
+    DWORD value_count = winetest_interactive ? 1000 : 500;
+    char name[32], buffer[32];
+    DWORD i, start, subkeys, values, len, dw;
+    HKEY key, subkey;
+    LONG ret;
+
+    ret = RegCreateKeyExA( hkey_main, "large", 0, NULL, REG_OPTION_VOLATILE, KEY_ALL_ACCESS,
+                           NULL, &key, NULL );
+    ok( !ret, "RegCreateKeyExA failed: %d\n", ret );
+    if (ret) return;
+
+    /* create the subkeys in a scrambled order */
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "key%06u", (i * 7919) % count );
+        ret = RegCreateKeyExA( key, name, 0, NULL, REG_OPTION_VOLATILE, KEY_ALL_ACCESS,
+                               NULL, &subkey, NULL );
+        if (ret) break;
+        RegCloseKey( subkey );
+    }
+    ok( !ret, "RegCreateKeyExA %s failed: %d\n", name, ret );
+    if (winetest_interactive)
+        trace( "created %u subkeys in %u ms\n", i, GetTickCount() - start );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "KEY%06u", (i * 3) % count );
+        ret = RegOpenKeyExA( key, name, 0, KEY_READ, &subkey );
+        if (ret) break;
+        RegCloseKey( subkey );
+    }
+    ok( !ret, "RegOpenKeyExA %s failed: %d\n", name, ret );
+    if (winetest_interactive)
+        trace( "opened %u subkeys in %u ms\n", i, GetTickCount() - start );
+
+    sprintf( name, "key%06u", count );
+    ret = RegOpenKeyExA( key, name, 0, KEY_READ, &subkey );
+    ok( ret == ERROR_FILE_NOT_FOUND, "RegOpenKeyExA returned %d\n", ret );
+
+    for (i = 0; i < value_count; i++)
+    {
+        sprintf( name, "value%04u", (i * 7) % value_count );
+        dw = i;
+        ret = RegSetValueExA( key, name, 0, REG_DWORD, (BYTE *)&dw, sizeof(dw) );
+        if (ret) break;
+    }
+    ok( !ret, "RegSetValueExA %s failed: %d\n", name, ret );
+
+    ret = RegQueryInfoKeyA( key, NULL, NULL, NULL, &subkeys, NULL, NULL, &values,
+                            NULL, NULL, NULL, NULL );
+    ok( !ret, "RegQueryInfoKeyA failed: %d\n", ret );
+    ok( subkeys == count, "got %u subkeys\n", subkeys );
+    ok( values == value_count, "got %u values\n", values );
+
+    /* subkeys are enumerated in name order */
+    for (i = 0; i < count; i += count / 10)
+    {
+        sprintf( name, "key%06u", i );
+        ret = RegEnumKeyA( key, i, buffer, sizeof(buffer) );
+        ok( !ret, "RegEnumKeyA %u failed: %d\n", i, ret );
+        ok( !strcmp( buffer, name ), "got %s for %u\n", buffer, i );
+    }
+    ret = RegEnumKeyA( key, count, buffer, sizeof(buffer) );
+    ok( ret == ERROR_NO_MORE_ITEMS, "RegEnumKeyA returned %d\n", ret );
+
+    for (i = 0; i < value_count; i++)
+    {
+        sprintf( name, "VALUE%04u", i );
+        len = sizeof(dw);
+        ret = RegQueryValueExA( key, name, NULL, NULL, (BYTE *)&dw, &len );
+        if (ret) break;
+        ok( (dw * 7) % value_count == i, "got %u for %s\n", dw, name );
+    }
+    ok( !ret, "RegQueryValueExA %s failed: %d\n", name, ret );
+
+    /* values are enumerated in creation order on Windows */
+    for (i = 0; i < value_count; i += value_count / 10)
+    {
+        sprintf( name, "value%04u", (i * 7) % value_count );
+        len = sizeof(buffer);
+        ret = RegEnumValueA( key, i, buffer, &len, NULL, NULL, NULL, NULL );
+        ok( !ret, "RegEnumValueA %u failed: %d\n", i, ret );
+        todo_wine_if( i ) ok( !strcmp( buffer, name ), "got %s for %u\n", buffer, i );
+    }
+
+    start = GetTickCount();
+    delete_key( key );
+    if (winetest_interactive)
+        trace( "deleted %u subkeys in %u ms\n", count, GetTickCount() - start );
+    RegCloseKey( key );
+}
+
 static void test_symlinks(void)
 {
     static const WCHAR targetW[] = {'\\','S','o','f','t','w','a','r','e','\\','W','i','n','e',
@@ -4216,6 +4314,7 @@ START_TEST(registry)
     test_reg_copy_tree();
     test_reg_delete_tree();
     test_rw_order();
+    test_large_key();
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
@@ -21,6 +21,7 @@
 #include <assert.h>
 
 #include "gdi_private.h"
+#include "winreg.h"
 #include "dibdrv.h"
 
 #include "wine/debug.h"
@@ -581,19 +582,144 @@ static void mask_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+/* Large operations can optionally be split in bands of rows that are rendered in
+ * parallel on the thread pool. Each band only writes its own rows and computes
+ * them exactly like the serial code would, so the result is the same. */
+
+#define MIN_BAND_PIXELS (512 * 512)  /* smaller operations aren't worth splitting */
+
+static int render_threads = -1;
+
+static int get_render_threads(void)
+{
+    char buffer[16];
+    DWORD type, size = sizeof(buffer);
+    SYSTEM_INFO info;
+    HKEY hkey;
+    int threads = 0;
+
+    if (render_threads != -1) return render_threads;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\GDI */
+    if (!RegOpenKeyA( HKEY_CURRENT_USER, "Software\\Wine\\GDI", &hkey ))
+    {
+        if (!RegQueryValueExA( hkey, "RenderThreads", NULL, &type, (BYTE *)buffer, &size ))
+        {
+            if (type == REG_DWORD) threads = *(DWORD *)buffer;
+            else if (type == REG_SZ) threads = atoi( buffer );
+        }
+        RegCloseKey( hkey );
+    }
+    GetSystemInfo( &info );
+    threads = max( 1, min( threads, info.dwNumberOfProcessors ));
+    TRACE( "using %d render threads\n", threads );
+    return render_threads = threads;
+}
+
+struct render_bands
+{
+    void (*func)( void *arg, int top, int bottom );
+    void  *arg;
+    int    top;
+    int    bottom;
+    int    height;   /* rows per band */
+    LONG   next;     /* index of the next band to render */
+    LONG   pending;  /* number of threads still rendering */
+    HANDLE done;
+};
+
+static void render_next_bands( struct render_bands *bands )
+{
+    int top;
+
+    while ((top = bands->top + (InterlockedIncrement( &bands->next ) - 1) * bands->height) < bands->bottom)
+        bands->func( bands->arg, top, min( top + bands->height, bands->bottom ));
+}
+
+static DWORD CALLBACK render_bands_proc( void *arg )
+{
+    struct render_bands *bands = arg;
+
+    render_next_bands( bands );
+    if (!InterlockedDecrement( &bands->pending )) SetEvent( bands->done );
+    return 0;
+}
+
+/* call func for the rows from top to bottom, split in bands rendered in parallel if worthwhile */
+static void render_rows( void (*func)( void *arg, int top, int bottom ), void *arg,
+                         int top, int bottom, int width )
+{
+    struct render_bands bands;
+    int i, threads = get_render_threads();
+
+    if (threads <= 1 || (LONGLONG)(bottom - top) * width < MIN_BAND_PIXELS ||
+        !(bands.done = CreateEventW( NULL, TRUE, FALSE, NULL )))
+    {
+        func( arg, top, bottom );
+        return;
+    }
+
+    bands.func    = func;
+    bands.arg     = arg;
+    bands.top     = top;
+    bands.bottom  = bottom;
+    bands.height  = max( 16, (bottom - top + threads * 4 - 1) / (threads * 4) );
+    bands.next    = 0;
+    bands.pending = threads;
+
+    for (i = 1; i < threads; i++)
+        if (!QueueUserWorkItem( render_bands_proc, &bands, WT_EXECUTEDEFAULT ))
+            InterlockedDecrement( &bands.pending );
+
+    render_next_bands( &bands );
+    if (InterlockedDecrement( &bands.pending )) WaitForSingleObject( bands.done, INFINITE );
+    CloseHandle( bands.done );
+}
+
+struct blend_rows
+{
+    dib_info      *dst;
+    const RECT    *rect;
+    const dib_info *src;
+    POINT          origin;
+    BLENDFUNCTION  blend;
+};
+
+static void blend_rows( void *arg, int top, int bottom )
+{
+    const struct blend_rows *rows = arg;
+    RECT rect = *rows->rect;
+    POINT origin = rows->origin;
+
+    origin.y += top - rect.top;
+    rect.top = top;
+    rect.bottom = bottom;
+    rows->dst->funcs->blend_rect( rows->dst, &rect, rows->src, &origin, rows->blend );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
-    POINT origin;
+    struct blend_rows rows;
     struct clipped_rects clipped_rects;
     int i;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
+
+    rows.dst   = dst;
+    rows.src   = src;
+    rows.blend = blend;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
-        origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
-        dst->funcs->blend_rect( dst, &clipped_rects.rects[i], src, &origin, blend );
+        rows.rect = &clipped_rects.rects[i];
+        rows.origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
+        rows.origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
+        /* rows of the source may get overwritten before being read */
+        if (dst->bits.ptr == src->bits.ptr)
+            blend_rows( &rows, rows.rect->top, rows.rect->bottom );
+        else
+            render_rows( blend_rows, &rows, rows.rect->top, rows.rect->bottom,
+                         rows.rect->right - rows.rect->left );
     }
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -678,19 +804,46 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
     bounds->bottom = v[2].y;
 }
 
+struct gradient_rows
+{
+    dib_info   *dib;
+    const RECT *rect;
+    TRIVERTEX  *v;
+    int         mode;
+    BOOL        ret;
+};
+
+static void gradient_rows( void *arg, int top, int bottom )
+{
+    struct gradient_rows *rows = arg;
+    RECT rect = *rows->rect;
+
+    rect.top = top;
+    rect.bottom = bottom;
+    /* all the bands fail the same way, no need to synchronize */
+    if (!rows->dib->funcs->gradient_rect( rows->dib, &rect, rows->v, rows->mode )) rows->ret = FALSE;
+}
+
 static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
 {
     int i;
     struct clipped_rects clipped_rects;
-    BOOL ret = TRUE;
+    struct gradient_rows rows;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
-    for (i = 0; i < clipped_rects.count; i++)
+
+    rows.dib  = dib;
+    rows.v    = v;
+    rows.mode = mode;
+    rows.ret  = TRUE;
+    for (i = 0; i < clipped_rects.count && rows.ret; i++)
     {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
+        rows.rect = &clipped_rects.rects[i];
+        render_rows( gradient_rows, &rows, rows.rect->top, rows.rect->bottom,
+                     rows.rect->right - rows.rect->left );
     }
     free_clipped_rects( &clipped_rects );
-    return ret;
+    return rows.ret;
 }
 
 static DWORD copy_src_bits( dib_info *src, RECT *src_rect )
@@ -1195,6 +1348,93 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
     return ERROR_SUCCESS;
 }
 
+struct stretch_rows
+{
+    dib_info               *dst_dib;
+    const dib_info         *src_dib;
+    POINT                   dst_start;
+    POINT                   src_start;
+    struct stretch_params   v_params;
+    struct stretch_params   h_params;
+    BOOL                    vstretch;
+    int                     mode;
+    int                     width;
+    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
+                    const dib_info *src_dib, const POINT *src_start,
+                    const struct stretch_params *params, int mode, BOOL keep_dst);
+};
+
+/* render the destination rows between top and bottom; the vertical steps are always */
+/* replayed from the start so that the result doesn't depend on the band boundaries */
+static void stretch_rows( void *arg, int top, int bottom )
+{
+    const struct stretch_rows *rows = arg;
+    const struct stretch_params *v_params = &rows->v_params;
+    POINT dst_start = rows->dst_start, src_start = rows->src_start;
+    int length = v_params->length, err = v_params->err_start;
+
+    if (rows->vstretch)
+    {
+        BOOL need_row = TRUE;
+        RECT last_row, this_row;
+        last_row.left = 0;
+        last_row.right = rows->width;
+
+        while (length--)
+        {
+            if (dst_start.y >= top && dst_start.y < bottom)
+            {
+                last_row.top = dst_start.y - v_params->dst_inc;
+                last_row.bottom = last_row.top + 1;
+
+                /* the previous row may belong to another band, render it again in that case */
+                if (need_row || last_row.top < top || last_row.top >= bottom)
+                {
+                    rows->row_fn( rows->dst_dib, &dst_start, rows->src_dib, &src_start,
+                                  &rows->h_params, rows->mode, FALSE );
+                    need_row = FALSE;
+                }
+                else
+                {
+                    this_row = last_row;
+                    offset_rect( &this_row, 0, v_params->dst_inc );
+                    copy_rect( rows->dst_dib, &this_row, rows->dst_dib, &last_row, NULL, R2_COPYPEN );
+                }
+            }
+
+            if (err > 0)
+            {
+                src_start.y += v_params->src_inc;
+                need_row = TRUE;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            dst_start.y += v_params->dst_inc;
+        }
+    }
+    else
+    {
+        int merged_rows = 0;
+
+        while (length--)
+        {
+            if ((rows->mode != STRETCH_DELETESCANS || !merged_rows) &&
+                dst_start.y >= top && dst_start.y < bottom)
+                rows->row_fn( rows->dst_dib, &dst_start, rows->src_dib, &src_start,
+                              &rows->h_params, rows->mode, merged_rows != 0 );
+            merged_rows++;
+
+            if (err > 0)
+            {
+                dst_start.y += v_params->dst_inc;
+                merged_rows = 0;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            src_start.y += v_params->src_inc;
+        }
+    }
+}
 
 DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
                           const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
@@ -1205,11 +1445,8 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     RECT rect;
     BOOL hstretch, vstretch;
     struct stretch_params v_params, h_params;
-    int err;
+    struct stretch_rows rows;
     DWORD ret;
-    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
-                    const dib_info *src_dib, const POINT *src_start,
-                    const struct stretch_params *params, int mode, BOOL keep_dst);
 
     TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
           dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
@@ -1243,64 +1480,18 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     dst_start.x -= dst->visrect.left;
     dst_start.y -= dst->visrect.top;
 
-    err = v_params.err_start;
-
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
-
-    if (vstretch)
-    {
-        BOOL need_row = TRUE;
-        RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
-        last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
-
-        while (v_params.length--)
-        {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
-            else
-            {
-                last_row.top = dst_start.y - v_params.dst_inc;
-                last_row.bottom = last_row.top + 1;
-                this_row = last_row;
-                offset_rect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
-            }
-
-            if (err > 0)
-            {
-                src_start.y += v_params.src_inc;
-                need_row = TRUE;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
-        }
-    }
-    else
-    {
-        int merged_rows = 0;
-
-        while (v_params.length--)
-        {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
-            merged_rows++;
-
-            if (err > 0)
-            {
-                dst_start.y += v_params.dst_inc;
-                merged_rows = 0;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
-        }
-    }
+    rows.dst_dib   = &dst_dib;
+    rows.src_dib   = &src_dib;
+    rows.dst_start = dst_start;
+    rows.src_start = src_start;
+    rows.v_params  = v_params;
+    rows.h_params  = h_params;
+    rows.vstretch  = vstretch;
+    rows.mode      = (vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    rows.width     = dst->visrect.right - dst->visrect.left;
+    rows.row_fn    = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+
+    render_rows( stretch_rows, &rows, 0, dst->visrect.bottom - dst->visrect.top, rows.width );
 
     /* update coordinates, the destination rectangle is always stored at 0,0 */
     *src = *dst;
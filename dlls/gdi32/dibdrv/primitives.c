@@ -19,6 +19,9 @@
  */
 
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "gdi_private.h"
 #include "dibdrv.h"
@@ -4651,31 +4654,130 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+#ifdef __SSE2__
+
+/* divide 16-bit lanes by 255, exact for all the values the blending formulas can produce */
+static inline __m128i div255_epu16( __m128i v )
+{
+    v = _mm_add_epi16( _mm_add_epi16( v, _mm_set1_epi16( 1 ) ), _mm_srli_epi16( v, 8 ));
+    return _mm_srli_epi16( v, 8 );
+}
+
+/* pack 16-bit channels back into pixels; like the C code, a channel that overflows sets */
+/* the low bit of the next one */
+static inline __m128i pack_argb_sse2( __m128i lo, __m128i hi )
+{
+    __m128i mask = _mm_set1_epi16( 0xff );
+    __m128i bytes = _mm_packus_epi16( _mm_and_si128( lo, mask ), _mm_and_si128( hi, mask ));
+    __m128i carry = _mm_packus_epi16( _mm_srli_epi16( lo, 8 ), _mm_srli_epi16( hi, 8 ));
+    return _mm_or_si128( bytes, _mm_slli_epi32( carry, 8 ));
+}
+
+/* same as blend_argb for the two pixels held in 16-bit lanes */
+static inline __m128i blend_argb_sse2( __m128i dst, __m128i src )
+{
+    __m128i alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( src, 0xff ), 0xff );
+    __m128i inv_alpha = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+
+    dst = _mm_add_epi16( _mm_mullo_epi16( dst, inv_alpha ), _mm_set1_epi16( 127 ));
+    return _mm_add_epi16( src, div255_epu16( dst ));
+}
+
+/* same as blend_argb_constant_alpha for the two pixels held in 16-bit lanes */
+static inline __m128i blend_argb_constant_alpha_sse2( __m128i dst, __m128i src, __m128i alpha, __m128i inv_alpha )
+{
+    __m128i val = _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_mullo_epi16( dst, inv_alpha ));
+    return div255_epu16( _mm_add_epi16( val, _mm_set1_epi16( 127 )));
+}
+
+/* scale the source by the constant alpha like blend_argb_alpha does */
+static inline __m128i scale_argb_sse2( __m128i src, __m128i alpha )
+{
+    return div255_epu16( _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_set1_epi16( 127 )));
+}
+
+#endif /* __SSE2__ */
+
+/* blend the leading pixels of a span four at a time; returns the number of pixels done, */
+/* the caller takes care of the remaining ones. */
+/* no_src_alpha means that the source alpha channel is ignored without AC_SRC_ALPHA. */
+static int blend_span_8888( DWORD *dst, const DWORD *src, int len, BLENDFUNCTION blend, BOOL no_src_alpha )
+{
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i alpha = _mm_set1_epi16( blend.SourceConstantAlpha );
+    __m128i inv_alpha = _mm_set1_epi16( 255 - blend.SourceConstantAlpha );
+    __m128i src_mask = _mm_set1_epi32( no_src_alpha ? 0xff000000 : 0 );
+    int i;
+
+    /* the vector loop reads ahead, make sure that doesn't change the result */
+    if (src != dst && dst < src + len && src < dst + len) return 0;
+
+    for (i = 0; i + 4 <= len; i += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + i) );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + i) );
+        __m128i s_lo, s_hi, d_lo, d_hi;
+
+        if (!(blend.AlphaFormat & AC_SRC_ALPHA)) s = _mm_or_si128( s, src_mask );
+        s_lo = _mm_unpacklo_epi8( s, zero );
+        s_hi = _mm_unpackhi_epi8( s, zero );
+        d_lo = _mm_unpacklo_epi8( d, zero );
+        d_hi = _mm_unpackhi_epi8( d, zero );
+
+        if (blend.AlphaFormat & AC_SRC_ALPHA)
+        {
+            if (blend.SourceConstantAlpha != 255)
+            {
+                s_lo = scale_argb_sse2( s_lo, alpha );
+                s_hi = scale_argb_sse2( s_hi, alpha );
+            }
+            d_lo = blend_argb_sse2( d_lo, s_lo );
+            d_hi = blend_argb_sse2( d_hi, s_hi );
+        }
+        else
+        {
+            d_lo = blend_argb_constant_alpha_sse2( d_lo, s_lo, alpha, inv_alpha );
+            d_hi = blend_argb_constant_alpha_sse2( d_hi, s_hi, alpha, inv_alpha );
+        }
+        _mm_storeu_si128( (__m128i *)(dst + i), pack_argb_sse2( d_lo, d_hi ));
+    }
+    return i;
+#else
+    return 0;
+#endif
+}
+
 static void blend_rect_8888(const dib_info *dst, const RECT *rc,
                             const dib_info *src, const POINT *origin, BLENDFUNCTION blend)
 {
     DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
     DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
+    BOOL no_src_alpha = src->compression != BI_RGB;
     int x, y;
 
     if (blend.AlphaFormat & AC_SRC_ALPHA)
     {
 	if (blend.SourceConstantAlpha == 255)
 	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
+		for (x = blend_span_8888( dst_ptr, src_ptr, rc->right - rc->left, blend, FALSE );
+                     x < rc->right - rc->left; x++)
 		    dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
         else
 	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
+		for (x = blend_span_8888( dst_ptr, src_ptr, rc->right - rc->left, blend, FALSE );
+                     x < rc->right - rc->left; x++)
 		    dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
     }
-    else if (src->compression == BI_RGB)
+    else if (!no_src_alpha)
 	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
+	    for (x = blend_span_8888( dst_ptr, src_ptr, rc->right - rc->left, blend, FALSE );
+                 x < rc->right - rc->left; x++)
 		dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
     else
 	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
+	    for (x = blend_span_8888( dst_ptr, src_ptr, rc->right - rc->left, blend, TRUE );
+                 x < rc->right - rc->left; x++)
 		dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
 }
 
@@ -4724,10 +4826,32 @@ static void blend_rect_24(const dib_info *dst, const RECT *rc,
     DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
     BYTE *dst_ptr = get_pixel_ptr_24( dst, rc->left, rc->top );
     int x, y;
+#ifdef __SSE2__
+    DWORD buffer[256];
+    int i, len;
+#endif
 
     for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride, src_ptr += src->stride / 4)
     {
-        for (x = 0; x < rc->right - rc->left; x++)
+        x = 0;
+#ifdef __SSE2__
+        /* expand the destination to 32 bpp so that it can be blended with vector instructions */
+        while ((len = min( (rc->right - rc->left - x) & ~3, ARRAY_SIZE(buffer) )))
+        {
+            BYTE *ptr = dst_ptr + x * 3;
+
+            for (i = 0; i < len; i++, ptr += 3) buffer[i] = ptr[0] | ptr[1] << 8 | ptr[2] << 16;
+            if (!(len = blend_span_8888( buffer, src_ptr + x, len, blend, FALSE ))) break;
+            for (i = 0, ptr = dst_ptr + x * 3; i < len; i++, ptr += 3)
+            {
+                ptr[0] = buffer[i];
+                ptr[1] = buffer[i] >> 8;
+                ptr[2] = buffer[i] >> 16;
+            }
+            x += len;
+        }
+#endif
+        for ( ; x < rc->right - rc->left; x++)
         {
             DWORD val = blend_rgb( dst_ptr[x * 3 + 2], dst_ptr[x * 3 + 1], dst_ptr[x * 3],
                                    src_ptr[x], blend );
@@ -6066,17 +6190,47 @@ static inline DWORD aa_rgb( BYTE r_dst, BYTE g_dst, BYTE b_dst, DWORD text, cons
             aa_color( r_dst, text >> 16, range->r_min, range->r_max ) << 16);
 }
 
+/* handle a run of sixteen glyph pixels that are all either transparent or opaque; */
+/* returns the number of pixels done, 0 if the caller has to blend them one by one */
+static inline int draw_glyph_run_32( DWORD *dst, const BYTE *glyph, int len, DWORD text_pixel )
+{
+#ifdef __SSE2__
+    __m128i val, text;
+
+    if (len < 16) return 0;
+    val = _mm_loadu_si128( (const __m128i *)glyph );
+    if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( val, _mm_set1_epi8( 1 )), val )) == 0xffff)
+        return 16;
+    if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_max_epu8( val, _mm_set1_epi8( 16 )), val )) != 0xffff)
+        return 0;
+    text = _mm_set1_epi32( text_pixel );
+    _mm_storeu_si128( (__m128i *)dst, text );
+    _mm_storeu_si128( (__m128i *)dst + 1, text );
+    _mm_storeu_si128( (__m128i *)dst + 2, text );
+    _mm_storeu_si128( (__m128i *)dst + 3, text );
+    return 16;
+#else
+    return 0;
+#endif
+}
+
 static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_info *glyph,
                              const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
 {
     DWORD *dst_ptr = get_pixel_ptr_32( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
-    int x, y;
+    int x, y, run;
 
     for (y = rect->top; y < rect->bottom; y++)
     {
         for (x = 0; x < rect->right - rect->left; x++)
         {
+            if (!(x & 15) && (run = draw_glyph_run_32( dst_ptr + x, glyph_ptr + x,
+                                                       rect->right - rect->left - x, text_pixel )))
+            {
+                x += run - 1;
+                continue;
+            }
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
             dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel, ranges + glyph_ptr[x] );
@@ -6091,7 +6245,7 @@ static void draw_glyph_32( const dib_info *dib, const RECT *rect, const dib_info
 {
     DWORD *dst_ptr = get_pixel_ptr_32( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
-    int x, y;
+    int x, y, run;
     DWORD text, val;
 
     text = get_field( text_pixel, dib->red_shift,   dib->red_len ) << 16 |
@@ -6102,6 +6256,12 @@ static void draw_glyph_32( const dib_info *dib, const RECT *rect, const dib_info
     {
         for (x = 0; x < rect->right - rect->left; x++)
         {
+            if (!(x & 15) && (run = draw_glyph_run_32( dst_ptr + x, glyph_ptr + x,
+                                                       rect->right - rect->left - x, text_pixel )))
+            {
+                x += run - 1;
+                continue;
+            }
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
             val = aa_rgb( get_field(dst_ptr[x], dib->red_shift,   dib->red_len),
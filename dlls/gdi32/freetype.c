@@ -401,6 +401,7 @@ struct font_fileinfo {
 
 struct tagGdiFont {
     struct list entry;
+    struct list hash_entry;
     struct list unused_entry;
     unsigned int refcount;
     GM **gm;
@@ -409,6 +410,7 @@ struct tagGdiFont {
     DWORD total_kern_pairs;
     KERNINGPAIR *kern_pairs;
     struct list child_fonts;
+    struct list glyph_cache;
 
     /* the following members can be accessed without locking, they are never modified after creation */
     FT_Face ft_face;
@@ -464,6 +466,31 @@ static struct list gdi_font_list = LIST_INIT(gdi_font_list);
 static struct list unused_gdi_font_list = LIST_INIT(unused_gdi_font_list);
 static unsigned int unused_font_count;
 #define UNUSED_CACHE_SIZE 10
+#define FONT_HASH_SIZE 256
+static struct list gdi_font_hash[FONT_HASH_SIZE];
+
+/* cache of the glyph bitmaps returned by get_glyph_outline */
+struct cached_glyph
+{
+    struct list  entry;        /* entry in the LRU list */
+    struct list  hash_entry;   /* entry in the hash table */
+    struct list  font_entry;   /* entry in the glyph_cache list of the font */
+    GdiFont     *font;         /* font the glyph was requested from */
+    GdiFont     *linked_font;  /* font the glyph was found in */
+    UINT         index;
+    UINT         format;
+    BOOL         tategaki;
+    GLYPHMETRICS gm;
+    ABC          abc;
+    DWORD        size;
+    BYTE         bits[1];
+};
+
+#define GLYPH_CACHE_HASH_SIZE 1024
+#define GLYPH_CACHE_MAX_SIZE  (4 * 1024 * 1024)
+static struct list glyph_cache_lru = LIST_INIT(glyph_cache_lru);
+static struct list glyph_cache_hash[GLYPH_CACHE_HASH_SIZE];
+static SIZE_T glyph_cache_size;
 static struct list system_links = LIST_INIT(system_links);
 
 static struct list font_subst_list = LIST_INIT(font_subst_list);
@@ -4378,12 +4405,16 @@ BOOL WineEngInit(void)
     HKEY hkey;
     DWORD disposition;
     HANDLE font_mutex;
+    int i;
 
     /* update locale dependent font info in registry */
     update_font_info();
 
     if(!init_freetype()) return FALSE;
 
+    for (i = 0; i < FONT_HASH_SIZE; i++) list_init( &gdi_font_hash[i] );
+    for (i = 0; i < GLYPH_CACHE_HASH_SIZE; i++) list_init( &glyph_cache_hash[i] );
+
 #ifdef SONAME_LIBFONTCONFIG
     init_fontconfig();
 #endif
@@ -4673,14 +4704,77 @@ static GdiFont *alloc_font(void)
     ret->kern_pairs = NULL;
     ret->instance_id = alloc_font_handle(ret);
     list_init(&ret->child_fonts);
+    list_init(&ret->glyph_cache);
     return ret;
 }
 
+static inline struct list *get_glyph_cache_bucket( const GdiFont *font, UINT index, UINT format )
+{
+    UINT hash = ((ULONG_PTR)font >> 4) ^ (index * 31) ^ (format << 7);
+    return &glyph_cache_hash[hash % GLYPH_CACHE_HASH_SIZE];
+}
+
+static void free_cached_glyph( struct cached_glyph *glyph )
+{
+    list_remove( &glyph->entry );
+    list_remove( &glyph->hash_entry );
+    list_remove( &glyph->font_entry );
+    glyph_cache_size -= glyph->size;
+    HeapFree( GetProcessHeap(), 0, glyph );
+}
+
+static struct cached_glyph *find_cached_glyph( GdiFont *font, GdiFont *linked_font, UINT index,
+                                               UINT format, BOOL tategaki )
+{
+    struct cached_glyph *glyph;
+
+    LIST_FOR_EACH_ENTRY( glyph, get_glyph_cache_bucket( font, index, format ), struct cached_glyph, hash_entry )
+    {
+        if (glyph->font != font || glyph->linked_font != linked_font) continue;
+        if (glyph->index != index || glyph->format != format || glyph->tategaki != tategaki) continue;
+        list_remove( &glyph->entry );
+        list_add_head( &glyph_cache_lru, &glyph->entry );
+        return glyph;
+    }
+    return NULL;
+}
+
+static void add_cached_glyph( GdiFont *font, GdiFont *linked_font, UINT index, UINT format, BOOL tategaki,
+                              const GLYPHMETRICS *gm, const ABC *abc, DWORD size, const void *bits )
+{
+    struct cached_glyph *glyph;
+
+    if (size > GLYPH_CACHE_MAX_SIZE / 16) return;
+    if (!(glyph = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( struct cached_glyph, bits[size] )))) return;
+
+    glyph->font        = font;
+    glyph->linked_font = linked_font;
+    glyph->index       = index;
+    glyph->format      = format;
+    glyph->tategaki    = tategaki;
+    glyph->gm          = *gm;
+    glyph->abc         = *abc;
+    glyph->size        = size;
+    memcpy( glyph->bits, bits, size );
+
+    list_add_head( &glyph_cache_lru, &glyph->entry );
+    list_add_head( get_glyph_cache_bucket( font, index, format ), &glyph->hash_entry );
+    list_add_head( &font->glyph_cache, &glyph->font_entry );
+    glyph_cache_size += size;
+
+    while (glyph_cache_size > GLYPH_CACHE_MAX_SIZE)
+        free_cached_glyph( LIST_ENTRY( list_tail( &glyph_cache_lru ), struct cached_glyph, entry ));
+}
+
 static void free_font(GdiFont *font)
 {
     CHILD_FONT *child, *child_next;
+    struct cached_glyph *glyph, *glyph_next;
     DWORD i;
 
+    LIST_FOR_EACH_ENTRY_SAFE( glyph, glyph_next, &font->glyph_cache, struct cached_glyph, font_entry )
+        free_cached_glyph( glyph );
+
     LIST_FOR_EACH_ENTRY_SAFE( child, child_next, &font->child_fonts, CHILD_FONT, entry )
     {
         list_remove(&child->entry);
@@ -4990,6 +5084,7 @@ static void release_font( GdiFont *font )
             font = LIST_ENTRY( list_tail( &unused_gdi_font_list ), struct tagGdiFont, unused_entry );
             TRACE( "freeing %p\n", font );
             list_remove( &font->entry );
+            list_remove( &font->hash_entry );
             list_remove( &font->unused_entry );
             free_font( font );
         }
@@ -5043,12 +5138,14 @@ static GdiFont *find_in_cache(HFONT hfont, const LOGFONTW *plf, const FMAT2 *pma
     calc_hash(&fd);
 
     /* try the in-use list */
-    LIST_FOR_EACH_ENTRY( ret, &gdi_font_list, struct tagGdiFont, entry )
+    LIST_FOR_EACH_ENTRY( ret, &gdi_font_hash[fd.hash % FONT_HASH_SIZE], struct tagGdiFont, hash_entry )
     {
         if(fontcmp(ret, &fd)) continue;
         if(!can_use_bitmap && !FT_IS_SCALABLE(ret->ft_face)) continue;
         list_remove( &ret->entry );
         list_add_head( &gdi_font_list, &ret->entry );
+        list_remove( &ret->hash_entry );
+        list_add_head( &gdi_font_hash[fd.hash % FONT_HASH_SIZE], &ret->hash_entry );
         grab_font( ret );
         return ret;
     }
@@ -5061,6 +5158,7 @@ static void add_to_cache(GdiFont *font)
 
     font->cache_num = cache_num++;
     list_add_head(&gdi_font_list, &font->entry);
+    list_add_head(&gdi_font_hash[font->font_desc.hash % FONT_HASH_SIZE], &font->hash_entry);
     TRACE( "font %p\n", font );
 }
 
@@ -7519,10 +7617,30 @@ static FT_Int get_load_flags( UINT format )
     return load_flags;
 }
 
+/* only the rendered bitmaps are worth caching */
+static inline BOOL is_cached_glyph_format( UINT format )
+{
+    switch (format)
+    {
+    case GGO_BITMAP:
+    case GGO_GRAY2_BITMAP:
+    case GGO_GRAY4_BITMAP:
+    case GGO_GRAY8_BITMAP:
+    case WINE_GGO_GRAY16_BITMAP:
+    case WINE_GGO_HRGB_BITMAP:
+    case WINE_GGO_HBGR_BITMAP:
+    case WINE_GGO_VRGB_BITMAP:
+    case WINE_GGO_VBGR_BITMAP:
+        return TRUE;
+    }
+    return FALSE;
+}
+
 static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
                                LPGLYPHMETRICS lpgm, ABC *abc, DWORD buflen, LPVOID buf,
                                const MAT2* lpmat)
 {
+    struct cached_glyph *cached;
     GLYPHMETRICS gm;
     FT_Face ft_face = incoming_font->ft_face;
     GdiFont *font = incoming_font;
@@ -7535,7 +7653,8 @@ static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
     FT_Matrix matrices[3];
     BOOL needsTransform = FALSE;
     BOOL tategaki = (font->name[0] == '@');
-    BOOL vertical_metrics;
+    BOOL vertical_metrics, use_cache;
+    UINT cache_format;
 
     TRACE("%p, %04x, %08x, %p, %08x, %p, %p\n", font, glyph, format, lpgm,
 	  buflen, buf, lpmat);
@@ -7564,12 +7683,26 @@ static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
             tategaki = check_unicode_tategaki(glyph);
     }
 
+    cache_format = format;  /* GGO_UNHINTED changes the rendering */
     format &= ~GGO_UNHINTED;
 
     if (format == GGO_METRICS && is_identity_MAT2(lpmat) &&
         get_cached_metrics( font, glyph_index, lpgm, abc ))
         return 1; /* FIXME */
 
+    use_cache = is_cached_glyph_format( format ) && is_identity_MAT2(lpmat);
+    if (use_cache && (cached = find_cached_glyph( incoming_font, font, glyph_index, cache_format, tategaki )))
+    {
+        TRACE( "cached glyph %04x format %x size %u\n", glyph_index, cache_format, cached->size );
+        *lpgm = cached->gm;
+        *abc = cached->abc;
+        if (!buf || !buflen) return cached->size;
+        if (cached->size > buflen) return GDI_ERROR;
+        memcpy( buf, cached->bits, cached->size );
+        memset( (BYTE *)buf + cached->size, 0, buflen - cached->size );
+        return cached->size;
+    }
+
     needsTransform = get_transform_matrices( font, tategaki, lpmat, matrices );
 
     vertical_metrics = (tategaki && FT_HAS_VERTICAL(ft_face));
@@ -7699,6 +7832,11 @@ static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
     if (needed != GDI_ERROR)
         *lpgm = gm;
 
+    /* bitmaps copied from bitmap fonts don't initialize the padding, don't cache them */
+    if (use_cache && needed && needed != GDI_ERROR && buf && buflen >= needed &&
+        ft_face->glyph->format == ft_glyph_format_outline)
+        add_cached_glyph( incoming_font, font, glyph_index, cache_format, tategaki, &gm, abc, needed, buf );
+
     return needed;
 }
 
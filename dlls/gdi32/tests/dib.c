@@ -26,6 +26,7 @@
 #include "winbase.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "winreg.h"
 #include "wincrypt.h"
 #include "mmsystem.h" /* DIBINDEX */
 
@@ -3516,11 +3517,366 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+/* blending a whole row goes through the vector code where it is available, blending */
+/* the pixels one at a time through the C code; both have to give the same result */
+static void test_alpha_blend_rows(void)
+{
+    static const int bpps[] = { 32, 24 };
+    static const BLENDFUNCTION blends[] =
+    {
+        { AC_SRC_OVER, 0, 128, 0 },
+        { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA },
+        { AC_SRC_OVER, 0, 77, AC_SRC_ALPHA },
+    };
+    char bmibuf[sizeof(BITMAPINFO) + 256 * sizeof(RGBQUAD)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    const int width = 67;
+    HBITMAP src_dib, row_dib, pixel_dib, orig_src, orig_row, orig_pixel;
+    HDC src_dc, row_dc, pixel_dc;
+    BYTE *src_bits, *row_bits, *pixel_bits;
+    unsigned int seed = 12345;
+    int i, j, x;
+
+    src_dc = CreateCompatibleDC( NULL );
+    row_dc = CreateCompatibleDC( NULL );
+    pixel_dc = CreateCompatibleDC( NULL );
+
+    memset( bmi, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = width;
+    bmi->bmiHeader.biHeight = 1;
+    bmi->bmiHeader.biBitCount = 32;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biCompression = BI_RGB;
+    src_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( src_dib != NULL, "failed to create source dib\n" );
+    orig_src = SelectObject( src_dc, src_dib );
+
+    for (i = 0; i < ARRAY_SIZE(bpps); i++)
+    {
+        bmi->bmiHeader.biBitCount = bpps[i];
+        row_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&row_bits, NULL, 0 );
+        ok( row_dib != NULL, "failed to create %u-bpp dib\n", bpps[i] );
+        pixel_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&pixel_bits, NULL, 0 );
+        ok( pixel_dib != NULL, "failed to create %u-bpp dib\n", bpps[i] );
+        orig_row = SelectObject( row_dc, row_dib );
+        orig_pixel = SelectObject( pixel_dc, pixel_dib );
+
+        for (j = 0; j < ARRAY_SIZE(blends); j++)
+        {
+            /* random pixels, including non-premultiplied ones whose channels overflow */
+            for (x = 0; x < width * 4; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                src_bits[x] = seed >> 16;
+            }
+            for (x = 0; x < width * bpps[i] / 8; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                row_bits[x] = pixel_bits[x] = seed >> 16;
+            }
+
+            GdiAlphaBlend( row_dc, 0, 0, width, 1, src_dc, 0, 0, width, 1, blends[j] );
+            for (x = 0; x < width; x++)
+                GdiAlphaBlend( pixel_dc, x, 0, 1, 1, src_dc, x, 0, 1, 1, blends[j] );
+            ok( !memcmp( row_bits, pixel_bits, width * bpps[i] / 8 ),
+                "%u-bpp: blend %u gives different results for a row and single pixels\n", bpps[i], j );
+        }
+
+        SelectObject( row_dc, orig_row );
+        SelectObject( pixel_dc, orig_pixel );
+        DeleteObject( row_dib );
+        DeleteObject( pixel_dib );
+    }
+
+    SelectObject( src_dc, orig_src );
+    DeleteObject( src_dib );
+    DeleteDC( src_dc );
+    DeleteDC( row_dc );
+    DeleteDC( pixel_dc );
+}
+
+static void test_large_dib_blits(void)
+{
+    static const char text[] = "The quick brown fox jumps over the lazy dog 0123456789";
+    static const int bpps[] = { 32, 24 };
+    char bmibuf[sizeof(BITMAPINFO) + 256 * sizeof(RGBQUAD)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    const int width = 3840, height = 2160, count = 10;
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 128, 0 };
+    HBITMAP dst_dib, src_dib, orig_dst, orig_src;
+    HDC dst_dc, src_dc;
+    DWORD *src_bits, start, stride;
+    BYTE *dst_bits, *ptr;
+    HFONT font, orig_font;
+    int i, j, y, x;
+
+    dst_dc = CreateCompatibleDC( NULL );
+    src_dc = CreateCompatibleDC( NULL );
+
+    memset( bmi, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = width;
+    bmi->bmiHeader.biHeight = -height;
+    bmi->bmiHeader.biBitCount = 32;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biCompression = BI_RGB;
+    src_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( src_dib != NULL, "failed to create source dib\n" );
+    orig_src = SelectObject( src_dc, src_dib );
+
+    font = CreateFontA( 24, 0, 0, 0, FW_NORMAL, 0, 0, 0, ANSI_CHARSET, 0, 0,
+                        ANTIALIASED_QUALITY, 0, "Tahoma" );
+
+    for (i = 0; i < ARRAY_SIZE(bpps); i++)
+    {
+        bmi->bmiHeader.biBitCount = bpps[i];
+        dst_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+        ok( dst_dib != NULL, "failed to create %u-bpp dib\n", bpps[i] );
+        orig_dst = SelectObject( dst_dc, dst_dib );
+        stride = (width * bpps[i] / 8 + 3) & ~3;
+
+        /* constant alpha, opaque blue destination and red source */
+        for (j = 0; j < width * height; j++) src_bits[j] = 0x00ff0000;
+        PatBlt( dst_dc, 0, 0, width, height, BLACKNESS );
+        SetDCBrushColor( dst_dc, RGB( 0, 0, 255 ));
+        SelectObject( dst_dc, GetStockObject( DC_BRUSH ));
+        PatBlt( dst_dc, 0, 0, width, height, PATCOPY );
+        blend.SourceConstantAlpha = 128;
+        blend.AlphaFormat = 0;
+        GdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+        for (y = 0; y < height; y += height - 1)
+            for (x = 0; x < width; x += 777)
+            {
+                ptr = dst_bits + y * stride + x * bpps[i] / 8;
+                ok( abs( ptr[0] - 0x7f ) <= 1 && !ptr[1] && abs( ptr[2] - 0x80 ) <= 1,
+                    "%u-bpp: wrong pixel %02x%02x%02x at %d,%d\n", bpps[i], ptr[2], ptr[1], ptr[0], x, y );
+            }
+
+        /* per-pixel alpha */
+        for (j = 0; j < width * height; j++) src_bits[j] = 0x80800000;
+        PatBlt( dst_dc, 0, 0, width, height, PATCOPY );
+        blend.SourceConstantAlpha = 255;
+        blend.AlphaFormat = AC_SRC_ALPHA;
+        GdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+        for (y = 0; y < height; y += height - 1)
+            for (x = 0; x < width; x += 777)
+            {
+                ptr = dst_bits + y * stride + x * bpps[i] / 8;
+                ok( abs( ptr[0] - 0x7f ) <= 1 && !ptr[1] && ptr[2] == 0x80,
+                    "%u-bpp: wrong pixel %02x%02x%02x at %d,%d\n", bpps[i], ptr[2], ptr[1], ptr[0], x, y );
+            }
+
+        /* the timings are only interesting when benchmarking */
+        if (winetest_interactive)
+        {
+            start = GetTickCount();
+            for (j = 0; j < count; j++)
+                GdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+            trace( "%u-bpp: AlphaBlend %u ms per %ux%u blit\n", bpps[i],
+                   (GetTickCount() - start) / count, width, height );
+
+            start = GetTickCount();
+            for (j = 0; j < count; j++)
+                StretchBlt( dst_dc, 0, 0, width, height, src_dc, 0, 0, width / 2 + j, height / 2 + j, SRCCOPY );
+            trace( "%u-bpp: StretchBlt %u ms per %ux%u blit\n", bpps[i],
+                   (GetTickCount() - start) / count, width, height );
+
+            orig_font = SelectObject( dst_dc, font );
+            SetBkMode( dst_dc, TRANSPARENT );
+            start = GetTickCount();
+            for (j = 0; j < count; j++)
+                for (y = 0; y < height; y += 24)
+                    ExtTextOutA( dst_dc, j, y, 0, NULL, text, strlen(text), NULL );
+            trace( "%u-bpp: ExtTextOut %u ms per %ux%u page of text\n", bpps[i],
+                   (GetTickCount() - start) / count, width, height );
+            SelectObject( dst_dc, orig_font );
+        }
+
+        SelectObject( dst_dc, orig_dst );
+        DeleteObject( dst_dib );
+    }
+
+    DeleteObject( font );
+    SelectObject( src_dc, orig_src );
+    DeleteObject( src_dib );
+    DeleteDC( src_dc );
+    DeleteDC( dst_dc );
+}
+
+/* render operations large enough to be split into bands, and return the hashes of the results */
+static void render_large_operations( char hashes[2][41] )
+{
+    static const int bpps[] = { 32, 24 };
+    static const BLENDFUNCTION blends[] =
+    {
+        { AC_SRC_OVER, 0, 128, 0 },
+        { AC_SRC_OVER, 0, 200, AC_SRC_ALPHA },
+    };
+    char bmibuf[sizeof(BITMAPINFO) + 256 * sizeof(RGBQUAD)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    const int width = 800, height = 600;  /* above the 512x512 pixels needed to split the rendering */
+    TRIVERTEX vrect[] =
+    {
+        { 0,     0,      0xff00, 0x0000, 0x8000, 0x0000 },
+        { width, height, 0x0000, 0xff00, 0x4000, 0x0000 },
+    };
+    TRIVERTEX vtri[] =
+    {
+        { 0,         0,      0xff00, 0x0000, 0x0000, 0x0000 },
+        { width,     50,     0x0000, 0xff00, 0x0000, 0x0000 },
+        { width / 3, height, 0x0000, 0x0000, 0xff00, 0x0000 },
+    };
+    GRADIENT_RECT rect = { 0, 1 };
+    GRADIENT_TRIANGLE tri = { 0, 1, 2 };
+    HBITMAP dst_dib, src_dib, orig_dst, orig_src;
+    HDC dst_dc, src_dc;
+    BYTE *dst_bits, *src_bits;
+    unsigned int seed = 54321;
+    char *hash;
+    int i, j, x;
+
+    dst_dc = CreateCompatibleDC( NULL );
+    src_dc = CreateCompatibleDC( NULL );
+
+    memset( bmi, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = width;
+    bmi->bmiHeader.biHeight = -height;
+    bmi->bmiHeader.biBitCount = 32;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biCompression = BI_RGB;
+    src_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( src_dib != NULL, "failed to create source dib\n" );
+    orig_src = SelectObject( src_dc, src_dib );
+
+    for (i = 0; i < ARRAY_SIZE(bpps); i++)
+    {
+        hashes[i][0] = 0;
+        bmi->bmiHeader.biBitCount = bpps[i];
+        dst_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+        ok( dst_dib != NULL, "failed to create %u-bpp dib\n", bpps[i] );
+        orig_dst = SelectObject( dst_dc, dst_dib );
+
+        for (x = 0; x < width * height * 4; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            src_bits[x] = seed >> 16;
+        }
+        for (x = 0; x < width * height * bpps[i] / 8; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            dst_bits[x] = seed >> 16;
+        }
+
+        for (j = 0; j < ARRAY_SIZE(blends); j++)
+        {
+            GdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blends[j] );
+            GdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 10, 10, width / 2, height / 2, blends[j] );
+        }
+
+        GdiGradientFill( dst_dc, vrect, 2, &rect, 1, GRADIENT_FILL_RECT_H );
+        GdiGradientFill( dst_dc, vtri, 3, &tri, 1, GRADIENT_FILL_TRIANGLE );
+        GdiGradientFill( dst_dc, vrect, 2, &rect, 1, GRADIENT_FILL_RECT_V );
+        GdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blends[1] );
+
+        /* enlarging, shrinking and mirroring */
+        SetStretchBltMode( dst_dc, COLORONCOLOR );
+        StretchBlt( dst_dc, 0, 0, width, height, src_dc, 3, 5, width / 3, height / 2, SRCCOPY );
+        StretchBlt( dst_dc, width - 1, 0, -width, height, src_dc, 0, 0, width, height, SRCCOPY );
+        SetStretchBltMode( dst_dc, BLACKONWHITE );
+        StretchDIBits( dst_dc, 0, height / 6, width, height * 2 / 3, 0, 0, width, height,
+                       src_bits, bmi, DIB_RGB_COLORS, SRCCOPY );
+        SetStretchBltMode( dst_dc, WHITEONBLACK );
+        StretchDIBits( dst_dc, 0, 0, width * 2 / 3, height, 0, 0, width, height,
+                       src_bits, bmi, DIB_RGB_COLORS, SRCINVERT );
+
+        if ((hash = hash_dib( dst_dc, bmi, dst_bits )))
+        {
+            strcpy( hashes[i], hash );
+            HeapFree( GetProcessHeap(), 0, hash );
+        }
+
+        SelectObject( dst_dc, orig_dst );
+        DeleteObject( dst_dib );
+    }
+
+    SelectObject( src_dc, orig_src );
+    DeleteObject( src_dib );
+    DeleteDC( src_dc );
+    DeleteDC( dst_dc );
+}
+
+/* compare large operations rendered on several threads to the serial results in a child process */
+static void test_render_threads(const char *argv0)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmd[MAX_PATH + 100], hashes[2][41];
+    DWORD disposition;
+    HKEY key;
+    LONG ret;
+
+    render_large_operations( hashes );
+    if (!hashes[0][0] || !hashes[1][0])
+    {
+        skip( "failed to hash the rendered images\n" );
+        return;
+    }
+
+    ret = RegCreateKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\GDI", 0, NULL, 0, KEY_ALL_ACCESS,
+                           NULL, &key, &disposition );
+    ok( !ret, "RegCreateKeyEx failed %d\n", ret );
+    if (ret) return;
+    ret = RegSetValueExA( key, "RenderThreads", 0, REG_SZ, (const BYTE *)"4", 2 );
+    ok( !ret, "RegSetValueEx failed %d\n", ret );
+
+    sprintf( cmd, "%s dib render_threads %s %s", argv0, hashes[0], hashes[1] );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ok( CreateProcessA( NULL, cmd, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+        "CreateProcess failed\n" );
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+
+    RegDeleteValueA( key, "RenderThreads" );
+    RegCloseKey( key );
+    if (disposition == REG_CREATED_NEW_KEY) RegDeleteKeyA( HKEY_CURRENT_USER, "Software\\Wine\\GDI" );
+}
+
+static void render_threads_child( char **argv )
+{
+    char hashes[2][41];
+    SYSTEM_INFO info;
+
+    /* the number of render threads is limited to the number of CPUs */
+    GetSystemInfo( &info );
+    if (info.dwNumberOfProcessors < 2) skip( "only one CPU, the rendering is not split\n" );
+
+    test_simple_graphics();
+    render_large_operations( hashes );
+    ok( !strcmp( hashes[0], argv[3] ), "32-bpp: got hash %s, expected %s\n", hashes[0], argv[3] );
+    ok( !strcmp( hashes[1], argv[4] ), "24-bpp: got hash %s, expected %s\n", hashes[1], argv[4] );
+}
+
 START_TEST(dib)
 {
+    char **argv;
+    int argc = winetest_get_mainargs( &argv );
+
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
+    if (argc >= 5 && !strcmp( argv[2], "render_threads" ))
+    {
+        render_threads_child( argv );
+        CryptReleaseContext(crypt_prov, 0);
+        return;
+    }
     test_simple_graphics();
+    test_alpha_blend_rows();
+    test_large_dib_blits();
+    test_render_threads( argv[0] );
 
     CryptReleaseContext(crypt_prov, 0);
 }
@@ -5860,6 +5860,90 @@ todo_wine
     ReleaseDC(NULL, hdc);
 }
 
+static void test_glyph_bitmap_cache(void)
+{
+    static const UINT formats[] = { GGO_BITMAP, GGO_GRAY2_BITMAP, GGO_GRAY4_BITMAP, GGO_GRAY8_BITMAP };
+    static const char text[] = "The quick brown fox jumps over the lazy dog";
+    /* a single pass exercises the cached glyphs, more are only useful for benchmarking */
+    const int iterations = winetest_interactive ? 100 : 1;
+    BYTE buf1[4096], buf2[4096];
+    GLYPHMETRICS gm1, gm2;
+    DWORD size1, size2, start;
+    HFONT hfont, hfont_prev;
+    HBITMAP dib, dib_prev;
+    BITMAPINFO bmi;
+    LOGFONTA lf;
+    void *bits;
+    HDC hdc;
+    int i, j, c;
+
+    if (!is_truetype_font_installed("Tahoma"))
+    {
+        skip("Tahoma is not installed\n");
+        return;
+    }
+
+    memset(&lf, 0, sizeof(lf));
+    lf.lfHeight = -24;
+    lstrcpyA(lf.lfFaceName, "Tahoma");
+    hfont = CreateFontIndirectA(&lf);
+    ok(hfont != 0, "CreateFontIndirectA error %u\n", GetLastError());
+
+    hdc = CreateCompatibleDC(0);
+    hfont_prev = SelectObject(hdc, hfont);
+
+    /* the same glyph must be returned every time, whatever the initial buffer contents */
+    for (i = 0; i < ARRAY_SIZE(formats); i++)
+    {
+        for (c = '!'; c <= '~'; c++)
+        {
+            memset(buf1, 0xcc, sizeof(buf1));
+            memset(buf2, 0x55, sizeof(buf2));
+            size1 = GetGlyphOutlineA(hdc, c, formats[i], &gm1, sizeof(buf1), buf1, &mat);
+            ok(size1 != GDI_ERROR, "format %u char %c: GetGlyphOutline failed\n", formats[i], c);
+            if (size1 == GDI_ERROR) continue;
+            size2 = GetGlyphOutlineA(hdc, c, formats[i], &gm2, sizeof(buf2), buf2, &mat);
+            ok(size2 == size1, "format %u char %c: got size %u, expected %u\n", formats[i], c, size2, size1);
+            ok(!memcmp(&gm1, &gm2, sizeof(gm1)), "format %u char %c: metrics differ\n", formats[i], c);
+            ok(!memcmp(buf1, buf2, size1), "format %u char %c: bitmaps differ\n", formats[i], c);
+            size2 = GetGlyphOutlineA(hdc, c, formats[i], &gm2, 0, NULL, &mat);
+            ok(size2 == size1, "format %u char %c: got size %u, expected %u\n", formats[i], c, size2, size1);
+        }
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < iterations; i++)
+        for (c = '!'; c <= '~'; c++)
+            GetGlyphOutlineA(hdc, c, GGO_GRAY8_BITMAP, &gm1, sizeof(buf1), buf1, &mat);
+    if (winetest_interactive)
+        trace("GetGlyphOutline: %u glyphs in %u ms\n", iterations * ('~' - '!' + 1), GetTickCount() - start);
+
+    memset(&bmi, 0, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = 1024;
+    bmi.bmiHeader.biHeight = 1024;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    dib = CreateDIBSection(0, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    ok(dib != NULL, "CreateDIBSection failed\n");
+    dib_prev = SelectObject(hdc, dib);
+
+    start = GetTickCount();
+    for (i = 0; i < iterations; i++)
+        for (j = 0; j < 1024; j += 24)
+            ExtTextOutA(hdc, i % 16, j, 0, NULL, text, strlen(text), NULL);
+    if (winetest_interactive)
+        trace("ExtTextOut: %u characters in %u ms\n", iterations * (1024 / 24 + 1) * (int)strlen(text),
+              GetTickCount() - start);
+
+    SelectObject(hdc, dib_prev);
+    DeleteObject(dib);
+    SelectObject(hdc, hfont_prev);
+    DeleteObject(hfont);
+    DeleteDC(hdc);
+}
+
 static void test_fstype_fixup(void)
 {
     HDC hdc;
@@ -7271,6 +7355,7 @@ START_TEST(font)
     test_bitmap_font_glyph_index();
     test_GetCharWidthI();
     test_long_names();
+    test_glyph_bitmap_cache();
 
     /* These tests should be last test until RemoveFontResource
      * is properly implemented.
@@ -4755,6 +4755,57 @@ static void test_file_access(void)
     }
 }
 
+static void test_file_dup(void)
+{
+    char path[MAX_PATH], fname[MAX_PATH], buf[16];
+    HANDLE hfile, hdup, hread;
+    DWORD ret, bytes;
+
+    GetTempPathA(MAX_PATH, path);
+    GetTempFileNameA(path, "foo", 0, fname);
+
+    hfile = CreateFileA(fname, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_DELETE_ON_CLOSE, 0);
+    ok(hfile != INVALID_HANDLE_VALUE, "CreateFile error %d\n", GetLastError());
+    ret = WriteFile(hfile, "hello world", 11, &bytes, NULL);
+    ok(ret && bytes == 11, "WriteFile error %d\n", GetLastError());
+
+    ret = DuplicateHandle(GetCurrentProcess(), hfile, GetCurrentProcess(), &hdup,
+                          0, FALSE, DUPLICATE_SAME_ACCESS);
+    ok(ret, "DuplicateHandle error %d\n", GetLastError());
+    ret = DuplicateHandle(GetCurrentProcess(), hfile, GetCurrentProcess(), &hread,
+                          GENERIC_READ, FALSE, 0);
+    ok(ret, "DuplicateHandle error %d\n", GetLastError());
+
+    /* the file position is shared between the handles */
+    SetFilePointer(hfile, 0, NULL, FILE_BEGIN);
+    memset(buf, 0, sizeof(buf));
+    ret = ReadFile(hdup, buf, 5, &bytes, NULL);
+    ok(ret && bytes == 5, "ReadFile error %d\n", GetLastError());
+    ok(!memcmp(buf, "hello", 5), "got %s\n", buf);
+    ret = ReadFile(hread, buf, 6, &bytes, NULL);
+    ok(ret && bytes == 6, "ReadFile error %d\n", GetLastError());
+    ok(!memcmp(buf, " world", 6), "got %s\n", buf);
+
+    SetLastError(0xdeadbeef);
+    ret = WriteFile(hread, "!", 1, &bytes, NULL);
+    ok(!ret, "WriteFile should fail\n");
+    ok(GetLastError() == ERROR_ACCESS_DENIED, "expected ERROR_ACCESS_DENIED, got %d\n", GetLastError());
+
+    /* the duplicated handles still work once the source is closed */
+    CloseHandle(hfile);
+    ret = WriteFile(hdup, "!", 1, &bytes, NULL);
+    ok(ret && bytes == 1, "WriteFile error %d\n", GetLastError());
+    SetFilePointer(hread, 0, NULL, FILE_BEGIN);
+    memset(buf, 0, sizeof(buf));
+    ret = ReadFile(hread, buf, sizeof(buf), &bytes, NULL);
+    ok(ret && bytes == 12, "ReadFile error %d\n", GetLastError());
+    ok(!memcmp(buf, "hello world!", 12), "got %s\n", buf);
+
+    CloseHandle(hread);
+    CloseHandle(hdup);
+}
+
 static void test_GetFinalPathNameByHandleA(void)
 {
     static char prefix[] = "GetFinalPathNameByHandleA";
@@ -5278,6 +5329,330 @@ static void test_overlapped_read(void)
     ok(ret, "Unexpected error %u.\n", GetLastError());
 }
 
+#define QUEUE_BLOCK_SIZE  4096
+#define QUEUE_BLOCK_COUNT 1024
+
+/* run random reads with a given number of them in flight */
+static void check_overlapped_queue_depth(const char *file_name, DWORD total)
+{
+    static const DWORD depths[] = { 1, 8, 32 };
+    HANDLE hfile, events[32];
+    OVERLAPPED ov[32];
+    DWORD *blocks[32];
+    DWORD i, j, d, ret, count, submitted, completed, start, elapsed;
+    unsigned int seed = 0;
+    char *buffer;
+
+    buffer = VirtualAlloc(NULL, QUEUE_BLOCK_SIZE * ARRAY_SIZE(events), MEM_COMMIT, PAGE_READWRITE);
+    ok(buffer != NULL, "VirtualAlloc failed %u\n", GetLastError());
+
+    hfile = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_FLAG_OVERLAPPED, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "Failed to open file, GetLastError() %u.\n", GetLastError());
+
+    for (i = 0; i < ARRAY_SIZE(events); i++)
+    {
+        events[i] = CreateEventA(NULL, TRUE, FALSE, NULL);
+        blocks[i] = (DWORD *)(buffer + i * QUEUE_BLOCK_SIZE);
+    }
+
+    for (d = 0; d < ARRAY_SIZE(depths); d++)
+    {
+        DWORD expect[32];
+        BOOL busy[32] = { FALSE };
+
+        submitted = completed = 0;
+        start = GetTickCount();
+        while (completed < total)
+        {
+            /* keep depths[d] reads in flight */
+            for (i = 0; i < depths[d] && submitted < total; i++)
+            {
+                if (busy[i]) continue;
+                j = (seed = seed * 1103515245 + 12345) % QUEUE_BLOCK_COUNT;
+                memset(&ov[i], 0, sizeof(ov[i]));
+                S(U(ov[i])).Offset = j * QUEUE_BLOCK_SIZE;
+                ov[i].hEvent = events[i];
+                expect[i] = j;
+                *blocks[i] = ~0u;
+                ret = ReadFile(hfile, blocks[i], QUEUE_BLOCK_SIZE, NULL, &ov[i]);
+                ok(ret || GetLastError() == ERROR_IO_PENDING,
+                        "ReadFile failed, error %u.\n", GetLastError());
+                busy[i] = TRUE;
+                submitted++;
+            }
+
+            ret = WaitForMultipleObjects(depths[d], events, FALSE, 5000);
+            ok(ret < WAIT_OBJECT_0 + depths[d], "wait failed %#x, error %u.\n", ret, GetLastError());
+            if (ret >= WAIT_OBJECT_0 + depths[d]) break;
+            i = ret - WAIT_OBJECT_0;
+
+            ret = GetOverlappedResult(hfile, &ov[i], &count, FALSE);
+            ok(ret && count == QUEUE_BLOCK_SIZE, "GetOverlappedResult failed, ret %#x, count %u, error %u.\n",
+                    ret, count, GetLastError());
+            ok(*blocks[i] == expect[i], "got block %u, expected %u.\n", *blocks[i], expect[i]);
+            ResetEvent(events[i]);
+            busy[i] = FALSE;
+            completed++;
+        }
+        elapsed = GetTickCount() - start;
+        if (winetest_interactive)
+            trace("queue depth %u: %u reads in %u ms (%u IOPS)\n", depths[d], completed, elapsed,
+                    elapsed ? completed * 1000 / elapsed : 0);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(events); i++) CloseHandle(events[i]);
+    CloseHandle(hfile);
+    VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+/* check the results and the order of the completion notifications of concurrent requests */
+static void check_overlapped_completions(const char *file_name)
+{
+    HANDLE hfile, port, events[32];
+    OVERLAPPED ov[32], *povl;
+    DWORD *blocks[32];
+    BOOL seen[32] = { FALSE };
+    DWORD i, ret, count;
+    ULONG_PTR key;
+    char *buffer;
+
+    buffer = VirtualAlloc(NULL, QUEUE_BLOCK_SIZE * ARRAY_SIZE(events), MEM_COMMIT, PAGE_READWRITE);
+    ok(buffer != NULL, "VirtualAlloc failed %u\n", GetLastError());
+
+    hfile = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_FLAG_OVERLAPPED, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "Failed to open file, GetLastError() %u.\n", GetLastError());
+    port = CreateIoCompletionPort(hfile, NULL, 0xabc, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed, error %u.\n", GetLastError());
+
+    for (i = 0; i < ARRAY_SIZE(events); i++)
+    {
+        events[i] = CreateEventA(NULL, TRUE, FALSE, NULL);
+        blocks[i] = (DWORD *)(buffer + i * QUEUE_BLOCK_SIZE);
+        *blocks[i] = ~0u;
+        memset(&ov[i], 0, sizeof(ov[i]));
+        S(U(ov[i])).Offset = (QUEUE_BLOCK_COUNT - 1 - 3 * i) * QUEUE_BLOCK_SIZE;
+        ov[i].hEvent = events[i];
+        ret = ReadFile(hfile, blocks[i], QUEUE_BLOCK_SIZE, NULL, &ov[i]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u.\n", GetLastError());
+    }
+
+    /* the status and the event must be set when the completion packet is queued */
+    for (i = 0; i < ARRAY_SIZE(events); i++)
+    {
+        ret = GetQueuedCompletionStatus(port, &count, &key, &povl, 5000);
+        ok(ret, "GetQueuedCompletionStatus failed, error %u.\n", GetLastError());
+        if (!ret) break;
+        ok(key == 0xabc, "got key %#x.\n", (DWORD)key);
+        ok(count == QUEUE_BLOCK_SIZE, "got count %u.\n", count);
+        ok(povl >= ov && povl < ov + ARRAY_SIZE(ov), "got overlapped %p.\n", povl);
+        if (povl < ov || povl >= ov + ARRAY_SIZE(ov)) break;
+        ok(!seen[povl - ov], "request %u completed twice.\n", (DWORD)(povl - ov));
+        seen[povl - ov] = TRUE;
+        ok(povl->Internal == STATUS_SUCCESS, "got status %#x.\n", (DWORD)povl->Internal);
+        ok(povl->InternalHigh == QUEUE_BLOCK_SIZE, "got size %u.\n", (DWORD)povl->InternalHigh);
+        ok(!WaitForSingleObject(povl->hEvent, 0), "event of request %u not signaled.\n", (DWORD)(povl - ov));
+        ok(*blocks[povl - ov] == QUEUE_BLOCK_COUNT - 1 - 3 * (povl - ov), "request %u: got block %u.\n",
+                (DWORD)(povl - ov), *blocks[povl - ov]);
+    }
+    ret = GetQueuedCompletionStatus(port, &count, &key, &povl, 0);
+    ok(!ret && GetLastError() == WAIT_TIMEOUT, "got ret %u, error %u.\n", ret, GetLastError());
+
+    /* a read issued after a write has completed sees the new data */
+    for (i = 0; i < 4; i++)
+    {
+        *blocks[0] = 0x10000 + i;
+        ResetEvent(events[0]);
+        memset(&ov[0], 0, sizeof(ov[0]));
+        S(U(ov[0])).Offset = i * QUEUE_BLOCK_SIZE;
+        ov[0].hEvent = events[0];
+        ret = WriteFile(hfile, blocks[0], QUEUE_BLOCK_SIZE, NULL, &ov[0]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u.\n", GetLastError());
+        ret = GetOverlappedResult(hfile, &ov[0], &count, TRUE);
+        ok(ret && count == QUEUE_BLOCK_SIZE, "write failed, ret %#x, count %u, error %u.\n",
+                ret, count, GetLastError());
+
+        *blocks[1] = ~0u;
+        ResetEvent(events[1]);
+        memset(&ov[1], 0, sizeof(ov[1]));
+        S(U(ov[1])).Offset = i * QUEUE_BLOCK_SIZE;
+        ov[1].hEvent = events[1];
+        ret = ReadFile(hfile, blocks[1], QUEUE_BLOCK_SIZE, NULL, &ov[1]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u.\n", GetLastError());
+        ret = GetOverlappedResult(hfile, &ov[1], &count, TRUE);
+        ok(ret && count == QUEUE_BLOCK_SIZE, "read failed, ret %#x, count %u, error %u.\n",
+                ret, count, GetLastError());
+        ok(*blocks[1] == 0x10000 + i, "got %#x.\n", *blocks[1]);
+
+        /* restore the block for the next runs */
+        *blocks[0] = i;
+        ResetEvent(events[0]);
+        ret = WriteFile(hfile, blocks[0], QUEUE_BLOCK_SIZE, NULL, &ov[0]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u.\n", GetLastError());
+        ret = GetOverlappedResult(hfile, &ov[0], &count, TRUE);
+        ok(ret && count == QUEUE_BLOCK_SIZE, "write failed, ret %#x, count %u, error %u.\n",
+                ret, count, GetLastError());
+    }
+    /* drain the packets of the last requests */
+    while (GetQueuedCompletionStatus(port, &count, &key, &povl, 0));
+
+    for (i = 0; i < ARRAY_SIZE(events); i++) CloseHandle(events[i]);
+    CloseHandle(hfile);
+    CloseHandle(port);
+    VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+static void test_overlapped_queue_depth(void)
+{
+    /* the large count is only useful for benchmarking */
+    const DWORD total = winetest_interactive ? 4096 : 256;
+    char temp_path[MAX_PATH], file_name[MAX_PATH], cmdline[2 * MAX_PATH];
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    HANDLE hfile;
+    DWORD i, ret, count;
+    char **argv;
+    char *buffer;
+
+    ret = GetTempPathA(MAX_PATH, temp_path);
+    ok(ret, "Unexpected error %u.\n", GetLastError());
+    ret = GetTempFileNameA(temp_path, "pfx", 0, file_name);
+    ok(ret, "Unexpected error %u.\n", GetLastError());
+
+    buffer = VirtualAlloc(NULL, QUEUE_BLOCK_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    ok(buffer != NULL, "VirtualAlloc failed %u\n", GetLastError());
+
+    hfile = CreateFileA(file_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "Failed to create file, GetLastError() %u.\n", GetLastError());
+    for (i = 0; i < QUEUE_BLOCK_COUNT; i++)
+    {
+        memset(buffer, 0, QUEUE_BLOCK_SIZE);
+        *(DWORD *)buffer = i;
+        ret = WriteFile(hfile, buffer, QUEUE_BLOCK_SIZE, &count, NULL);
+        ok(ret && count == QUEUE_BLOCK_SIZE, "WriteFile failed, ret %#x, count %u, error %u.\n",
+                ret, count, GetLastError());
+    }
+    CloseHandle(hfile);
+    VirtualFree(buffer, 0, MEM_RELEASE);
+
+    check_overlapped_queue_depth(file_name, total);
+    check_overlapped_completions(file_name);
+
+    /* run the same checks in a child process with the Wine io_uring support enabled */
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" file queue_depth \"%s\" %u", argv[0], file_name, total);
+    SetEnvironmentVariableA("WINEIOURING", "1");
+    ret = CreateProcessA(argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "CreateProcess failed, error %u.\n", GetLastError());
+    SetEnvironmentVariableA("WINEIOURING", NULL);
+    if (ret)
+    {
+        winetest_wait_child_process(pi.hProcess);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+    }
+
+    ret = DeleteFileA(file_name);
+    ok(ret, "Unexpected error %u.\n", GetLastError());
+}
+
+static void test_mixed_case_open(void)
+{
+    /* a couple of lookups per file check the cache, the large count is only for benchmarking */
+    const DWORD file_count = winetest_interactive ? 500 : 50;
+    const DWORD total = winetest_interactive ? 100000 : 2 * file_count;
+    char temp_path[MAX_PATH], dir_name[MAX_PATH], file_name[MAX_PATH], short_name[MAX_PATH];
+    DWORD i, j, ret, start, elapsed;
+    HANDLE hfile;
+    char *p;
+
+    ret = GetTempPathA(MAX_PATH, temp_path);
+    ok(ret, "Unexpected error %u.\n", GetLastError());
+    sprintf(dir_name, "%sWineMixedCase", temp_path);
+    ret = CreateDirectoryA(dir_name, NULL);
+    ok(ret, "CreateDirectory failed, error %u.\n", GetLastError());
+
+    for (i = 0; i < file_count; i++)
+    {
+        sprintf(file_name, "%s\\SubDir%u.Tmp", dir_name, i % 4);
+        CreateDirectoryA(file_name, NULL);
+        sprintf(file_name, "%s\\SubDir%u.Tmp\\MixedCaseFile%u.Txt", dir_name, i % 4, i);
+        hfile = CreateFileA(file_name, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        ok(hfile != INVALID_HANDLE_VALUE, "failed to create %s, error %u.\n", file_name, GetLastError());
+        CloseHandle(hfile);
+    }
+
+    /* directories modified in the last seconds may not be cached */
+    Sleep(2500);
+
+    start = GetTickCount();
+    for (i = 0; i < total; i++)
+    {
+        j = (i * 7919) % file_count;
+        sprintf(file_name, "%s\\SUBDIR%u.TMP\\mixedcasefile%u.TXT", dir_name, j % 4, j);
+        /* vary the case of the file name */
+        for (p = strrchr(file_name, '\\') + 1; *p; p++)
+            if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'z' && (i + (p - file_name)) % 3 == 0) *p ^= 0x20;
+        hfile = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+        ok(hfile != INVALID_HANDLE_VALUE, "failed to open %s, error %u.\n", file_name, GetLastError());
+        if (hfile == INVALID_HANDLE_VALUE) break;
+        CloseHandle(hfile);
+    }
+    elapsed = GetTickCount() - start;
+    if (winetest_interactive)
+        trace("opened %u mixed case paths in %u ms\n", i, elapsed);
+
+    /* generated short names are looked up through the cache too */
+    sprintf(file_name, "%s\\SubDir1.Tmp\\MixedCaseFile1.Txt", dir_name);
+    ret = GetShortPathNameA(file_name, short_name, MAX_PATH);
+    ok(ret && ret < MAX_PATH, "GetShortPathName failed, error %u.\n", GetLastError());
+    ok(strcmp(short_name, file_name), "got the long name %s.\n", short_name);
+    for (p = strrchr(short_name, '\\') + 1; *p; p++) *p = tolower(*p);
+    hfile = CreateFileA(short_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "failed to open %s, error %u.\n", short_name, GetLastError());
+    CloseHandle(hfile);
+
+    /* a file deleted after the directory got cached */
+    sprintf(file_name, "%s\\SubDir2.Tmp\\MixedCaseFile2.Txt", dir_name);
+    ret = DeleteFileA(file_name);
+    ok(ret, "DeleteFile failed, error %u.\n", GetLastError());
+    sprintf(file_name, "%s\\SUBDIR2.TMP\\MIXEDCASEFILE2.TXT", dir_name);
+    hfile = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    ok(hfile == INVALID_HANDLE_VALUE && GetLastError() == ERROR_FILE_NOT_FOUND,
+            "got %p, error %u.\n", hfile, GetLastError());
+
+    sprintf(file_name, "%s\\SubDir0.Tmp\\MissingFile.Txt", dir_name);
+    hfile = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    ok(hfile == INVALID_HANDLE_VALUE && GetLastError() == ERROR_FILE_NOT_FOUND,
+            "got %p, error %u.\n", hfile, GetLastError());
+
+    /* files created after the directory got cached */
+    sprintf(file_name, "%s\\SubDir0.Tmp\\NewFile.Txt", dir_name);
+    hfile = CreateFileA(file_name, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "failed to create %s, error %u.\n", file_name, GetLastError());
+    CloseHandle(hfile);
+    sprintf(file_name, "%s\\SUBDIR0.TMP\\NEWFILE.TXT", dir_name);
+    hfile = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "failed to open %s, error %u.\n", file_name, GetLastError());
+    CloseHandle(hfile);
+    ret = DeleteFileA(file_name);
+    ok(ret, "DeleteFile failed, error %u.\n", GetLastError());
+
+    for (i = 0; i < file_count; i++)
+    {
+        sprintf(file_name, "%s\\SubDir%u.Tmp\\MixedCaseFile%u.Txt", dir_name, i % 4, i);
+        DeleteFileA(file_name);
+    }
+    for (i = 0; i < 4; i++)
+    {
+        sprintf(file_name, "%s\\SubDir%u.Tmp", dir_name, i);
+        RemoveDirectoryA(file_name);
+    }
+    ret = RemoveDirectoryA(dir_name);
+    ok(ret, "RemoveDirectory failed, error %u.\n", GetLastError());
+}
+
 static void test_file_readonly_access(void)
 {
     static const DWORD default_sharing = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
@@ -5413,10 +5788,18 @@ static void test_SetFileTime(void)
 START_TEST(file)
 {
     char temp_path[MAX_PATH];
+    char **argv;
     DWORD ret;
 
     InitFunctionPointers();
 
+    if (winetest_get_mainargs(&argv) >= 5 && !strcmp(argv[2], "queue_depth"))
+    {
+        check_overlapped_queue_depth(argv[3], atoi(argv[4]));
+        check_overlapped_completions(argv[3]);
+        return;
+    }
+
     ret = GetTempPathA(MAX_PATH, temp_path);
     ok(ret != 0, "GetTempPath error %u\n", GetLastError());
     ret = GetTempFileNameA(temp_path, "tmp", 0, filename);
@@ -5474,12 +5857,15 @@ START_TEST(file)
     test_SetFileValidData();
     test_WriteFileGather();
     test_file_access();
+    test_file_dup();
     test_GetFinalPathNameByHandleA();
     test_GetFinalPathNameByHandleW();
     test_SetFileInformationByHandle();
     test_GetFileAttributesExW();
     test_post_completion();
     test_overlapped_read();
+    test_overlapped_queue_depth();
+    test_mixed_case_open();
     test_file_readonly_access();
     test_find_file_stream();
     test_SetFileTime();
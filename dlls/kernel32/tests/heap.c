@@ -39,6 +39,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static BOOL (WINAPI *pGetPhysicallyInstalledSystemMemory)(ULONGLONG *);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
@@ -892,6 +893,142 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+struct lfh_thread_params
+{
+    HANDLE heap;
+    HANDLE start;
+    LONG   count;
+    unsigned int iterations;
+};
+
+static DWORD WINAPI lfh_thread( void *arg )
+{
+    struct lfh_thread_params *params = arg;
+    BYTE *ptrs[64];
+    unsigned int i, j, errors = 0;
+
+    WaitForSingleObject( params->start, INFINITE );
+    for (i = 0; i < params->iterations; i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(ptrs); j++)
+        {
+            if (!(ptrs[j] = HeapAlloc( params->heap, 0, 8 + (j % 16) * 24 ))) break;
+            memset( ptrs[j], j, 8 );
+        }
+        if (j < ARRAY_SIZE(ptrs)) errors++;
+        while (j--)
+        {
+            if (ptrs[j][0] != j || ptrs[j][7] != j) errors++;
+            if (!HeapFree( params->heap, 0, ptrs[j] )) errors++;
+        }
+        InterlockedExchangeAdd( &params->count, ARRAY_SIZE(ptrs) );
+    }
+    ok( !errors, "got %u errors\n", errors );
+    return 0;
+}
+
+static void test_lfh_threads( HANDLE heap, unsigned int count, unsigned int iterations )
+{
+    struct lfh_thread_params params;
+    HANDLE threads[8];
+    DWORD start, elapsed;
+    unsigned int i;
+
+    params.heap = heap;
+    params.start = CreateEventA( NULL, TRUE, FALSE, NULL );
+    params.count = 0;
+    params.iterations = iterations;
+    for (i = 0; i < count; i++) threads[i] = CreateThread( NULL, 0, lfh_thread, &params, 0, NULL );
+
+    start = GetTickCount();
+    SetEvent( params.start );
+    WaitForMultipleObjects( count, threads, TRUE, INFINITE );
+    elapsed = GetTickCount() - start;
+    for (i = 0; i < count; i++) CloseHandle( threads[i] );
+    CloseHandle( params.start );
+
+    ok( params.count == count * iterations * 64, "got %u allocations\n", params.count );
+    if (winetest_interactive)
+        trace( "%u threads: %u allocations in %u ms\n", count, params.count, elapsed );
+}
+
+static void test_HeapSetInformation(void)
+{
+    static const BYTE zero[100];
+    ULONG info;
+    HANDLE heap;
+    void *ptr, *ptr2;
+    BOOL ret;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "HeapSetInformation succeeded\n" );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+
+    info = 2;
+    SetLastError( 0xdeadbeef );
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    if (!ret)
+    {
+        /* the LFH is not available when running under a debugger or with heap debugging */
+        skip( "LFH not available, error %u\n", GetLastError() );
+        HeapDestroy( heap );
+        return;
+    }
+
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2, "expected 2, got %u\n", info );
+
+    info = 0;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "HeapSetInformation succeeded\n" );
+
+    ptr = HeapAlloc( heap, HEAP_ZERO_MEMORY, 100 );
+    ok( ptr != NULL, "HeapAlloc failed\n" );
+    ok( HeapSize( heap, 0, ptr ) == 100, "wrong size %lu\n", HeapSize( heap, 0, ptr ) );
+    ok( !memcmp( ptr, zero, 100 ), "block not zeroed\n" );
+    memset( ptr, 0xcc, 100 );
+    ret = HeapFree( heap, 0, ptr );
+    ok( ret, "HeapFree failed\n" );
+
+    ptr2 = HeapAlloc( heap, HEAP_ZERO_MEMORY, 100 );
+    ok( ptr2 != NULL, "HeapAlloc failed\n" );
+    ok( !memcmp( ptr2, zero, 100 ), "block not zeroed\n" );
+    ptr = HeapReAlloc( heap, 0, ptr2, 200 );
+    ok( ptr != NULL, "HeapReAlloc failed\n" );
+    ok( HeapSize( heap, 0, ptr ) == 200, "wrong size %lu\n", HeapSize( heap, 0, ptr ) );
+    HeapFree( heap, 0, ptr );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+    test_lfh_threads( heap, 4, 50 );
+    if (winetest_interactive)
+    {
+        test_lfh_threads( heap, 1, 2000 );
+        test_lfh_threads( heap, 2, 2000 );
+        test_lfh_threads( heap, 4, 2000 );
+        test_lfh_threads( heap, 8, 2000 );
+    }
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    HeapCompact( heap, 0 );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+    HeapDestroy( heap );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1245,6 +1382,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_HeapSetInformation();
     test_GetPhysicallyInstalledSystemMemory();
 
     if (pRtlGetNtGlobalFlags)
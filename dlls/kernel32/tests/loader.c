@@ -1869,8 +1869,9 @@ static void test_section_access(void)
     char buf[256];
     int i;
     DWORD dummy, file_align;
-    HANDLE hfile;
+    HANDLE hfile, hmap;
     HMODULE hlib;
+    void *addr;
     char temp_path[MAX_PATH];
     char dll_name[MAX_PATH];
     SIZE_T size;
@@ -1971,6 +1972,22 @@ static void test_section_access(void)
             /* FIXME: remove the condition below once Wine is fixed */
             todo_wine_if (info.Protect == PAGE_WRITECOPY || info.Protect == PAGE_EXECUTE_WRITECOPY)
                 ok(info.Protect == td[i].scn_page_access_after_write, "%d: got %#x != expected %#x\n", i, info.Protect, td[i].scn_page_access_after_write);
+
+            /* the write must not be visible in another mapping of the same image */
+            hfile = CreateFileA(dll_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0);
+            ok(hfile != INVALID_HANDLE_VALUE, "%d: CreateFile error %d\n", i, GetLastError());
+            hmap = CreateFileMappingW(hfile, NULL, PAGE_READONLY | SEC_IMAGE, 0, 0, 0);
+            ok(hmap != 0, "%d: CreateFileMapping error %d\n", i, GetLastError());
+            addr = MapViewOfFile(hmap, 0, 0, 0, 0);
+            ok(addr != NULL, "%d: MapViewOfFile error %d\n", i, GetLastError());
+            if (addr)
+            {
+                ok(!memcmp((const char *)addr + section.VirtualAddress, section_data, section.SizeOfRawData),
+                   "%d: wrong section data\n", i);
+                UnmapViewOfFile(addr);
+            }
+            CloseHandle(hmap);
+            CloseHandle(hfile);
         }
 
         SetLastError(0xdeadbeef);
@@ -3863,6 +3880,285 @@ static void test_dll_file( const char *name )
 #undef OK_FIELD
 }
 
+static const char * const startup_dlls[] =
+{
+    "advapi32.dll", "comctl32.dll", "comdlg32.dll", "crypt32.dll", "d3d9.dll", "dbghelp.dll",
+    "dsound.dll", "gdi32.dll", "gdiplus.dll", "imm32.dll", "msi.dll", "msvcrt.dll", "ole32.dll",
+    "oleaut32.dll", "opengl32.dll", "rpcrt4.dll", "secur32.dll", "setupapi.dll", "shell32.dll",
+    "shlwapi.dll", "urlmon.dll", "user32.dll", "uxtheme.dll", "version.dll", "wininet.dll",
+    "winmm.dll", "ws2_32.dll", "xmllite.dll",
+};
+
+static void load_dlls_child(void)
+{
+    HMODULE modules[ARRAY_SIZE(startup_dlls)];
+    DWORD i, start = GetTickCount();
+
+    for (i = 0; i < ARRAY_SIZE(startup_dlls); i++)
+        if (!(modules[i] = LoadLibraryA( startup_dlls[i] ))) trace( "failed to load %s\n", startup_dlls[i] );
+    trace( "loaded %u dlls in %u ms\n", i, GetTickCount() - start );
+    for (i = 0; i < ARRAY_SIZE(startup_dlls); i++) if (modules[i]) FreeLibrary( modules[i] );
+}
+
+static void test_startup_time(void)
+{
+    char cmdline[MAX_PATH + 32];
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    DWORD i, ret, start;
+    char **argv;
+
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" loader load_dlls", argv[0] );
+
+    /* the first run may populate caches, the second one is a warm startup */
+    for (i = 0; i < 2; i++)
+    {
+        start = GetTickCount();
+        ret = CreateProcessA( argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+        ok( ret, "CreateProcess failed, error %u\n", GetLastError() );
+        if (!ret) return;
+        ret = WaitForSingleObject( pi.hProcess, 30000 );
+        ok( ret == WAIT_OBJECT_0, "child process failed to terminate\n" );
+        trace( "startup %u: %u ms\n", i, GetTickCount() - start );
+        CloseHandle( pi.hThread );
+        CloseHandle( pi.hProcess );
+    }
+}
+
+struct import_cache_data
+{
+    IMAGE_EXPORT_DIRECTORY exports;
+    DWORD functions[2];
+    DWORD names[2];
+    WORD ordinals[2];
+    char export_names[2][8];
+    IMAGE_IMPORT_DESCRIPTOR descr[2];
+    IMAGE_THUNK_DATA original_thunks[3];
+    IMAGE_THUNK_DATA thunks[3];
+    struct { WORD hint; char name[8]; } imports[2];
+    char module[32];
+    DWORD values[2];
+};
+
+/* create a dll exporting func1 and func2, or importing them from another dll if import_from is set */
+static void create_import_cache_dll( const char *dll_name, const char *import_from, BOOL swap, DWORD timestamp )
+{
+    struct import_cache_data data;
+    IMAGE_NT_HEADERS nt;
+    IMAGE_SECTION_HEADER section;
+    DWORD i, dummy;
+    HANDLE hfile;
+
+#define DATA_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&data))
+    nt = nt_header_template;
+    nt.FileHeader.NumberOfSections = 1;
+    nt.FileHeader.TimeDateStamp = timestamp;
+    nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER);
+    nt.FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_32BIT_MACHINE |
+                                    IMAGE_FILE_RELOCS_STRIPPED | IMAGE_FILE_DLL;
+    nt.OptionalHeader.SectionAlignment = page_size;
+    nt.OptionalHeader.FileAlignment = 0x200;
+    nt.OptionalHeader.ImageBase = import_from ? 0x12340000 : 0x12380000;
+    nt.OptionalHeader.SizeOfImage = 2 * page_size;
+    nt.OptionalHeader.SizeOfHeaders = nt.OptionalHeader.FileAlignment;
+    nt.OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    memset( nt.OptionalHeader.DataDirectory, 0, sizeof(nt.OptionalHeader.DataDirectory) );
+
+    memset( &data, 0, sizeof(data) );
+    if (import_from)
+    {
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size = sizeof(data.descr);
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = DATA_RVA(data.descr);
+        U(data.descr[0]).OriginalFirstThunk = DATA_RVA( data.original_thunks );
+        data.descr[0].FirstThunk = DATA_RVA( data.thunks );
+        data.descr[0].Name = DATA_RVA( data.module );
+        strcpy( data.module, import_from );
+        for (i = 0; i < 2; i++)
+        {
+            sprintf( data.imports[i].name, "func%u", swap ? 2 - i : i + 1 );
+            data.original_thunks[i].u1.AddressOfData = DATA_RVA( &data.imports[i] );
+            data.thunks[i].u1.AddressOfData = 0xdeadbeef;
+        }
+    }
+    else
+    {
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size = sizeof(data.exports);
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress = DATA_RVA(&data.exports);
+        data.exports.Base = 1;
+        data.exports.NumberOfFunctions = 2;
+        data.exports.NumberOfNames = 2;
+        data.exports.AddressOfFunctions = DATA_RVA( data.functions );
+        data.exports.AddressOfNames = DATA_RVA( data.names );
+        data.exports.AddressOfNameOrdinals = DATA_RVA( data.ordinals );
+        for (i = 0; i < 2; i++)
+        {
+            sprintf( data.export_names[i], "func%u", i + 1 );
+            data.functions[i] = DATA_RVA( &data.values[swap ? 1 - i : i] );
+            data.names[i] = DATA_RVA( data.export_names[i] );
+            data.ordinals[i] = i;
+        }
+    }
+
+    hfile = CreateFileA( dll_name, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, 0 );
+    ok( hfile != INVALID_HANDLE_VALUE, "failed to create %s err %u\n", dll_name, GetLastError() );
+    if (hfile == INVALID_HANDLE_VALUE) return;
+
+    memset( &section, 0, sizeof(section) );
+    memcpy( section.Name, ".data", sizeof(".data") );
+    section.PointerToRawData = nt.OptionalHeader.FileAlignment;
+    section.VirtualAddress = nt.OptionalHeader.SectionAlignment;
+    section.Misc.VirtualSize = sizeof(data);
+    section.SizeOfRawData = sizeof(data);
+    section.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+    WriteFile( hfile, &dos_header, sizeof(dos_header), &dummy, NULL );
+    WriteFile( hfile, &nt, sizeof(nt), &dummy, NULL );
+    WriteFile( hfile, &section, sizeof(section), &dummy, NULL );
+    SetFilePointer( hfile, section.PointerToRawData, NULL, SEEK_SET );
+    WriteFile( hfile, &data, sizeof(data), &dummy, NULL );
+    CloseHandle( hfile );
+#undef DATA_RVA
+}
+
+static void import_cache_child( const char *target_name, const char *dll_name )
+{
+    const struct import_cache_data *data;
+    HMODULE target, module;
+    const char *name;
+    void *expect;
+    DWORD i;
+
+    target = LoadLibraryA( target_name );
+    ok( target != NULL, "failed to load %s err %u\n", target_name, GetLastError() );
+    module = LoadLibraryA( dll_name );
+    ok( module != NULL, "failed to load %s err %u\n", dll_name, GetLastError() );
+    if (!target || !module) return;
+
+    data = (const struct import_cache_data *)((char *)module + page_size);
+    for (i = 0; i < 2; i++)
+    {
+        name = (const char *)module + data->original_thunks[i].u1.AddressOfData + sizeof(WORD);
+        expect = GetProcAddress( target, name );
+        ok( expect != NULL, "%s not found\n", name );
+        ok( (void *)data->thunks[i].u1.Function == expect, "thunk %u: got %p for %s, expected %p\n",
+            i, (void *)data->thunks[i].u1.Function, name, expect );
+    }
+    FreeLibrary( module );
+    FreeLibrary( target );
+}
+
+static void run_import_cache_child( const char *target_name, const char *dll_name )
+{
+    char cmdline[3 * MAX_PATH];
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    char **argv;
+    BOOL ret;
+
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" loader import_cache \"%s\" \"%s\"", argv[0], target_name, dll_name );
+    ret = CreateProcessA( argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "CreateProcess failed, error %u\n", GetLastError() );
+    if (!ret) return;
+    winetest_wait_child_process( pi.hProcess );
+    CloseHandle( pi.hThread );
+    CloseHandle( pi.hProcess );
+}
+
+static void test_import_cache(void)
+{
+    char temp_path[MAX_PATH], target_name[MAX_PATH], dll_name[MAX_PATH];
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ldr", 0, target_name );
+    GetTempFileNameA( temp_path, "ldr", 0, dll_name );
+    create_import_cache_dll( target_name, NULL, FALSE, 1 );
+    create_import_cache_dll( dll_name, strrchr( target_name, '\\' ) + 1, FALSE, 1 );
+
+    /* the Wine import cache is only used when enabled, it is ignored on Windows */
+    SetEnvironmentVariableA( "WINEIMPORTCACHE", "1" );
+
+    /* the first run fills the cache, the second one uses it */
+    run_import_cache_child( target_name, dll_name );
+    run_import_cache_child( target_name, dll_name );
+
+    /* swapped exports in the target */
+    create_import_cache_dll( target_name, NULL, TRUE, 2 );
+    run_import_cache_child( target_name, dll_name );
+    run_import_cache_child( target_name, dll_name );
+
+    /* swapped imports in the importing dll */
+    create_import_cache_dll( dll_name, strrchr( target_name, '\\' ) + 1, TRUE, 2 );
+    run_import_cache_child( target_name, dll_name );
+    run_import_cache_child( target_name, dll_name );
+
+    SetEnvironmentVariableA( "WINEIMPORTCACHE", NULL );
+    DeleteFileA( dll_name );
+    DeleteFileA( target_name );
+}
+
+static DWORD WINAPI module_lookup_thread( void *arg )
+{
+    HMODULE kernel32 = GetModuleHandleA( "kernel32.dll" );
+    DWORD i, count = PtrToUlong( arg );
+
+    for (i = 0; i < count; i++)
+    {
+        if (GetModuleHandleA( "kernel32" ) != kernel32) return 1;
+        if (GetProcAddress( kernel32, "GetTickCount" ) != (FARPROC)GetTickCount) return 2;
+        if (!GetProcAddress( kernel32, "HeapAlloc" )) return 3;  /* forwarded to ntdll */
+        if (GetProcAddress( kernel32, "no_such_function" )) return 4;
+    }
+    return 0;
+}
+
+static void test_module_lookup_threads(void)
+{
+    /* the large count and the concurrent loads are only useful for benchmarking */
+    const DWORD count = winetest_interactive ? 100000 : 1000;
+    HANDLE threads[4];
+    HMODULE module;
+    DWORD i, ret, start;
+
+    module = GetModuleHandleA( "version" );
+    if (module) skip( "version.dll is already loaded\n" );
+    else
+    {
+        module = LoadLibraryA( "version.dll" );
+        ok( module != NULL, "failed to load version.dll, error %u\n", GetLastError() );
+        ok( GetModuleHandleA( "version" ) == module, "wrong module handle\n" );
+        ok( GetProcAddress( module, "GetFileVersionInfoSizeA" ) != NULL, "GetProcAddress failed\n" );
+        FreeLibrary( module );
+        ok( !GetModuleHandleA( "version" ), "version.dll is still loaded\n" );
+        ok( GetLastError() == ERROR_MOD_NOT_FOUND, "wrong error %u\n", GetLastError() );
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread( NULL, 0, module_lookup_thread, ULongToPtr( count ), 0, NULL );
+
+    /* load and unload another dll concurrently with the lookups */
+    while (winetest_interactive &&
+           WaitForMultipleObjects( ARRAY_SIZE(threads), threads, TRUE, 0 ) == WAIT_TIMEOUT)
+    {
+        module = LoadLibraryA( "version.dll" );
+        ok( module != NULL, "failed to load version.dll, error %u\n", GetLastError() );
+        ok( GetModuleHandleA( "version" ) == module, "wrong module handle\n" );
+        ok( GetProcAddress( module, "GetFileVersionInfoSizeA" ) != NULL, "GetProcAddress failed\n" );
+        FreeLibrary( module );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        WaitForSingleObject( threads[i], INFINITE );
+        GetExitCodeThread( threads[i], &ret );
+        ok( !ret, "thread %u failed with %u\n", i, ret );
+        CloseHandle( threads[i] );
+    }
+    if (winetest_interactive) trace( "module lookups: %u ms\n", GetTickCount() - start );
+}
+
 START_TEST(loader)
 {
     int argc;
@@ -3916,6 +4212,16 @@ START_TEST(loader)
         *child_failures = -1;
 
     argc = winetest_get_mainargs(&argv);
+    if (argc > 2 && !strcmp( argv[2], "load_dlls" ))
+    {
+        load_dlls_child();
+        return;
+    }
+    if (argc > 4 && !strcmp( argv[2], "import_cache" ))
+    {
+        import_cache_child( argv[3], argv[4] );
+        return;
+    }
     if (argc > 4)
     {
         test_dll_phase = atoi(argv[4]);
@@ -3928,6 +4234,9 @@ START_TEST(loader)
     test_ImportDescriptors();
     test_section_access();
     test_import_resolution();
+    test_import_cache();
+    if (winetest_interactive) test_startup_time();
+    test_module_lookup_threads();
     test_ExitProcess();
     test_InMemoryOrderModuleList();
     test_dll_file( "ntdll.dll" );
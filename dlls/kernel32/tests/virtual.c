@@ -2051,6 +2051,61 @@ static void test_write_watch(void)
     VirtualFree( base, 0, MEM_RELEASE );
 }
 
+static void test_write_watch_large(void)
+{
+    /* a few MB are enough to check the results, 1 GB is only for benchmarking */
+    SIZE_T size = winetest_interactive ? 1024 * 1024 * 1024 : 4 * 1024 * 1024;
+    ULONG_PTR count, pages, i;
+    DWORD start, dirty_time, get_time, ret;
+    ULONG pagesize;
+    void **results;
+    char *base;
+    int pass;
+
+    if (!pGetWriteWatch)
+    {
+        win_skip( "GetWriteWatch not supported\n" );
+        return;
+    }
+
+    base = VirtualAlloc( 0, size, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE );
+    if (!base)
+    {
+        skip( "failed to allocate %lu bytes with write watch\n", size );
+        return;
+    }
+    pages = size / si.dwPageSize;
+    results = HeapAlloc( GetProcessHeap(), 0, pages * sizeof(*results) );
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        start = GetTickCount();
+        for (i = 0; i < pages; i++) base[i * si.dwPageSize] = pass;
+        dirty_time = GetTickCount() - start;
+
+        count = pages;
+        start = GetTickCount();
+        ret = pGetWriteWatch( WRITE_WATCH_FLAG_RESET, base, size, results, &count, &pagesize );
+        get_time = GetTickCount() - start;
+        ok( !ret, "GetWriteWatch failed %u\n", GetLastError() );
+        ok( count == pages, "wrong count %lu\n", count );
+        ok( pagesize == si.dwPageSize, "wrong page size %u\n", pagesize );
+        ok( results[0] == base, "wrong first result %p\n", results[0] );
+        ok( results[count - 1] == base + size - si.dwPageSize, "wrong last result %p\n", results[count - 1] );
+        if (winetest_interactive)
+            trace( "pass %d: dirtying %lu pages took %u ms, GetWriteWatch took %u ms\n",
+                   pass, pages, dirty_time, get_time );
+    }
+
+    count = pages;
+    ret = pGetWriteWatch( 0, base, size, results, &count, &pagesize );
+    ok( !ret, "GetWriteWatch failed %u\n", GetLastError() );
+    ok( count == 0, "wrong count %lu\n", count );
+
+    HeapFree( GetProcessHeap(), 0, results );
+    VirtualFree( base, 0, MEM_RELEASE );
+}
+
 #if defined(__i386__) || defined(__x86_64__)
 
 static DWORD WINAPI stack_commit_func( void *arg )
@@ -4204,6 +4259,7 @@ START_TEST(virtual)
     test_IsBadWritePtr();
     test_IsBadCodePtr();
     test_write_watch();
+    test_write_watch_large();
 #if defined(__i386__) || defined(__x86_64__)
     test_stack_commit();
 #endif
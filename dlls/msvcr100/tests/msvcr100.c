@@ -152,6 +152,14 @@ typedef struct {
     void *vtable;
 } Context;
 
+struct ContextVtbl {
+    unsigned int (__thiscall *GetId)(const Context*);
+    unsigned int (__thiscall *GetVirtualProcessorId)(const Context*);
+    unsigned int (__thiscall *GetScheduleGroupId)(const Context*);
+    void (__thiscall *Unblock)(Context*);
+    MSVCRT_bool (__thiscall *IsSynchronouslyBlocked)(const Context*);
+};
+
 typedef struct {
     void *policy_container;
 } SchedulerPolicy;
@@ -170,8 +178,8 @@ struct SchedulerVtbl {
     unsigned int (__thiscall *Release)(Scheduler*);
     void (__thiscall *RegisterShutdownEvent)(Scheduler*,HANDLE);
     void (__thiscall *Attach)(Scheduler*);
-    /* CreateScheduleGroup */
-    /* ScheduleTask */
+    void* (__thiscall *CreateScheduleGroup)(Scheduler*);
+    void (__thiscall *ScheduleTask)(Scheduler*,void (__cdecl*)(void*),void*);
 };
 
 static int* (__cdecl *p_errno)(void);
@@ -223,6 +231,7 @@ static int (__cdecl *p_event_wait_for_multiple)(event**, size_t, MSVCRT_bool, un
 
 static Context* (__cdecl *p_Context_CurrentContext)(void);
 static unsigned int (__cdecl *p_Context_Id)(void);
+static void (__cdecl *p_Context_Block)(void);
 static SchedulerPolicy* (__thiscall *p_SchedulerPolicy_ctor)(SchedulerPolicy*);
 static void (__thiscall *p_SchedulerPolicy_SetConcurrencyLimits)(SchedulerPolicy*, unsigned int, unsigned int);
 static void (__thiscall *p_SchedulerPolicy_dtor)(SchedulerPolicy*);
@@ -230,6 +239,7 @@ static Scheduler* (__cdecl *p_Scheduler_Create)(SchedulerPolicy*);
 static Scheduler* (__cdecl *p_CurrentScheduler_Get)(void);
 static void (__cdecl *p_CurrentScheduler_Detach)(void);
 static unsigned int (__cdecl *p_CurrentScheduler_Id)(void);
+static void (__cdecl *p_CurrentScheduler_ScheduleTask)(void (__cdecl*)(void*),void*);
 
 static int (__cdecl *p__memicmp)(const char*, const char*, size_t);
 static int (__cdecl *p__memicmp_l)(const char*, const char*, size_t,_locale_t);
@@ -274,6 +284,7 @@ static BOOL init(void)
     SET(p___strncnt, "__strncnt");
 
     SET(p_Context_Id, "?Id@Context@Concurrency@@SAIXZ");
+    SET(p_Context_Block, "?Block@Context@Concurrency@@SAXXZ");
     SET(p_CurrentScheduler_Detach, "?Detach@CurrentScheduler@Concurrency@@SAXXZ");
     SET(p_CurrentScheduler_Id, "?Id@CurrentScheduler@Concurrency@@SAIXZ");
 
@@ -318,6 +329,7 @@ static BOOL init(void)
         SET(p_SchedulerPolicy_dtor, "??1SchedulerPolicy@Concurrency@@QEAA@XZ");
         SET(p_Scheduler_Create, "?Create@Scheduler@Concurrency@@SAPEAV12@AEBVSchedulerPolicy@2@@Z");
         SET(p_CurrentScheduler_Get, "?Get@CurrentScheduler@Concurrency@@SAPEAVScheduler@2@XZ");
+        SET(p_CurrentScheduler_ScheduleTask, "?ScheduleTask@CurrentScheduler@Concurrency@@SAXP6AXPEAX@Z0@Z");
     } else {
         SET(pSpinWait_ctor_yield, "??0?$_SpinWait@$00@details@Concurrency@@QAE@P6AXXZ@Z");
         SET(pSpinWait_dtor, "??_F?$_SpinWait@$00@details@Concurrency@@QAEXXZ");
@@ -359,6 +371,7 @@ static BOOL init(void)
         SET(p_SchedulerPolicy_dtor, "??1SchedulerPolicy@Concurrency@@QAE@XZ");
         SET(p_Scheduler_Create, "?Create@Scheduler@Concurrency@@SAPAV12@ABVSchedulerPolicy@2@@Z");
         SET(p_CurrentScheduler_Get, "?Get@CurrentScheduler@Concurrency@@SAPAVScheduler@2@XZ");
+        SET(p_CurrentScheduler_ScheduleTask, "?ScheduleTask@CurrentScheduler@Concurrency@@SAXP6AXPAX@Z0@Z");
     }
 
     init_thiscall_thunk();
@@ -989,6 +1002,174 @@ static void test_Scheduler(void)
     call_func1(p_SchedulerPolicy_dtor, &policy);
 }
 
+/* maximum size, a smaller range is summed unless benchmarking */
+#define PARALLEL_FOR_SIZE  (1 << 22)
+#define PARALLEL_FOR_CHUNK (1 << 12)
+
+struct parallel_for_chunk {
+    struct parallel_for_data *data;
+    unsigned int start, end;
+};
+
+struct parallel_for_data {
+    Scheduler *scheduler;
+    const unsigned int *input;
+    unsigned int size;
+    ULONGLONG sums[PARALLEL_FOR_SIZE / PARALLEL_FOR_CHUNK];
+    struct parallel_for_chunk chunks[PARALLEL_FOR_SIZE / PARALLEL_FOR_CHUNK];
+    LONG pending;
+    LONG running;
+    LONG max_running;
+    BOOL wrong_scheduler;
+    HANDLE done;
+};
+
+static void __cdecl parallel_for_task(void *arg)
+{
+    struct parallel_for_chunk *chunk = arg;
+    struct parallel_for_data *data = chunk->data;
+    unsigned int i, mid, end = chunk->end;
+    LONG running, max_running;
+    ULONGLONG sum = 0;
+
+    running = InterlockedIncrement(&data->running);
+    while ((max_running = data->max_running) < running)
+        InterlockedCompareExchange(&data->max_running, running, max_running);
+
+    if (p_CurrentScheduler_Get() != data->scheduler)
+        data->wrong_scheduler = TRUE;
+
+    /* split the range like parallel_for, the other half may be stolen by another worker */
+    while (end - chunk->start > PARALLEL_FOR_CHUNK) {
+        mid = chunk->start + (end - chunk->start) / 2;
+        data->chunks[mid / PARALLEL_FOR_CHUNK].data = data;
+        data->chunks[mid / PARALLEL_FOR_CHUNK].start = mid;
+        data->chunks[mid / PARALLEL_FOR_CHUNK].end = end;
+        InterlockedIncrement(&data->pending);
+        p_CurrentScheduler_ScheduleTask(parallel_for_task, &data->chunks[mid / PARALLEL_FOR_CHUNK]);
+        end = mid;
+    }
+
+    for (i = chunk->start; i < end; i++)
+        sum += data->input[i];
+    data->sums[chunk->start / PARALLEL_FOR_CHUNK] = sum;
+
+    InterlockedDecrement(&data->running);
+    if (!InterlockedDecrement(&data->pending))
+        SetEvent(data->done);
+}
+
+static DWORD run_parallel_for(struct parallel_for_data *data, unsigned int chunk_size, ULONGLONG expected)
+{
+    ULONGLONG sum = 0;
+    unsigned int i;
+    DWORD start;
+
+    memset(data->sums, 0, sizeof(data->sums));
+    data->pending = data->size / chunk_size;
+    data->running = 0;
+    data->wrong_scheduler = FALSE;
+    ResetEvent(data->done);
+
+    start = GetTickCount();
+    for (i = 0; i < data->size; i += chunk_size) {
+        data->chunks[i / PARALLEL_FOR_CHUNK].data = data;
+        data->chunks[i / PARALLEL_FOR_CHUNK].start = i;
+        data->chunks[i / PARALLEL_FOR_CHUNK].end = i + chunk_size;
+        call_func3(data->scheduler->vtable->ScheduleTask, data->scheduler,
+                parallel_for_task, &data->chunks[i / PARALLEL_FOR_CHUNK]);
+    }
+    ok(WaitForSingleObject(data->done, 10000) == WAIT_OBJECT_0, "tasks didn't finish\n");
+    start = GetTickCount() - start;
+
+    for (i = 0; i < ARRAY_SIZE(data->sums); i++)
+        sum += data->sums[i];
+    ok(sum == expected, "got sum %s, expected %s\n", wine_dbgstr_longlong(sum),
+            wine_dbgstr_longlong(expected));
+    ok(!data->wrong_scheduler, "task ran on the wrong scheduler\n");
+    return start;
+}
+
+static void __cdecl block_task(void *arg)
+{
+    Context **ctx = arg;
+
+    *ctx = p_Context_CurrentContext();
+    p_Context_Block();
+    *ctx = NULL;
+}
+
+static void test_Scheduler_ScheduleTask(void)
+{
+    struct parallel_for_data *data;
+    Context *volatile blocked_ctx = NULL;
+    SchedulerPolicy policy;
+    unsigned int *input, i;
+    ULONGLONG expected = 0;
+    Context *ctx;
+    HANDLE shutdown;
+    DWORD start, time;
+    unsigned int size = winetest_interactive ? PARALLEL_FOR_SIZE : 16 * PARALLEL_FOR_CHUNK;
+
+    input = HeapAlloc(GetProcessHeap(), 0, size * sizeof(*input));
+    for (i = 0; i < size; i++) {
+        input[i] = i * 2654435761u;
+        expected += input[i];
+    }
+    data = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*data));
+    data->input = input;
+    data->size = size;
+    data->done = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    start = GetTickCount();
+    for (i = 0; i < size; i++)
+        data->sums[0] += input[i];
+    if (winetest_interactive)
+        trace("serial loop: %u ms\n", GetTickCount() - start);
+    ok(data->sums[0] == expected, "got sum %s\n", wine_dbgstr_longlong(data->sums[0]));
+
+    call_func1(p_SchedulerPolicy_ctor, &policy);
+    call_func3(p_SchedulerPolicy_SetConcurrencyLimits, &policy, 1, 2);
+    data->scheduler = p_Scheduler_Create(&policy);
+    ok(data->scheduler != NULL, "Scheduler::Create() = NULL\n");
+    call_func1(p_SchedulerPolicy_dtor, &policy);
+
+    shutdown = CreateEventW(NULL, TRUE, FALSE, NULL);
+    call_func2(data->scheduler->vtable->RegisterShutdownEvent, data->scheduler, shutdown);
+
+    time = run_parallel_for(data, PARALLEL_FOR_CHUNK, expected);
+    if (winetest_interactive)
+        trace("%u tasks scheduled from an external thread: %u ms\n", size / PARALLEL_FOR_CHUNK, time);
+    time = run_parallel_for(data, size, expected);
+    if (winetest_interactive)
+        trace("%u tasks split by the workers: %u ms\n", size / PARALLEL_FOR_CHUNK, time);
+    ok(data->max_running >= 1 && data->max_running <= 2, "max_running = %d\n", data->max_running);
+
+    /* Unblock can be called before Block */
+    ctx = p_Context_CurrentContext();
+    call_func1(((struct ContextVtbl*)ctx->vtable)->Unblock, ctx);
+    p_Context_Block();
+
+    call_func3(data->scheduler->vtable->ScheduleTask, data->scheduler, block_task, (void*)&blocked_ctx);
+    for (i = 0; i < 500 && !blocked_ctx; i++) Sleep(10);
+    ok(blocked_ctx != NULL, "task didn't start\n");
+    if (blocked_ctx) {
+        for (i = 0; i < 500 && !call_func1(((struct ContextVtbl*)blocked_ctx->vtable)->IsSynchronouslyBlocked,
+                    blocked_ctx); i++) Sleep(10);
+        call_func1(((struct ContextVtbl*)blocked_ctx->vtable)->Unblock, blocked_ctx);
+        for (i = 0; i < 500 && blocked_ctx; i++) Sleep(10);
+        ok(!blocked_ctx, "task was not unblocked\n");
+    }
+
+    call_func1(data->scheduler->vtable->Release, data->scheduler);
+    ok(WaitForSingleObject(shutdown, 5000) == WAIT_OBJECT_0, "scheduler was not shut down\n");
+
+    CloseHandle(shutdown);
+    CloseHandle(data->done);
+    HeapFree(GetProcessHeap(), 0, data);
+    HeapFree(GetProcessHeap(), 0, input);
+}
+
 static void test__memicmp(void)
 {
     static const char *s1 = "abc";
@@ -1113,6 +1294,7 @@ START_TEST(msvcr100)
 
     test_ExternalContextBase();
     test_Scheduler();
+    test_Scheduler_ScheduleTask();
     test_wmemcpy_s();
     test_wmemmove_s();
     test_fread_s();
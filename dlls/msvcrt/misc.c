@@ -257,10 +257,22 @@ void CDECL _chkesp(void)
 
 #endif  /* __i386__ */
 
-static inline void swap(char *l, char *r, MSVCRT_size_t size)
+typedef void (*swap_func)(char *l, char *r, MSVCRT_size_t size);
+
+static void swap(char *l, char *r, MSVCRT_size_t size)
 {
+    MSVCRT_size_t word;
     char tmp;
 
+    if(!(((ULONG_PTR)l | (ULONG_PTR)r | size) & (sizeof(word)-1))) {
+        for(; size; size-=sizeof(word), l+=sizeof(word), r+=sizeof(word)) {
+            word = *(MSVCRT_size_t*)l;
+            *(MSVCRT_size_t*)l = *(MSVCRT_size_t*)r;
+            *(MSVCRT_size_t*)r = word;
+        }
+        return;
+    }
+
     while(size--) {
         tmp = *l;
         *l++ = *r;
@@ -268,8 +280,29 @@ static inline void swap(char *l, char *r, MSVCRT_size_t size)
     }
 }
 
-static void small_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
-        int (CDECL *compar)(void *, const void *, const void *), void *context)
+static void swap_4(char *l, char *r, MSVCRT_size_t size)
+{
+    DWORD tmp = *(DWORD*)l;
+    *(DWORD*)l = *(DWORD*)r;
+    *(DWORD*)r = tmp;
+}
+
+static void swap_8(char *l, char *r, MSVCRT_size_t size)
+{
+    ULONGLONG tmp = *(ULONGLONG*)l;
+    *(ULONGLONG*)l = *(ULONGLONG*)r;
+    *(ULONGLONG*)r = tmp;
+}
+
+static void swap_16(char *l, char *r, MSVCRT_size_t size)
+{
+    swap_8(l, r, 8);
+    swap_8(l+8, r+8, 8);
+}
+
+static FORCEINLINE void small_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
+        int (CDECL *compar)(void *, const void *, const void *), void *context,
+        swap_func swap_elems)
 {
     MSVCRT_size_t e, i;
     char *max, *p;
@@ -283,40 +316,86 @@ static void small_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
         }
 
         if(p != max)
-            swap(p, max, size);
+            swap_elems(p, max, size);
     }
 }
 
-static void quick_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
-        int (CDECL *compar)(void *, const void *, const void *), void *context)
+static FORCEINLINE void sift_down(void *base, MSVCRT_size_t root, MSVCRT_size_t nmemb,
+        MSVCRT_size_t size, int (CDECL *compar)(void *, const void *, const void *),
+        void *context, swap_func swap_elems)
+{
+    MSVCRT_size_t child;
+
+#define X(i) ((char*)base+size*(i))
+    while(root < nmemb/2) {
+        child = 2*root+1;
+        if(child+1 < nmemb && compar(context, X(child+1), X(child)) > 0)
+            child++;
+        if(compar(context, X(child), X(root)) <= 0)
+            break;
+        swap_elems(X(root), X(child), size);
+        root = child;
+    }
+#undef X
+}
+
+/* Used by quick_sort when partitioning degenerates, keeps the sort O(n log n). */
+static FORCEINLINE void heap_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
+        int (CDECL *compar)(void *, const void *, const void *), void *context,
+        swap_func swap_elems)
+{
+    MSVCRT_size_t i;
+
+    for(i=nmemb/2; i>0; i--)
+        sift_down(base, i-1, nmemb, size, compar, context, swap_elems);
+
+    for(i=nmemb-1; i>0; i--) {
+        swap_elems(base, (char*)base+size*i, size);
+        sift_down(base, 0, i, size, compar, context, swap_elems);
+    }
+}
+
+static FORCEINLINE void quick_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
+        int (CDECL *compar)(void *, const void *, const void *), void *context,
+        swap_func swap_elems)
 {
     MSVCRT_size_t stack_lo[8*sizeof(MSVCRT_size_t)], stack_hi[8*sizeof(MSVCRT_size_t)];
+    unsigned int stack_depth[8*sizeof(MSVCRT_size_t)], depth;
     MSVCRT_size_t beg, end, lo, hi, med;
     int stack_pos;
 
     stack_pos = 0;
     stack_lo[stack_pos] = 0;
     stack_hi[stack_pos] = nmemb-1;
+    for(depth=0; nmemb>1; nmemb>>=1)
+        depth += 2;
+    stack_depth[stack_pos] = depth;
 
 #define X(i) ((char*)base+size*(i))
     while(stack_pos >= 0) {
         beg = stack_lo[stack_pos];
-        end = stack_hi[stack_pos--];
+        end = stack_hi[stack_pos];
+        depth = stack_depth[stack_pos--];
 
         if(end-beg < 8) {
-            small_sort(X(beg), end-beg+1, size, compar, context);
+            small_sort(X(beg), end-beg+1, size, compar, context, swap_elems);
+            continue;
+        }
+        if(!depth) {
+            heap_sort(X(beg), end-beg+1, size, compar, context, swap_elems);
             continue;
         }
+        depth--;
 
         lo = beg;
         hi = end;
         med = lo + (hi-lo+1)/2;
         if(compar(context, X(lo), X(med)) > 0)
-            swap(X(lo), X(med), size);
+            swap_elems(X(lo), X(med), size);
         if(compar(context, X(lo), X(hi)) > 0)
-            swap(X(lo), X(hi), size);
+            swap_elems(X(lo), X(hi), size);
         if(compar(context, X(med), X(hi)) > 0)
-            swap(X(med), X(hi), size);
+            swap_elems(X(med), X(hi), size);
 
         lo++;
         hi--;
@@ -336,7 +415,7 @@ static void quick_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
             if(hi < lo)
                 break;
 
-            swap(X(lo), X(hi), size);
+            swap_elems(X(lo), X(hi), size);
             if(hi == med)
                 med = lo;
             lo++;
@@ -352,18 +431,46 @@ static void quick_sort(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
         if(hi-beg >= end-lo) {
             stack_lo[++stack_pos] = beg;
             stack_hi[stack_pos] = hi;
+            stack_depth[stack_pos] = depth;
             stack_lo[++stack_pos] = lo;
             stack_hi[stack_pos] = end;
+            stack_depth[stack_pos] = depth;
         }else {
             stack_lo[++stack_pos] = lo;
             stack_hi[stack_pos] = end;
+            stack_depth[stack_pos] = depth;
             stack_lo[++stack_pos] = beg;
             stack_hi[stack_pos] = hi;
+            stack_depth[stack_pos] = depth;
         }
     }
 #undef X
 }
 
+static void quick_sort_4(void *base, MSVCRT_size_t nmemb,
+        int (CDECL *compar)(void *, const void *, const void *), void *context)
+{
+    quick_sort(base, nmemb, 4, compar, context, swap_4);
+}
+
+static void quick_sort_8(void *base, MSVCRT_size_t nmemb,
+        int (CDECL *compar)(void *, const void *, const void *), void *context)
+{
+    quick_sort(base, nmemb, 8, compar, context, swap_8);
+}
+
+static void quick_sort_16(void *base, MSVCRT_size_t nmemb,
+        int (CDECL *compar)(void *, const void *, const void *), void *context)
+{
+    quick_sort(base, nmemb, 16, compar, context, swap_16);
+}
+
+static void quick_sort_generic(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
+        int (CDECL *compar)(void *, const void *, const void *), void *context)
+{
+    quick_sort(base, nmemb, size, compar, context, swap);
+}
+
 /*********************************************************************
  * qsort_s (MSVCRT.@)
  *
@@ -382,7 +489,15 @@ void CDECL MSVCRT_qsort_s(void *base, MSVCRT_size_t nmemb, MSVCRT_size_t size,
 
     if (nmemb < 2) return;
 
-    quick_sort(base, nmemb, size, compar, context);
+    /* the element swaps are specialized for common sizes, the comparisons are the same */
+    if(size == 4 && !((ULONG_PTR)base & 3))
+        quick_sort_4(base, nmemb, compar, context);
+    else if(size == 8 && !((ULONG_PTR)base & 7))
+        quick_sort_8(base, nmemb, compar, context);
+    else if(size == 16 && !((ULONG_PTR)base & 7))
+        quick_sort_16(base, nmemb, compar, context);
+    else
+        quick_sort_generic(base, nmemb, size, compar, context);
 }
 
 /*********************************************************************
@@ -25,6 +25,7 @@
 #include "windef.h"
 #include "winternl.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "msvcrt.h"
 #include "cppexcept.h"
 #include "cxx.h"
@@ -110,11 +111,16 @@ struct scheduler_list {
     struct scheduler_list *next;
 };
 
+struct scheduler_worker;
+
 typedef struct {
     Context context;
     struct scheduler_list scheduler;
     unsigned int id;
     union allocator_cache_entry *allocator_cache[8];
+    struct scheduler_worker *worker;
+    LONG blocked;
+    HANDLE unblock_event;
 } ExternalContextBase;
 extern const vtable_ptr MSVCRT_ExternalContextBase_vtable;
 static void ExternalContextBase_ctor(ExternalContextBase*);
@@ -156,9 +162,37 @@ typedef struct {
     int shutdown_size;
     HANDLE *shutdown_events;
     CRITICAL_SECTION cs;
+    struct list chores;
+    struct list workers;
+    unsigned int min_workers;
+    unsigned int max_workers;
+    unsigned int worker_count;
+    unsigned int blocked_workers;
+    LONG idle_workers;
+    HANDLE wake_semaphore;
+    BOOL shutdown;
 } ThreadScheduler;
 extern const vtable_ptr MSVCRT_ThreadScheduler_vtable;
 
+/* task queued with ScheduleTask, allocated with Concurrency_Alloc */
+struct scheduled_chore {
+    struct list entry;
+    void (__cdecl *proc)(void*);
+    void *data;
+};
+
+/* worker threads take chores from their own queue first, then from the
+ * scheduler queue and finally steal them from the other workers */
+struct scheduler_worker {
+    struct list entry;
+    ThreadScheduler *scheduler;
+    CRITICAL_SECTION cs;
+    struct list chores; /* the worker pushes and pops at the head, others steal from the tail */
+};
+
+/* workers above MinConcurrency exit after being idle for that long */
+#define SCHEDULER_WORKER_IDLE_TIMEOUT 10000
+
 typedef struct {
     Scheduler *scheduler;
 } _Scheduler;
@@ -180,7 +214,8 @@ static CRITICAL_SECTION default_scheduler_cs = { &default_scheduler_cs_debug, -1
 static SchedulerPolicy default_scheduler_policy;
 static ThreadScheduler *default_scheduler;
 
-static void create_default_scheduler(void);
+static Scheduler* get_default_scheduler(void);
+static void scheduler_worker_block(struct scheduler_worker*, BOOL);
 
 static Context* try_get_current_context(void)
 {
@@ -256,22 +291,51 @@ unsigned int __cdecl Context_Id(void)
     return ctx ? call_Context_GetId(ctx) : -1;
 }
 
+static HANDLE get_unblock_event(ExternalContextBase *context)
+{
+    HANDLE event;
+
+    if (!context->unblock_event) {
+        event = CreateEventW(NULL, FALSE, FALSE, NULL);
+        if (InterlockedCompareExchangePointer(&context->unblock_event, event, NULL))
+            CloseHandle(event);
+    }
+    return context->unblock_event;
+}
+
 /* ?Block@Context@Concurrency@@SAXXZ */
 void __cdecl Context_Block(void)
 {
-    FIXME("()\n");
+    ExternalContextBase *context = (ExternalContextBase*)get_current_context();
+
+    TRACE("()\n");
+
+    if (context->context.vtable != &MSVCRT_ExternalContextBase_vtable) {
+        ERR("unknown context set\n");
+        return;
+    }
+
+    /* Unblock may be called before Block */
+    if (InterlockedIncrement(&context->blocked) != 1)
+        return;
+
+    if (context->worker) scheduler_worker_block(context->worker, TRUE);
+    WaitForSingleObject(get_unblock_event(context), INFINITE);
+    if (context->worker) scheduler_worker_block(context->worker, FALSE);
 }
 
 /* ?Yield@Context@Concurrency@@SAXXZ */
 void __cdecl Context_Yield(void)
 {
-    FIXME("()\n");
+    TRACE("()\n");
+    SwitchToThread();
 }
 
 /* ?_SpinYield@Context@Concurrency@@SAXXZ */
 void __cdecl Context__SpinYield(void)
 {
-    FIXME("()\n");
+    TRACE("()\n");
+    Sleep(0);
 }
 
 /* ?IsCurrentTaskCollectionCanceling@Context@Concurrency@@SA_NXZ */
@@ -284,7 +348,12 @@ MSVCRT_bool __cdecl Context_IsCurrentTaskCollectionCanceling(void)
 /* ?Oversubscribe@Context@Concurrency@@SAX_N@Z */
 void __cdecl Context_Oversubscribe(MSVCRT_bool begin)
 {
-    FIXME("(%x)\n", begin);
+    ExternalContextBase *context = (ExternalContextBase*)try_get_current_context();
+
+    TRACE("(%x)\n", begin);
+
+    if (context && context->context.vtable == &MSVCRT_ExternalContextBase_vtable && context->worker)
+        scheduler_worker_block(context->worker, begin);
 }
 
 /* ?ScheduleGroupId@Context@Concurrency@@SAIXZ */
@@ -327,14 +396,17 @@ unsigned int __thiscall ExternalContextBase_GetScheduleGroupId(const ExternalCon
 DEFINE_THISCALL_WRAPPER(ExternalContextBase_Unblock, 4)
 void __thiscall ExternalContextBase_Unblock(ExternalContextBase *this)
 {
-    FIXME("(%p)->() stub\n", this);
+    TRACE("(%p)->()\n", this);
+
+    if (!InterlockedDecrement(&this->blocked))
+        SetEvent(get_unblock_event(this));
 }
 
 DEFINE_THISCALL_WRAPPER(ExternalContextBase_IsSynchronouslyBlocked, 4)
 MSVCRT_bool __thiscall ExternalContextBase_IsSynchronouslyBlocked(const ExternalContextBase *this)
 {
-    FIXME("(%p)->() stub\n", this);
-    return FALSE;
+    TRACE("(%p)->()\n", this);
+    return this->blocked > 0;
 }
 
 static void ExternalContextBase_dtor(ExternalContextBase *this)
@@ -351,6 +423,9 @@ static void ExternalContextBase_dtor(ExternalContextBase *this)
         }
     }
 
+    if (this->unblock_event)
+        CloseHandle(this->unblock_event);
+
     if (this->scheduler.scheduler) {
         call_Scheduler_Release(this->scheduler.scheduler);
 
@@ -389,10 +464,7 @@ static void ExternalContextBase_ctor(ExternalContextBase *this)
     memset(this, 0, sizeof(*this));
     this->context.vtable = &MSVCRT_ExternalContextBase_vtable;
     this->id = InterlockedIncrement(&context_id);
-
-    create_default_scheduler();
-    this->scheduler.scheduler = &default_scheduler->scheduler;
-    call_Scheduler_Reference(&default_scheduler->scheduler);
+    this->scheduler.scheduler = get_default_scheduler();
 }
 
 /* ?Alloc@Concurrency@@YAPAXI@Z */
@@ -625,11 +697,17 @@ void __thiscall SchedulerPolicy_dtor(SchedulerPolicy *this)
 
 static void ThreadScheduler_dtor(ThreadScheduler *this)
 {
+    struct scheduled_chore *chore, *next;
     int i;
 
     if(this->ref != 0) WARN("ref = %d\n", this->ref);
     SchedulerPolicy_dtor(&this->policy);
 
+    /* only left if no worker could be started */
+    LIST_FOR_EACH_ENTRY_SAFE(chore, next, &this->chores, struct scheduled_chore, entry)
+        Concurrency_Free(chore);
+    CloseHandle(this->wake_semaphore);
+
     for(i=0; i<this->shutdown_count; i++)
         SetEvent(this->shutdown_events[i]);
     MSVCRT_operator_delete(this->shutdown_events);
@@ -638,6 +716,239 @@ static void ThreadScheduler_dtor(ThreadScheduler *this)
     DeleteCriticalSection(&this->cs);
 }
 
+static BOOL ThreadScheduler_take_idle_worker(ThreadScheduler *this)
+{
+    LONG idle;
+
+    do {
+        if (!(idle = this->idle_workers))
+            return FALSE;
+    } while (InterlockedCompareExchange(&this->idle_workers, idle - 1, idle) != idle);
+    return TRUE;
+}
+
+static BOOL ThreadScheduler_wake_worker(ThreadScheduler *this)
+{
+    if (!ThreadScheduler_take_idle_worker(this))
+        return FALSE;
+    ReleaseSemaphore(this->wake_semaphore, 1, NULL);
+    return TRUE;
+}
+
+static struct scheduled_chore* scheduler_worker_get_chore(struct scheduler_worker *worker)
+{
+    ThreadScheduler *scheduler = worker->scheduler;
+    struct scheduler_worker *victim;
+    struct list *entry;
+
+    EnterCriticalSection(&worker->cs);
+    if ((entry = list_head(&worker->chores)))
+        list_remove(entry);
+    LeaveCriticalSection(&worker->cs);
+    if (entry)
+        return LIST_ENTRY(entry, struct scheduled_chore, entry);
+
+    EnterCriticalSection(&scheduler->cs);
+    if ((entry = list_head(&scheduler->chores))) {
+        list_remove(entry);
+    }else {
+        LIST_FOR_EACH_ENTRY(victim, &scheduler->workers, struct scheduler_worker, entry) {
+            if (victim == worker) continue;
+
+            EnterCriticalSection(&victim->cs);
+            if ((entry = list_tail(&victim->chores)))
+                list_remove(entry);
+            LeaveCriticalSection(&victim->cs);
+            if (entry) break;
+        }
+    }
+    LeaveCriticalSection(&scheduler->cs);
+
+    return entry ? LIST_ENTRY(entry, struct scheduled_chore, entry) : NULL;
+}
+
+static void scheduler_worker_run_chore(struct scheduled_chore *chore)
+{
+    void (__cdecl *proc)(void*) = chore->proc;
+    void *data = chore->data;
+
+    Concurrency_Free(chore);
+    TRACE("running %p(%p)\n", proc, data);
+    proc(data);
+}
+
+static DWORD WINAPI scheduler_worker_proc(void *arg)
+{
+    struct scheduler_worker *worker = arg;
+    ThreadScheduler *scheduler = worker->scheduler;
+    ExternalContextBase *context = MSVCRT_operator_new(sizeof(*context));
+    struct scheduled_chore *chore;
+    BOOL retire = FALSE, destroy = FALSE;
+    HMODULE module;
+
+    TRACE("(%p) started\n", worker);
+
+    /* the scheduler doesn't hold a reference on itself through the contexts of its workers, */
+    /* so that they exit once it's released */
+    memset(context, 0, sizeof(*context));
+    context->context.vtable = &MSVCRT_ExternalContextBase_vtable;
+    context->id = InterlockedIncrement(&context_id);
+    context->scheduler.scheduler = &scheduler->scheduler;
+    context->worker = worker;
+    TlsSetValue(context_tls_index, context);
+
+    for (;;) {
+        if ((chore = scheduler_worker_get_chore(worker))) {
+            scheduler_worker_run_chore(chore);
+            continue;
+        }
+        if (scheduler->shutdown)
+            break;
+
+        InterlockedIncrement(&scheduler->idle_workers);
+        if ((chore = scheduler_worker_get_chore(worker)) || scheduler->shutdown) {
+            /* someone may already have woken us up, consume the wakeup */
+            if (!ThreadScheduler_take_idle_worker(scheduler))
+                WaitForSingleObject(scheduler->wake_semaphore, INFINITE);
+            if (chore) scheduler_worker_run_chore(chore);
+            continue;
+        }
+
+        if (WaitForSingleObject(scheduler->wake_semaphore, SCHEDULER_WORKER_IDLE_TIMEOUT) != WAIT_TIMEOUT)
+            continue;
+        if (!ThreadScheduler_take_idle_worker(scheduler)) {
+            WaitForSingleObject(scheduler->wake_semaphore, INFINITE);
+            continue;
+        }
+
+        EnterCriticalSection(&scheduler->cs);
+        retire = scheduler->worker_count > scheduler->min_workers;
+        if (retire) {
+            list_remove(&worker->entry);
+            scheduler->worker_count--;
+            destroy = scheduler->shutdown && !scheduler->worker_count;
+        }
+        LeaveCriticalSection(&scheduler->cs);
+        if (retire) break;
+    }
+
+    if (!retire) {
+        EnterCriticalSection(&scheduler->cs);
+        list_remove(&worker->entry);
+        scheduler->worker_count--;
+        destroy = !scheduler->worker_count;
+        LeaveCriticalSection(&scheduler->cs);
+    }
+
+    TRACE("(%p) exiting\n", worker);
+
+    context->worker = NULL;
+    context->scheduler.scheduler = NULL;
+
+    worker->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&worker->cs);
+    HeapFree(GetProcessHeap(), 0, worker);
+
+    /* the last worker of a released scheduler destroys it */
+    if (destroy) {
+        ThreadScheduler_dtor(scheduler);
+        MSVCRT_operator_delete(scheduler);
+    }
+
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+            (const WCHAR*)scheduler_worker_proc, &module);
+    FreeLibraryAndExitThread(module, 0);
+}
+
+/* start workers up to MinConcurrency, and one more if the limit allows it */
+static void ThreadScheduler_add_worker(ThreadScheduler *this)
+{
+    const unsigned int *policies = this->policy.policy_container->policies;
+    struct scheduler_worker *worker;
+    HMODULE module;
+    HANDLE thread;
+
+    if (this->worker_count >= this->max_workers + this->blocked_workers)
+        return;
+
+    EnterCriticalSection(&this->cs);
+    do {
+        if (this->shutdown || this->worker_count >= this->max_workers + this->blocked_workers)
+            break;
+
+        if (!(worker = HeapAlloc(GetProcessHeap(), 0, sizeof(*worker))))
+            break;
+        worker->scheduler = this;
+        list_init(&worker->chores);
+        InitializeCriticalSection(&worker->cs);
+        worker->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": scheduler_worker");
+
+        /* workers keep the dll loaded until they exit */
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                (const WCHAR*)scheduler_worker_proc, &module);
+        thread = CreateThread(NULL, policies[ContextStackSize] * 1024,
+                scheduler_worker_proc, worker, CREATE_SUSPENDED, NULL);
+        if (!thread) {
+            ERR("failed to create worker thread: %u\n", GetLastError());
+            FreeLibrary(module);
+            worker->cs.DebugInfo->Spare[0] = 0;
+            DeleteCriticalSection(&worker->cs);
+            HeapFree(GetProcessHeap(), 0, worker);
+            break;
+        }
+        if (policies[ContextPriority] != INHERIT_THREAD_PRIORITY)
+            SetThreadPriority(thread, policies[ContextPriority]);
+
+        list_add_tail(&this->workers, &worker->entry);
+        this->worker_count++;
+        ResumeThread(thread);
+        CloseHandle(thread);
+    } while (this->worker_count < this->min_workers);
+    LeaveCriticalSection(&this->cs);
+}
+
+/* blocked and oversubscribed workers don't count against MaxConcurrency */
+static void scheduler_worker_block(struct scheduler_worker *worker, BOOL block)
+{
+    ThreadScheduler *scheduler = worker->scheduler;
+    BOOL pending;
+
+    EnterCriticalSection(&scheduler->cs);
+    if (block)
+        scheduler->blocked_workers++;
+    else if (scheduler->blocked_workers)
+        scheduler->blocked_workers--;
+    pending = !list_empty(&scheduler->chores) || !list_empty(&worker->chores);
+    LeaveCriticalSection(&scheduler->cs);
+
+    if (block && pending && !ThreadScheduler_wake_worker(scheduler))
+        ThreadScheduler_add_worker(scheduler);
+}
+
+static void ThreadScheduler_queue_chore(ThreadScheduler *this,
+        void (__cdecl *proc)(void*), void *data)
+{
+    ExternalContextBase *context = (ExternalContextBase*)get_current_context();
+    struct scheduled_chore *chore = Concurrency_Alloc(sizeof(*chore));
+
+    chore->proc = proc;
+    chore->data = data;
+
+    if (context->context.vtable == &MSVCRT_ExternalContextBase_vtable &&
+            context->worker && context->worker->scheduler == this) {
+        EnterCriticalSection(&context->worker->cs);
+        list_add_head(&context->worker->chores, &chore->entry);
+        LeaveCriticalSection(&context->worker->cs);
+    }else {
+        EnterCriticalSection(&this->cs);
+        list_add_tail(&this->chores, &chore->entry);
+        LeaveCriticalSection(&this->cs);
+    }
+
+    if (!ThreadScheduler_wake_worker(this))
+        ThreadScheduler_add_worker(this);
+}
+
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_Id, 4)
 unsigned int __thiscall ThreadScheduler_Id(const ThreadScheduler *this)
 {
@@ -667,6 +978,25 @@ unsigned int __thiscall ThreadScheduler_Reference(ThreadScheduler *this)
     return InterlockedIncrement(&this->ref);
 }
 
+/* running workers finish the queued chores and destroy the scheduler */
+static void ThreadScheduler_shutdown(ThreadScheduler *this)
+{
+    BOOL destroy;
+    LONG idle;
+
+    EnterCriticalSection(&this->cs);
+    this->shutdown = TRUE;
+    destroy = !this->worker_count;
+    if (!destroy && (idle = InterlockedExchange(&this->idle_workers, 0)))
+        ReleaseSemaphore(this->wake_semaphore, idle, NULL);
+    LeaveCriticalSection(&this->cs);
+
+    if (destroy) {
+        ThreadScheduler_dtor(this);
+        MSVCRT_operator_delete(this);
+    }
+}
+
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_Release, 4)
 unsigned int __thiscall ThreadScheduler_Release(ThreadScheduler *this)
 {
@@ -675,8 +1005,12 @@ unsigned int __thiscall ThreadScheduler_Release(ThreadScheduler *this)
     TRACE("(%p)\n", this);
 
     if(!ret) {
-        ThreadScheduler_dtor(this);
-        MSVCRT_operator_delete(this);
+        EnterCriticalSection(&default_scheduler_cs);
+        if(default_scheduler == this)
+            default_scheduler = NULL;
+        LeaveCriticalSection(&default_scheduler_cs);
+
+        ThreadScheduler_shutdown(this);
     }
     return ret;
 }
@@ -746,14 +1080,19 @@ DEFINE_THISCALL_WRAPPER(ThreadScheduler_ScheduleTask_loc, 16)
 void __thiscall ThreadScheduler_ScheduleTask_loc(ThreadScheduler *this,
         void (__cdecl *proc)(void*), void* data, /*location*/void *placement)
 {
-    FIXME("(%p %p %p %p) stub\n", this, proc, data, placement);
+    TRACE("(%p %p %p %p)\n", this, proc, data, placement);
+
+    if (placement)
+        FIXME("placement %p ignored\n", placement);
+    ThreadScheduler_queue_chore(this, proc, data);
 }
 
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_ScheduleTask, 12)
 void __thiscall ThreadScheduler_ScheduleTask(ThreadScheduler *this,
         void (__cdecl *proc)(void*), void* data)
 {
-    FIXME("(%p %p %p) stub\n", this, proc, data);
+    TRACE("(%p %p %p)\n", this, proc, data);
+    ThreadScheduler_queue_chore(this, proc, data);
 }
 
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_IsAvailableLocation, 8)
@@ -804,6 +1143,15 @@ static ThreadScheduler* ThreadScheduler_ctor(ThreadScheduler *this,
     this->shutdown_count = this->shutdown_size = 0;
     this->shutdown_events = NULL;
 
+    list_init(&this->chores);
+    list_init(&this->workers);
+    this->min_workers = SchedulerPolicy_GetPolicyValue(&this->policy, MinConcurrency);
+    this->max_workers = max(this->virt_proc_no, this->min_workers);
+    this->worker_count = this->blocked_workers = 0;
+    this->idle_workers = 0;
+    this->wake_semaphore = CreateSemaphoreW(NULL, 0, MAXLONG, NULL);
+    this->shutdown = FALSE;
+
     InitializeCriticalSection(&this->cs);
     this->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": ThreadScheduler");
     return this;
@@ -888,15 +1236,23 @@ void __cdecl CurrentScheduler_Detach(void)
     }
 }
 
-static void create_default_scheduler(void)
+/* the default scheduler lives as long as contexts reference it, returns a new reference */
+static Scheduler* get_default_scheduler(void)
 {
-    if(default_scheduler)
-        return;
+    ThreadScheduler *scheduler;
+    LONG ref;
 
     EnterCriticalSection(&default_scheduler_cs);
-    if(!default_scheduler) {
-        ThreadScheduler *scheduler;
-
+    /* a scheduler whose last reference is being released can't be revived */
+    if((scheduler = default_scheduler)) {
+        do {
+            if(!(ref = scheduler->ref)) {
+                scheduler = NULL;
+                break;
+            }
+        } while(InterlockedCompareExchange(&scheduler->ref, ref + 1, ref) != ref);
+    }
+    if(!scheduler) {
         if(!default_scheduler_policy.policy_container)
             SchedulerPolicy_ctor(&default_scheduler_policy);
 
@@ -905,6 +1261,7 @@ static void create_default_scheduler(void)
         default_scheduler = scheduler;
     }
     LeaveCriticalSection(&default_scheduler_cs);
+    return &scheduler->scheduler;
 }
 
 /* ?Get@CurrentScheduler@Concurrency@@SAPAVScheduler@2@XZ */
@@ -1146,10 +1503,10 @@ void msvcrt_free_scheduler(void)
         TlsFree(context_tls_index);
     if(default_scheduler_policy.policy_container)
         SchedulerPolicy_dtor(&default_scheduler_policy);
-    if(default_scheduler) {
-        ThreadScheduler_dtor(default_scheduler);
-        MSVCRT_operator_delete(default_scheduler);
-    }
+    /* still referenced by the contexts of other threads; the workers keep the dll */
+    /* loaded, so none are left at this point and the scheduler is destroyed right away */
+    if(default_scheduler)
+        ThreadScheduler_shutdown(default_scheduler);
 }
 
 void msvcrt_free_scheduler_thread(void)
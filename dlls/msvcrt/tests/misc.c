@@ -490,6 +490,146 @@ static void test_qsort_s(void)
         ok(tab[i] == i, "data sorted incorrectly on position %d: %d\n", i, tab[i]);
 }
 
+struct qsort_record
+{
+    int key;
+    int id;
+    void *ptr;
+};
+
+static int __cdecl qsort_int_comp(void *ctx, const void *l, const void *r)
+{
+    int a = *(const int*)l, b = *(const int*)r;
+    return a < b ? -1 : a > b;
+}
+
+static int __cdecl qsort_record_comp(void *ctx, const void *l, const void *r)
+{
+    const struct qsort_record *a = l, *b = r;
+    return a->key < b->key ? -1 : a->key > b->key;
+}
+
+static int __cdecl qsort_count_comp(void *ctx, const void *l, const void *r)
+{
+    (*(unsigned int*)ctx)++;
+    return qsort_int_comp(NULL, l, r);
+}
+
+/* McIlroy's adversary: values are only fixed when the sort compares them, */
+/* in the way that makes its partitioning as unbalanced as possible */
+struct qsort_adversary
+{
+    int *val;
+    int gas;
+    int solid;
+    int candidate;
+};
+
+static int __cdecl qsort_adversary_comp(void *ctx, const void *l, const void *r)
+{
+    struct qsort_adversary *adv = ctx;
+    int x = *(const int*)l, y = *(const int*)r;
+
+    if(adv->val[x] == adv->gas && adv->val[y] == adv->gas)
+        adv->val[x == adv->candidate ? x : y] = adv->solid++;
+    if(adv->val[x] == adv->gas)
+        adv->candidate = x;
+    else if(adv->val[y] == adv->gas)
+        adv->candidate = y;
+    return adv->val[x] - adv->val[y];
+}
+
+static void test_qsort_s_perf(void)
+{
+    /* the large count is only useful for benchmarking */
+    const unsigned int count = winetest_interactive ? 10000000 : 100000;
+    struct qsort_adversary adv;
+    struct qsort_record *recs;
+    unsigned int i, seed, compares, log2;
+    DWORD start;
+    int *ints;
+
+    if(!p_qsort_s) {
+        win_skip("qsort_s not available\n");
+        return;
+    }
+
+    ints = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*ints));
+    recs = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*recs));
+    adv.val = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*adv.val));
+    if(!ints || !recs || !adv.val) {
+        skip("not enough memory\n");
+        HeapFree(GetProcessHeap(), 0, ints);
+        HeapFree(GetProcessHeap(), 0, recs);
+        HeapFree(GetProcessHeap(), 0, adv.val);
+        return;
+    }
+
+    seed = 1;
+    for(i=0; i<count; i++) {
+        seed = seed * 1103515245 + 12345;
+        ints[i] = seed >> 1;
+        recs[i].key = ints[i] % 1000000;
+        recs[i].id = i;
+        recs[i].ptr = &recs[i];
+    }
+
+    start = GetTickCount();
+    p_qsort_s(ints, count, sizeof(*ints), qsort_int_comp, NULL);
+    if(winetest_interactive)
+        trace("sorted %u random ints in %u ms\n", count, GetTickCount() - start);
+    for(i=1; i<count; i++)
+        if(ints[i-1] > ints[i]) break;
+    ok(i == count, "ints sorted incorrectly on position %u\n", i);
+
+    start = GetTickCount();
+    p_qsort_s(ints, count, sizeof(*ints), qsort_int_comp, NULL);
+    if(winetest_interactive)
+        trace("sorted %u sorted ints in %u ms\n", count, GetTickCount() - start);
+    for(i=1; i<count; i++)
+        if(ints[i-1] > ints[i]) break;
+    ok(i == count, "ints sorted incorrectly on position %u\n", i);
+
+    start = GetTickCount();
+    p_qsort_s(recs, count, sizeof(*recs), qsort_record_comp, NULL);
+    if(winetest_interactive)
+        trace("sorted %u records of %u bytes in %u ms\n", count, (unsigned int)sizeof(*recs),
+                GetTickCount() - start);
+    for(i=1; i<count; i++)
+        if(recs[i-1].key > recs[i].key || recs[i].ptr != &recs[recs[i].id]) break;
+    ok(i == count, "records sorted incorrectly on position %u\n", i);
+
+    /* build an input that degenerates the partitioning, then sort it again; */
+    /* the sort has to switch to the heap sort to stay in O(n log n) */
+    adv.gas = count;
+    adv.solid = 0;
+    adv.candidate = 0;
+    for(i=0; i<count; i++) {
+        ints[i] = i;
+        adv.val[i] = adv.gas;
+    }
+    p_qsort_s(ints, count, sizeof(*ints), qsort_adversary_comp, &adv);
+    for(i=0; i<count; i++) {
+        if(adv.val[i] == adv.gas) adv.val[i] = adv.solid++;
+        ints[i] = adv.val[i];
+    }
+
+    compares = 0;
+    start = GetTickCount();
+    p_qsort_s(ints, count, sizeof(*ints), qsort_count_comp, &compares);
+    if(winetest_interactive)
+        trace("sorted %u adversarial ints in %u ms\n", count, GetTickCount() - start);
+    for(i=1; i<count; i++)
+        if(ints[i-1] > ints[i]) break;
+    ok(i == count, "ints sorted incorrectly on position %u\n", i);
+    for(log2=0; (1u << log2) < count; log2++);
+    ok(compares / count < 8 * log2, "%u compares for %u adversarial ints\n", compares, count);
+
+    HeapFree(GetProcessHeap(), 0, ints);
+    HeapFree(GetProcessHeap(), 0, recs);
+    HeapFree(GetProcessHeap(), 0, adv.val);
+}
+
 static void test_math_functions(void)
 {
     double ret;
@@ -681,6 +821,7 @@ START_TEST(misc)
     test__popen(arg_v[0]);
     test__invalid_parameter();
     test_qsort_s();
+    test_qsort_s_perf();
     test_math_functions();
     test_thread_handle_close();
     test__lfind_s();
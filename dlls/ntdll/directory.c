@@ -202,16 +202,22 @@ struct dir_data
     struct file_identity    id;      /* directory file identity */
     struct dir_data_names  *names;   /* directory file names */
     struct dir_data_buffer *buffer;  /* head of data buffers list */
+    BOOL                    stream;  /* names are read in batches and not sorted */
+    DIR                    *dir;     /* directory stream for the next batches, NULL when done */
+    UNICODE_STRING          mask;    /* mask for the next batches */
+    NTSTATUS                error;   /* error reading the next batch, reported on the next call */
 };
 
 static const unsigned int dir_data_buffer_initial_size = 4096;
 static const unsigned int dir_data_cache_initial_size  = 256;
 static const unsigned int dir_data_names_initial_size  = 64;
+static const unsigned int dir_data_stream_batch_size   = 16384;  /* larger directories can be streamed */
 
 static struct dir_data **dir_data_cache;
 static unsigned int dir_data_cache_size;
 
 static BOOL show_dot_files;
+static BOOL stream_large_dirs;
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
 /* at some point we may want to allow Winelib apps to set this */
@@ -379,18 +385,28 @@ static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
     return TRUE;
 }
 
-/* free the complete directory data structure */
-static void free_dir_data( struct dir_data *data )
+/* free the directory names, keeping the names array */
+static void reset_dir_data( struct dir_data *data )
 {
     struct dir_data_buffer *buffer, *next;
 
-    if (!data) return;
-
     for (buffer = data->buffer; buffer; buffer = next)
     {
         next = buffer->next;
         RtlFreeHeap( GetProcessHeap(), 0, buffer );
     }
+    data->buffer = NULL;
+    data->count = data->pos = 0;
+}
+
+/* free the complete directory data structure */
+static void free_dir_data( struct dir_data *data )
+{
+    if (!data) return;
+
+    reset_dir_data( data );
+    if (data->dir) closedir( data->dir );
+    RtlFreeHeap( GetProcessHeap(), 0, data->mask.Buffer );
     RtlFreeHeap( GetProcessHeap(), 0, data->names );
     RtlFreeHeap( GetProcessHeap(), 0, data );
 }
@@ -1230,6 +1246,8 @@ static DWORD WINAPI init_options( RTL_RUN_ONCE *once, void *param, void **contex
 {
     static const WCHAR WineW[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e',0};
     static const WCHAR ShowDotFilesW[] = {'S','h','o','w','D','o','t','F','i','l','e','s',0};
+    static const WCHAR StreamLargeDirectoriesW[] = {'S','t','r','e','a','m','L','a','r','g','e',
+                                                    'D','i','r','e','c','t','o','r','i','e','s',0};
     char tmp[80];
     HANDLE root, hkey;
     DWORD dummy;
@@ -1254,6 +1272,12 @@ static DWORD WINAPI init_options( RTL_RUN_ONCE *once, void *param, void **contex
             WCHAR *str = (WCHAR *)((KEY_VALUE_PARTIAL_INFORMATION *)tmp)->Data;
             show_dot_files = IS_OPTION_TRUE( str[0] );
         }
+        RtlInitUnicodeString( &nameW, StreamLargeDirectoriesW );
+        if (!NtQueryValueKey( hkey, &nameW, KeyValuePartialInformation, tmp, sizeof(tmp), &dummy ))
+        {
+            WCHAR *str = (WCHAR *)((KEY_VALUE_PARTIAL_INFORMATION *)tmp)->Data;
+            stream_large_dirs = IS_OPTION_TRUE( str[0] );
+        }
         NtClose( hkey );
     }
     NtClose( root );
@@ -1751,31 +1775,80 @@ static NTSTATUS read_directory_data_stat( struct dir_data *data, const char *uni
 }
 
 
+/***********************************************************************
+ *           read_directory_data_batch
+ *
+ * Read entries from the directory stream until the end, or until a batch is full
+ * when streaming large directories.
+ */
+static NTSTATUS read_directory_data_batch( struct dir_data *data, const UNICODE_STRING *mask )
+{
+    struct dirent *de;
+
+    while (!stream_large_dirs || data->count < dir_data_stream_batch_size)
+    {
+        if (!(de = readdir( data->dir )))
+        {
+            closedir( data->dir );
+            data->dir = NULL;
+            break;
+        }
+        if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
+        if (!append_entry( data, de->d_name, NULL, mask )) return STATUS_NO_MEMORY;
+    }
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           read_directory_readdir
  *
  * Read a directory using the POSIX readdir interface; helper for NtQueryDirectoryFile.
+ * When the StreamLargeDirectories option is set, only the first batch of entries of
+ * large directories is read, and the rest is streamed unsorted as the caller consumes them.
  */
 static NTSTATUS read_directory_data_readdir( struct dir_data *data, const UNICODE_STRING *mask )
 {
-    struct dirent *de;
-    NTSTATUS status = STATUS_NO_MEMORY;
-    DIR *dir = opendir( "." );
+    NTSTATUS status;
 
-    if (!dir) return STATUS_NO_SUCH_FILE;
+    if (!(data->dir = opendir( "." ))) return STATUS_NO_SUCH_FILE;
 
-    if (!append_entry( data, ".", NULL, mask )) goto done;
-    if (!append_entry( data, "..", NULL, mask )) goto done;
-    while ((de = readdir( dir )))
+    if (!append_entry( data, ".", NULL, mask )) return STATUS_NO_MEMORY;
+    if (!append_entry( data, "..", NULL, mask )) return STATUS_NO_MEMORY;
+    if ((status = read_directory_data_batch( data, mask ))) return status;
+    if (!data->dir) return STATUS_SUCCESS;
+
+    TRACE( "streaming large directory\n" );
+    data->stream = TRUE;
+    if (mask)
     {
-        if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
-        if (!append_entry( data, de->d_name, NULL, mask )) goto done;
+        if (!(data->mask.Buffer = RtlAllocateHeap( GetProcessHeap(), 0, mask->Length )))
+            return STATUS_NO_MEMORY;
+        memcpy( data->mask.Buffer, mask->Buffer, mask->Length );
+        data->mask.Length = data->mask.MaximumLength = mask->Length;
     }
-    status = STATUS_SUCCESS;
+    return STATUS_SUCCESS;
+}
 
-done:
-    closedir( dir );
-    return status;
+
+/***********************************************************************
+ *           read_next_directory_data
+ *
+ * Replace the current names of a streamed directory by the next batch.
+ */
+static NTSTATUS read_next_directory_data( struct dir_data *data, BOOL restart )
+{
+    const UNICODE_STRING *mask = data->mask.Buffer ? &data->mask : NULL;
+
+    reset_dir_data( data );
+    if (restart)
+    {
+        if (data->dir) rewinddir( data->dir );
+        else if (!(data->dir = opendir( "." ))) return STATUS_NO_SUCH_FILE;
+        if (!append_entry( data, ".", NULL, mask )) return STATUS_NO_MEMORY;
+        if (!append_entry( data, "..", NULL, mask )) return STATUS_NO_MEMORY;
+    }
+    return read_directory_data_batch( data, mask );
 }
 
 
@@ -1851,15 +1924,16 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
     i = 0;
     if (i < data->count && !strcmp( data->names[i].unix_name, "." )) i++;
     if (i < data->count && !strcmp( data->names[i].unix_name, ".." )) i++;
-    if (i < data->count) qsort( data->names + i, data->count - i, sizeof(*data->names), name_compare );
+    if (i < data->count && !data->stream)
+        qsort( data->names + i, data->count - i, sizeof(*data->names), name_compare );
 
     if (data->count)
     {
         /* release unused space */
-        if (data->buffer)
+        if (data->buffer && !data->stream)
             RtlReAllocateHeap( GetProcessHeap(), HEAP_REALLOC_IN_PLACE_ONLY, data->buffer,
                                offsetof( struct dir_data_buffer, data[data->buffer->pos] ));
-        if (data->count < data->size)
+        if (data->count < data->size && !data->stream)
             RtlReAllocateHeap( GetProcessHeap(), HEAP_REALLOC_IN_PLACE_ONLY, data->names,
                                data->count * sizeof(*data->names) );
         if (!fstat( fd, &st ))
@@ -2004,16 +2078,28 @@ NTSTATUS WINAPI DECLSPEC_HOTPATCH NtQueryDirectoryFile( HANDLE handle, HANDLE ev
         {
             union file_directory_info *last_info = NULL;
 
-            if (restart_scan) data->pos = 0;
+            if (restart_scan)
+            {
+                if (data->stream) status = data->error = read_next_directory_data( data, TRUE );
+                else data->pos = 0;
+            }
 
-            while (!status && data->pos < data->count)
+            while (!status)
             {
+                if (data->pos == data->count)
+                {
+                    if (!data->dir || data->error) break;
+                    /* return the entries already filled, and report the error on the next call */
+                    data->error = read_next_directory_data( data, FALSE );
+                    if (data->error) break;
+                    continue;
+                }
                 status = get_dir_data_entry( data, buffer, io, length, info_class, &last_info );
                 if (!status || status == STATUS_BUFFER_OVERFLOW) data->pos++;
                 if (single_entry) break;
             }
 
-            if (!last_info) status = STATUS_NO_MORE_FILES;
+            if (!last_info) status = data->error ? data->error : STATUS_NO_MORE_FILES;
             else if (status == STATUS_MORE_ENTRIES) status = STATUS_SUCCESS;
 
             io->u.Status = status;
@@ -2031,6 +2117,284 @@ NTSTATUS WINAPI DECLSPEC_HOTPATCH NtQueryDirectoryFile( HANDLE handle, HANDLE ev
 }
 
 
+/***********************************************************************
+ *           Directory name cache
+ *
+ * Case-insensitive lookups that miss the stat() shortcut would otherwise
+ * read the whole directory each time. Directories that haven't been
+ * modified recently get their long and short names indexed in a hash
+ * table, which stays valid as long as the directory mtime doesn't change.
+ */
+
+#define DIR_CACHE_MAX_DIRS  256  /* max number of cached directories */
+#define DIR_CACHE_HASH_SIZE 64   /* size of the directory hash table */
+#define DIR_CACHE_MIN_AGE   2    /* min age in seconds of a directory mtime before it's cached */
+
+struct dir_cache_name
+{
+    unsigned int   next;         /* index of next name in hash chain, ~0u for none */
+    unsigned int   name;         /* offset of the Unicode name in the names pool */
+    unsigned int   unix_name;    /* offset of the Unix name in the names pool */
+    unsigned short len;          /* length of the Unicode name in chars */
+    unsigned short is_short;     /* whether this is a generated short name */
+};
+
+struct dir_cache
+{
+    struct list            entry;      /* entry in dir_cache_list, most recently built first */
+    struct list            hash_entry; /* entry in dir_cache_hash */
+    struct file_identity   id;         /* directory file identity */
+    time_t                 mtime;      /* directory modification time when it was read */
+    unsigned int           count;      /* number of names */
+    unsigned int           size;       /* size of the names array */
+    unsigned int           pool_size;  /* allocated size of the names pool */
+    unsigned int           pool_pos;   /* used size of the names pool */
+    unsigned int           hash_mask;  /* hash table size - 1 */
+    unsigned int          *hash;       /* index of the first name in each hash chain */
+    struct dir_cache_name *names;      /* names array */
+    char                  *pool;       /* names pool */
+};
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );
+static struct list dir_cache_hash[DIR_CACHE_HASH_SIZE];
+static unsigned int dir_cache_count;
+static RTL_SRWLOCK dir_cache_lock = RTL_SRWLOCK_INIT;
+
+static unsigned int hash_dir_cache_name( const WCHAR *name, int len )
+{
+    unsigned int hash = 0;
+    while (len--) hash = hash * 31 + toupperW( *name++ );
+    return hash;
+}
+
+static inline struct list *get_dir_cache_bucket( dev_t dev, ino_t ino )
+{
+    return &dir_cache_hash[(ino ^ dev) % DIR_CACHE_HASH_SIZE];
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+    RtlFreeHeap( GetProcessHeap(), 0, cache->hash );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->names );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->pool );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/* store data in the names pool, returning its offset or ~0u on failure */
+static unsigned int add_dir_cache_data( struct dir_cache *cache, const void *data, unsigned int size )
+{
+    unsigned int pos = (cache->pool_pos + sizeof(WCHAR) - 1) & ~(sizeof(WCHAR) - 1);
+
+    if (pos + size > cache->pool_size)
+    {
+        unsigned int new_size = max( cache->pool_size * 2, pos + size );
+        char *new_pool;
+
+        if (cache->pool)
+            new_pool = RtlReAllocateHeap( GetProcessHeap(), 0, cache->pool, new_size );
+        else
+            new_pool = RtlAllocateHeap( GetProcessHeap(), 0, new_size );
+        if (!new_pool) return ~0u;
+        cache->pool = new_pool;
+        cache->pool_size = new_size;
+    }
+    memcpy( cache->pool + pos, data, size );
+    cache->pool_pos = pos + size;
+    return pos;
+}
+
+static BOOL add_dir_cache_name( struct dir_cache *cache, const WCHAR *name, unsigned int len,
+                                unsigned int unix_name, BOOL is_short )
+{
+    struct dir_cache_name *entry;
+
+    if (cache->count == cache->size)
+    {
+        unsigned int new_size = max( 64, cache->size * 2 );
+        struct dir_cache_name *new_names;
+
+        if (cache->names)
+            new_names = RtlReAllocateHeap( GetProcessHeap(), 0, cache->names, new_size * sizeof(*new_names) );
+        else
+            new_names = RtlAllocateHeap( GetProcessHeap(), 0, new_size * sizeof(*new_names) );
+        if (!new_names) return FALSE;
+        cache->names = new_names;
+        cache->size = new_size;
+    }
+    entry = &cache->names[cache->count];
+    if ((entry->name = add_dir_cache_data( cache, name, len * sizeof(WCHAR) )) == ~0u) return FALSE;
+    entry->unix_name = unix_name;
+    entry->len = len;
+    entry->is_short = is_short;
+    cache->count++;
+    return TRUE;
+}
+
+/***********************************************************************
+ *           read_dir_cache
+ *
+ * Read all the names of a directory into a new cache entry.
+ */
+static struct dir_cache *read_dir_cache( DIR *dir, const struct stat *st )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN], short_nameW[12];
+    struct dir_cache *cache;
+    struct dirent *de;
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    unsigned int i, hash_size, unix_name;
+    int len;
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+    cache->id.dev = st->st_dev;
+    cache->id.ino = st->st_ino;
+    cache->mtime  = st->st_mtime;
+
+    str.Buffer = buffer;
+    str.MaximumLength = sizeof(buffer);
+    while ((de = readdir( dir )))
+    {
+        if ((unix_name = add_dir_cache_data( cache, de->d_name, strlen(de->d_name) + 1 )) == ~0u) goto failed;
+        len = ntdll_umbstowcs( 0, de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
+        if (len <= 0) continue;
+        if (!add_dir_cache_name( cache, buffer, len, unix_name, FALSE )) goto failed;
+
+        str.Length = len * sizeof(WCHAR);
+        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+        {
+            len = hash_short_file_name( &str, short_nameW );
+            if (!add_dir_cache_name( cache, short_nameW, len, unix_name, TRUE )) goto failed;
+        }
+    }
+
+    for (hash_size = 16; hash_size < cache->count * 2; hash_size *= 2) ;
+    if (!(cache->hash = RtlAllocateHeap( GetProcessHeap(), 0, hash_size * sizeof(*cache->hash) )))
+        goto failed;
+    memset( cache->hash, 0xff, hash_size * sizeof(*cache->hash) );
+    cache->hash_mask = hash_size - 1;
+    for (i = 0; i < cache->count; i++)
+    {
+        struct dir_cache_name *entry = &cache->names[i];
+        unsigned int hash = hash_dir_cache_name( (WCHAR *)(cache->pool + entry->name), entry->len );
+
+        entry->next = cache->hash[hash & cache->hash_mask];
+        cache->hash[hash & cache->hash_mask] = i;
+    }
+    return cache;
+
+failed:
+    free_dir_cache( cache );
+    return NULL;
+}
+
+/***********************************************************************
+ *           find_dir_cache_name
+ *
+ * Look up a name in a directory cache, long names taking precedence over short names.
+ * The Unix name found is copied to unix_name.
+ */
+static BOOL find_dir_cache_name( const struct dir_cache *cache, const WCHAR *name, int length,
+                                 BOOLEAN short_names, char *unix_name )
+{
+    const struct dir_cache_name *entry, *found = NULL;
+    unsigned int i = cache->hash[hash_dir_cache_name( name, length ) & cache->hash_mask];
+
+    for ( ; i != ~0u; i = entry->next)
+    {
+        entry = &cache->names[i];
+        if (entry->len != length) continue;
+        if (entry->is_short && (!short_names || found)) continue;
+        if (strncmpiW( (const WCHAR *)(cache->pool + entry->name), name, length )) continue;
+        found = entry;
+        if (!entry->is_short) break;
+    }
+    if (!found) return FALSE;
+    strcpy( unix_name, cache->pool + found->unix_name );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look up a name in the cached contents of a directory.
+ * Returns STATUS_NOT_FOUND if the directory isn't cached or the cache is stale.
+ */
+static NTSTATUS lookup_dir_cache( const struct stat *st, const WCHAR *name, int length,
+                                  BOOLEAN short_names, char *unix_name )
+{
+    struct list *bucket = get_dir_cache_bucket( st->st_dev, st->st_ino );
+    struct dir_cache *cache;
+    NTSTATUS status = STATUS_NOT_FOUND;
+
+    RtlAcquireSRWLockShared( &dir_cache_lock );
+    if (bucket->next) LIST_FOR_EACH_ENTRY( cache, bucket, struct dir_cache, hash_entry )
+    {
+        if (cache->id.dev != st->st_dev || cache->id.ino != st->st_ino) continue;
+        if (cache->mtime == st->st_mtime)
+            status = find_dir_cache_name( cache, name, length, short_names, unix_name )
+                     ? STATUS_SUCCESS : STATUS_OBJECT_PATH_NOT_FOUND;
+        break;
+    }
+    RtlReleaseSRWLockShared( &dir_cache_lock );
+    return status;
+}
+
+static void remove_dir_cache( struct dir_cache *cache )
+{
+    list_remove( &cache->entry );
+    list_remove( &cache->hash_entry );
+    dir_cache_count--;
+    free_dir_cache( cache );
+}
+
+/* add a directory to the cache, replacing any stale entry for it; takes ownership of the cache */
+static void add_dir_cache( struct dir_cache *cache )
+{
+    struct list *bucket;
+    struct dir_cache *old;
+
+    RtlAcquireSRWLockExclusive( &dir_cache_lock );
+    bucket = get_dir_cache_bucket( cache->id.dev, cache->id.ino );
+    if (!bucket->next) list_init( bucket );
+    LIST_FOR_EACH_ENTRY( old, bucket, struct dir_cache, hash_entry )
+    {
+        if (old->id.dev != cache->id.dev || old->id.ino != cache->id.ino) continue;
+        remove_dir_cache( old );
+        break;
+    }
+    if (dir_cache_count == DIR_CACHE_MAX_DIRS)
+        remove_dir_cache( LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry ));
+    list_add_head( &dir_cache_list, &cache->entry );
+    list_add_head( bucket, &cache->hash_entry );
+    dir_cache_count++;
+    RtlReleaseSRWLockExclusive( &dir_cache_lock );
+}
+
+/* check if a directory can be cached; unix_name is the directory path */
+static BOOL is_dir_cacheable( const char *unix_name, const struct stat *st )
+{
+    /* a directory modified within the mtime granularity may be changed again without notice */
+    if (st->st_mtime > time( NULL ) - DIR_CACHE_MIN_AGE) return FALSE;
+
+#ifdef VFAT_IOCTL_READDIR_BOTH
+    {
+        /* VFAT has real short names, don't replace them with generated ones */
+        int fd = open( unix_name, O_RDONLY | O_DIRECTORY );
+        BOOL ret;
+
+        if (fd == -1) return FALSE;
+        RtlEnterCriticalSection( &dir_section );
+        ret = !start_vfat_ioctl( fd );
+        RtlLeaveCriticalSection( &dir_section );
+        close( fd );
+        return ret;
+    }
+#else
+    return TRUE;
+#endif
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2043,10 +2407,12 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 {
     WCHAR buffer[MAX_DIR_ENTRY_LEN];
     UNICODE_STRING str;
-    BOOLEAN spaces, is_name_8_dot_3;
+    BOOLEAN spaces, is_name_8_dot_3, cacheable = FALSE;
     DIR *dir;
     struct dirent *de;
-    struct stat st;
+    struct dir_cache *cache;
+    struct stat st, dir_st;
+    NTSTATUS status;
     int ret, used_default;
 
     /* try a shortcut for this directory */
@@ -2082,10 +2448,24 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 
     if (!is_name_8_dot_3 && !get_dir_case_sensitivity( unix_name )) goto not_found;
 
+    /* try the cached directory contents */
+
+    if (!stat( unix_name, &dir_st ))
+    {
+        status = lookup_dir_cache( &dir_st, name, length, is_name_8_dot_3, unix_name + pos );
+        if (status == STATUS_OBJECT_PATH_NOT_FOUND) goto not_found;
+        if (status == STATUS_SUCCESS)
+        {
+            unix_name[pos - 1] = '/';
+            goto success;
+        }
+        cacheable = is_dir_cacheable( unix_name, &dir_st );
+    }
+
     /* now look for it through the directory */
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
-    if (is_name_8_dot_3)
+    if (is_name_8_dot_3 && !cacheable)
     {
         int fd = open( unix_name, O_RDONLY | O_DIRECTORY );
         if (fd != -1)
@@ -2146,6 +2526,20 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
         else return FILE_GetNtStatus();
     }
+    if (cacheable)
+    {
+        if ((cache = read_dir_cache( dir, &dir_st )))
+        {
+            BOOL found = find_dir_cache_name( cache, name, length, is_name_8_dot_3, unix_name + pos );
+
+            closedir( dir );
+            add_dir_cache( cache );
+            if (!found) goto not_found;
+            unix_name[pos - 1] = '/';
+            goto success;
+        }
+        rewinddir( dir );
+    }
     unix_name[pos - 1] = '/';
     str.Buffer = buffer;
     str.MaximumLength = sizeof(buffer);
@@ -30,6 +30,12 @@
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_SYS_STATVFS_H
 # include <sys/statvfs.h>
 #endif
@@ -109,6 +115,11 @@
 #include "ddk/ntddk.h"
 #include "ddk/ntddser.h"
 
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(IORING_FEAT_RW_CUR_POS)
+#define USE_IO_URING
+#endif
+
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
@@ -506,6 +517,257 @@ NTSTATUS FILE_GetNtStatus(void)
     }
 }
 
+#ifdef USE_IO_URING
+
+/***********************************************************************
+ *                  io_uring file I/O                                  *
+ *
+ * Overlapped reads and writes on regular files are queued to an io_uring
+ * instance and completed from a dedicated thread, instead of blocking the
+ * caller in pread/pwrite. Only requests that report completion through an
+ * event (and optionally a completion port) are handled here; everything
+ * else goes through the synchronous path.
+ */
+
+#define URING_ENTRIES 256
+
+struct uring_request
+{
+    IO_STATUS_BLOCK *iosb;
+    HANDLE           handle;   /* file handle, for completion port notification */
+    HANDLE           event;
+    ULONG_PTR        cvalue;
+    BOOL             read;
+};
+
+static struct
+{
+    int                    fd;
+    volatile unsigned int *sq_head;
+    volatile unsigned int *sq_tail;
+    unsigned int           sq_mask;
+    unsigned int          *sq_array;
+    struct io_uring_sqe   *sqes;
+    volatile unsigned int *cq_head;
+    volatile unsigned int *cq_tail;
+    unsigned int           cq_mask;
+    struct io_uring_cqe   *cqes;
+    LONG                   cq_entries;
+    LONG                   pending;   /* number of requests submitted and not yet completed */
+} uring;
+
+static LONG use_uring = -1;
+
+static RTL_CRITICAL_SECTION uring_section;
+static RTL_CRITICAL_SECTION_DEBUG uring_critsect_debug =
+{
+    0, 0, &uring_section,
+    { &uring_critsect_debug.ProcessLocksList, &uring_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": uring_section") }
+};
+static RTL_CRITICAL_SECTION uring_section = { &uring_critsect_debug, -1, 0, 0, 0, 0 };
+
+/* complete a single request, called on the completion thread */
+static void uring_complete( struct uring_request *req, int res )
+{
+    IO_STATUS_BLOCK *iosb = req->iosb;
+    NTSTATUS status;
+    ULONG total = 0;
+
+    if (res >= 0)
+    {
+        total = res;
+        status = (total || !req->read) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    else if (res == -EFAULT && !req->read) status = STATUS_INVALID_USER_BUFFER;
+    else
+    {
+        errno = -res;
+        status = FILE_GetNtStatus();
+    }
+
+    TRACE( "%p: completed iosb %p status %08x total %u\n", req->handle, iosb, status, total );
+
+    iosb->Information = total;
+    interlocked_xchg( (LONG *)&iosb->u.Status, status );
+    NtSetEvent( req->event, NULL );
+    if (req->cvalue) NTDLL_AddCompletion( req->handle, req->cvalue, status, total, TRUE );
+    RtlFreeHeap( GetProcessHeap(), 0, req );
+}
+
+static void CALLBACK uring_thread_proc( void *arg )
+{
+    struct io_uring_cqe *cqe;
+    unsigned int head;
+
+    for (;;)
+    {
+        head = *uring.cq_head;
+        if (head == *uring.cq_tail)
+        {
+            syscall( __NR_io_uring_enter, uring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+            continue;
+        }
+        cqe = &uring.cqes[head & uring.cq_mask];
+        uring_complete( (struct uring_request *)(ULONG_PTR)cqe->user_data, cqe->res );
+        interlocked_xchg( (LONG *)uring.cq_head, head + 1 );
+        interlocked_xchg_add( &uring.pending, -1 );
+    }
+}
+
+/* create the ring and its completion thread; uring_section must be held */
+static BOOL uring_setup(void)
+{
+    struct io_uring_params params;
+    const char *env = getenv( "WINEIOURING" );
+    size_t size;
+    char *ring;
+    void *sqes;
+    HANDLE thread;
+    int fd;
+
+    if (!env || !atoi( env )) return FALSE;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params )) == -1)
+    {
+        WARN( "io_uring not available: %s\n", strerror( errno ));
+        return FALSE;
+    }
+    /* IORING_FEAT_RW_CUR_POS comes with the same kernel release as IORING_OP_READ/WRITE */
+    if ((params.features & (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS)) !=
+        (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS))
+    {
+        WARN( "io_uring features %#x not supported\n", params.features );
+        close( fd );
+        return FALSE;
+    }
+
+    size = max( params.sq_off.array + params.sq_entries * sizeof(unsigned int),
+                params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe) );
+    ring = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if (ring == MAP_FAILED)
+    {
+        close( fd );
+        return FALSE;
+    }
+    sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if (sqes == MAP_FAILED)
+    {
+        munmap( ring, size );
+        close( fd );
+        return FALSE;
+    }
+
+    uring.fd         = fd;
+    uring.sq_head    = (unsigned int *)(ring + params.sq_off.head);
+    uring.sq_tail    = (unsigned int *)(ring + params.sq_off.tail);
+    uring.sq_mask    = *(unsigned int *)(ring + params.sq_off.ring_mask);
+    uring.sq_array   = (unsigned int *)(ring + params.sq_off.array);
+    uring.sqes       = sqes;
+    uring.cq_head    = (unsigned int *)(ring + params.cq_off.head);
+    uring.cq_tail    = (unsigned int *)(ring + params.cq_off.tail);
+    uring.cq_mask    = *(unsigned int *)(ring + params.cq_off.ring_mask);
+    uring.cqes       = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+    uring.cq_entries = params.cq_entries;
+
+    if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                             uring_thread_proc, NULL, &thread, NULL ))
+    {
+        munmap( sqes, params.sq_entries * sizeof(struct io_uring_sqe) );
+        munmap( ring, size );
+        close( fd );
+        return FALSE;
+    }
+    NtClose( thread );
+    TRACE( "using io_uring with %u entries\n", params.sq_entries );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           uring_submit
+ *
+ * Queue an overlapped read or write on a regular file.
+ * Returns STATUS_PENDING if the request was queued, STATUS_NOT_SUPPORTED if
+ * the caller should perform the I/O itself.
+ */
+static NTSTATUS uring_submit( HANDLE handle, int fd, HANDLE event, ULONG_PTR cvalue,
+                              IO_STATUS_BLOCK *iosb, void *buffer, ULONG length,
+                              off_t offset, BOOL read )
+{
+    struct uring_request *req;
+    struct io_uring_sqe *sqe;
+    unsigned int tail;
+    int ret = -1;
+
+    /* without an event GetOverlappedResult waits on the file handle, which is always signaled */
+    if (!event || !length) return STATUS_NOT_SUPPORTED;
+
+    if (use_uring == -1)
+    {
+        RtlEnterCriticalSection( &uring_section );
+        if (use_uring == -1) interlocked_xchg( &use_uring, uring_setup() );
+        RtlLeaveCriticalSection( &uring_section );
+    }
+    if (!use_uring) return STATUS_NOT_SUPPORTED;
+
+    if (read)
+    {
+        struct stat st;
+
+        /* reads at end of file fail synchronously */
+        if (fstat( fd, &st ) == -1 || offset >= st.st_size) return STATUS_NOT_SUPPORTED;
+        /* the kernel won't trigger write watches for us */
+        if (!virtual_prepare_async_write( buffer, length )) return STATUS_NOT_SUPPORTED;
+    }
+
+    if (!(req = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*req) ))) return STATUS_NOT_SUPPORTED;
+    req->iosb   = iosb;
+    req->handle = handle;
+    req->event  = event;
+    req->cvalue = cvalue;
+    req->read   = read;
+
+    iosb->u.Status = STATUS_PENDING;
+    iosb->Information = 0;
+    NtResetEvent( event, NULL );
+
+    RtlEnterCriticalSection( &uring_section );
+    if (interlocked_xchg_add( &uring.pending, 1 ) < uring.cq_entries)
+    {
+        tail = *uring.sq_tail;
+        sqe = &uring.sqes[tail & uring.sq_mask];
+        memset( sqe, 0, sizeof(*sqe) );
+        sqe->opcode    = read ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd        = fd;
+        sqe->off       = offset;
+        sqe->addr      = (ULONG_PTR)buffer;
+        sqe->len       = length;
+        sqe->user_data = (ULONG_PTR)req;
+        uring.sq_array[tail & uring.sq_mask] = tail & uring.sq_mask;
+        interlocked_xchg( (LONG *)uring.sq_tail, tail + 1 );
+
+        while ((ret = syscall( __NR_io_uring_enter, uring.fd, 1, 0, 0, NULL, 0 )) == -1 && errno == EINTR);
+        /* take the entry back if the kernel didn't consume it */
+        if (ret != 1 && *uring.sq_head == tail) interlocked_xchg( (LONG *)uring.sq_tail, tail );
+    }
+    if (ret != 1) interlocked_xchg_add( &uring.pending, -1 );
+    RtlLeaveCriticalSection( &uring_section );
+
+    if (ret != 1)
+    {
+        WARN( "failed to submit request: %d\n", ret == -1 ? errno : ret );
+        RtlFreeHeap( GetProcessHeap(), 0, req );
+        return STATUS_NOT_SUPPORTED;
+    }
+    TRACE( "%p: queued %s of %u bytes at %s\n", handle, read ? "read" : "write",
+           length, wine_dbgstr_longlong( offset ));
+    return STATUS_PENDING;
+}
+
+#endif  /* USE_IO_URING */
+
 /***********************************************************************
  *             FILE_AsyncReadService      (INTERNAL)
  */
@@ -859,6 +1121,12 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
+#ifdef USE_IO_URING
+            if (async_read && !apc &&
+                (status = uring_submit( hFile, unix_handle, hEvent, cvalue, io_status, buffer,
+                                        length, offset->QuadPart, TRUE )) == STATUS_PENDING)
+                goto err;
+#endif
             /* async I/O doesn't make sense on regular files */
             while ((result = virtual_locked_pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
@@ -1264,6 +1532,12 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
                 goto done;
             }
 
+#ifdef USE_IO_URING
+            if (async_write && !apc &&
+                (status = uring_submit( hFile, unix_handle, hEvent, cvalue, io_status, (void *)buffer,
+                                        length, off, FALSE )) == STATUS_PENDING)
+                goto err;
+#endif
             /* async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
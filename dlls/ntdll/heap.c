@@ -85,6 +85,7 @@ typedef struct
 #define ARENA_PENDING_MAGIC    0xbedead
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
+#define ARENA_LFH_MAGIC        0x48464c
 
 #define ARENA_INUSE_FILLER     0x55
 #define ARENA_TAIL_FILLER      0xab
@@ -132,6 +133,21 @@ typedef union
     void       *alignment[4];
 } FREE_LIST_ENTRY;
 
+/* Low-fragmentation heap front-end: blocks of the same size are cached in
+ * lock-free lists, one set of lists per slot. Threads are spread across the
+ * slots so that the common allocation path doesn't need the heap lock. Freed
+ * blocks are validated under the heap lock before going back to the cache. */
+#define HEAP_LFH_NB_SLOTS      16
+#define HEAP_LFH_NB_BINS       128
+#define HEAP_LFH_MAX_DEPTH     32   /* max number of cached blocks per bin */
+#define HEAP_LFH_BATCH         8    /* number of blocks to allocate when refilling a bin */
+#define HEAP_LFH_MAX_SIZE      (HEAP_MIN_DATA_SIZE + (HEAP_LFH_NB_BINS - 1) * ALIGNMENT)
+
+typedef struct
+{
+    SLIST_HEADER bins[HEAP_LFH_NB_BINS];  /* cached blocks, indexed by block size */
+} LFH_SLOT;
+
 struct tagHEAP;
 
 typedef struct tagSUBHEAP
@@ -164,6 +180,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    LFH_SLOT        *lfh;           /* Low-fragmentation heap slots, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -1057,6 +1074,170 @@ static ARENA_FREE *HEAP_FindFreeBlock( HEAP *heap, SIZE_T size,
 }
 
 
+/***********************************************************************
+ *           allocate_block
+ *
+ * Allocate an in-use block of the given rounded size. Heap must be locked.
+ */
+static ARENA_INUSE *allocate_block( HEAP *heap, SIZE_T rounded_size )
+{
+    ARENA_FREE *pArena;
+    ARENA_INUSE *pInUse;
+    SUBHEAP *subheap;
+
+    /* Locate a suitable free block */
+
+    if (!(pArena = HEAP_FindFreeBlock( heap, rounded_size, &subheap ))) return NULL;
+
+    /* Remove the arena from the free list */
+
+    list_remove( &pArena->entry );
+
+    /* Build the in-use arena */
+
+    pInUse = (ARENA_INUSE *)pArena;
+
+    /* in-use arena is smaller than free arena,
+     * so we have to add the difference to the size */
+    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
+    pInUse->magic = ARENA_INUSE_MAGIC;
+
+    /* Shrink the block */
+
+    HEAP_ShrinkBlock( subheap, pInUse, rounded_size );
+    return pInUse;
+}
+
+
+/***********************************************************************
+ *           lfh_get_bin
+ *
+ * Get the LFH bin of the current thread for blocks of the given size.
+ */
+static inline SLIST_HEADER *lfh_get_bin( HEAP *heap, SIZE_T size )
+{
+    ULONG_PTR slot = ((ULONG_PTR)NtCurrentTeb()->ClientId.UniqueThread >> 2) % HEAP_LFH_NB_SLOTS;
+
+    if (size < HEAP_MIN_DATA_SIZE || size > HEAP_LFH_MAX_SIZE) return NULL;
+    return &heap->lfh[slot].bins[(size - HEAP_MIN_DATA_SIZE) / ALIGNMENT];
+}
+
+
+/***********************************************************************
+ *           lfh_free_block
+ *
+ * Put an in-use block into the LFH cache. Doesn't need the heap lock.
+ */
+static BOOL lfh_free_block( HEAP *heap, ARENA_INUSE *arena )
+{
+    SLIST_HEADER *bin = lfh_get_bin( heap, arena->size & ARENA_SIZE_MASK );
+
+    if (!bin || RtlQueryDepthSList( bin ) >= HEAP_LFH_MAX_DEPTH) return FALSE;
+    arena->magic = ARENA_LFH_MAGIC;
+    RtlInterlockedPushEntrySList( bin, (SLIST_ENTRY *)(arena + 1) );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_allocate_block
+ *
+ * Get a block from the LFH cache, refilling the cache from the heap if needed.
+ * The heap lock is only taken on refill.
+ */
+static ARENA_INUSE *lfh_allocate_block( HEAP *heap, SIZE_T rounded_size )
+{
+    SLIST_HEADER *bin = lfh_get_bin( heap, rounded_size );
+    ARENA_INUSE *arena, *ret = NULL;
+    SLIST_ENTRY *entry;
+    unsigned int i;
+
+    if (!bin) return NULL;
+
+    if ((entry = RtlInterlockedPopEntrySList( bin )))
+    {
+        ret = (ARENA_INUSE *)entry - 1;
+        ret->magic = ARENA_INUSE_MAGIC;
+        return ret;
+    }
+
+    RtlEnterCriticalSection( &heap->critSection );
+    for (i = 0; i < HEAP_LFH_BATCH; i++)
+    {
+        if (!(arena = allocate_block( heap, rounded_size ))) break;
+        if (!ret) ret = arena;
+        else if (!lfh_free_block( heap, arena ))
+            HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, arena ), arena );
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           lfh_flush
+ *
+ * Return all the blocks cached by the LFH to the heap. Heap must be locked.
+ */
+static void lfh_flush( HEAP *heap )
+{
+    SLIST_ENTRY *entry, *next;
+    unsigned int i, j;
+
+    for (i = 0; i < HEAP_LFH_NB_SLOTS; i++)
+    {
+        for (j = 0; j < HEAP_LFH_NB_BINS; j++)
+        {
+            for (entry = RtlInterlockedFlushSList( &heap->lfh[i].bins[j] ); entry; entry = next)
+            {
+                ARENA_INUSE *arena = (ARENA_INUSE *)entry - 1;
+
+                next = entry->Next;
+                arena->magic = ARENA_INUSE_MAGIC;
+                HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, arena ), arena );
+            }
+        }
+    }
+}
+
+
+/***********************************************************************
+ *           lfh_enable
+ *
+ * Switch a heap to the low-fragmentation front-end.
+ */
+static NTSTATUS lfh_enable( HEAP *heap )
+{
+    void *ptr = NULL;
+    SIZE_T size = HEAP_LFH_NB_SLOTS * sizeof(LFH_SLOT);
+    unsigned int i, j;
+
+    /* the LFH doesn't support unserialized heaps, and would defeat the debugging checks */
+    if (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_VALIDATE | HEAP_PAGE_ALLOCS |
+                       HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED))
+        return STATUS_UNSUCCESSFUL;
+    if (heap->pending_free || RUNNING_ON_VALGRIND) return STATUS_UNSUCCESSFUL;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+        return STATUS_NO_MEMORY;
+    for (i = 0; i < HEAP_LFH_NB_SLOTS; i++)
+        for (j = 0; j < HEAP_LFH_NB_BINS; j++)
+            RtlInitializeSListHead( &((LFH_SLOT *)ptr)[i].bins[j] );
+
+    RtlEnterCriticalSection( &heap->critSection );
+    if (!heap->lfh) heap->lfh = ptr;
+    else
+    {
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), &ptr, &size, MEM_RELEASE );
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+    TRACE( "enabled LFH for heap %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           HEAP_IsValidArenaPtr
  *
@@ -1213,7 +1394,8 @@ static BOOL HEAP_ValidateInUseArena( const SUBHEAP *subheap, const ARENA_INUSE *
     }
 
     /* Check magic number */
-    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC)
+    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC &&
+        pArena->magic != ARENA_LFH_MAGIC)
     {
         if (quiet == NOISY) {
             ERR("Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, pArena->magic, pArena );
@@ -1428,7 +1610,7 @@ static BOOL validate_block_pointer( HEAP *heap, SUBHEAP **ret_subheap, const ARE
         ret = HEAP_ValidateInUseArena( subheap, arena, QUIET );
     else if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET)
         WARN( "Heap %p: unaligned arena pointer %p\n", subheap->heap, arena );
-    else if (arena->magic == ARENA_PENDING_MAGIC)
+    else if (arena->magic == ARENA_PENDING_MAGIC || arena->magic == ARENA_LFH_MAGIC)
         WARN( "Heap %p: block %p used after free\n", subheap->heap, arena + 1 );
     else if (arena->magic != ARENA_INUSE_MAGIC)
         WARN( "Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, arena->magic, arena );
@@ -1637,6 +1819,12 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
         addr = heapPtr->pending_free;
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
     }
+    if (heapPtr->lfh)
+    {
+        size = 0;
+        addr = heapPtr->lfh;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
     size = 0;
     addr = heapPtr->subheap.base;
     NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
@@ -1663,9 +1851,7 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
  */
 void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 {
-    ARENA_FREE *pArena;
     ARENA_INUSE *pInUse;
-    SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
     SIZE_T rounded_size;
 
@@ -1682,6 +1868,15 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && (pInUse = lfh_allocate_block( heapPtr, rounded_size )))
+    {
+        pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
+        notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
+        initialize_block( pInUse + 1, size, pInUse->unused_bytes, flags );
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse + 1 );
+        return pInUse + 1;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1693,9 +1888,7 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
         return ret;
     }
 
-    /* Locate a suitable free block */
-
-    if (!(pArena = HEAP_FindFreeBlock( heapPtr, rounded_size, &subheap )))
+    if (!(pInUse = allocate_block( heapPtr, rounded_size )))
     {
         TRACE("(%p,%08x,%08lx): returning NULL\n",
                   heap, flags, size  );
@@ -1704,22 +1897,6 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
         return NULL;
     }
 
-    /* Remove the arena from the free list */
-
-    list_remove( &pArena->entry );
-
-    /* Build the in-use arena */
-
-    pInUse = (ARENA_INUSE *)pArena;
-
-    /* in-use arena is smaller than free arena,
-     * so we have to add the difference to the size */
-    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
-    pInUse->magic = ARENA_INUSE_MAGIC;
-
-    /* Shrink the block */
-
-    HEAP_ShrinkBlock( subheap, pInUse, rounded_size );
     pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
 
     notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
@@ -1765,18 +1942,19 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+    pInUse  = (ARENA_INUSE *)ptr - 1;
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
     notify_free( ptr );
 
     /* Some sanity checks */
-    pInUse  = (ARENA_INUSE *)ptr - 1;
     if (!validate_block_pointer( heapPtr, &subheap, pInUse )) goto error;
 
     if (!subheap)
         free_large_block( heapPtr, flags, ptr );
-    else
+    else if (!heapPtr->lfh || !lfh_free_block( heapPtr, pInUse ))
         HEAP_MakeInUseBlockFree( subheap, pInUse );
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
@@ -1952,12 +2130,21 @@ error:
  *  The number of bytes compacted.
  *
  * NOTES
- *  This function is a harmless stub.
+ *  This function only returns the blocks cached by the LFH to the heap.
  */
 ULONG WINAPI RtlCompactHeap( HANDLE heap, ULONG flags )
 {
     static BOOL reported;
-    if (!reported++) FIXME( "(%p, 0x%x) stub\n", heap, flags );
+    HEAP *heapPtr = HEAP_GetPtr( heap );
+
+    if (!reported++) FIXME( "(%p, 0x%x) semi-stub\n", heap, flags );
+
+    if (heapPtr && heapPtr->lfh)
+    {
+        RtlEnterCriticalSection( &heapPtr->critSection );
+        lfh_flush( heapPtr );
+        RtlLeaveCriticalSection( &heapPtr->critSection );
+    }
     return 0;
 }
 
@@ -2132,7 +2319,8 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         }
 
         if (((ARENA_INUSE *)ptr - 1)->magic == ARENA_INUSE_MAGIC ||
-            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC)
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC ||
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_LFH_MAGIC)
         {
             ARENA_INUSE *pArena = (ARENA_INUSE *)ptr - 1;
             ptr += pArena->size & ARENA_SIZE_MASK;
@@ -2180,7 +2368,7 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         entry->lpData = pArena + 1;
         entry->cbData = pArena->size & ARENA_SIZE_MASK;
         entry->cbOverhead = sizeof(ARENA_INUSE);
-        entry->wFlags = (pArena->magic == ARENA_PENDING_MAGIC) ?
+        entry->wFlags = (pArena->magic == ARENA_PENDING_MAGIC || pArena->magic == ARENA_LFH_MAGIC) ?
                         PROCESS_HEAP_UNCOMMITTED_RANGE : PROCESS_HEAP_ENTRY_BUSY;
         /* FIXME: can't handle PROCESS_HEAP_ENTRY_MOVEABLE
         and PROCESS_HEAP_ENTRY_DDESHARE yet */
@@ -2245,6 +2433,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2253,7 +2443,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lfh ? 2 : 0; /* low-fragmentation or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2267,6 +2458,27 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap, the LFH can't be disabled once enabled */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:
+            return lfh_enable( heapPtr );
+        default:
+            FIXME("%p: unsupported heap compatibility mode %u\n", heap, *(ULONG *)info);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
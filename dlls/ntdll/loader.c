@@ -93,12 +93,25 @@ static const char * const reason_names[] =
 
 static const WCHAR dllW[] = {'.','d','l','l',0};
 
+/* hash indexes of the loaded modules */
+enum module_index
+{
+    MODULE_INDEX_ADDRESS,
+    MODULE_INDEX_BASENAME,
+    MODULE_INDEX_FULLNAME,
+    MODULE_INDEX_FILEID,
+    MODULE_INDEX_COUNT
+};
+
 /* internal representation of 32bit modules. per process. */
 typedef struct _wine_modref
 {
     LDR_MODULE            ldr;
+    struct list           index_entry[MODULE_INDEX_COUNT];
+    BOOL                  published;  /* visible to the lookups without loader_section */
     dev_t                 dev;
     ino_t                 ino;
+    time_t                mtime;
     int                   alloc_deps;
     int                   nDeps;
     struct _wine_modref **deps;
@@ -426,6 +439,165 @@ static void call_ldr_notifications( ULONG reason, LDR_MODULE *module )
     }
 }
 
+/***********************************************************************
+ *           Module indexes
+ *
+ * Hash tables of the loaded modules by base address, base name, full name
+ * and file id, kept in sync with the module lists. They are only modified
+ * with both the loader_section and the module_index_lock held, so that
+ * simple lookups can be done with the module_index_lock alone.
+ *
+ * Modules are indexed as soon as they are allocated, but the lookups done
+ * without the loader_section only return them once they are published, that
+ * is once they have been fully loaded and attached, and until they start
+ * being unloaded.
+ */
+
+#define MODULE_INDEX_HASH_SIZE 128
+
+static struct list module_index[MODULE_INDEX_COUNT][MODULE_INDEX_HASH_SIZE];
+static RTL_SRWLOCK module_index_lock = RTL_SRWLOCK_INIT;
+
+static unsigned int hash_module_address( const void *base )
+{
+    return ((ULONG_PTR)base >> 16) % MODULE_INDEX_HASH_SIZE;
+}
+
+static unsigned int hash_module_name( const WCHAR *name, unsigned int len )
+{
+    unsigned int hash = 0;
+
+    while (len--) hash = hash * 31 + toupperW( *name++ );
+    return hash % MODULE_INDEX_HASH_SIZE;
+}
+
+static unsigned int hash_module_fileid( dev_t dev, ino_t ino )
+{
+    return (unsigned int)((ULONGLONG)ino ^ ((ULONGLONG)ino >> 32) ^ dev) % MODULE_INDEX_HASH_SIZE;
+}
+
+static unsigned int get_module_hash( const WINE_MODREF *wm, enum module_index index )
+{
+    switch (index)
+    {
+    case MODULE_INDEX_ADDRESS:
+        return hash_module_address( wm->ldr.BaseAddress );
+    case MODULE_INDEX_BASENAME:
+        return hash_module_name( wm->ldr.BaseDllName.Buffer, wm->ldr.BaseDllName.Length / sizeof(WCHAR) );
+    case MODULE_INDEX_FULLNAME:
+        return hash_module_name( wm->ldr.FullDllName.Buffer, wm->ldr.FullDllName.Length / sizeof(WCHAR) );
+    default:
+        return hash_module_fileid( wm->dev, wm->ino );
+    }
+}
+
+/* return the hash bucket, or NULL if no module has been indexed yet */
+static inline struct list *get_module_bucket( enum module_index index, unsigned int hash )
+{
+    struct list *bucket = &module_index[index][hash];
+    return bucket->next ? bucket : NULL;
+}
+
+/*************************************************************************
+ *		add_module_index
+ *
+ * Add a module to the indexes it isn't part of yet. Modules without a file id
+ * (builtin .so modules, or native ones before it's set) are only added to the
+ * other indexes.
+ * The loader_section must be locked while calling this function.
+ */
+static void add_module_index( WINE_MODREF *wm, BOOL head )
+{
+    unsigned int i, j;
+
+    RtlAcquireSRWLockExclusive( &module_index_lock );
+
+    if (!module_index[0][0].next)
+        for (i = 0; i < MODULE_INDEX_COUNT; i++)
+            for (j = 0; j < MODULE_INDEX_HASH_SIZE; j++) list_init( &module_index[i][j] );
+
+    for (i = 0; i < MODULE_INDEX_COUNT; i++)
+    {
+        struct list *bucket;
+
+        if (wm->index_entry[i].next) continue;
+        if (i == MODULE_INDEX_FILEID && !wm->dev && !wm->ino) continue;
+        bucket = &module_index[i][get_module_hash( wm, i )];
+        if (head) list_add_head( bucket, &wm->index_entry[i] );
+        else list_add_tail( bucket, &wm->index_entry[i] );
+    }
+
+    RtlReleaseSRWLockExclusive( &module_index_lock );
+}
+
+/*************************************************************************
+ *		publish_module
+ *
+ * Make a module visible, or not, to the lookups done without the loader_section.
+ * The loader_section must be locked while calling this function.
+ */
+static void publish_module( WINE_MODREF *wm, BOOL published )
+{
+    if (wm->published == published) return;
+    RtlAcquireSRWLockExclusive( &module_index_lock );
+    wm->published = published;
+    RtlReleaseSRWLockExclusive( &module_index_lock );
+}
+
+/*************************************************************************
+ *		remove_module_index
+ *
+ * Remove a module from all the indexes.
+ * The loader_section must be locked while calling this function.
+ */
+static void remove_module_index( WINE_MODREF *wm )
+{
+    unsigned int i;
+
+    RtlAcquireSRWLockExclusive( &module_index_lock );
+    for (i = 0; i < MODULE_INDEX_COUNT; i++)
+    {
+        if (!wm->index_entry[i].next) continue;
+        list_remove( &wm->index_entry[i] );
+        wm->index_entry[i].next = wm->index_entry[i].prev = NULL;
+    }
+    RtlReleaseSRWLockExclusive( &module_index_lock );
+}
+
+/*************************************************************************
+ *		find_address_index
+ *
+ * Find a module from its base address in the index.
+ * The loader_section or the module_index_lock must be held while calling this function.
+ */
+static WINE_MODREF *find_address_index( HMODULE hmod )
+{
+    struct list *bucket = get_module_bucket( MODULE_INDEX_ADDRESS, hash_module_address( hmod ));
+    WINE_MODREF *wm;
+
+    if (!bucket) return NULL;
+    LIST_FOR_EACH_ENTRY( wm, bucket, WINE_MODREF, index_entry[MODULE_INDEX_ADDRESS] )
+        if (wm->ldr.BaseAddress == hmod) return wm;
+    return NULL;
+}
+
+/*************************************************************************
+ *		find_basename_index
+ *
+ * Find a module from its base name in the index.
+ * The loader_section or the module_index_lock must be held while calling this function.
+ */
+static WINE_MODREF *find_basename_index( LPCWSTR name )
+{
+    struct list *bucket = get_module_bucket( MODULE_INDEX_BASENAME, hash_module_name( name, strlenW(name) ));
+    WINE_MODREF *wm;
+
+    if (!bucket) return NULL;
+    LIST_FOR_EACH_ENTRY( wm, bucket, WINE_MODREF, index_entry[MODULE_INDEX_BASENAME] )
+        if (!strcmpiW( name, wm->ldr.BaseDllName.Buffer )) return wm;
+    return NULL;
+}
+
 /*************************************************************************
  *		get_modref
  *
@@ -434,19 +606,12 @@ static void call_ldr_notifications( ULONG reason, LDR_MODULE *module )
  */
 static WINE_MODREF *get_modref( HMODULE hmod )
 {
-    PLIST_ENTRY mark, entry;
-    PLDR_MODULE mod;
+    WINE_MODREF *wm;
 
     if (cached_modref && cached_modref->ldr.BaseAddress == hmod) return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        mod = CONTAINING_RECORD(entry, LDR_MODULE, InMemoryOrderModuleList);
-        if (mod->BaseAddress == hmod)
-            return cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-    }
-    return NULL;
+    if ((wm = find_address_index( hmod ))) cached_modref = wm;
+    return wm;
 }
 
 
@@ -458,22 +623,13 @@ static WINE_MODREF *get_modref( HMODULE hmod )
  */
 static WINE_MODREF *find_basename_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
+    WINE_MODREF *wm;
 
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.BaseDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->BaseDllName.Buffer ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
-    }
-    return NULL;
+    if ((wm = find_basename_index( name ))) cached_modref = wm;
+    return wm;
 }
 
 
@@ -485,8 +641,9 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
  */
 static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
 {
-    PLIST_ENTRY mark, entry;
+    struct list *bucket;
     UNICODE_STRING name = *nt_name;
+    WINE_MODREF *wm;
 
     if (name.Length <= 4 * sizeof(WCHAR)) return NULL;
     name.Length -= 4 * sizeof(WCHAR);  /* for \??\ prefix */
@@ -495,14 +652,16 @@ static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
     if (cached_modref && RtlEqualUnicodeString( &name, &cached_modref->ldr.FullDllName, TRUE ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    if (!(bucket = get_module_bucket( MODULE_INDEX_FULLNAME,
+                                      hash_module_name( name.Buffer, name.Length / sizeof(WCHAR) ))))
+        return NULL;
+
+    LIST_FOR_EACH_ENTRY( wm, bucket, WINE_MODREF, index_entry[MODULE_INDEX_FULLNAME] )
     {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (RtlEqualUnicodeString( &name, &mod->FullDllName, TRUE ))
+        if (RtlEqualUnicodeString( &name, &wm->ldr.FullDllName, TRUE ))
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
+            cached_modref = wm;
+            return wm;
         }
     }
     return NULL;
@@ -517,17 +676,17 @@ static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
  */
 static WINE_MODREF *find_fileid_module( struct stat *st )
 {
-    LIST_ENTRY *mark, *entry;
+    struct list *bucket;
+    WINE_MODREF *wm;
 
     if (cached_modref && cached_modref->dev == st->st_dev && cached_modref->ino == st->st_ino)
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        LDR_MODULE *mod = CONTAINING_RECORD( entry, LDR_MODULE, InLoadOrderModuleList );
-        WINE_MODREF *wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
+    if (!(bucket = get_module_bucket( MODULE_INDEX_FILEID, hash_module_fileid( st->st_dev, st->st_ino ))))
+        return NULL;
 
+    LIST_FOR_EACH_ENTRY( wm, bucket, WINE_MODREF, index_entry[MODULE_INDEX_FILEID] )
+    {
         if (wm->dev == st->st_dev && wm->ino == st->st_ino)
         {
             cached_modref = wm;
@@ -683,13 +842,12 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 
 
 /*************************************************************************
- *		find_named_export
+ *		find_name_ordinal
  *
- * Find an exported function by name.
- * The loader_section must be locked while calling this function.
+ * Find the index in the export functions table of an exported name.
  */
-static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
-                                  DWORD exp_size, const char *name, int hint, LPCWSTR load_path )
+static int find_name_ordinal( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+                              const char *name, int hint )
 {
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
@@ -699,8 +857,7 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
     if (hint >= 0 && hint <= max)
     {
         char *ename = get_rva( module, names[hint] );
-        if (!strcmp( ename, name ))
-            return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
+        if (!strcmp( ename, name )) return ordinals[hint];
     }
 
     /* then do a binary search */
@@ -708,13 +865,364 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
     {
         int res, pos = (min + max) / 2;
         char *ename = get_rva( module, names[pos] );
-        if (!(res = strcmp( ename, name )))
-            return find_ordinal_export( module, exports, exp_size, ordinals[pos], load_path );
+        if (!(res = strcmp( ename, name ))) return ordinals[pos];
         if (res > 0) max = pos - 1;
         else min = pos + 1;
     }
-    return NULL;
+    return -1;
+}
+
 
+/*************************************************************************
+ *		find_named_export
+ *
+ * Find an exported function by name.
+ * The loader_section must be locked while calling this function.
+ */
+static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+                                  DWORD exp_size, const char *name, int hint, LPCWSTR load_path )
+{
+    int ordinal = find_name_ordinal( module, exports, name, hint );
+
+    if (ordinal == -1) return NULL;
+    return find_ordinal_export( module, exports, exp_size, ordinal, load_path );
+}
+
+
+/*************************************************************************
+ *		find_export_nolock
+ *
+ * Find an exported function of a loaded module without the loader_section.
+ * Forwarded exports and relay or snoop debugging need the loader_section,
+ * so NULL is returned for them and the caller has to use the normal path.
+ * The module_index_lock must be held while calling this function.
+ */
+static void *find_export_nolock( HMODULE module, const ANSI_STRING *name, ULONG ord )
+{
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    WINE_MODREF *wm;
+    const DWORD *functions;
+    DWORD exp_size, ordinal;
+    const char *proc;
+
+    if (TRACE_ON(snoop) || TRACE_ON(relay)) return NULL;
+    if (!(wm = find_address_index( module )) || !wm->published) return NULL;
+    if (!(exports = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size )))
+        return NULL;
+
+    if (name) ordinal = find_name_ordinal( module, exports, name->Buffer, -1 );
+    else ordinal = ord - exports->Base;
+    if (ordinal >= exports->NumberOfFunctions) return NULL;
+
+    functions = get_rva( module, exports->AddressOfFunctions );
+    if (!functions[ordinal]) return NULL;
+    proc = get_rva( module, functions[ordinal] );
+
+    /* if the address falls into the export dir, it's a forward */
+    if (proc >= (const char *)exports && proc < (const char *)exports + exp_size) return NULL;
+    return (void *)proc;
+}
+
+
+/***********************************************************************
+ *           Import cache
+ *
+ * The resolved import address tables of native modules are saved in the
+ * prefix, as the target module and export RVA of each entry, so that the
+ * imports can be bound without export lookups the next time the module is
+ * loaded. Like bound imports, the data is only used if the identity of the
+ * importing and target modules is unchanged.
+ */
+
+#define IMPORT_CACHE_MAGIC  (0x57494300 | sizeof(void *))  /* "WIC" + pointer size */
+#define IMPORT_CACHE_NONE   (~0u)
+
+struct import_cache_module
+{
+    ULONGLONG dev;
+    ULONGLONG ino;
+    ULONGLONG mtime;
+    DWORD     timestamp;         /* FileHeader.TimeDateStamp */
+    DWORD     image_size;        /* OptionalHeader.SizeOfImage */
+    WCHAR     name[32];          /* base name, to find the target of forwarded exports */
+};
+
+struct import_cache_header
+{
+    DWORD                      magic;
+    DWORD                      module_count;
+    DWORD                      thunk_count;
+    DWORD                      reserved;
+    struct import_cache_module self;   /* identity of the importing module */
+};
+
+struct import_cache_thunk
+{
+    DWORD module;                /* index of the target module, IMPORT_CACHE_NONE if not cached */
+    DWORD rva;                   /* RVA of the export in the target module */
+};
+
+struct import_cache
+{
+    struct import_cache_header *data;      /* cached data read from the prefix, NULL if none */
+    struct import_cache_module *modules;   /* cached modules */
+    struct import_cache_thunk  *thunks;    /* cached thunks */
+    WINE_MODREF               **targets;   /* loaded modules matching the cached ones */
+    unsigned int                pos;       /* position of the next thunk */
+    BOOL                        dirty;     /* whether the cached data needs to be written */
+    struct import_cache_header  header;    /* new data */
+    struct import_cache_module *new_modules;
+    struct import_cache_thunk  *new_thunks;
+    unsigned int                modules_size;
+    unsigned int                thunks_size;
+    const WINE_MODREF          *last_module;  /* target of the last recorded thunk */
+    DWORD                       last_index;   /* index of the last target in the new data */
+};
+
+static int use_import_cache = -1;
+
+/* get the identity of a module, return FALSE if it can't be cached */
+static BOOL get_import_cache_module( const WINE_MODREF *wm, struct import_cache_module *module )
+{
+    const IMAGE_NT_HEADERS *nt = RtlImageNtHeader( wm->ldr.BaseAddress );
+
+    if (!wm->dev && !wm->ino) return FALSE;  /* not loaded from a PE file */
+    if (wm->ldr.BaseDllName.Length >= sizeof(module->name)) return FALSE;
+    memset( module, 0, sizeof(*module) );
+    module->dev        = wm->dev;
+    module->ino        = wm->ino;
+    module->mtime      = wm->mtime;
+    module->timestamp  = nt->FileHeader.TimeDateStamp;
+    module->image_size = nt->OptionalHeader.SizeOfImage;
+    memcpy( module->name, wm->ldr.BaseDllName.Buffer, wm->ldr.BaseDllName.Length );
+    return TRUE;
+}
+
+/* build the Unix file name of the cache for a module */
+static char *get_import_cache_name( const WINE_MODREF *wm )
+{
+    const char *config_dir = wine_get_config_dir();
+    char *name;
+
+    if (!(name = RtlAllocateHeap( GetProcessHeap(), 0, strlen(config_dir) + sizeof("/importcache/") + 34 )))
+        return NULL;
+    sprintf( name, "%s/importcache/%s-%s", config_dir,
+             wine_dbgstr_longlong( wm->dev ), wine_dbgstr_longlong( wm->ino ));
+    return name;
+}
+
+/***********************************************************************
+ *           open_import_cache
+ *
+ * Initialize the import cache for a module, reading its cached data if any.
+ */
+static BOOL open_import_cache( WINE_MODREF *wm, struct import_cache *cache )
+{
+    struct import_cache_header *data = NULL;
+    struct stat st;
+    char *name;
+    size_t size;
+    int fd;
+
+    if (use_import_cache == -1)
+    {
+        const char *env = getenv( "WINEIMPORTCACHE" );
+        use_import_cache = env && atoi( env ) && !TRACE_ON(relay) && !TRACE_ON(snoop);
+    }
+    if (!use_import_cache) return FALSE;
+
+    memset( cache, 0, sizeof(*cache) );
+    if (!get_import_cache_module( wm, &cache->header.self )) return FALSE;
+    cache->header.magic = IMPORT_CACHE_MAGIC;
+    cache->dirty = TRUE;
+
+    if (!(name = get_import_cache_name( wm ))) return TRUE;
+    fd = open( name, O_RDONLY );
+    RtlFreeHeap( GetProcessHeap(), 0, name );
+    if (fd == -1) return TRUE;
+
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*data)) goto done;
+    size = st.st_size;
+    if (!(data = RtlAllocateHeap( GetProcessHeap(), 0, size ))) goto done;
+    if (pread( fd, data, size, 0 ) != size) goto done;
+
+    if (data->magic != IMPORT_CACHE_MAGIC) goto done;
+    if (memcmp( &data->self, &cache->header.self, sizeof(data->self) )) goto done;
+    if (size != sizeof(*data) + data->module_count * sizeof(*cache->modules) +
+                data->thunk_count * sizeof(*cache->thunks)) goto done;
+    if (!(cache->targets = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                            data->module_count * sizeof(*cache->targets) + 1 )))
+        goto done;
+
+    cache->data    = data;
+    cache->modules = (struct import_cache_module *)(data + 1);
+    cache->thunks  = (struct import_cache_thunk *)(cache->modules + data->module_count);
+    cache->dirty   = FALSE;
+    data = NULL;
+    TRACE( "using import cache for %s\n", debugstr_w(wm->ldr.FullDllName.Buffer) );
+
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, data );
+    close( fd );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           close_import_cache
+ *
+ * Write the new data of an import cache if needed, and free it.
+ */
+static void close_import_cache( WINE_MODREF *wm, struct import_cache *cache, BOOL save )
+{
+    struct import_cache_header *data = &cache->header;
+    char *name, *tmp_name = NULL, *p;
+    int fd;
+
+    if (cache->data && cache->pos != cache->data->thunk_count) cache->dirty = TRUE;
+    if (!save || !cache->dirty || !(name = get_import_cache_name( wm ))) goto done;
+
+    if ((tmp_name = RtlAllocateHeap( GetProcessHeap(), 0, strlen(name) + 10 )))
+    {
+        p = strrchr( name, '/' );
+        *p = 0;
+        mkdir( name, 0777 );
+        *p = '/';
+        sprintf( tmp_name, "%s.%x", name, getpid() );
+        if ((fd = open( tmp_name, O_WRONLY | O_CREAT | O_EXCL, 0666 )) != -1)
+        {
+            BOOL ok = (write( fd, data, sizeof(*data) ) == sizeof(*data) &&
+                       write( fd, cache->new_modules, data->module_count * sizeof(*cache->new_modules) ) ==
+                       data->module_count * sizeof(*cache->new_modules) &&
+                       write( fd, cache->new_thunks, data->thunk_count * sizeof(*cache->new_thunks) ) ==
+                       data->thunk_count * sizeof(*cache->new_thunks));
+            close( fd );
+            if (!ok || rename( tmp_name, name ) == -1) unlink( tmp_name );
+            else TRACE( "saved import cache for %s\n", debugstr_w(wm->ldr.FullDllName.Buffer) );
+        }
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, tmp_name );
+    RtlFreeHeap( GetProcessHeap(), 0, name );
+
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, cache->data );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->targets );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->new_modules );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->new_thunks );
+}
+
+/* find or add the index of a target module in the new data */
+static DWORD add_import_cache_module( struct import_cache *cache, const WINE_MODREF *wm )
+{
+    struct import_cache_module module;
+    unsigned int i;
+
+    if (!get_import_cache_module( wm, &module )) return IMPORT_CACHE_NONE;
+    for (i = 0; i < cache->header.module_count; i++)
+        if (!memcmp( &cache->new_modules[i], &module, sizeof(module) )) return i;
+
+    if (i == cache->modules_size)
+    {
+        unsigned int new_size = max( 16, cache->modules_size * 2 );
+        struct import_cache_module *new_modules;
+
+        if (cache->new_modules)
+            new_modules = RtlReAllocateHeap( GetProcessHeap(), 0, cache->new_modules,
+                                             new_size * sizeof(*new_modules) );
+        else
+            new_modules = RtlAllocateHeap( GetProcessHeap(), 0, new_size * sizeof(*new_modules) );
+        if (!new_modules) return IMPORT_CACHE_NONE;
+        cache->new_modules = new_modules;
+        cache->modules_size = new_size;
+    }
+    cache->new_modules[i] = module;
+    cache->header.module_count++;
+    return i;
+}
+
+/* record the resolved address of the next thunk in the new data */
+static void add_import_cache_thunk( struct import_cache *cache, const WINE_MODREF *imp, ULONG_PTR proc )
+{
+    struct import_cache_thunk *thunk;
+    LDR_MODULE *mod;
+
+    if (!cache) return;
+
+    if (cache->header.thunk_count == cache->thunks_size)
+    {
+        unsigned int new_size = max( 256, cache->thunks_size * 2 );
+        struct import_cache_thunk *new_thunks;
+
+        if (cache->new_thunks)
+            new_thunks = RtlReAllocateHeap( GetProcessHeap(), 0, cache->new_thunks,
+                                            new_size * sizeof(*new_thunks) );
+        else
+            new_thunks = RtlAllocateHeap( GetProcessHeap(), 0, new_size * sizeof(*new_thunks) );
+        if (!new_thunks)
+        {
+            cache->dirty = FALSE;  /* give up on saving it */
+            return;
+        }
+        cache->new_thunks = new_thunks;
+        cache->thunks_size = new_size;
+    }
+    thunk = &cache->new_thunks[cache->header.thunk_count++];
+    thunk->module = IMPORT_CACHE_NONE;
+    thunk->rva = 0;
+
+    /* forwarded exports resolve to another module */
+    if ((char *)proc < (char *)imp->ldr.BaseAddress ||
+        (char *)proc >= (char *)imp->ldr.BaseAddress + imp->ldr.SizeOfImage)
+    {
+        if (LdrFindEntryForAddress( (void *)proc, &mod )) return;
+        imp = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
+    }
+    if (imp != cache->last_module)
+    {
+        cache->last_index = add_import_cache_module( cache, imp );
+        cache->last_module = imp;
+    }
+    if ((thunk->module = cache->last_index) != IMPORT_CACHE_NONE)
+        thunk->rva = proc - (ULONG_PTR)imp->ldr.BaseAddress;
+}
+
+/***********************************************************************
+ *           get_import_cache_thunk
+ *
+ * Get the cached address of the next thunk, or 0 if it needs to be resolved.
+ */
+static ULONG_PTR get_import_cache_thunk( struct import_cache *cache, WINE_MODREF *imp )
+{
+    const struct import_cache_thunk *thunk;
+    const struct import_cache_module *module;
+    struct import_cache_module id;
+    WINE_MODREF *wm;
+
+    if (!cache || !cache->data) return 0;
+    if (cache->pos >= cache->data->thunk_count)
+    {
+        cache->dirty = TRUE;
+        return 0;
+    }
+    thunk = &cache->thunks[cache->pos++];
+    if (thunk->module >= cache->data->module_count) return 0;
+    module = &cache->modules[thunk->module];
+
+    if (!(wm = cache->targets[thunk->module]))
+    {
+        /* the target is either the imported module, or an already loaded module for forwards */
+        if (!((imp->dev == module->dev && imp->ino == module->ino && (wm = imp)) ||
+              (wm = find_basename_module( module->name ))))
+            return 0;
+        if (!get_import_cache_module( wm, &id ) || memcmp( &id, module, sizeof(id) ))
+        {
+            TRACE( "%s changed\n", debugstr_w(module->name) );
+            cache->dirty = TRUE;
+            return 0;
+        }
+        cache->targets[thunk->module] = wm;
+    }
+    if (thunk->rva >= wm->ldr.SizeOfImage) return 0;
+    return (ULONG_PTR)wm->ldr.BaseAddress + thunk->rva;
 }
 
 
@@ -724,7 +1232,8 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
  * Import the dll specified by the given import descriptor.
  * The loader_section must be locked while calling this function.
  */
-static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LPCWSTR load_path, WINE_MODREF **pwm )
+static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LPCWSTR load_path,
+                        WINE_MODREF **pwm, struct import_cache *cache )
 {
     NTSTATUS status;
     WINE_MODREF *wmImp;
@@ -813,6 +1322,8 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
             WARN(" imported from %s, allocating stub %p\n",
                  debugstr_w(current_modref->ldr.FullDllName.Buffer),
                  (void *)thunk_list->u1.Function );
+            get_import_cache_thunk( cache, wmImp );
+            add_import_cache_thunk( cache, wmImp, 0 );
             import_list++;
             thunk_list++;
         }
@@ -821,7 +1332,12 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
 
     while (import_list->u1.Ordinal)
     {
-        if (IMAGE_SNAP_BY_ORDINAL(import_list->u1.Ordinal))
+        if ((thunk_list->u1.Function = get_import_cache_thunk( cache, wmImp )))
+        {
+            TRACE_(imports)("--- cached %s.%p = %p\n", name, (void *)import_list->u1.Ordinal,
+                            (void *)thunk_list->u1.Function );
+        }
+        else if (IMAGE_SNAP_BY_ORDINAL(import_list->u1.Ordinal))
         {
             int ordinal = IMAGE_ORDINAL(import_list->u1.Ordinal);
 
@@ -853,6 +1369,7 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
             TRACE_(imports)("--- %s %s.%d = %p\n",
                             pe_name->Name, name, pe_name->Hint, (void *)thunk_list->u1.Function);
         }
+        add_import_cache_thunk( cache, wmImp, thunk_list->u1.Function );
         import_list++;
         thunk_list++;
     }
@@ -1088,6 +1605,8 @@ static NTSTATUS fixup_imports( WINE_MODREF *wm, LPCWSTR load_path )
     int i, dep, nb_imports;
     const IMAGE_IMPORT_DESCRIPTOR *imports;
     WINE_MODREF *prev, *imp;
+    struct import_cache cache;
+    BOOL use_cache;
     DWORD size;
     NTSTATUS status;
     ULONG_PTR cookie;
@@ -1119,17 +1638,19 @@ static NTSTATUS fixup_imports( WINE_MODREF *wm, LPCWSTR load_path )
     prev = current_modref;
     current_modref = wm;
     status = STATUS_SUCCESS;
+    use_cache = open_import_cache( wm, &cache );
     for (i = 0; i < nb_imports; i++)
     {
         dep = wm->nDeps++;
 
-        if (!import_dll( wm->ldr.BaseAddress, &imports[i], load_path, &imp ))
+        if (!import_dll( wm->ldr.BaseAddress, &imports[i], load_path, &imp, use_cache ? &cache : NULL ))
         {
             imp = NULL;
             status = STATUS_DLL_NOT_FOUND;
         }
         wm->deps[dep] = imp;
     }
+    if (use_cache) close_import_cache( wm, &cache, !status );
     current_modref = prev;
     if (wm->ldr.ActivationContext) RtlDeactivateActivationContext( 0, cookie );
     return status;
@@ -1173,6 +1694,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name
                    &wm->ldr.InLoadOrderModuleList);
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList,
                    &wm->ldr.InMemoryOrderModuleList);
+    add_module_index( wm, FALSE );
     /* wait until init is called for inserting into InInitializationOrderModuleList */
 
     if (!(nt->OptionalHeader.DllCharacteristics & IMAGE_DLLCHARACTERISTICS_NX_COMPAT))
@@ -1394,6 +1916,7 @@ static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved )
         if (status == STATUS_SUCCESS)
         {
             wm->ldr.Flags |= LDR_PROCESS_ATTACHED;
+            publish_module( wm, TRUE );
         }
         else
         {
@@ -1470,6 +1993,7 @@ static void process_detach(void)
 
             /* Call detach notification */
             mod->Flags &= ~LDR_PROCESS_ATTACHED;
+            publish_module( CONTAINING_RECORD(mod, WINE_MODREF, ldr), FALSE );
             MODULE_InitDLL( CONTAINING_RECORD(mod, WINE_MODREF, ldr), 
                             DLL_PROCESS_DETACH, ULongToPtr(process_detaching) );
             call_ldr_notifications( LDR_DLL_NOTIFICATION_REASON_UNLOADED, mod );
@@ -1687,6 +2211,16 @@ NTSTATUS WINAPI LdrGetProcedureAddress(HMODULE module, const ANSI_STRING *name,
     IMAGE_EXPORT_DIRECTORY *exports;
     DWORD exp_size;
     NTSTATUS ret = STATUS_PROCEDURE_NOT_FOUND;
+    void *proc;
+
+    RtlAcquireSRWLockShared( &module_index_lock );
+    proc = find_export_nolock( module, name, ord );
+    RtlReleaseSRWLockShared( &module_index_lock );
+    if (proc)
+    {
+        *address = proc;
+        return STATUS_SUCCESS;
+    }
 
     RtlEnterCriticalSection( &loader_section );
 
@@ -1696,8 +2230,8 @@ NTSTATUS WINAPI LdrGetProcedureAddress(HMODULE module, const ANSI_STRING *name,
                                                       IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size )))
     {
         LPCWSTR load_path = NtCurrentTeb()->Peb->ProcessParameters->DllPath.Buffer;
-        void *proc = name ? find_named_export( module, exports, exp_size, name->Buffer, -1, load_path )
-                          : find_ordinal_export( module, exports, exp_size, ord - exports->Base, load_path );
+        proc = name ? find_named_export( module, exports, exp_size, name->Buffer, -1, load_path )
+                    : find_ordinal_export( module, exports, exp_size, ord - exports->Base, load_path );
         if (proc)
         {
             *address = proc;
@@ -1828,6 +2362,7 @@ static void load_builtin_callback( void *module, const char *filename )
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_module_index( wm );
             /* FIXME: free the modref */
             builtin_load_info->status = STATUS_DLL_NOT_FOUND;
             return;
@@ -2175,6 +2710,8 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, const UNICODE_STRING *nt_nam
 
     wm->dev = st->st_dev;
     wm->ino = st->st_ino;
+    wm->mtime = st->st_mtime;
+    add_module_index( wm, FALSE );
     if (image_info->loader_flags) wm->ldr.Flags |= LDR_COR_IMAGE;
     if (image_info->image_flags & IMAGE_FLAGS_ComPlusILOnly) wm->ldr.Flags |= LDR_COR_ILONLY;
 
@@ -2195,6 +2732,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, const UNICODE_STRING *nt_nam
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_module_index( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -2911,6 +3449,43 @@ NTSTATUS WINAPI DECLSPEC_HOTPATCH LdrLoadDll(LPCWSTR path_name, DWORD flags,
 }
 
 
+/******************************************************************
+ *		find_loaded_dll_nolock
+ *
+ * Find an already loaded dll from its base name without the loader_section.
+ * Names containing a path or redirected by the activation context need the
+ * full search of find_dll_file, so NULL is returned for them.
+ */
+static HMODULE find_loaded_dll_nolock( LPCWSTR libname )
+{
+    ACTCTX_SECTION_KEYED_DATA data;
+    UNICODE_STRING nameW;
+    WCHAR buffer[MAX_PATH];
+    WINE_MODREF *wm;
+    HMODULE ret = NULL;
+
+    if (contains_path( libname )) return NULL;
+    if (!strrchrW( libname, '.' ))
+    {
+        if (strlenW( libname ) + ARRAY_SIZE(dllW) > ARRAY_SIZE(buffer)) return NULL;
+        strcpyW( buffer, libname );
+        strcatW( buffer, dllW );
+        libname = buffer;
+    }
+
+    RtlInitUnicodeString( &nameW, libname );
+    data.cbSize = sizeof(data);
+    if (RtlFindActivationContextSectionString( 0, NULL, ACTIVATION_CONTEXT_SECTION_DLL_REDIRECTION,
+                                               &nameW, &data ) != STATUS_SXS_KEY_NOT_FOUND)
+        return NULL;
+
+    RtlAcquireSRWLockShared( &module_index_lock );
+    if ((wm = find_basename_index( libname )) && wm->published) ret = wm->ldr.BaseAddress;
+    RtlReleaseSRWLockShared( &module_index_lock );
+    return ret;
+}
+
+
 /******************************************************************
  *		LdrGetDllHandle (NTDLL.@)
  */
@@ -2922,6 +3497,14 @@ NTSTATUS WINAPI LdrGetDllHandle( LPCWSTR load_path, ULONG flags, const UNICODE_S
     void *module;
     pe_image_info_t image_info;
     struct stat st;
+    HMODULE ret;
+
+    if ((ret = find_loaded_dll_nolock( name->Buffer )))
+    {
+        *base = ret;
+        TRACE( "%s -> %p\n", debugstr_us(name), ret );
+        return STATUS_SUCCESS;
+    }
 
     RtlEnterCriticalSection( &loader_section );
 
@@ -3310,6 +3893,7 @@ void WINAPI RtlExitUserProcess( DWORD status )
     RtlAcquirePebLock();
     NtTerminateProcess( 0, status );
     LdrShutdownProcess();
+    server_trace_call_stats();
     NtTerminateProcess( GetCurrentProcess(), status );
     exit( get_unix_exit_code( status ));
 }
@@ -3371,6 +3955,7 @@ static void free_modref( WINE_MODREF *wm )
     RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
     if (wm->ldr.InInitializationOrderModuleList.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderModuleList);
+    remove_module_index( wm );
 
     TRACE(" unloading %s\n", debugstr_w(wm->ldr.FullDllName.Buffer));
     if (!TRACE_ON(module))
@@ -3450,6 +4035,7 @@ static void MODULE_DecRefCount( WINE_MODREF *wm )
 
     if ( wm->ldr.LoadCount == 0 )
     {
+        publish_module( wm, FALSE );
         wm->ldr.Flags |= LDR_UNLOAD_IN_PROGRESS;
 
         for ( i = 0; i < wm->nDeps; i++ )
@@ -3852,6 +4438,8 @@ void __wine_process_init(void)
     InsertHeadList( &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList, &wm->ldr.InLoadOrderModuleList );
     RemoveEntryList( &wm->ldr.InMemoryOrderModuleList );
     InsertHeadList( &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList, &wm->ldr.InMemoryOrderModuleList );
+    remove_module_index( wm );
+    add_module_index( wm, TRUE );
 
     if ((status = virtual_alloc_thread_stack( &stack, 0, 0, NULL )) != STATUS_SUCCESS)
     {
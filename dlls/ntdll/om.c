@@ -368,7 +368,12 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
             {
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
+                server_remove_inproc_sync_from_cache( source );
             }
+            else if (reply->self && dest_process == NtCurrentProcess() &&
+                     (options & DUPLICATE_SAME_ACCESS) && reply->handle &&
+                     wine_server_ptr_handle( reply->handle ) != source)
+                server_dup_fd_to_cache( source, wine_server_ptr_handle( reply->handle ));
         }
     }
     SERVER_END_REQ;
@@ -387,6 +392,7 @@ NTSTATUS close_handle( HANDLE handle )
     NTSTATUS ret;
     int fd = server_remove_fd_from_cache( handle );
 
+    server_remove_inproc_sync_from_cache( handle );
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -416,6 +422,38 @@ NTSTATUS close_handle( HANDLE handle )
     return ret;
 }
 
+/* close several handles in as few server round-trips as possible; null handles are ignored */
+NTSTATUS close_handles( const HANDLE *handles, unsigned int count )
+{
+    struct __server_request_info reqs[16];
+    int fds[ARRAY_SIZE(reqs)];
+    NTSTATUS ret = STATUS_SUCCESS;
+    unsigned int i, nb;
+
+    while (count)
+    {
+        for (nb = 0; count && nb < ARRAY_SIZE(reqs); handles++, count--)
+        {
+            struct close_handle_request *req;
+
+            if (!*handles) continue;
+            fds[nb] = server_remove_fd_from_cache( *handles );
+            server_remove_inproc_sync_from_cache( *handles );
+            req = server_init_request( &reqs[nb++], REQ_close_handle );
+            req->handle = wine_server_obj_handle( *handles );
+        }
+        if (!nb) break;
+
+        server_call_batch( reqs, nb );
+        for (i = 0; i < nb; i++)
+        {
+            if (fds[i] != -1) close( fds[i] );
+            if (!ret) ret = reqs[i].u.reply.reply_header.error;
+        }
+    }
+    return ret;
+}
+
 /**************************************************************************
  *                 NtClose				[NTDLL.@]
  *
@@ -1219,6 +1219,7 @@ NTSTATUS WINAPI RtlCreateUserProcess( UNICODE_STRING *path, ULONG attributes,
     NTSTATUS status;
     BOOL success = FALSE;
     HANDLE file_handle, process_info = 0, process_handle = 0, thread_handle = 0;
+    HANDLE handles[4];
     ULONG process_id, thread_id;
     struct object_attributes *objattr;
     data_size_t attr_len;
@@ -1355,10 +1356,11 @@ NTSTATUS WINAPI RtlCreateUserProcess( UNICODE_STRING *path, ULONG attributes,
     else status = err ? err : ERROR_INTERNAL_ERROR;
 
 done:
-    NtClose( file_handle );
-    if (process_info) NtClose( process_info );
-    if (process_handle) NtClose( process_handle );
-    if (thread_handle) NtClose( thread_handle );
+    handles[0] = file_handle;
+    handles[1] = process_info;
+    handles[2] = process_handle;
+    handles[3] = thread_handle;
+    close_handles( handles, ARRAY_SIZE(handles) );
     if (socketfd[0] != -1) close( socketfd[0] );
     RtlFreeHeap( GetProcessHeap(), 0, startup_info );
     RtlFreeHeap( GetProcessHeap(), 0, winedebug );
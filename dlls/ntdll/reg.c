@@ -773,18 +773,78 @@ NTSTATUS WINAPI NtNotifyChangeKey(
  * ZwQueryMultipleValueKey
  */
 
-NTSTATUS WINAPI NtQueryMultipleValueKey(
-	HANDLE KeyHandle,
-	PKEY_MULTIPLE_VALUE_INFORMATION ListOfValuesToQuery,
-	ULONG NumberOfItems,
-	PVOID MultipleValueInformation,
-	ULONG Length,
-	PULONG  ReturnLength)
+NTSTATUS WINAPI NtQueryMultipleValueKey( HANDLE handle, KEY_MULTIPLE_VALUE_INFORMATION *values, ULONG count,
+                                         void *buffer, ULONG length, ULONG *result_len )
 {
-	FIXME("(%p,%p,0x%08x,%p,0x%08x,%p) stub!\n",
-	KeyHandle, ListOfValuesToQuery, NumberOfItems, MultipleValueInformation,
-	Length,ReturnLength);
-	return STATUS_SUCCESS;
+    struct __server_request_info *reqs;
+    struct get_key_value_request *req;
+    const struct get_key_value_reply *reply;
+    NTSTATUS ret = STATUS_SUCCESS;
+    ULONG i, pos, size;
+
+    TRACE( "(%p,%p,%u,%p,%u,%p)\n", handle, values, count, buffer, length, result_len );
+
+    for (i = 0; i < count; i++)
+        if (values[i].ValueName->Length > MAX_VALUE_LENGTH) return STATUS_OBJECT_NAME_NOT_FOUND;
+
+    if (!count)
+    {
+        if (result_len) *result_len = 0;
+        return STATUS_SUCCESS;
+    }
+    if (!(reqs = RtlAllocateHeap( GetProcessHeap(), 0, count * sizeof(*reqs) ))) return STATUS_NO_MEMORY;
+
+    for (;;)
+    {
+        /* first retrieve the types and sizes of all the values in a single batch */
+        for (i = 0; i < count; i++)
+        {
+            req = server_init_request( &reqs[i], REQ_get_key_value );
+            req->hkey = wine_server_obj_handle( handle );
+            wine_server_add_data( req, values[i].ValueName->Buffer, values[i].ValueName->Length );
+        }
+        if ((ret = server_call_batch( reqs, count ))) break;
+
+        for (i = pos = size = 0; i < count; i++)
+        {
+            reply = &reqs[i].u.reply.get_key_value_reply;
+            if ((ret = reply->__header.error)) goto done;
+            values[i].Type       = reply->type;
+            values[i].DataLength = reply->total;
+            values[i].DataOffset = pos;
+            size = pos + reply->total;
+            pos = (size + sizeof(ULONG) - 1) & ~(sizeof(ULONG) - 1);
+        }
+        if (result_len) *result_len = size;
+        if (length < size)
+        {
+            ret = STATUS_BUFFER_OVERFLOW;
+            break;
+        }
+
+        /* then fetch the data directly into the buffer */
+        for (i = 0; i < count; i++)
+        {
+            req = server_init_request( &reqs[i], REQ_get_key_value );
+            req->hkey = wine_server_obj_handle( handle );
+            wine_server_add_data( req, values[i].ValueName->Buffer, values[i].ValueName->Length );
+            wine_server_set_reply( req, (char *)buffer + values[i].DataOffset, values[i].DataLength );
+        }
+        if ((ret = server_call_batch( reqs, count ))) break;
+
+        for (i = 0; i < count; i++)
+        {
+            reply = &reqs[i].u.reply.get_key_value_reply;
+            if ((ret = reply->__header.error)) goto done;
+            if (reply->type != values[i].Type || reply->total != values[i].DataLength) break;
+        }
+        if (i == count) break;
+        /* a value has been modified in the meantime, start over */
+    }
+
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, reqs );
+    return ret;
 }
 
 /******************************************************************************
@@ -1133,6 +1193,76 @@ static NTSTATUS RTL_ReportRegistryValue(PKEY_VALUE_FULL_INFORMATION pInfo,
 }
 
 
+/* report all the values of a key, retrieving them from the server in batches */
+static NTSTATUS RTL_ReportAllValues(HANDLE handle, PRTL_QUERY_REGISTRY_TABLE QueryTable,
+                                    PVOID Context, PVOID Environment, ULONG *count)
+{
+    static const ULONG fixed_size = FIELD_OFFSET(KEY_VALUE_FULL_INFORMATION, Name);
+    struct __server_request_info reqs[16];
+    struct enum_key_value_request *req;
+    const struct enum_key_value_reply *reply;
+    KEY_VALUE_FULL_INFORMATION *info;
+    KEY_CACHED_INFORMATION key_info;
+    ULONG i, nb, len, entry_size = 0;
+    char *buffer = NULL;
+    NTSTATUS status;
+
+    *count = 0;
+    for (;;)
+    {
+        if (!buffer)
+        {
+            /* size the entries from the largest value of the key */
+            status = NtQueryKey(handle, KeyCachedInformation, &key_info, sizeof(key_info), &len);
+            if (status != STATUS_SUCCESS) return status;
+            if (key_info.Values <= *count) return STATUS_SUCCESS;
+            entry_size = (fixed_size + key_info.MaxValueNameLen + key_info.MaxValueDataLen + 7) & ~7;
+            if (!(buffer = RtlAllocateHeap(GetProcessHeap(), 0, ARRAY_SIZE(reqs) * entry_size)))
+                return STATUS_NO_MEMORY;
+        }
+
+        /* ask for one more value than expected so that the end of the list is
+         * detected in the same round-trip */
+        nb = min(key_info.Values - min(*count, key_info.Values) + 1, ARRAY_SIZE(reqs));
+        for (i = 0; i < nb; i++)
+        {
+            info = (KEY_VALUE_FULL_INFORMATION *)(buffer + i * entry_size);
+            req = server_init_request(&reqs[i], REQ_enum_key_value);
+            req->hkey       = wine_server_obj_handle(handle);
+            req->index      = *count + i;
+            req->info_class = KeyValueFullInformation;
+            wine_server_set_reply(req, info->Name, entry_size - fixed_size);
+        }
+        if ((status = server_call_batch(reqs, nb)) != STATUS_SUCCESS) break;
+
+        for (i = 0; i < nb; i++)
+        {
+            reply = &reqs[i].u.reply.enum_key_value_reply;
+            info = (KEY_VALUE_FULL_INFORMATION *)(buffer + i * entry_size);
+            if ((status = reply->__header.error) != STATUS_SUCCESS) break;
+            if (reply->total > wine_server_reply_size(reply)) break;  /* value grew in the meantime */
+
+            copy_key_value_info(KeyValueFullInformation, info, entry_size, reply->type, reply->namelen,
+                                wine_server_reply_size(reply) - reply->namelen);
+            status = RTL_ReportRegistryValue(info, QueryTable, Context, Environment);
+            if (status != STATUS_SUCCESS && status != STATUS_BUFFER_TOO_SMALL) break;
+            status = STATUS_SUCCESS;
+            (*count)++;
+        }
+        if (status == STATUS_NO_MORE_ENTRIES) status = STATUS_SUCCESS;
+        if (status != STATUS_SUCCESS || (i < nb && reply->__header.error)) break;
+        if (i < nb)
+        {
+            /* resize the entries and retry from the value that didn't fit */
+            RtlFreeHeap(GetProcessHeap(), 0, buffer);
+            buffer = NULL;
+        }
+    }
+    RtlFreeHeap(GetProcessHeap(), 0, buffer);
+    return status;
+}
+
+
 static NTSTATUS RTL_KeyHandleCreateObject(ULONG RelativeTo, PCWSTR Path, POBJECT_ATTRIBUTES regkey, PUNICODE_STRING str)
 {
     PCWSTR base;
@@ -1235,7 +1365,7 @@ NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
                                        IN PVOID Environment OPTIONAL)
 {
     UNICODE_STRING Value;
-    HANDLE handle, topkey;
+    HANDLE handle, topkey, handles[2];
     PKEY_VALUE_FULL_INFORMATION pInfo = NULL;
     ULONG len, buflen = 0;
     NTSTATUS status=STATUS_SUCCESS, ret = STATUS_SUCCESS;
@@ -1307,32 +1437,47 @@ NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
             }
 
             /* Report all subkeys */
-            for (i = 0;; ++i)
+            if (!(QueryTable->Flags & RTL_QUERY_REGISTRY_DELETE))
             {
-                status = NtEnumerateValueKey(handle, i,
-                    KeyValueFullInformation, pInfo, buflen, &len);
-                if (status == STATUS_NO_MORE_ENTRIES)
-                    break;
-                if (status == STATUS_BUFFER_OVERFLOW ||
-                    status == STATUS_BUFFER_TOO_SMALL)
-                {
-                    buflen = len;
-                    RtlFreeHeap(GetProcessHeap(), 0, pInfo);
-                    pInfo = RtlAllocateHeap(GetProcessHeap(), 0, buflen);
-                    NtEnumerateValueKey(handle, i, KeyValueFullInformation,
-                        pInfo, buflen, &len);
-                }
+                ULONG count;
 
-                status = RTL_ReportRegistryValue(pInfo, QueryTable, Context, Environment);
-                if(status != STATUS_SUCCESS && status != STATUS_BUFFER_TOO_SMALL)
+                status = RTL_ReportAllValues(handle, QueryTable, Context, Environment, &count);
+                if (status != STATUS_SUCCESS)
                 {
                     ret = status;
                     goto out;
                 }
-                if (QueryTable->Flags & RTL_QUERY_REGISTRY_DELETE)
+                i = count;
+            }
+            else
+            {
+                for (i = 0;; ++i)
                 {
-                    RtlInitUnicodeString(&Value, pInfo->Name);
-                    NtDeleteValueKey(handle, &Value);
+                    status = NtEnumerateValueKey(handle, i,
+                        KeyValueFullInformation, pInfo, buflen, &len);
+                    if (status == STATUS_NO_MORE_ENTRIES)
+                        break;
+                    if (status == STATUS_BUFFER_OVERFLOW ||
+                        status == STATUS_BUFFER_TOO_SMALL)
+                    {
+                        buflen = len;
+                        RtlFreeHeap(GetProcessHeap(), 0, pInfo);
+                        pInfo = RtlAllocateHeap(GetProcessHeap(), 0, buflen);
+                        NtEnumerateValueKey(handle, i, KeyValueFullInformation,
+                            pInfo, buflen, &len);
+                    }
+
+                    status = RTL_ReportRegistryValue(pInfo, QueryTable, Context, Environment);
+                    if(status != STATUS_SUCCESS && status != STATUS_BUFFER_TOO_SMALL)
+                    {
+                        ret = status;
+                        goto out;
+                    }
+                    if (QueryTable->Flags & RTL_QUERY_REGISTRY_DELETE)
+                    {
+                        RtlInitUnicodeString(&Value, pInfo->Name);
+                        NtDeleteValueKey(handle, &Value);
+                    }
                 }
             }
 
@@ -1386,9 +1531,9 @@ NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
 
 out:
     RtlFreeHeap(GetProcessHeap(), 0, pInfo);
-    if (handle != topkey)
-        NtClose(handle);
-    NtClose(topkey);
+    handles[0] = topkey;
+    handles[1] = (handle != topkey) ? handle : 0;
+    close_handles(handles, 2);
     return ret;
 }
 
@@ -83,6 +83,7 @@
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(server);
+WINE_DECLARE_DEBUG_CHANNEL(serverstats);
 
 /* Some versions of glibc don't define this */
 #ifndef SCM_RIGHTS
@@ -119,6 +120,11 @@ sigset_t server_block_set;  /* signals to block during server calls */
 static int fd_socket = -1;  /* socket to exchange file descriptors with the server */
 static pid_t server_pid;
 
+/* server call statistics, reported with +serverstats */
+static int server_requests;         /* number of requests sent to the server */
+static int server_round_trips;      /* number of round-trips to the server */
+static LONGLONG server_call_time;   /* time spent waiting for the server, in 100ns units */
+
 static RTL_CRITICAL_SECTION fd_cache_section;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
 {
@@ -140,6 +146,16 @@ static inline LONG64 interlocked_xchg64( LONG64 *dest, LONG64 val )
 #endif
 }
 
+/* atomically read a 64-bit value, without taking ownership of the cache line */
+static inline LONG64 interlocked_read64( LONG64 *src )
+{
+#ifdef _WIN64
+    return *(volatile LONG64 *)src;
+#else
+    return interlocked_cmpxchg64( src, 0, 0 );
+#endif
+}
+
 #ifdef __GNUC__
 static void fatal_error( const char *err, ... ) __attribute__((noreturn, format(printf,1,2)));
 static void fatal_perror( const char *err, ... ) __attribute__((noreturn, format(printf,1,2)));
@@ -283,10 +299,25 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 unsigned int server_call_unlocked( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    LARGE_INTEGER start, end;
+    LONGLONG time;
     unsigned int ret;
 
-    if ((ret = send_request( req ))) return ret;
-    return wait_reply( req );
+    if (!TRACE_ON(serverstats))
+    {
+        if ((ret = send_request( req ))) return ret;
+        return wait_reply( req );
+    }
+
+    NtQueryPerformanceCounter( &start, NULL );
+    if (!(ret = send_request( req ))) ret = wait_reply( req );
+    NtQueryPerformanceCounter( &end, NULL );
+
+    interlocked_xchg_add( &server_requests, 1 );
+    interlocked_xchg_add( &server_round_trips, 1 );
+    do time = server_call_time;
+    while (interlocked_cmpxchg64( &server_call_time, time + end.QuadPart - start.QuadPart, time ) != time);
+    return ret;
 }
 
 
@@ -324,6 +355,106 @@ unsigned int CDECL wine_server_call( void *req_ptr )
 }
 
 
+/***********************************************************************
+ *           server_call_batch
+ *
+ * Perform several independent server calls in a single round-trip.
+ * Each request receives its own reply and status, as if it had been sent
+ * with wine_server_call; the return value is the status of the batch
+ * itself. Requests that the batch didn't get to are failed with that status.
+ * Only the requests listed in the server's is_batch_request() are supported.
+ */
+unsigned int server_call_batch( struct __server_request_info *reqs, unsigned int count )
+{
+    data_size_t req_size = 0, reply_size = 0, size, pos;
+    unsigned int i, j, done = 0, ret;
+    char *buffer, *replies, *ptr;
+
+    for (i = 0; i < count; i++)
+    {
+        req_size += BATCH_ALIGN( sizeof(reqs[i].u.req) + reqs[i].u.req.request_header.request_size );
+        reply_size += BATCH_ALIGN( sizeof(reqs[i].u.reply) + reqs[i].u.req.request_header.reply_size );
+    }
+    if (!(buffer = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, req_size + reply_size )))
+        return STATUS_NO_MEMORY;
+    replies = buffer + req_size;
+
+    for (i = 0, ptr = buffer; i < count; i++)
+    {
+        char *start = ptr;
+
+        memcpy( ptr, &reqs[i].u.req, sizeof(reqs[i].u.req) );
+        ptr += sizeof(reqs[i].u.req);
+        for (j = 0; j < reqs[i].data_count; j++)
+        {
+            memcpy( ptr, reqs[i].data[j].ptr, reqs[i].data[j].size );
+            ptr += reqs[i].data[j].size;
+        }
+        ptr = start + BATCH_ALIGN( ptr - start );
+    }
+
+    SERVER_START_REQ( batch )
+    {
+        wine_server_add_data( req, buffer, req_size );
+        wine_server_set_reply( req, replies, reply_size );
+        ret = wine_server_call( req );
+        done = min( reply->count, count );
+        reply_size = wine_server_reply_size( reply );
+    }
+    SERVER_END_REQ;
+
+    if (TRACE_ON(serverstats)) interlocked_xchg_add( &server_requests, count - 1 );
+
+    for (i = pos = 0; i < count; i++)
+    {
+        if (i < done && reply_size - pos >= sizeof(reqs[i].u.reply))
+        {
+            memcpy( &reqs[i].u.reply, replies + pos, sizeof(reqs[i].u.reply) );
+            size = reqs[i].u.reply.reply_header.reply_size;
+            if (size) memcpy( reqs[i].reply_data, replies + pos + sizeof(reqs[i].u.reply), size );
+            pos += min( BATCH_ALIGN( sizeof(reqs[i].u.reply) + size ), reply_size - pos );
+        }
+        else
+        {
+            memset( &reqs[i].u.reply, 0, sizeof(reqs[i].u.reply) );
+            reqs[i].u.reply.reply_header.error = ret ? ret : STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    RtlFreeHeap( GetProcessHeap(), 0, buffer );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           server_init_request
+ *
+ * Initialize a request structure for server_call_batch.
+ */
+void *server_init_request( struct __server_request_info *req, enum request type )
+{
+    memset( &req->u.req, 0, sizeof(req->u.req) );
+    req->u.req.request_header.req = type;
+    req->data_count = 0;
+    req->reply_data = NULL;
+    return &req->u.req;
+}
+
+
+/***********************************************************************
+ *           server_trace_call_stats
+ *
+ * Report the server call statistics of the process.
+ */
+void server_trace_call_stats(void)
+{
+    if (!TRACE_ON(serverstats)) return;
+    TRACE_(serverstats)( "%u requests in %u round-trips, %s us waiting for the server\n",
+                         server_requests, server_round_trips,
+                         wine_dbgstr_longlong( server_call_time / 10 ));
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -895,7 +1026,7 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
 
     if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return STATUS_INVALID_HANDLE;
 
-    cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+    cache.data = interlocked_read64( &fd_cache[entry][idx].data );
     if (!cache.data) return STATUS_INVALID_HANDLE;
 
     /* if fd type is invalid, fd stores an error value */
@@ -909,6 +1040,38 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
 }
 
 
+/***********************************************************************
+ *           server_dup_fd_to_cache
+ *
+ * Prefetch the fd cache entry of a handle duplicated with the same access in
+ * the current process, to avoid a server round-trip on its first use.
+ */
+void server_dup_fd_to_cache( HANDLE src, HANDLE dst )
+{
+    unsigned int entry, idx = handle_to_index( src, &entry );
+    unsigned int access, options;
+    enum server_fd_type type;
+    union fd_cache_entry cache;
+    sigset_t sigset;
+    int fd, dst_fd;
+
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return;
+    cache.data = interlocked_read64( &fd_cache[entry][idx].data );
+    if (!cache.data || cache.s.type == FD_TYPE_INVALID) return;
+    if ((fd = dup( cache.s.fd - 1 )) == -1) return;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    /* make sure the source wasn't closed while duplicating its fd */
+    if (interlocked_read64( &fd_cache[entry][idx].data ) != cache.data ||
+        get_cached_fd( dst, &dst_fd, &type, &access, &options ) != STATUS_INVALID_HANDLE ||
+        !add_fd_to_cache( dst, fd, cache.s.type, cache.s.access, cache.s.options ))
+    {
+        close( fd );
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+}
+
+
 /***********************************************************************
  *           server_remove_fd_from_cache
  */
@@ -989,6 +1152,224 @@ done:
 }
 
 
+/***********************************************************************/
+/* in-process synchronization objects support */
+
+union inproc_sync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;         /* index in the shared region */
+        unsigned int type : 4;      /* object type, plus one so that 0 can be used as the unset value */
+        unsigned int access : 28;   /* handle access rights (standard and specific rights only) */
+    } s;
+};
+
+C_ASSERT( sizeof(union inproc_sync_cache_entry) == sizeof(LONG64) );
+
+#define INPROC_SYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(union inproc_sync_cache_entry))
+#define INPROC_SYNC_CACHE_ENTRIES     128
+
+static union inproc_sync_cache_entry *inproc_sync_cache[INPROC_SYNC_CACHE_ENTRIES];
+static struct inproc_sync *inproc_sync_region;
+static struct inproc_completion *inproc_completion_region;
+static int inproc_sync_enabled = -1;
+
+static RTL_CRITICAL_SECTION inproc_sync_section;
+static RTL_CRITICAL_SECTION_DEBUG inproc_sync_critsect_debug =
+{
+    0, 0, &inproc_sync_section,
+    { &inproc_sync_critsect_debug.ProcessLocksList, &inproc_sync_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": inproc_sync_section") }
+};
+static RTL_CRITICAL_SECTION inproc_sync_section = { &inproc_sync_critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline unsigned int inproc_sync_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / INPROC_SYNC_CACHE_BLOCK_SIZE;
+    return idx % INPROC_SYNC_CACHE_BLOCK_SIZE;
+}
+
+
+/***********************************************************************
+ *           init_inproc_sync
+ *
+ * Map the shared region if in-process synchronization is enabled.
+ * Caller must hold inproc_sync_section.
+ */
+static void init_inproc_sync(void)
+{
+    const char *env = getenv( "WINEINPROCSYNC" );
+    obj_handle_t fd_handle;
+    data_size_t size = 0;
+    void *ptr;
+    int fd = -1;
+
+    inproc_sync_enabled = 0;
+    if (!env || !atoi( env )) return;
+
+    SERVER_START_REQ( get_inproc_sync_region )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &fd_handle );
+        }
+    }
+    SERVER_END_REQ;
+
+    if (fd == -1) return;
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return;
+    inproc_sync_region = ptr;
+    inproc_sync_enabled = 1;
+    TRACE( "using in-process synchronization, region %p-%p\n", ptr, (char *)ptr + size );
+}
+
+
+/***********************************************************************
+ *           init_inproc_completion
+ *
+ * Map the completion ports region. Caller must hold inproc_sync_section.
+ */
+static BOOL init_inproc_completion(void)
+{
+    obj_handle_t fd_handle;
+    data_size_t size = 0;
+    void *ptr;
+    int fd = -1;
+
+    if (inproc_completion_region) return TRUE;
+
+    SERVER_START_REQ( get_inproc_completion_region )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &fd_handle );
+        }
+    }
+    SERVER_END_REQ;
+
+    if (fd == -1) return FALSE;
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return FALSE;
+    inproc_completion_region = ptr;
+    TRACE( "using in-process completion ports, region %p-%p\n", ptr, (char *)ptr + size );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           get_inproc_sync_cache
+ *
+ * Retrieve the cached in-process state of a handle, asking the server on first use.
+ */
+static BOOL get_inproc_sync_cache( HANDLE handle, union inproc_sync_cache_entry *ret )
+{
+    unsigned int entry, idx = inproc_sync_handle_to_index( handle, &entry );
+    union inproc_sync_cache_entry cache;
+    sigset_t sigset;
+
+    if (!inproc_sync_enabled || entry >= INPROC_SYNC_CACHE_ENTRIES) return FALSE;
+
+    cache.data = 0;
+    if (inproc_sync_cache[entry])
+        cache.data = interlocked_read64( &inproc_sync_cache[entry][idx].data );
+
+    if (!cache.data)
+    {
+        server_enter_uninterrupted_section( &inproc_sync_section, &sigset );
+
+        if (inproc_sync_enabled == -1) init_inproc_sync();
+
+        if (inproc_sync_enabled && !inproc_sync_cache[entry])
+        {
+            void *ptr = wine_anon_mmap( NULL, INPROC_SYNC_CACHE_BLOCK_SIZE * sizeof(union inproc_sync_cache_entry),
+                                        PROT_READ | PROT_WRITE, 0 );
+            if (ptr != MAP_FAILED) inproc_sync_cache[entry] = ptr;
+        }
+
+        if (inproc_sync_enabled && inproc_sync_cache[entry])
+        {
+            SERVER_START_REQ( get_inproc_sync )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                if (!wine_server_call( req ))
+                {
+                    cache.s.index  = reply->index;
+                    cache.s.type   = reply->type + 1;
+                    cache.s.access = reply->access;
+                }
+            }
+            SERVER_END_REQ;
+
+            if (cache.s.type == INPROC_SYNC_COMPLETION + 1 && !init_inproc_completion())
+                cache.s.type = INPROC_SYNC_NONE + 1;
+            if (cache.data) interlocked_xchg64( &inproc_sync_cache[entry][idx].data, cache.data );
+        }
+
+        server_leave_uninterrupted_section( &inproc_sync_section, &sigset );
+    }
+
+    if (!cache.data || cache.s.type == INPROC_SYNC_NONE + 1) return FALSE;
+    *ret = cache;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           server_get_inproc_sync
+ *
+ * Return the shared state of an event or semaphore handle, or NULL if the
+ * object can't be accessed in-process.
+ */
+struct inproc_sync *server_get_inproc_sync( HANDLE handle, enum inproc_sync_type *type,
+                                            unsigned int *access )
+{
+    union inproc_sync_cache_entry cache;
+
+    if (!get_inproc_sync_cache( handle, &cache )) return NULL;
+    if (cache.s.type == INPROC_SYNC_COMPLETION + 1) return NULL;
+    *type = cache.s.type - 1;
+    *access = cache.s.access;
+    return inproc_sync_region + cache.s.index;
+}
+
+
+/***********************************************************************
+ *           server_get_inproc_completion
+ *
+ * Return the shared queue of a completion port handle, or NULL if the
+ * port can't be accessed in-process.
+ */
+struct inproc_completion *server_get_inproc_completion( HANDLE handle, unsigned int *access )
+{
+    union inproc_sync_cache_entry cache;
+
+    if (!get_inproc_sync_cache( handle, &cache )) return NULL;
+    if (cache.s.type != INPROC_SYNC_COMPLETION + 1) return NULL;
+    *access = cache.s.access;
+    return inproc_completion_region + cache.s.index;
+}
+
+
+/***********************************************************************
+ *           server_remove_inproc_sync_from_cache
+ */
+void server_remove_inproc_sync_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = inproc_sync_handle_to_index( handle, &entry );
+
+    if (entry < INPROC_SYNC_CACHE_ENTRIES && inproc_sync_cache[entry])
+        interlocked_xchg64( &inproc_sync_cache[entry][idx].data, 0 );
+}
+
+
 /***********************************************************************
  *           wine_server_fd_to_handle   (NTDLL.@)
  *
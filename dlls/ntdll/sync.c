@@ -229,6 +229,268 @@ NTSTATUS validate_open_object_attributes( const OBJECT_ATTRIBUTES *attr )
     return STATUS_SUCCESS;
 }
 
+/*
+ *	In-process synchronization
+ *
+ * When enabled, the state of events and semaphores lives in memory shared with
+ * the server, and can be updated directly as long as the server has no thread
+ * waiting on the object. Blocking waits still go through the server.
+ */
+
+/* try to update an event state in-process; return the previous state, or -1 if we need the server */
+static int inproc_set_event( HANDLE handle, int value )
+{
+    enum inproc_sync_type type;
+    struct inproc_sync *sync;
+    unsigned int access;
+    int old;
+
+    if (!(sync = server_get_inproc_sync( handle, &type, &access ))) return -1;
+    if (type != INPROC_SYNC_AUTO_EVENT && type != INPROC_SYNC_MANUAL_EVENT) return -1;
+    if (!(access & EVENT_MODIFY_STATE)) return -1;
+
+    do
+    {
+        old = sync->state;
+        if (old & INPROC_SYNC_WAITERS) return -1;
+    } while (interlocked_cmpxchg( &sync->state, value, old ) != old);
+    return old;
+}
+
+/* try to release a semaphore in-process */
+static NTSTATUS inproc_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    enum inproc_sync_type type;
+    struct inproc_sync *sync;
+    unsigned int access;
+    int old;
+
+    if (!(sync = server_get_inproc_sync( handle, &type, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if (type != INPROC_SYNC_SEMAPHORE || !(access & SEMAPHORE_MODIFY_STATE)) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = sync->state;
+        if (old & INPROC_SYNC_WAITERS) return STATUS_NOT_IMPLEMENTED;
+        if ((ULONG)old + count < (ULONG)old || (ULONG)old + count > sync->max)
+            return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (interlocked_cmpxchg( &sync->state, old + count, old ) != old);
+
+    if (previous) *previous = old;
+    return STATUS_SUCCESS;
+}
+
+/* try to acquire an object in-process; return 1 if acquired, 0 if not signaled, -1 if we need the server */
+static int inproc_try_acquire( struct inproc_sync *sync, enum inproc_sync_type type )
+{
+    int old;
+
+    do
+    {
+        old = sync->state;
+        /* a signaled manual-reset event can be acquired even if there are waiters */
+        if (type == INPROC_SYNC_MANUAL_EVENT && (old & ~INPROC_SYNC_WAITERS)) return 1;
+        if (old & INPROC_SYNC_WAITERS) return -1;
+        if (!old) return 0;
+    } while (interlocked_cmpxchg( &sync->state, type == INPROC_SYNC_SEMAPHORE ? old - 1 : 0, old ) != old);
+    return 1;
+}
+
+/* try to satisfy a wait in-process */
+static NTSTATUS inproc_wait( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                             const LARGE_INTEGER *timeout )
+{
+    struct inproc_sync *syncs[MAXIMUM_WAIT_OBJECTS];
+    enum inproc_sync_type types[MAXIMUM_WAIT_OBJECTS];
+    unsigned int access;
+    DWORD i;
+
+    if (!wait_any && count > 1) return STATUS_NOT_IMPLEMENTED;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!(syncs[i] = server_get_inproc_sync( handles[i], &types[i], &access )))
+            return STATUS_NOT_IMPLEMENTED;
+        if (!(access & SYNCHRONIZE)) return STATUS_NOT_IMPLEMENTED;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        switch (inproc_try_acquire( syncs[i], types[i] ))
+        {
+        case 1: return STATUS_WAIT_0 + i;
+        case -1: return STATUS_NOT_IMPLEMENTED;
+        }
+    }
+
+    if (timeout && !timeout->QuadPart) return STATUS_TIMEOUT;
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+/*
+ * Completion port queues shared with the server are bounded lock-free rings
+ * of packets; threads waiting for packets sleep on a futex in the shared state,
+ * so it has to be a process-shared futex.
+ */
+#ifdef __linux__
+
+/* add a packet to the shared ring of a completion port; fails if the ring is full */
+static BOOL inproc_completion_push( struct inproc_completion *port, ULONG_PTR key, ULONG_PTR value,
+                                    NTSTATUS status, ULONG_PTR information )
+{
+    struct inproc_completion_packet *packet;
+    unsigned int pos = *(volatile int *)&port->tail, prev;
+    int diff;
+
+    for (;;)
+    {
+        packet = &port->packets[pos & (INPROC_COMPLETION_PACKETS - 1)];
+        diff = *(volatile int *)&packet->seq - pos;
+        if (!diff)
+        {
+            if ((prev = interlocked_cmpxchg( &port->tail, pos + 1, pos )) == pos) break;
+            pos = prev;
+        }
+        else if (diff < 0) return FALSE;
+        else pos = *(volatile int *)&port->tail;
+    }
+    packet->ckey        = key;
+    packet->cvalue      = value;
+    packet->status      = status;
+    packet->information = information;
+    interlocked_xchg( &packet->seq, pos + 1 );
+    return TRUE;
+}
+
+/* remove a packet from the shared ring of a completion port; fails if it is empty */
+static BOOL inproc_completion_pop( struct inproc_completion *port, FILE_IO_COMPLETION_INFORMATION *info )
+{
+    struct inproc_completion_packet *packet;
+    unsigned int pos = *(volatile int *)&port->head, prev;
+    int diff;
+
+    for (;;)
+    {
+        packet = &port->packets[pos & (INPROC_COMPLETION_PACKETS - 1)];
+        diff = *(volatile int *)&packet->seq - (pos + 1);
+        if (!diff)
+        {
+            if ((prev = interlocked_cmpxchg( &port->head, pos + 1, pos )) == pos) break;
+            pos = prev;
+        }
+        else if (diff < 0) return FALSE;
+        else pos = *(volatile int *)&port->head;
+    }
+    info->CompletionKey             = packet->ckey;
+    info->CompletionValue           = packet->cvalue;
+    info->IoStatusBlock.Information = packet->information;
+    info->IoStatusBlock.u.Status    = packet->status;
+    interlocked_xchg( &packet->seq, pos + INPROC_COMPLETION_PACKETS );
+    return TRUE;
+}
+
+/* try to add a packet to a completion port in-process */
+static NTSTATUS inproc_set_completion( HANDLE handle, ULONG_PTR key, ULONG_PTR value,
+                                       NTSTATUS status, ULONG_PTR information )
+{
+    struct inproc_completion *port;
+    unsigned int access;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(port = server_get_inproc_completion( handle, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if (!(access & IO_COMPLETION_MODIFY_STATE)) return STATUS_NOT_IMPLEMENTED;
+    if (*(volatile int *)&port->flags & INPROC_COMPLETION_OVERFLOW) return STATUS_NOT_IMPLEMENTED;
+    if (!inproc_completion_push( port, key, value, status, information )) return STATUS_NOT_IMPLEMENTED;
+
+    /* the futex is updated after the packet is added and before the waiters are checked,
+     * so a thread going to sleep either sees the packet or a changed futex value */
+    interlocked_xchg_add( &port->futex, 1 );
+    if (*(volatile int *)&port->waiters)
+        syscall( __NR_futex, &port->futex, FUTEX_WAKE, 1, NULL, 0, 0 );
+
+    if (*(volatile int *)&port->flags & INPROC_COMPLETION_SERVER_WAITERS)
+    {
+        SERVER_START_REQ( wake_completion )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+    }
+    return STATUS_SUCCESS;
+}
+
+/* try to remove packets from a completion port in-process, waiting on the futex while it is empty */
+static NTSTATUS inproc_remove_completion( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                          ULONG *written, const LARGE_INTEGER *timeout )
+{
+    struct inproc_completion *port;
+    struct timespec timespec;
+    LARGE_INTEGER end;
+    unsigned int access;
+    int futex, generation, ret;
+    ULONG i;
+
+    if (!count || !use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(port = server_get_inproc_completion( handle, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if ((access & (IO_COMPLETION_MODIFY_STATE | SYNCHRONIZE)) != (IO_COMPLETION_MODIFY_STATE | SYNCHRONIZE))
+        return STATUS_NOT_IMPLEMENTED;
+
+    if (timeout && timeout->QuadPart < 0)
+    {
+        NtQuerySystemTime( &end );
+        end.QuadPart -= timeout->QuadPart;
+        timeout = &end;
+    }
+    generation = *(volatile int *)&port->generation;
+
+    for (;;)
+    {
+        futex = *(volatile int *)&port->futex;
+        for (i = 0; i < count; i++) if (!inproc_completion_pop( port, &info[i] )) break;
+        if (i)
+        {
+            *written = i;
+            return STATUS_SUCCESS;
+        }
+
+        /* the server has more packets in its own queue */
+        if (*(volatile int *)&port->flags & INPROC_COMPLETION_OVERFLOW) return STATUS_NOT_IMPLEMENTED;
+
+        if (timeout)
+        {
+            if (!timeout->QuadPart) return STATUS_TIMEOUT;
+            timespec_from_timeout( &timespec, timeout );
+            if (timespec.tv_sec < 0 || timespec.tv_nsec < 0) return STATUS_TIMEOUT;
+        }
+
+        interlocked_xchg_add( &port->waiters, 1 );
+        ret = syscall( __NR_futex, &port->futex, FUTEX_WAIT, futex, timeout ? &timespec : NULL, 0, 0 );
+        interlocked_xchg_add( &port->waiters, -1 );
+
+        /* the port was destroyed while we were waiting */
+        if (*(volatile int *)&port->generation != generation) return STATUS_ABANDONED_WAIT_0;
+        if (ret == -1 && errno == ETIMEDOUT) return STATUS_TIMEOUT;
+    }
+}
+
+#else  /* __linux__ */
+
+static NTSTATUS inproc_set_completion( HANDLE handle, ULONG_PTR key, ULONG_PTR value,
+                                       NTSTATUS status, ULONG_PTR information )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS inproc_remove_completion( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                          ULONG *written, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
+
 /*
  *	Semaphores
  */
@@ -329,6 +591,10 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
     NTSTATUS ret;
+
+    if ((ret = inproc_release_semaphore( handle, count, previous )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -406,6 +672,14 @@ NTSTATUS WINAPI NtOpenEvent( HANDLE *handle, ACCESS_MASK access, const OBJECT_AT
 NTSTATUS WINAPI NtSetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
+    int state;
+
+    if ((state = inproc_set_event( handle, 1 )) != -1)
+    {
+        if (prev_state) *prev_state = state;
+        return STATUS_SUCCESS;
+    }
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -423,6 +697,14 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, LONG *prev_state )
 NTSTATUS WINAPI NtResetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
+    int state;
+
+    if ((state = inproc_set_event( handle, 0 )) != -1)
+    {
+        if (prev_state) *prev_state = state;
+        return STATUS_SUCCESS;
+    }
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -454,6 +736,14 @@ NTSTATUS WINAPI NtClearEvent ( HANDLE handle )
 NTSTATUS WINAPI NtPulseEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
+    int state;
+
+    /* without waiters, pulsing only resets the event */
+    if ((state = inproc_set_event( handle, 0 )) != -1)
+    {
+        if (prev_state) *prev_state = state;
+        return STATUS_SUCCESS;
+    }
 
     SERVER_START_REQ( event_op )
     {
@@ -1078,9 +1368,13 @@ static NTSTATUS wait_objects( DWORD count, const HANDLE *handles,
 {
     select_op_t select_op;
     UINT i, flags = SELECT_INTERRUPTIBLE;
+    NTSTATUS ret;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    if (!alertable && (ret = inproc_wait( count, handles, wait_any, timeout )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1331,6 +1625,10 @@ NTSTATUS WINAPI NtSetIoCompletion( HANDLE CompletionPort, ULONG_PTR CompletionKe
     TRACE("(%p, %lx, %lx, %x, %lx)\n", CompletionPort, CompletionKey,
           CompletionValue, Status, NumberOfBytesTransferred);
 
+    if ((status = inproc_set_completion( CompletionPort, CompletionKey, CompletionValue, Status,
+                                         NumberOfBytesTransferred )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+
     SERVER_START_REQ( add_completion )
     {
         req->handle      = wine_server_obj_handle( CompletionPort );
@@ -1362,11 +1660,24 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
                                       PULONG_PTR CompletionValue, PIO_STATUS_BLOCK iosb,
                                       PLARGE_INTEGER WaitTime )
 {
+    FILE_IO_COMPLETION_INFORMATION info;
     NTSTATUS status;
+    ULONG written;
 
     TRACE("(%p, %p, %p, %p, %p)\n", CompletionPort, CompletionKey,
           CompletionValue, iosb, WaitTime);
 
+    if ((status = inproc_remove_completion( CompletionPort, &info, 1, &written, WaitTime )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (status == STATUS_SUCCESS)
+        {
+            *CompletionKey = info.CompletionKey;
+            *CompletionValue = info.CompletionValue;
+            *iosb = info.IoStatusBlock;
+        }
+        return status;
+    }
+
     for(;;)
     {
         SERVER_START_REQ( remove_completion )
@@ -1401,6 +1712,14 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE port, FILE_IO_COMPLETION_INFORMAT
 
     TRACE("%p %p %u %p %p %u\n", port, info, count, written, timeout, alertable);
 
+    /* alertable waits have to go through the server, but available packets can still be removed directly */
+    ret = inproc_remove_completion( port, info, count, written, alertable ? &zero_timeout : timeout );
+    if (ret != STATUS_NOT_IMPLEMENTED && (ret != STATUS_TIMEOUT || !alertable))
+    {
+        if (ret != STATUS_SUCCESS) *written = 1;
+        return ret;
+    }
+
     for (;;)
     {
         while (i < count)
@@ -35,6 +35,7 @@
 
 #include "wine/test.h"
 #include "winnls.h"
+#include "winreg.h"
 #include "winternl.h"
 
 static NTSTATUS (WINAPI *pNtClose)( PHANDLE );
@@ -829,6 +830,144 @@ done:
     pRtlFreeUnicodeString(&ntdirname);
 }
 
+static void count_large_directory( HANDLE handle, UNICODE_STRING *mask, BOOLEAN restart, BOOL sorted,
+                                   BYTE *seen, UINT file_count, UINT *found )
+{
+    FILE_DIRECTORY_INFORMATION *info;
+    IO_STATUS_BLOCK io;
+    BYTE data[8192];
+    char name[MAX_PATH];
+    NTSTATUS status;
+    UINT pos, index, next = 0;
+
+    *found = 0;
+    memset( seen, 0, file_count );
+    for (;;)
+    {
+        status = pNtQueryDirectoryFile( handle, NULL, NULL, NULL, &io, data, sizeof(data),
+                                        FileDirectoryInformation, FALSE, mask, restart );
+        restart = FALSE;
+        if (status == STATUS_NO_MORE_FILES) break;
+        ok( status == STATUS_SUCCESS, "failed to query directory; status %x\n", status );
+        if (status) break;
+
+        for (pos = 0; ; pos += info->NextEntryOffset)
+        {
+            info = (FILE_DIRECTORY_INFORMATION *)(data + pos);
+            WideCharToMultiByte( CP_ACP, 0, info->FileName, info->FileNameLength / sizeof(WCHAR),
+                                 name, sizeof(name), NULL, NULL );
+            name[info->FileNameLength / sizeof(WCHAR)] = 0;
+            if (sscanf( name, "f%05u.tmp", &index ) == 1 && index < file_count)
+            {
+                ok( !seen[index], "%s returned twice\n", name );
+                if (sorted) ok( index == next, "got %s, expected index %u\n", name, next );
+                seen[index] = 1;
+                next = index + 1;
+                (*found)++;
+            }
+            else ok( 0, "unexpected file %s\n", name );
+            if (!info->NextEntryOffset) break;
+        }
+    }
+}
+
+static void check_large_directory( const char *testdir, UINT file_count, BOOL sorted )
+{
+    static WCHAR maskW[] = {'*','.','t','m','p'};
+    WCHAR testdirW[MAX_PATH];
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING ntdirname, mask;
+    IO_STATUS_BLOCK io;
+    NTSTATUS status;
+    HANDLE handle;
+    UINT found;
+    DWORD start;
+    BYTE *seen;
+
+    pRtlMultiByteToUnicodeN( testdirW, sizeof(testdirW), NULL, testdir, strlen(testdir) + 1 );
+    if (!pRtlDosPathNameToNtPathName_U( testdirW, &ntdirname, NULL, NULL ))
+    {
+        ok( 0, "RtlDosPathNametoNtPathName_U failed\n" );
+        return;
+    }
+    InitializeObjectAttributes( &attr, &ntdirname, OBJ_CASE_INSENSITIVE, 0, NULL );
+    status = pNtOpenFile( &handle, SYNCHRONIZE | FILE_LIST_DIRECTORY, &attr, &io, FILE_SHARE_READ,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT | FILE_DIRECTORY_FILE );
+    ok( status == STATUS_SUCCESS, "failed to open dir %s\n", testdir );
+    pRtlFreeUnicodeString( &ntdirname );
+    if (status) return;
+
+    mask.Buffer = maskW;
+    mask.Length = mask.MaximumLength = sizeof(maskW);
+    seen = HeapAlloc( GetProcessHeap(), 0, file_count );
+
+    start = GetTickCount();
+    count_large_directory( handle, &mask, TRUE, sorted, seen, file_count, &found );
+    ok( found == file_count, "found %u files\n", found );
+    if (winetest_interactive) trace( "enumerated %u files in %u ms\n", found, GetTickCount() - start );
+
+    /* restart the scan */
+    count_large_directory( handle, &mask, TRUE, sorted, seen, file_count, &found );
+    ok( found == file_count, "found %u files after restart\n", found );
+
+    HeapFree( GetProcessHeap(), 0, seen );
+    pNtClose( handle );
+}
+
+static void test_NtQueryDirectoryFile_large( const char *argv0 )
+{
+    /* just over the size where Wine can stream the directory; more files are only useful for benchmarking */
+    const UINT file_count = winetest_interactive ? 50000 : 16500;
+    char testdir[MAX_PATH], name[MAX_PATH], cmdline[2 * MAX_PATH];
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    HANDLE file;
+    HKEY key;
+    UINT i;
+
+    GetTempPathA( MAX_PATH, testdir );
+    strcat( testdir, "large.tmp" );
+    if (!CreateDirectoryA( testdir, NULL ))
+    {
+        skip( "failed to create directory, error %u\n", GetLastError() );
+        return;
+    }
+    for (i = 0; i < file_count; i++)
+    {
+        sprintf( name, "%s\\f%05u.tmp", testdir, i );
+        file = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+        ok( file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", name, GetLastError() );
+        CloseHandle( file );
+    }
+
+    /* large directories are sorted by default */
+    check_large_directory( testdir, file_count, TRUE );
+
+    /* check the Wine streaming mode in a child process, the option is only read once */
+    if (!RegCreateKeyA( HKEY_CURRENT_USER, "Software\\Wine", &key ))
+    {
+        RegSetValueExA( key, "StreamLargeDirectories", 0, REG_SZ, (const BYTE *)"Y", 2 );
+        sprintf( cmdline, "\"%s\" directory large \"%s\" %u", argv0, testdir, file_count );
+        if (CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi ))
+        {
+            winetest_wait_child_process( pi.hProcess );
+            CloseHandle( pi.hProcess );
+            CloseHandle( pi.hThread );
+        }
+        else ok( 0, "CreateProcess failed, error %u\n", GetLastError() );
+        RegDeleteValueA( key, "StreamLargeDirectories" );
+        RegCloseKey( key );
+    }
+    else skip( "failed to open the Wine key\n" );
+
+    for (i = 0; i < file_count; i++)
+    {
+        sprintf( name, "%s\\f%05u.tmp", testdir, i );
+        DeleteFileA( name );
+    }
+    RemoveDirectoryA( testdir );
+}
+
 static void test_redirection(void)
 {
     ULONG old, cur;
@@ -882,6 +1021,8 @@ static void test_redirection(void)
 START_TEST(directory)
 {
     WCHAR sysdir[MAX_PATH];
+    char **argv;
+    int argc;
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
     if (!hntdll)
     {
@@ -903,9 +1044,18 @@ START_TEST(directory)
     pRtlWow64EnableFsRedirection = (void *)GetProcAddress(hntdll,"RtlWow64EnableFsRedirection");
     pRtlWow64EnableFsRedirectionEx = (void *)GetProcAddress(hntdll,"RtlWow64EnableFsRedirectionEx");
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 5 && !strcmp( argv[2], "large" ))
+    {
+        /* entries may be streamed unsorted */
+        check_large_directory( argv[3], atoi( argv[4] ), FALSE );
+        return;
+    }
+
     GetSystemDirectoryW( sysdir, MAX_PATH );
     test_directory_sort( sysdir );
     test_NtQueryDirectoryFile();
     test_NtQueryDirectoryFile_case();
+    test_NtQueryDirectoryFile_large( argv[0] );
     test_redirection();
 }
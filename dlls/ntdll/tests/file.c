@@ -1054,6 +1054,171 @@ static void test_set_io_completion(void)
     pNtClose( h );
 }
 
+struct completion_thread_params
+{
+    HANDLE       port;
+    HANDLE       reply_port;
+    unsigned int count;
+};
+
+static DWORD WINAPI completion_pong_thread( void *arg )
+{
+    struct completion_thread_params *params = arg;
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR key, value;
+    NTSTATUS res;
+
+    for (;;)
+    {
+        res = pNtRemoveIoCompletion( params->port, &key, &value, &iosb, NULL );
+        if (res || !key) break;
+        pNtSetIoCompletion( params->reply_port, key, value, STATUS_SUCCESS, 0 );
+        params->count++;
+    }
+    return res;
+}
+
+static DWORD WINAPI completion_dequeue_thread( void *arg )
+{
+    struct completion_thread_params *params = arg;
+    FILE_IO_COMPLETION_INFORMATION info[16];
+    NTSTATUS res;
+    ULONG i, count;
+
+    for (;;)
+    {
+        res = pNtRemoveIoCompletionEx( params->port, info, ARRAY_SIZE(info), &count, NULL, FALSE );
+        if (res) return res;
+        for (i = 0; i < count; i++)
+        {
+            if (!info[i].CompletionKey) return 0;
+            params->count++;
+        }
+    }
+}
+
+static void test_io_completion_throughput(void)
+{
+    static const unsigned int packets = 3000;
+    unsigned int ping_count = winetest_interactive ? 10000 : 100;
+    unsigned int dequeue_count = winetest_interactive ? 100000 : 1000;
+    struct completion_thread_params params[8];
+    FILE_IO_COMPLETION_INFORMATION info[64];
+    HANDLE port, reply_port, threads[8];
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR key, value;
+    unsigned int i, total;
+    NTSTATUS res;
+    DWORD start;
+    ULONG count;
+
+    if (!pNtRemoveIoCompletionEx)
+    {
+        skip("NtRemoveIoCompletionEx() not present\n");
+        return;
+    }
+
+    res = pNtCreateIoCompletion( &port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#x\n", res );
+    res = pNtCreateIoCompletion( &reply_port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#x\n", res );
+
+    /* packets must be returned in order, even when the queue grows large */
+    for (i = 0; i < packets; i++)
+    {
+        res = pNtSetIoCompletion( port, i + 1, i, STATUS_SUCCESS, i );
+        ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %#x\n", res );
+    }
+    count = get_pending_msgs( port );
+    ok( count == packets, "got %u pending packets\n", count );
+    for (i = 0; i < packets; i += count)
+    {
+        count = 0xdeadbeef;
+        res = pNtRemoveIoCompletionEx( port, info, ARRAY_SIZE(info), &count, NULL, FALSE );
+        ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %#x\n", res );
+        if (res) break;
+        ok( count && count <= ARRAY_SIZE(info), "wrong count %u\n", count );
+        ok( info[0].CompletionKey == i + 1, "wrong key %#lx, expected %#x\n", info[0].CompletionKey, i + 1 );
+        ok( info[count - 1].CompletionKey == i + count, "wrong key %#lx, expected %#x\n",
+            info[count - 1].CompletionKey, i + count );
+        ok( info[count - 1].IoStatusBlock.Information == i + count - 1, "wrong information %#lx\n",
+            info[count - 1].IoStatusBlock.Information );
+    }
+    count = get_pending_msgs( port );
+    ok( !count, "got %u pending packets\n", count );
+
+    /* ping-pong between two threads */
+    memset( params, 0, sizeof(params) );
+    params[0].port = port;
+    params[0].reply_port = reply_port;
+    threads[0] = CreateThread( NULL, 0, completion_pong_thread, &params[0], 0, NULL );
+
+    start = GetTickCount();
+    for (i = 0; i < ping_count; i++)
+    {
+        pNtSetIoCompletion( port, i + 1, i, STATUS_SUCCESS, 0 );
+        res = pNtRemoveIoCompletion( reply_port, &key, &value, &iosb, NULL );
+        if (res || key != i + 1 || value != i) break;
+    }
+    ok( i == ping_count, "got status %#x key %#lx value %#lx after %u round trips\n", res, key, value, i );
+    if (winetest_interactive)
+        trace( "%u completion port round trips in %u ms\n", i, GetTickCount() - start );
+
+    pNtSetIoCompletion( port, 0, 0, STATUS_SUCCESS, 0 );
+    WaitForSingleObject( threads[0], INFINITE );
+    CloseHandle( threads[0] );
+    ok( params[0].count == ping_count, "pong thread got %u packets\n", params[0].count );
+
+    /* many threads removing packets in batches */
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        params[i].port = port;
+        params[i].count = 0;
+        threads[i] = CreateThread( NULL, 0, completion_dequeue_thread, &params[i], 0, NULL );
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < dequeue_count; i++) pNtSetIoCompletion( port, i + 1, i, STATUS_SUCCESS, 0 );
+    for (i = 0; i < ARRAY_SIZE(threads); i++) pNtSetIoCompletion( port, 0, 0, STATUS_SUCCESS, 0 );
+    WaitForMultipleObjects( ARRAY_SIZE(threads), threads, TRUE, INFINITE );
+    if (winetest_interactive)
+        trace( "%u completion packets through %u threads in %u ms\n", dequeue_count,
+               (unsigned int)ARRAY_SIZE(threads), GetTickCount() - start );
+
+    for (i = total = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        total += params[i].count;
+        CloseHandle( threads[i] );
+    }
+    ok( total == dequeue_count, "threads got %u packets\n", total );
+
+    pNtClose( reply_port );
+    pNtClose( port );
+}
+
+static void test_inproc_io_completion(void)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH];
+    char **argv;
+
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" file inproc_completion", argv[0] );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+
+    /* in-process completion ports are only used when in-process synchronization is enabled */
+    SetEnvironmentVariableA( "WINEINPROCSYNC", "1" );
+    ok( CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+        "CreateProcess failed err %u\n", GetLastError() );
+    SetEnvironmentVariableA( "WINEINPROCSYNC", NULL );
+
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+}
+
 static void test_file_io_completion(void)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -4904,6 +5069,8 @@ START_TEST(file)
 {
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+    char **argv;
+
     if (!hntdll)
     {
         skip("not running on NT, skipping test\n");
@@ -4941,6 +5108,13 @@ START_TEST(file)
     pNtQueryFullAttributesFile = (void *)GetProcAddress(hntdll, "NtQueryFullAttributesFile");
     pNtFlushBuffersFile = (void *)GetProcAddress(hntdll, "NtFlushBuffersFile");
 
+    if (winetest_get_mainargs( &argv ) >= 3 && !strcmp( argv[2], "inproc_completion" ))
+    {
+        test_set_io_completion();
+        test_io_completion_throughput();
+        return;
+    }
+
     test_read_write();
     test_NtCreateFile();
     create_file_test();
@@ -4950,6 +5124,8 @@ START_TEST(file)
     append_file_test();
     nt_mailslot_test();
     test_set_io_completion();
+    test_io_completion_throughput();
+    test_inproc_io_completion();
     test_file_io_completion();
     test_file_basic_information();
     test_file_all_information();
@@ -1614,6 +1614,7 @@ static void test_event(void)
     UNICODE_STRING str;
     OBJECT_ATTRIBUTES attr;
     EVENT_BASIC_INFORMATION info;
+    DWORD ret, start, count, i;
     static const WCHAR eventName[] = {'\\','B','a','s','e','N','a','m','e','d','O','b','j','e','c','t','s','\\','t','e','s','t','E','v','e','n','t',0};
 
     pRtlInitUnicodeString(&str, eventName);
@@ -1671,6 +1672,130 @@ static void test_event(void)
     ok( prev_state == 1, "prev_state = %x\n", prev_state );
 
     pNtClose(Event);
+
+    /* auto-reset event */
+    status = pNtCreateEvent(&Event, GENERIC_ALL, NULL, SynchronizationEvent, 0);
+    ok( status == STATUS_SUCCESS, "NtCreateEvent failed %08x\n", status );
+
+    ret = WaitForSingleObject( Event, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %08x\n", ret );
+
+    status = pNtSetEvent( Event, &prev_state );
+    ok( status == STATUS_SUCCESS, "NtSetEvent failed: %08x\n", status );
+    ok( !prev_state, "prev_state = %x\n", prev_state );
+
+    ret = WaitForSingleObject( Event, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %08x\n", ret );
+    ret = WaitForSingleObject( Event, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %08x\n", ret );
+
+    status = pNtSetEvent( Event, NULL );
+    ok( status == STATUS_SUCCESS, "NtSetEvent failed: %08x\n", status );
+    status = pNtResetEvent( Event, &prev_state );
+    ok( status == STATUS_SUCCESS, "NtResetEvent failed: %08x\n", status );
+    ok( prev_state == 1, "prev_state = %x\n", prev_state );
+
+    /* the large count is only useful for benchmarking */
+    count = winetest_interactive ? 100000 : 100;
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        pNtSetEvent( Event, NULL );
+        if (WaitForSingleObject( Event, 0 )) break;
+    }
+    ok( i == count, "wait failed after %u iterations\n", i );
+    if (winetest_interactive) trace( "%u set/wait iterations in %u ms\n", i, GetTickCount() - start );
+
+    pNtClose(Event);
+}
+
+static void test_semaphore(void)
+{
+    HANDLE semaphore;
+    NTSTATUS status;
+    ULONG prev;
+    DWORD ret;
+
+    status = pNtCreateSemaphore( &semaphore, GENERIC_ALL, NULL, 1, 2 );
+    ok( status == STATUS_SUCCESS, "NtCreateSemaphore failed %08x\n", status );
+
+    prev = 0xdeadbeef;
+    status = pNtReleaseSemaphore( semaphore, 2, &prev );
+    ok( status == STATUS_SEMAPHORE_LIMIT_EXCEEDED, "NtReleaseSemaphore failed %08x\n", status );
+    ok( prev == 0xdeadbeef, "prev = %u\n", prev );
+
+    status = pNtReleaseSemaphore( semaphore, 1, &prev );
+    ok( status == STATUS_SUCCESS, "NtReleaseSemaphore failed %08x\n", status );
+    ok( prev == 1, "prev = %u\n", prev );
+
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %08x\n", ret );
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %08x\n", ret );
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %08x\n", ret );
+
+    status = pNtReleaseSemaphore( semaphore, 1, &prev );
+    ok( status == STATUS_SUCCESS, "NtReleaseSemaphore failed %08x\n", status );
+    ok( prev == 0, "prev = %u\n", prev );
+
+    pNtClose( semaphore );
+}
+
+static void test_semaphore_child(void)
+{
+    HANDLE semaphore;
+    LONG prev;
+    DWORD ret;
+
+    semaphore = OpenSemaphoreA( SEMAPHORE_ALL_ACCESS, FALSE, "om_test_semaphore" );
+    ok( semaphore != NULL, "OpenSemaphore failed %u\n", GetLastError() );
+
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %08x\n", ret );
+    ret = ReleaseSemaphore( semaphore, 2, &prev );
+    ok( ret, "ReleaseSemaphore failed %u\n", GetLastError() );
+    ok( prev == 0, "prev = %d\n", prev );
+    ret = ReleaseSemaphore( semaphore, 1, NULL );
+    ok( !ret, "ReleaseSemaphore succeeded\n" );
+
+    CloseHandle( semaphore );
+}
+
+/* the semaphore state lives in the region of the process that first accessed it,
+ * other processes have to go through the server */
+static void test_semaphore_process(const char *argv0)
+{
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si = { sizeof(si) };
+    char cmdline[MAX_PATH + 32];
+    HANDLE semaphore;
+    DWORD ret;
+
+    semaphore = CreateSemaphoreA( NULL, 1, 2, "om_test_semaphore" );
+    ok( semaphore != NULL, "CreateSemaphore failed %u\n", GetLastError() );
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %08x\n", ret );
+    ret = ReleaseSemaphore( semaphore, 1, NULL );
+    ok( ret, "ReleaseSemaphore failed %u\n", GetLastError() );
+
+    sprintf( cmdline, "\"%s\" om semaphore", argv0 );
+    SetEnvironmentVariableA( "WINEINPROCSYNC", "1" );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    SetEnvironmentVariableA( "WINEINPROCSYNC", NULL );
+    ok( ret, "CreateProcess failed %u\n", GetLastError() );
+    winetest_wait_child_process( pi.hProcess );
+    CloseHandle( pi.hProcess );
+    CloseHandle( pi.hThread );
+
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %08x\n", ret );
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %08x\n", ret );
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %08x\n", ret );
+
+    CloseHandle( semaphore );
 }
 
 static const WCHAR keyed_nameW[] = {'\\','B','a','s','e','N','a','m','e','d','O','b','j','e','c','t','s',
@@ -2152,6 +2277,8 @@ START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
+    char **argv;
+    int argc;
 
     if (!hntdll)
     {
@@ -2159,6 +2286,13 @@ START_TEST(om)
         return;
     }
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "semaphore" ))
+    {
+        test_semaphore_child();
+        return;
+    }
+
     pCreateWaitableTimerA = (void *)GetProcAddress(hkernel32, "CreateWaitableTimerA");
 
     pRtlCreateUnicodeStringFromAsciiz = (void *)GetProcAddress(hntdll, "RtlCreateUnicodeStringFromAsciiz");
@@ -2217,6 +2351,8 @@ START_TEST(om)
     test_query_object();
     test_type_mismatch();
     test_event();
+    test_semaphore();
+    test_semaphore_process( argv[0] );
     test_mutant();
     test_keyed_events();
     test_null_device();
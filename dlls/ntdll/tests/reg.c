@@ -133,6 +133,7 @@ static NTSTATUS (WINAPI * pNtCreateKey)( PHANDLE retkey, ACCESS_MASK access, con
 static NTSTATUS (WINAPI * pNtQueryKey)(HANDLE,KEY_INFORMATION_CLASS,PVOID,ULONG,PULONG);
 static NTSTATUS (WINAPI * pNtQueryLicenseValue)(const UNICODE_STRING *,ULONG *,PVOID,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtQueryValueKey)(HANDLE,const UNICODE_STRING *,KEY_VALUE_INFORMATION_CLASS,void *,DWORD,DWORD *);
+static NTSTATUS (WINAPI * pNtQueryMultipleValueKey)(HANDLE,KEY_MULTIPLE_VALUE_INFORMATION *,ULONG,void *,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtSetValueKey)(HANDLE, const PUNICODE_STRING, ULONG,
                                ULONG, const void*, ULONG  );
 static NTSTATUS (WINAPI * pNtQueryInformationProcess)(HANDLE,PROCESSINFOCLASS,PVOID,ULONG,PULONG);
@@ -206,6 +207,7 @@ static BOOL InitFunctionPtrs(void)
     pNtQueryLicenseValue = (void *)GetProcAddress(hntdll, "NtQueryLicenseValue");
     pNtOpenKeyEx = (void *)GetProcAddress(hntdll, "NtOpenKeyEx");
     pNtNotifyChangeMultipleKeys = (void *)GetProcAddress(hntdll, "NtNotifyChangeMultipleKeys");
+    pNtQueryMultipleValueKey = (void *)GetProcAddress(hntdll, "NtQueryMultipleValueKey");
 
     return TRUE;
 }
@@ -838,6 +840,70 @@ static void test_NtQueryValueKey(void)
     pNtClose(key);
 }
 
+static void test_NtQueryMultipleValueKey(void)
+{
+    static const WCHAR dwordW[] = {'m','u','l','t','i','d','w','o','r','d',0};
+    static const WCHAR stringW2[] = {'m','u','l','t','i','s','t','r','i','n','g',0};
+    static const WCHAR missingW[] = {'m','u','l','t','i','m','i','s','s','i','n','g',0};
+    KEY_MULTIPLE_VALUE_INFORMATION values[2];
+    UNICODE_STRING dword_name, string_name, missing_name;
+    OBJECT_ATTRIBUTES attr;
+    NTSTATUS status;
+    HANDLE key;
+    DWORD data = 0x12345678;
+    char buffer[64];
+    ULONG len;
+
+    if (!pNtQueryMultipleValueKey)
+    {
+        win_skip("NtQueryMultipleValueKey not available\n");
+        return;
+    }
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ|KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08x\n", status);
+
+    pRtlInitUnicodeString(&dword_name, dwordW);
+    pRtlInitUnicodeString(&string_name, stringW2);
+    pRtlInitUnicodeString(&missing_name, missingW);
+    status = pNtSetValueKey(key, &dword_name, 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+    status = pNtSetValueKey(key, &string_name, 0, REG_SZ, (void *)stringW, sizeof(stringW));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+
+    values[0].ValueName = &string_name;
+    values[1].ValueName = &dword_name;
+    len = 0xdeadbeef;
+    memset(buffer, 0xcc, sizeof(buffer));
+    status = pNtQueryMultipleValueKey(key, values, 2, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryMultipleValueKey Failed: 0x%08x\n", status);
+    ok(len >= sizeof(stringW) + sizeof(data) && len <= sizeof(buffer), "got length %u\n", len);
+    ok(values[0].Type == REG_SZ, "got type %u\n", values[0].Type);
+    ok(values[0].DataLength == sizeof(stringW), "got length %u\n", values[0].DataLength);
+    ok(values[0].DataOffset + values[0].DataLength <= len, "got offset %u\n", values[0].DataOffset);
+    if (values[0].DataOffset + values[0].DataLength <= sizeof(buffer))
+        ok(!memcmp(buffer + values[0].DataOffset, stringW, sizeof(stringW)), "wrong string data\n");
+    ok(values[1].Type == REG_DWORD, "got type %u\n", values[1].Type);
+    ok(values[1].DataLength == sizeof(data), "got length %u\n", values[1].DataLength);
+    ok(values[1].DataOffset + values[1].DataLength <= len, "got offset %u\n", values[1].DataOffset);
+    if (values[1].DataOffset + values[1].DataLength <= sizeof(buffer))
+        ok(*(DWORD *)(buffer + values[1].DataOffset) == data, "wrong dword data\n");
+
+    len = 0xdeadbeef;
+    status = pNtQueryMultipleValueKey(key, values, 2, buffer, sizeof(data), &len);
+    ok(status == STATUS_BUFFER_OVERFLOW, "NtQueryMultipleValueKey returned 0x%08x\n", status);
+    ok(len >= sizeof(stringW) + sizeof(data), "got length %u\n", len);
+
+    values[1].ValueName = &missing_name;
+    status = pNtQueryMultipleValueKey(key, values, 2, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "NtQueryMultipleValueKey returned 0x%08x\n", status);
+
+    pNtDeleteValueKey(key, &dword_name);
+    pNtDeleteValueKey(key, &string_name);
+    pNtClose(key);
+}
+
 static void test_NtDeleteKey(void)
 {
     NTSTATUS status;
@@ -2034,6 +2100,7 @@ START_TEST(reg)
     test_NtFlushKey();
     test_NtQueryKey();
     test_NtQueryLicenseKey();
+    test_NtQueryMultipleValueKey();
     test_NtQueryValueKey();
     test_long_value_name();
     test_notify();
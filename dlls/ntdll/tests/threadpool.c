@@ -585,6 +585,103 @@ static void test_tp_simple(void)
     CloseHandle(semaphore);
 }
 
+struct throughput_data
+{
+    LONG    count;
+    LONG    total;
+    DWORD   work;
+    HANDLE  done;
+};
+
+static void CALLBACK throughput_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct throughput_data *data = userdata;
+    volatile DWORD value = 0;
+    DWORD i;
+
+    for (i = 0; i < data->work; i++)
+        value += i;
+
+    if (InterlockedIncrement(&data->count) == data->total)
+        SetEvent(data->done);
+}
+
+static void test_tp_simple_throughput(void)
+{
+    static const struct
+    {
+        const char *name;
+        LONG        total;
+        DWORD       work;
+    }
+    tests[] =
+    {
+        { "tiny",   100000, 0 },
+        { "medium", 10000,  10000 },
+    };
+    struct throughput_data data;
+    TP_CALLBACK_ENVIRON environment;
+    TP_CLEANUP_GROUP *group;
+    DWORD result, ticks;
+    NTSTATUS status;
+    TP_POOL *pool;
+    int i, j, use_group;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    group = NULL;
+    status = pTpAllocCleanupGroup(&group);
+    ok(!status, "TpAllocCleanupGroup failed with status %x\n", status);
+    ok(group != NULL, "expected group != NULL\n");
+
+    data.done = CreateEventA(NULL, FALSE, FALSE, NULL);
+    ok(data.done != NULL, "CreateEventA failed %u\n", GetLastError());
+
+    /* Callbacks in a cleanup group have to be tracked for cancellation, so they
+     * go through the shared pool list, the others use the per-thread queues. */
+    for (i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        for (use_group = 0; use_group < 2; use_group++)
+        {
+            memset(&environment, 0, sizeof(environment));
+            environment.Version = 1;
+            environment.Pool = pool;
+            environment.CleanupGroup = use_group ? group : NULL;
+
+            /* only a quick check of the callback counts unless benchmarking */
+            data.count = 0;
+            data.total = winetest_interactive ? tests[i].total : tests[i].total / 100;
+            data.work  = tests[i].work;
+
+            ticks = GetTickCount();
+            for (j = 0; j < data.total; j++)
+            {
+                status = pTpSimpleTryPost(throughput_cb, &data, &environment);
+                if (status) break;
+            }
+            ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+            result = WaitForSingleObject(data.done, 30000);
+            ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+            ok(data.count == data.total, "expected %d callbacks, got %d\n", data.total, data.count);
+            ticks = GetTickCount() - ticks;
+
+            if (winetest_interactive)
+                trace("%s work items%s: %d callbacks in %u ms\n", tests[i].name,
+                      use_group ? " (cleanup group)" : "", data.total, ticks);
+
+            if (use_group) pTpReleaseCleanupGroupMembers(group, FALSE, NULL);
+        }
+    }
+
+    /* cleanup */
+    CloseHandle(data.done);
+    pTpReleaseCleanupGroup(group);
+    pTpReleasePool(pool);
+}
+
 static void CALLBACK work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
 {
     trace("Running work callback\n");
@@ -1413,6 +1510,119 @@ static void test_tp_timer(void)
     CloseHandle(semaphore);
 }
 
+struct timer_jitter_info
+{
+    LARGE_INTEGER last;
+    LONGLONG      max_jitter;
+    LONGLONG      total_jitter;
+    LONG          count;
+};
+
+static LARGE_INTEGER timer_jitter_period;
+
+static void CALLBACK timer_jitter_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_TIMER *timer)
+{
+    struct timer_jitter_info *info = userdata;
+    LARGE_INTEGER now;
+    LONGLONG jitter;
+
+    QueryPerformanceCounter(&now);
+    if (info->count++)
+    {
+        jitter = now.QuadPart - info->last.QuadPart - timer_jitter_period.QuadPart;
+        if (jitter < 0) jitter = -jitter;
+        info->total_jitter += jitter;
+        if (jitter > info->max_jitter) info->max_jitter = jitter;
+    }
+    info->last = now;
+}
+
+static void test_tp_timer_jitter(void)
+{
+    static const int num_timers = 10000, period = 100, duration = 1000;
+    LONGLONG max_jitter = 0, total_jitter = 0, count = 0;
+    FILETIME creation_time, exit_time, kernel_start, user_start, kernel_end, user_end;
+    struct timer_jitter_info *infos;
+    TP_CALLBACK_ENVIRON environment;
+    LARGE_INTEGER when, frequency;
+    ULONGLONG cpu_time;
+    TP_TIMER **timers;
+    NTSTATUS status;
+    TP_POOL *pool;
+    int i, missed = 0;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    QueryPerformanceFrequency(&frequency);
+    timer_jitter_period.QuadPart = frequency.QuadPart * period / 1000;
+
+    infos = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, num_timers * sizeof(*infos));
+    timers = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, num_timers * sizeof(*timers));
+    for (i = 0; i < num_timers; i++)
+    {
+        status = pTpAllocTimer(&timers[i], timer_jitter_cb, &infos[i], &environment);
+        ok(!status, "TpAllocTimer failed with status %x\n", status);
+        if (status) break;
+    }
+    if (i < num_timers)
+    {
+        while (i--) pTpReleaseTimer(timers[i]);
+        goto done;
+    }
+
+    GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_start, &user_start);
+
+    /* spread the first expiration over one period */
+    for (i = 0; i < num_timers; i++)
+    {
+        when.QuadPart = -(LONGLONG)(10 + i % period) * 10000;
+        pTpSetTimer(timers[i], &when, period, 0);
+    }
+
+    Sleep(duration);
+
+    for (i = 0; i < num_timers; i++)
+        pTpSetTimer(timers[i], NULL, 0, 0);
+    for (i = 0; i < num_timers; i++)
+    {
+        pTpWaitForTimer(timers[i], TRUE);
+        pTpReleaseTimer(timers[i]);
+    }
+
+    GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_end, &user_end);
+
+    for (i = 0; i < num_timers; i++)
+    {
+        if (!infos[i].count) missed++;
+        if (infos[i].count > 1) count += infos[i].count - 1;
+        total_jitter += infos[i].total_jitter;
+        if (infos[i].max_jitter > max_jitter) max_jitter = infos[i].max_jitter;
+    }
+    ok(!missed, "%d of %d timers never fired\n", missed, num_timers);
+
+    cpu_time = ((ULONGLONG)kernel_end.dwHighDateTime << 32 | kernel_end.dwLowDateTime) -
+               ((ULONGLONG)kernel_start.dwHighDateTime << 32 | kernel_start.dwLowDateTime) +
+               ((ULONGLONG)user_end.dwHighDateTime << 32 | user_end.dwLowDateTime) -
+               ((ULONGLONG)user_start.dwHighDateTime << 32 | user_start.dwLowDateTime);
+
+    trace("%d timers with %d ms period: %u intervals, average jitter %u us, maximum jitter %u us, cpu time %u ms\n",
+          num_timers, period, (DWORD)count,
+          count ? (DWORD)(total_jitter * 1000000 / frequency.QuadPart / count) : 0,
+          (DWORD)(max_jitter * 1000000 / frequency.QuadPart), (DWORD)(cpu_time / 10000));
+
+done:
+    HeapFree(GetProcessHeap(), 0, timers);
+    HeapFree(GetProcessHeap(), 0, infos);
+    pTpReleasePool(pool);
+}
+
 struct window_length_info
 {
     HANDLE semaphore;
@@ -1915,6 +2125,7 @@ START_TEST(threadpool)
         return;
 
     test_tp_simple();
+    test_tp_simple_throughput();
     test_tp_work();
     test_tp_work_scheduler();
     test_tp_group_wait();
@@ -1922,6 +2133,7 @@ START_TEST(threadpool)
     test_tp_instance();
     test_tp_disassociate();
     test_tp_timer();
+    if (winetest_interactive) test_tp_timer_jitter();
     test_tp_window_length();
     test_tp_wait();
     test_tp_multi_wait();
@@ -84,17 +84,35 @@ struct wait_work_item
     int CallbackInProgress;
 };
 
+/* Timers of the legacy timer queues and the threadpool timers share one
+ * hierarchical timer wheel, which is serviced by a single thread. Level 0
+ * has one slot per millisecond, each slot of level n covers a full turn of
+ * level n - 1, and timers are moved down one level when the lower level
+ * wraps around. Everything is locked via timerqueue.cs. */
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS  6
+
+struct timer_wheel_entry
+{
+    struct list entry;
+    ULONGLONG expire;           /* expiration time in ms, EXPIRE_NEVER if not queued */
+    ULONG window;               /* tolerable delay in ms, used to coalesce wakeups */
+    /* called from the timer thread with timerqueue.cs held */
+    void (*callback)( struct timer_wheel_entry *entry, ULONGLONG expire, ULONGLONG now );
+};
+
 struct timer_queue;
 struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct timer_wheel_entry wheel;
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
     DWORD period;
     ULONG flags;
-    ULONGLONG expire;
     BOOL destroy;               /* timer should be deleted; once set, never unset */
     HANDLE event;               /* removal event */
 };
@@ -102,11 +120,9 @@ struct queue_timer
 struct timer_queue
 {
     DWORD magic;
-    RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* locked via timerqueue.cs */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
-    HANDLE event;
-    HANDLE thread;
+    HANDLE event;               /* signaled when the last timer of a deleted queue is gone */
 };
 
 /*
@@ -114,8 +130,19 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_MAX_QUEUES 64
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
+/* Local work queue. Simple callbacks without a cleanup group are queued
+ * round-robin to one of these instead of the pool list, so that submitting
+ * and executing them doesn't require the pool lock. Each worker thread
+ * drains its own queue first and steals from the others when it is empty. */
+struct threadpool_queue
+{
+    RTL_SRWLOCK             lock;
+    struct list             items;
+};
+
 /* internal threadpool representation */
 struct threadpool
 {
@@ -125,12 +152,20 @@ struct threadpool
     CRITICAL_SECTION        cs;
     /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
     struct list             pools[3];
+    LONG                    num_pooled;
     RTL_CONDITION_VARIABLE  update_event;
-    /* information about worker threads, locked via .cs */
+    /* information about worker threads, locked via .cs, the counters are
+     * also updated with interlocked operations and may be read without lock */
     int                     max_workers;
     int                     min_workers;
     int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_busy_workers;
+    LONG                    num_idle_workers;
+    /* local work queues, see struct threadpool_queue */
+    LONG                    num_queued;
+    LONG                    next_queue;
+    unsigned int            num_queues;
+    struct threadpool_queue queues[1];
 };
 
 enum threadpool_objtype
@@ -182,12 +217,9 @@ struct threadpool_object
             PTP_TIMER_CALLBACK callback;
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
-            BOOL            timer_pending;
-            struct list     timer_entry;
+            struct timer_wheel_entry timer_entry;
             BOOL            timer_set;
-            ULONGLONG       timeout;
             LONG            period;
-            LONG            window_length;
         } timer;
         struct
         {
@@ -239,16 +271,20 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
     RTL_CONDITION_VARIABLE  update_event;
+    /* timer wheel, see struct timer_wheel_entry */
+    ULONGLONG               time;
+    ULONGLONG               wakeup;
+    struct list             slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
 }
 timerqueue =
 {
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
-    RTL_CONDITION_VARIABLE_INIT                 /* update_event */
+    RTL_CONDITION_VARIABLE_INIT,                /* update_event */
+    0,                                          /* time */
+    EXPIRE_NEVER,                               /* wakeup */
 };
 
 static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug =
@@ -709,212 +745,412 @@ NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
 }
 
 
-/************************** Timer Queue Impl **************************/
+/************************** Timer Wheel **************************/
 
-static void queue_remove_timer(struct queue_timer *t)
+static inline ULONGLONG queue_current_time(void)
 {
-    /* We MUST hold the queue cs while calling this function.  This ensures
-       that we cannot queue another callback for this timer.  The runcount
-       being zero makes sure we don't have any already queued.  */
-    struct timer_queue *q = t->q;
-
-    assert(t->runcount == 0);
-    assert(t->destroy);
-
-    list_remove(&t->entry);
-    if (t->event)
-        NtSetEvent(t->event, NULL);
-    RtlFreeHeap(GetProcessHeap(), 0, t);
-
-    if (q->quit && list_empty(&q->timers))
-        NtSetEvent(q->event, NULL);
+    LARGE_INTEGER now, freq;
+    NtQueryPerformanceCounter(&now, &freq);
+    return now.QuadPart * 1000 / freq.QuadPart;
 }
 
-static void timer_cleanup_callback(struct queue_timer *t)
+/***********************************************************************
+ *           timer_wheel_slot    (internal)
+ *
+ * Returns the slot of the timer wheel for a given expiration time. Timers
+ * which already expired are put into the current slot, timers beyond the
+ * range of the wheel into the last slot, which will be rehashed when it
+ * is reached.
+ */
+static struct list *timer_wheel_slot( ULONGLONG expire )
 {
-    struct timer_queue *q = t->q;
-    RtlEnterCriticalSection(&q->cs);
+    ULONGLONG delta = expire > timerqueue.time ? expire - timerqueue.time : 0;
+    unsigned int level = 0;
 
-    assert(0 < t->runcount);
-    --t->runcount;
+    if (!delta)
+        expire = timerqueue.time;
+    else if (delta >> (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+        expire = timerqueue.time + ((ULONGLONG)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
 
-    if (t->destroy && t->runcount == 0)
-        queue_remove_timer(t);
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >> (TIMER_WHEEL_BITS * (level + 1)))
+        level++;
 
-    RtlLeaveCriticalSection(&q->cs);
+    return &timerqueue.slots[level][(expire >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
 }
 
-static DWORD WINAPI timer_callback_wrapper(LPVOID p)
+/***********************************************************************
+ *           timer_wheel_insert    (internal)
+ */
+static void timer_wheel_insert( struct timer_wheel_entry *entry, ULONGLONG expire )
 {
-    struct queue_timer *t = p;
-    t->callback(t->param, TRUE);
-    timer_cleanup_callback(t);
-    return 0;
+    assert( entry->expire == EXPIRE_NEVER );
+
+    entry->expire = expire;
+    list_add_tail( timer_wheel_slot( expire ), &entry->entry );
+
+    /* Wake up the timer thread when the timeout has to be updated. */
+    if (expire < timerqueue.wakeup)
+        RtlWakeAllConditionVariable( &timerqueue.update_event );
 }
 
-static inline ULONGLONG queue_current_time(void)
+/***********************************************************************
+ *           timer_wheel_remove    (internal)
+ */
+static void timer_wheel_remove( struct timer_wheel_entry *entry )
 {
-    LARGE_INTEGER now, freq;
-    NtQueryPerformanceCounter(&now, &freq);
-    return now.QuadPart * 1000 / freq.QuadPart;
+    if (entry->expire == EXPIRE_NEVER)
+        return;
+
+    list_remove( &entry->entry );
+    entry->expire = EXPIRE_NEVER;
 }
 
-static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
-                            BOOL set_event)
+/***********************************************************************
+ *           timer_wheel_advance    (internal)
+ *
+ * Advances the timer wheel up to the current time and moves all expired
+ * timers to a list.
+ */
+static void timer_wheel_advance( ULONGLONG now, struct list *expired )
 {
-    /* We MUST hold the queue cs while calling this function.  */
-    struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
+    struct timer_wheel_entry *entry, *next;
+    unsigned int level, index, shift;
+    struct list cascade;
 
-    assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
-
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
+    while (timerqueue.time <= now)
+    {
+        /* Move timers of the next slot of the higher levels down when the
+         * lower level wraps around. */
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
         {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
+            shift = TIMER_WHEEL_BITS * level;
+            if (timerqueue.time & (((ULONGLONG)1 << shift) - 1))
                 break;
-        }
-    list_add_before(ptr, &t->entry);
 
-    t->expire = time;
+            list_init( &cascade );
+            list_move_tail( &cascade, &timerqueue.slots[level][(timerqueue.time >> shift) & (TIMER_WHEEL_SLOTS - 1)] );
+            LIST_FOR_EACH_ENTRY_SAFE( entry, next, &cascade, struct timer_wheel_entry, entry )
+            {
+                list_remove( &entry->entry );
+                list_add_tail( timer_wheel_slot( entry->expire ), &entry->entry );
+            }
+        }
 
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
-        NtSetEvent(q->event, NULL);
-}
+        index = timerqueue.time & (TIMER_WHEEL_SLOTS - 1);
+        list_move_tail( expired, &timerqueue.slots[0][index] );
 
-static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
-                                    BOOL set_event)
-{
-    /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
-    queue_add_timer(t, time, set_event);
+        /* Skip empty slots, but not beyond the next wrap around. */
+        while (++index < TIMER_WHEEL_SLOTS && list_empty( &timerqueue.slots[0][index] ));
+        timerqueue.time = min( (timerqueue.time & ~(ULONGLONG)(TIMER_WHEEL_SLOTS - 1)) + index, now + 1 );
+    }
 }
 
-static void queue_timer_expire(struct timer_queue *q)
+/***********************************************************************
+ *           timer_wheel_find    (internal)
+ *
+ * Finds the earliest expiration time in [from, to) and the smallest
+ * window length of the timers which expire at this time.
+ */
+static BOOL timer_wheel_find( ULONGLONG from, ULONGLONG to, ULONGLONG *expire, ULONG *window )
 {
-    struct queue_timer *t = NULL;
+    struct timer_wheel_entry *entry;
+    unsigned int level, shift, count, i;
+    ULONGLONG first, last;
+    BOOL found = FALSE;
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        shift = TIMER_WHEEL_BITS * level;
+        first = max( from, timerqueue.time ) >> shift;
+        last  = (to - 1) >> shift;
+        if (first > last) continue;
+
+        count = min( last - first + 1, TIMER_WHEEL_SLOTS );
+        for (i = 0; i < count; i++)
         {
-            ++t->runcount;
-            if (t->period)
+            LIST_FOR_EACH_ENTRY( entry, &timerqueue.slots[level][(first + i) & (TIMER_WHEEL_SLOTS - 1)],
+                                 struct timer_wheel_entry, entry )
             {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
+                if (entry->expire < from || entry->expire >= to)
+                    continue;
+
+                if (!found || entry->expire < *expire)
+                {
+                    *expire = entry->expire;
+                    *window = entry->window;
+                    found = TRUE;
+                }
+                else if (entry->expire == *expire)
+                    *window = min( *window, entry->window );
             }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
         }
-        else
-            t = NULL;
     }
-    RtlLeaveCriticalSection(&q->cs);
 
-    if (t)
-    {
-        if (t->flags & WT_EXECUTEINTIMERTHREAD)
-            timer_callback_wrapper(t);
-        else
-        {
-            ULONG flags
-                = (t->flags
-                   & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
-                      | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
-            NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
-            if (status != STATUS_SUCCESS)
-                timer_cleanup_callback(t);
-        }
-    }
+    return found;
 }
 
-static ULONG queue_get_timeout(struct timer_queue *q)
+/***********************************************************************
+ *           timer_wheel_next_wakeup    (internal)
+ *
+ * Determines when the timer thread has to wake up next. This is either
+ * when the next slot of level 0 with timers is reached, possibly delayed
+ * within the window length of the timers to process several at once, or
+ * when timers of a higher level have to be moved down.
+ */
+static ULONGLONG timer_wheel_next_wakeup(void)
 {
-    struct queue_timer *t;
-    ULONG timeout = INFINITE;
+    ULONGLONG next = EXPIRE_NEVER, lower = EXPIRE_NEVER, upper, expire;
+    unsigned int level, shift, index, i;
+    ULONG window;
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    index = timerqueue.time & (TIMER_WHEEL_SLOTS - 1);
+    for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
+        if (list_empty( &timerqueue.slots[0][(index + i) & (TIMER_WHEEL_SLOTS - 1)] )) continue;
+        next = lower = timerqueue.time + i;
+        break;
+    }
 
-        if (t->expire != EXPIRE_NEVER)
+    /* The current slot of a higher level was already moved down, unless
+     * the lower level is just about to wrap around. */
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        shift = TIMER_WHEEL_BITS * level;
+        index = (timerqueue.time >> shift) & (TIMER_WHEEL_SLOTS - 1);
+        for (i = (timerqueue.time & (((ULONGLONG)1 << shift) - 1)) ? 1 : 0; i <= TIMER_WHEEL_SLOTS; i++)
         {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
+            if (list_empty( &timerqueue.slots[level][(index + i) & (TIMER_WHEEL_SLOTS - 1)] )) continue;
+            next = min( next, ((timerqueue.time >> shift) + i) << shift );
+            break;
         }
     }
-    RtlLeaveCriticalSection(&q->cs);
 
-    return timeout;
+    /* Use the window length to optimize wakeup times. */
+    if (next != lower || !timer_wheel_find( lower, lower + 1, &expire, &window ))
+        return next;
+
+    upper = lower + window;
+    for (i = 0; i < TIMER_WHEEL_SLOTS && timer_wheel_find( lower + 1, upper, &expire, &window ); i++)
+    {
+        lower = expire;
+        upper = min( upper, expire + window );
+    }
+
+    return lower;
 }
 
-static void WINAPI timer_queue_thread_proc(LPVOID p)
+/***********************************************************************
+ *           timerqueue_thread_proc    (internal)
+ */
+static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    struct timer_queue *q = p;
-    ULONG timeout_ms;
+    struct timer_wheel_entry *entry;
+    struct list expired, *ptr;
+    LARGE_INTEGER timeout;
+    ULONGLONG now, expire;
+
+    TRACE( "starting timer queue thread\n" );
 
-    timeout_ms = INFINITE;
+    RtlEnterCriticalSection( &timerqueue.cs );
     for (;;)
     {
-        LARGE_INTEGER timeout;
-        NTSTATUS status;
-        BOOL done = FALSE;
+        timerqueue.wakeup = 0;
 
-        status = NtWaitForSingleObject(
-            q->event, FALSE, get_nt_timeout(&timeout, timeout_ms));
+        /* Check for expired timers. Callbacks may release the lock temporarily,
+         * timers which are removed in the meantime are also removed from the list. */
+        now = queue_current_time();
+        list_init( &expired );
+        timer_wheel_advance( now, &expired );
 
-        if (status == STATUS_WAIT_0)
+        while ((ptr = list_head( &expired )))
         {
-            /* There are two possible ways to trigger the event.  Either
-               we are quitting and the last timer got removed, or a new
-               timer got put at the head of the list so we need to adjust
-               our timeout.  */
-            RtlEnterCriticalSection(&q->cs);
-            if (q->quit && list_empty(&q->timers))
-                done = TRUE;
-            RtlLeaveCriticalSection(&q->cs);
+            entry = LIST_ENTRY( ptr, struct timer_wheel_entry, entry );
+            expire = entry->expire;
+            list_remove( &entry->entry );
+            entry->expire = EXPIRE_NEVER;
+            entry->callback( entry, expire, now );
         }
-        else if (status == STATUS_TIMEOUT)
-            queue_timer_expire(q);
 
-        if (done)
+        /* Wait for timer update events or until the next timer expires. */
+        if (timerqueue.objcount)
+        {
+            timerqueue.wakeup = timer_wheel_next_wakeup();
+            now = queue_current_time();
+            if (timerqueue.wakeup == EXPIRE_NEVER)
+                RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, NULL );
+            else if (timerqueue.wakeup > now)
+            {
+                timeout.QuadPart = -(LONGLONG)(timerqueue.wakeup - now) * 10000;
+                RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
+            }
+            continue;
+        }
+
+        /* All timers have been destroyed, if no new timers are created
+         * within some amount of time, then we can shutdown this thread. */
+        timerqueue.wakeup = EXPIRE_NEVER;
+        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+        if (RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs,
+            &timeout ) == STATUS_TIMEOUT && !timerqueue.objcount)
+        {
             break;
+        }
+    }
+
+    timerqueue.thread_running = FALSE;
+    RtlLeaveCriticalSection( &timerqueue.cs );
+
+    TRACE( "terminating timer queue thread\n" );
+    RtlExitUserThread( 0 );
+}
+
+/***********************************************************************
+ *           timerqueue_acquire    (internal)
+ *
+ * Accounts a new timer and makes sure that the timer thread is running.
+ * Has to be called with timerqueue.cs held.
+ */
+static NTSTATUS timerqueue_acquire(void)
+{
+    unsigned int level, i;
+    NTSTATUS status;
+    HANDLE thread;
+
+    if (!timerqueue.thread_running)
+    {
+        /* The timer wheel is always empty when the thread is not running. */
+        assert( !timerqueue.objcount );
+        timerqueue.time = queue_current_time();
+        for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+            for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+                list_init( &timerqueue.slots[level][i] );
+
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      timerqueue_thread_proc, NULL, &thread, NULL );
+        if (status != STATUS_SUCCESS)
+            return status;
 
-        timeout_ms = queue_get_timeout(q);
+        timerqueue.thread_running = TRUE;
+        NtClose( thread );
     }
 
-    NtClose(q->event);
-    RtlDeleteCriticalSection(&q->cs);
+    timerqueue.objcount++;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           timerqueue_release    (internal)
+ *
+ * Releases a timer accounted with timerqueue_acquire.
+ * Has to be called with timerqueue.cs held.
+ */
+static void timerqueue_release(void)
+{
+    /* If the last timer object was destroyed, then wake up the thread. */
+    if (!--timerqueue.objcount)
+        RtlWakeAllConditionVariable( &timerqueue.update_event );
+}
+
+
+/************************** Timer Queue Impl **************************/
+
+static void queue_destroy(struct timer_queue *q)
+{
+    /* We MUST hold the timerqueue cs while calling this function.  */
+    if (q->event)
+        NtSetEvent(q->event, NULL);
     q->magic = 0;
     RtlFreeHeap(GetProcessHeap(), 0, q);
-    RtlExitUserThread( 0 );
+}
+
+static void queue_remove_timer(struct queue_timer *t)
+{
+    /* We MUST hold the timerqueue cs while calling this function.  This
+       ensures that we cannot queue another callback for this timer.  The
+       runcount being zero makes sure we don't have any already queued.  */
+    struct timer_queue *q = t->q;
+
+    assert(t->runcount == 0);
+    assert(t->destroy);
+    assert(t->wheel.expire == EXPIRE_NEVER);
+
+    list_remove(&t->entry);
+    if (t->event)
+        NtSetEvent(t->event, NULL);
+    RtlFreeHeap(GetProcessHeap(), 0, t);
+    timerqueue_release();
+
+    if (q->quit && list_empty(&q->timers))
+        queue_destroy(q);
+}
+
+static void timer_cleanup_callback(struct queue_timer *t)
+{
+    RtlEnterCriticalSection(&timerqueue.cs);
+
+    assert(0 < t->runcount);
+    --t->runcount;
+
+    if (t->destroy && t->runcount == 0)
+        queue_remove_timer(t);
+
+    RtlLeaveCriticalSection(&timerqueue.cs);
+}
+
+static DWORD WINAPI timer_callback_wrapper(LPVOID p)
+{
+    struct queue_timer *t = p;
+    t->callback(t->param, TRUE);
+    timer_cleanup_callback(t);
+    return 0;
+}
+
+static void queue_timer_expired(struct timer_wheel_entry *entry, ULONGLONG expire,
+                                ULONGLONG now)
+{
+    /* Called from the timer thread with the timerqueue cs held.  */
+    struct queue_timer *t = CONTAINING_RECORD(entry, struct queue_timer, wheel);
+    ULONGLONG next;
+
+    assert(!t->destroy);
+    ++t->runcount;
+    if (t->period)
+    {
+        next = expire + t->period;
+        /* avoid trigger cascade if overloaded / hibernated */
+        if (next < now)
+            next = now + t->period;
+        timer_wheel_insert(&t->wheel, next);
+    }
+
+    if (t->flags & WT_EXECUTEINTIMERTHREAD)
+    {
+        RtlLeaveCriticalSection(&timerqueue.cs);
+        timer_callback_wrapper(t);
+        RtlEnterCriticalSection(&timerqueue.cs);
+    }
+    else
+    {
+        ULONG flags
+            = (t->flags
+               & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
+                  | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
+        NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
+        if (status != STATUS_SUCCESS)
+            timer_cleanup_callback(t);
+    }
 }
 
 static void queue_destroy_timer(struct queue_timer *t)
 {
-    /* We MUST hold the queue cs while calling this function.  */
+    /* We MUST hold the timerqueue cs while calling this function.  */
     t->destroy = TRUE;
+    timer_wheel_remove(&t->wheel);
     if (t->runcount == 0)
         /* Ensure a timer is promptly removed.  If callbacks are pending,
            it will be removed after the last one finishes by the callback
            cleanup wrapper.  */
         queue_remove_timer(t);
-    else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
-        queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
 /***********************************************************************
@@ -931,29 +1167,14 @@ static void queue_destroy_timer(struct queue_timer *t)
  */
 NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 {
-    NTSTATUS status;
     struct timer_queue *q = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *q);
     if (!q)
         return STATUS_NO_MEMORY;
 
-    RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
-    status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
-    if (status != STATUS_SUCCESS)
-    {
-        RtlFreeHeap(GetProcessHeap(), 0, q);
-        return status;
-    }
-    status = RtlCreateUserThread(GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                 timer_queue_thread_proc, q, &q->thread, NULL);
-    if (status != STATUS_SUCCESS)
-    {
-        NtClose(q->event);
-        RtlFreeHeap(GetProcessHeap(), 0, q);
-        return status;
-    }
+    q->event = NULL;
 
     *NewTimerQueue = q;
     return STATUS_SUCCESS;
@@ -979,44 +1200,38 @@ NTSTATUS WINAPI RtlDeleteTimerQueueEx(HANDLE TimerQueue, HANDLE CompletionEvent)
 {
     struct timer_queue *q = TimerQueue;
     struct queue_timer *t, *temp;
-    HANDLE thread;
+    HANDLE event = CompletionEvent;
     NTSTATUS status;
 
     if (!q || q->magic != TIMER_QUEUE_MAGIC)
         return STATUS_INVALID_HANDLE;
 
-    thread = q->thread;
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    {
+        status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+        if (status != STATUS_SUCCESS)
+            return status;
+    }
 
-    RtlEnterCriticalSection(&q->cs);
+    RtlEnterCriticalSection(&timerqueue.cs);
+    LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
+        queue_destroy_timer(t);
     q->quit = TRUE;
-    if (list_head(&q->timers))
-        /* When the last timer is removed, it will signal the timer thread to
-           exit...  */
-        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
-            queue_destroy_timer(t);
-    else
-        /* However if we have none, we must do it ourselves.  */
-        NtSetEvent(q->event, NULL);
-    RtlLeaveCriticalSection(&q->cs);
+    q->event = event;
+    if (list_empty(&q->timers))
+        queue_destroy(q);
+    /* Otherwise the queue is destroyed when the last timer is removed
+       after its pending callbacks finished.  */
+    RtlLeaveCriticalSection(&timerqueue.cs);
 
     if (CompletionEvent == INVALID_HANDLE_VALUE)
     {
-        NtWaitForSingleObject(thread, FALSE, NULL);
-        status = STATUS_SUCCESS;
-    }
-    else
-    {
-        if (CompletionEvent)
-        {
-            FIXME("asynchronous return on completion event unimplemented\n");
-            NtWaitForSingleObject(thread, FALSE, NULL);
-            NtSetEvent(CompletionEvent, NULL);
-        }
-        status = STATUS_PENDING;
+        NtWaitForSingleObject(event, FALSE, NULL);
+        NtClose(event);
+        return STATUS_SUCCESS;
     }
 
-    NtClose(thread);
-    return status;
+    return STATUS_PENDING;
 }
 
 static struct timer_queue *get_timer_queue(HANDLE TimerQueue)
@@ -1086,6 +1301,9 @@ NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
         return STATUS_NO_MEMORY;
 
     t->q = q;
+    t->wheel.expire = EXPIRE_NEVER;
+    t->wheel.window = 0;
+    t->wheel.callback = queue_timer_expired;
     t->runcount = 0;
     t->callback = Callback;
     t->param = Parameter;
@@ -1094,13 +1312,15 @@ NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
     t->destroy = FALSE;
     t->event = NULL;
 
-    status = STATUS_SUCCESS;
-    RtlEnterCriticalSection(&q->cs);
+    RtlEnterCriticalSection(&timerqueue.cs);
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
-    else
-        queue_add_timer(t, queue_current_time() + DueTime, TRUE);
-    RtlLeaveCriticalSection(&q->cs);
+    else if (!(status = timerqueue_acquire()))
+    {
+        list_add_tail(&q->timers, &t->entry);
+        timer_wheel_insert(&t->wheel, queue_current_time() + DueTime);
+    }
+    RtlLeaveCriticalSection(&timerqueue.cs);
 
     if (status == STATUS_SUCCESS)
         *NewTimer = t;
@@ -1132,16 +1352,16 @@ NTSTATUS WINAPI RtlUpdateTimer(HANDLE TimerQueue, HANDLE Timer,
                                DWORD DueTime, DWORD Period)
 {
     struct queue_timer *t = Timer;
-    struct timer_queue *q = t->q;
 
-    RtlEnterCriticalSection(&q->cs);
+    RtlEnterCriticalSection(&timerqueue.cs);
     /* Can't change a timer if it was once-only or destroyed.  */
-    if (t->expire != EXPIRE_NEVER)
+    if (t->wheel.expire != EXPIRE_NEVER)
     {
         t->period = Period;
-        queue_move_timer(t, queue_current_time() + DueTime, TRUE);
+        timer_wheel_remove(&t->wheel);
+        timer_wheel_insert(&t->wheel, queue_current_time() + DueTime);
     }
-    RtlLeaveCriticalSection(&q->cs);
+    RtlLeaveCriticalSection(&timerqueue.cs);
 
     return STATUS_SUCCESS;
 }
@@ -1168,13 +1388,11 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
                                HANDLE CompletionEvent)
 {
     struct queue_timer *t = Timer;
-    struct timer_queue *q;
     NTSTATUS status = STATUS_PENDING;
     HANDLE event = NULL;
 
     if (!Timer)
         return STATUS_INVALID_PARAMETER_1;
-    q = t->q;
     if (CompletionEvent == INVALID_HANDLE_VALUE)
     {
         status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -1184,12 +1402,12 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     else if (CompletionEvent)
         event = CompletionEvent;
 
-    RtlEnterCriticalSection(&q->cs);
+    RtlEnterCriticalSection(&timerqueue.cs);
     t->event = event;
     if (t->runcount == 0 && event)
         status = STATUS_SUCCESS;
     queue_destroy_timer(t);
-    RtlLeaveCriticalSection(&q->cs);
+    RtlLeaveCriticalSection(&timerqueue.cs);
 
     if (CompletionEvent == INVALID_HANDLE_VALUE && event)
     {
@@ -1204,98 +1422,6 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
-/***********************************************************************
- *           timerqueue_thread_proc    (internal)
- */
-static void CALLBACK timerqueue_thread_proc( void *param )
-{
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
-    LARGE_INTEGER now, timeout;
-    struct list *ptr;
-
-    TRACE( "starting timer queue thread\n" );
-
-    RtlEnterCriticalSection( &timerqueue.cs );
-    for (;;)
-    {
-        NtQuerySystemTime( &now );
-
-        /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
-        {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
-            assert( timer->type == TP_OBJECT_TYPE_TIMER );
-            assert( timer->u.timer.timer_pending );
-            if (timer->u.timer.timeout > now.QuadPart)
-                break;
-
-            /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
-            timer->u.timer.timer_pending = FALSE;
-            tp_object_submit( timer, FALSE );
-
-            /* Insert the timer back into the queue, except it's marked for shutdown. */
-            if (timer->u.timer.period && !timer->shutdown)
-            {
-                timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
-                if (timer->u.timer.timeout <= now.QuadPart)
-                    timer->u.timer.timeout = now.QuadPart + 1;
-
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
-                timer->u.timer.timer_pending = TRUE;
-            }
-        }
-
-        timeout_lower = TIMEOUT_INFINITE;
-        timeout_upper = TIMEOUT_INFINITE;
-
-        /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
-        }
-
-        /* Wait for timer update events or until the next timer expires. */
-        if (timerqueue.objcount)
-        {
-            timeout.QuadPart = timeout_lower;
-            RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
-            continue;
-        }
-
-        /* All timers have been destroyed, if no new timers are created
-         * within some amount of time, then we can shutdown this thread. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs,
-            &timeout ) == STATUS_TIMEOUT && !timerqueue.objcount)
-        {
-            break;
-        }
-    }
-
-    timerqueue.thread_running = FALSE;
-    RtlLeaveCriticalSection( &timerqueue.cs );
-
-    TRACE( "terminating timer queue thread\n" );
-    RtlExitUserThread( 0 );
-}
-
 /***********************************************************************
  *           tp_new_worker_thread    (internal)
  *
@@ -1312,12 +1438,36 @@ static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
     {
         interlocked_inc( &pool->refcount );
         pool->num_workers++;
-        pool->num_busy_workers++;
+        interlocked_inc( &pool->num_busy_workers );
         NtClose( thread );
     }
     return status;
 }
 
+/***********************************************************************
+ *           tp_timer_expired    (internal)
+ *
+ * Called from the timer thread when a threadpool timer expires.
+ */
+static void tp_timer_expired( struct timer_wheel_entry *entry, ULONGLONG expire, ULONGLONG now )
+{
+    struct threadpool_object *timer = CONTAINING_RECORD( entry, struct threadpool_object, u.timer.timer_entry );
+    assert( timer->type == TP_OBJECT_TYPE_TIMER );
+
+    /* Queue a new callback in one of the worker threads. */
+    tp_object_submit( timer, FALSE );
+
+    /* Insert the timer back into the queue, except it's marked for shutdown. */
+    if (timer->u.timer.period && !timer->shutdown)
+    {
+        expire += timer->u.timer.period;
+        if (expire <= now)
+            expire = now + 1;
+
+        timer_wheel_insert( entry, expire );
+    }
+}
+
 /***********************************************************************
  *           tp_timerqueue_lock    (internal)
  *
@@ -1326,36 +1476,22 @@ static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
  */
 static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
 {
-    NTSTATUS status = STATUS_SUCCESS;
+    NTSTATUS status;
     assert( timer->type == TP_OBJECT_TYPE_TIMER );
 
     timer->u.timer.timer_initialized    = FALSE;
-    timer->u.timer.timer_pending        = FALSE;
     timer->u.timer.timer_set            = FALSE;
-    timer->u.timer.timeout              = 0;
     timer->u.timer.period               = 0;
-    timer->u.timer.window_length        = 0;
+    timer->u.timer.timer_entry.expire   = EXPIRE_NEVER;
+    timer->u.timer.timer_entry.window   = 0;
+    timer->u.timer.timer_entry.callback = tp_timer_expired;
 
     RtlEnterCriticalSection( &timerqueue.cs );
 
     /* Make sure that the timerqueue thread is running. */
-    if (!timerqueue.thread_running)
-    {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      timerqueue_thread_proc, NULL, &thread, NULL );
-        if (status == STATUS_SUCCESS)
-        {
-            timerqueue.thread_running = TRUE;
-            NtClose( thread );
-        }
-    }
-
+    status = timerqueue_acquire();
     if (status == STATUS_SUCCESS)
-    {
         timer->u.timer.timer_initialized = TRUE;
-        timerqueue.objcount++;
-    }
 
     RtlLeaveCriticalSection( &timerqueue.cs );
     return status;
@@ -1374,19 +1510,8 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
     if (timer->u.timer.timer_initialized)
     {
         /* If timer was pending, remove it. */
-        if (timer->u.timer.timer_pending)
-        {
-            list_remove( &timer->u.timer.timer_entry );
-            timer->u.timer.timer_pending = FALSE;
-        }
-
-        /* If the last timer object was destroyed, then wake up the thread. */
-        if (!--timerqueue.objcount)
-        {
-            assert( list_empty( &timerqueue.pending_timers ) );
-            RtlWakeAllConditionVariable( &timerqueue.update_event );
-        }
-
+        timer_wheel_remove( &timer->u.timer.timer_entry );
+        timerqueue_release();
         timer->u.timer.timer_initialized = FALSE;
     }
     RtlLeaveCriticalSection( &timerqueue.cs );
@@ -1648,10 +1773,12 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
  */
 static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 {
+    unsigned int num_queues = NtCurrentTeb()->Peb->NumberOfProcessors;
     struct threadpool *pool;
     unsigned int i;
 
-    pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
+    num_queues = max( 1, min( num_queues, THREADPOOL_MAX_QUEUES ) );
+    pool = RtlAllocateHeap( GetProcessHeap(), 0, FIELD_OFFSET( struct threadpool, queues[num_queues] ) );
     if (!pool)
         return STATUS_NO_MEMORY;
 
@@ -1664,12 +1791,23 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         list_init( &pool->pools[i] );
+    pool->num_pooled            = 0;
     RtlInitializeConditionVariable( &pool->update_event );
 
     pool->max_workers           = 500;
     pool->min_workers           = 0;
     pool->num_workers           = 0;
     pool->num_busy_workers      = 0;
+    pool->num_idle_workers      = 0;
+
+    pool->num_queued            = 0;
+    pool->next_queue            = 0;
+    pool->num_queues            = num_queues;
+    for (i = 0; i < num_queues; ++i)
+    {
+        RtlInitializeSRWLock( &pool->queues[i].lock );
+        list_init( &pool->queues[i].items );
+    }
 
     TRACE( "allocated threadpool %p\n", pool );
 
@@ -1710,6 +1848,8 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
     assert( !pool->objcount );
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         assert( list_empty( &pool->pools[i] ) );
+    for (i = 0; i < pool->num_queues; ++i)
+        assert( list_empty( &pool->queues[i].items ) );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1769,24 +1909,28 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
         pool = default_threadpool;
     }
 
-    RtlEnterCriticalSection( &pool->cs );
-
-    /* Make sure that the threadpool has at least one thread. */
-    if (!pool->num_workers)
-        status = tp_new_worker_thread( pool );
-
     /* Keep a reference, and increment objcount to ensure that the
-     * last thread doesn't terminate. */
-    if (status == STATUS_SUCCESS)
+     * last thread doesn't terminate. The last thread only terminates
+     * when objcount is zero, so while other objects exist there is
+     * always at least one thread and the lock can be skipped. */
+    interlocked_inc( &pool->refcount );
+    if (interlocked_inc( &pool->objcount ) == 1 || !pool->num_workers)
     {
-        interlocked_inc( &pool->refcount );
-        pool->objcount++;
-    }
+        RtlEnterCriticalSection( &pool->cs );
 
-    RtlLeaveCriticalSection( &pool->cs );
+        /* Make sure that the threadpool has at least one thread. */
+        if (!pool->num_workers)
+            status = tp_new_worker_thread( pool );
+
+        RtlLeaveCriticalSection( &pool->cs );
+    }
 
     if (status != STATUS_SUCCESS)
+    {
+        interlocked_dec( &pool->objcount );
+        tp_threadpool_release( pool );
         return status;
+    }
 
     *out = pool;
     return STATUS_SUCCESS;
@@ -1799,9 +1943,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
  */
 static void tp_threadpool_unlock( struct threadpool *pool )
 {
-    RtlEnterCriticalSection( &pool->cs );
-    pool->objcount--;
-    RtlLeaveCriticalSection( &pool->cs );
+    interlocked_dec( &pool->objcount );
     tp_threadpool_release( pool );
 }
 
@@ -1951,6 +2093,86 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 static void tp_object_prio_queue( struct threadpool_object *object )
 {
     list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
+    object->pool->num_pooled++;
+}
+
+static void tp_object_prio_dequeue( struct threadpool_object *object )
+{
+    list_remove( &object->pool_entry );
+    object->pool->num_pooled--;
+}
+
+/***********************************************************************
+ *           tp_object_queue_local    (internal)
+ *
+ * Queues a simple callback to one of the local work queues. Such objects
+ * are not part of a cleanup group, so they can neither be waited for nor
+ * cancelled, and the only state that has to be updated is the queue itself.
+ */
+static void tp_object_queue_local( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+    struct threadpool_queue *queue;
+
+    queue = &pool->queues[(ULONG)interlocked_xchg_add( &pool->next_queue, 1 ) % pool->num_queues];
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    list_add_tail( &queue->items, &object->pool_entry );
+    RtlReleaseSRWLockExclusive( &queue->lock );
+
+    /* Workers increment num_idle_workers and check num_queued again before
+     * going to sleep, so either they see the new item or we see them. */
+    interlocked_inc( &pool->num_queued );
+
+    if (*(volatile LONG *)&pool->num_idle_workers)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        RtlWakeConditionVariable( &pool->update_event );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+    else if (*(volatile LONG *)&pool->num_busy_workers >= pool->num_workers &&
+             pool->num_workers < pool->max_workers)
+    {
+        /* All threads are busy executing callbacks - start a new one. */
+        RtlEnterCriticalSection( &pool->cs );
+        if (pool->num_busy_workers >= pool->num_workers && !pool->num_idle_workers &&
+            pool->num_workers < pool->max_workers)
+            tp_new_worker_thread( pool );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+}
+
+/***********************************************************************
+ *           tp_object_dequeue_local    (internal)
+ *
+ * Takes the next item from the local work queue of a worker thread, or
+ * steals one from the other queues if it is empty.
+ */
+static struct threadpool_object *tp_object_dequeue_local( struct threadpool *pool, unsigned int home )
+{
+    struct threadpool_queue *queue;
+    struct list *ptr = NULL;
+    unsigned int i, pass;
+
+    /* In the first pass, skip other queues which are currently locked. */
+    for (pass = 0; pass < 2 && !ptr && *(volatile LONG *)&pool->num_queued; pass++)
+    {
+        for (i = 0; i < pool->num_queues && !ptr; i++)
+        {
+            queue = &pool->queues[(home + i) % pool->num_queues];
+            if (list_empty( &queue->items )) continue;
+
+            if (!i || pass) RtlAcquireSRWLockExclusive( &queue->lock );
+            else if (!RtlTryAcquireSRWLockExclusive( &queue->lock )) continue;
+
+            if ((ptr = list_head( &queue->items )))
+                list_remove( ptr );
+            RtlReleaseSRWLockExclusive( &queue->lock );
+        }
+    }
+
+    if (!ptr) return NULL;
+    interlocked_dec( &pool->num_queued );
+    return LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
 }
 
 /***********************************************************************
@@ -1967,6 +2189,15 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
+    /* Simple callbacks which can't be waited for or cancelled bypass the pool list. */
+    if (object->type == TP_OBJECT_TYPE_SIMPLE && !object->group &&
+        object->priority == TP_CALLBACK_PRIORITY_NORMAL)
+    {
+        interlocked_inc( &object->refcount );
+        tp_object_queue_local( object );
+        return;
+    }
+
     RtlEnterCriticalSection( &pool->cs );
 
     /* Start new worker threads if required. */
@@ -2008,7 +2239,7 @@ static void tp_object_cancel( struct threadpool_object *object )
     {
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
+        tp_object_prio_dequeue( object );
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
@@ -2112,33 +2343,167 @@ static struct list *threadpool_get_next_item( const struct threadpool *pool )
     return ptr;
 }
 
+/***********************************************************************
+ *           tp_object_execute    (internal)
+ *
+ * Executes a callback of a threadpool object, followed by the finalization
+ * callback and the cleanup tasks requested by the callback.
+ */
+static void tp_object_execute( struct threadpool_object *object, struct threadpool_instance *instance,
+                               BOOL associated, TP_WAIT_RESULT wait_result )
+{
+    TP_CALLBACK_INSTANCE *callback_instance = (TP_CALLBACK_INSTANCE *)instance;
+    NTSTATUS status;
+
+    /* Initialize threadpool instance struct. */
+    instance->object                    = object;
+    instance->threadid                  = GetCurrentThreadId();
+    instance->associated                = associated;
+    instance->may_run_long              = object->may_run_long;
+    instance->cleanup.critical_section  = NULL;
+    instance->cleanup.mutex             = NULL;
+    instance->cleanup.semaphore         = NULL;
+    instance->cleanup.semaphore_count   = 0;
+    instance->cleanup.event             = NULL;
+    instance->cleanup.library           = NULL;
+
+    switch (object->type)
+    {
+        case TP_OBJECT_TYPE_SIMPLE:
+        {
+            TRACE( "executing simple callback %p(%p, %p)\n",
+                   object->u.simple.callback, callback_instance, object->userdata );
+            object->u.simple.callback( callback_instance, object->userdata );
+            TRACE( "callback %p returned\n", object->u.simple.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_WORK:
+        {
+            TRACE( "executing work callback %p(%p, %p, %p)\n",
+                   object->u.work.callback, callback_instance, object->userdata, object );
+            object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
+            TRACE( "callback %p returned\n", object->u.work.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_TIMER:
+        {
+            TRACE( "executing timer callback %p(%p, %p, %p)\n",
+                   object->u.timer.callback, callback_instance, object->userdata, object );
+            object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
+            TRACE( "callback %p returned\n", object->u.timer.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_WAIT:
+        {
+            TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
+                   object->u.wait.callback, callback_instance, object->userdata, object, wait_result );
+            object->u.wait.callback( callback_instance, object->userdata, (TP_WAIT *)object, wait_result );
+            TRACE( "callback %p returned\n", object->u.wait.callback );
+            break;
+        }
+
+        default:
+            assert(0);
+            break;
+    }
+
+    /* Execute finalization callback. */
+    if (object->finalization_callback)
+    {
+        TRACE( "executing finalization callback %p(%p, %p)\n",
+               object->finalization_callback, callback_instance, object->userdata );
+        object->finalization_callback( callback_instance, object->userdata );
+        TRACE( "callback %p returned\n", object->finalization_callback );
+    }
+
+    /* Execute cleanup tasks. */
+    if (instance->cleanup.critical_section)
+    {
+        RtlLeaveCriticalSection( instance->cleanup.critical_section );
+    }
+    if (instance->cleanup.mutex)
+    {
+        status = NtReleaseMutant( instance->cleanup.mutex, NULL );
+        if (status != STATUS_SUCCESS) return;
+    }
+    if (instance->cleanup.semaphore)
+    {
+        status = NtReleaseSemaphore( instance->cleanup.semaphore, instance->cleanup.semaphore_count, NULL );
+        if (status != STATUS_SUCCESS) return;
+    }
+    if (instance->cleanup.event)
+    {
+        status = NtSetEvent( instance->cleanup.event, NULL );
+        if (status != STATUS_SUCCESS) return;
+    }
+    if (instance->cleanup.library)
+    {
+        LdrUnloadDll( instance->cleanup.library );
+    }
+}
+
+/***********************************************************************
+ *           threadpool_worker_grow    (internal)
+ *
+ * Adds workers based on the depth of the local work queues: idle workers
+ * are woken up while items are left, and new workers are started (up to
+ * the number of queues) when there are more items than workers.
+ */
+static void threadpool_worker_grow( struct threadpool *pool )
+{
+    LONG depth = *(volatile LONG *)&pool->num_queued;
+
+    if (!depth) return;
+    if (*(volatile LONG *)&pool->num_idle_workers)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        RtlWakeConditionVariable( &pool->update_event );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+    else if (depth > pool->num_workers && pool->num_workers < pool->num_queues &&
+             pool->num_workers < pool->max_workers)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        if (!pool->num_idle_workers && pool->num_workers < pool->num_queues &&
+            pool->num_workers < pool->max_workers)
+            tp_new_worker_thread( pool );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
 static void CALLBACK threadpool_worker_proc( void *param )
 {
-    TP_CALLBACK_INSTANCE *callback_instance;
+    struct threadpool_object *object;
     struct threadpool_instance instance;
     struct threadpool *pool = param;
     TP_WAIT_RESULT wait_result = 0;
     LARGE_INTEGER timeout;
+    unsigned int home;
     struct list *ptr;
     NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
+    home = (ULONG)interlocked_xchg_add( &pool->next_queue, 1 ) % pool->num_queues;
+
     RtlEnterCriticalSection( &pool->cs );
-    pool->num_busy_workers--;
+    interlocked_dec( &pool->num_busy_workers );
     for (;;)
     {
         while ((ptr = threadpool_get_next_item( pool )))
         {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+            object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
             assert( object->num_pending_callbacks > 0 );
 
             /* If further pending callbacks are queued, move the work item to
              * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
+            tp_object_prio_dequeue( object );
             if (--object->num_pending_callbacks)
                 tp_object_prio_queue( object );
 
@@ -2152,102 +2517,13 @@ static void CALLBACK threadpool_worker_proc( void *param )
             /* Leave critical section and do the actual callback. */
             object->num_associated_callbacks++;
             object->num_running_callbacks++;
-            pool->num_busy_workers++;
+            interlocked_inc( &pool->num_busy_workers );
             RtlLeaveCriticalSection( &pool->cs );
 
-            /* Initialize threadpool instance struct. */
-            callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
-            instance.object                     = object;
-            instance.threadid                   = GetCurrentThreadId();
-            instance.associated                 = TRUE;
-            instance.may_run_long               = object->may_run_long;
-            instance.cleanup.critical_section   = NULL;
-            instance.cleanup.mutex              = NULL;
-            instance.cleanup.semaphore          = NULL;
-            instance.cleanup.semaphore_count    = 0;
-            instance.cleanup.event              = NULL;
-            instance.cleanup.library            = NULL;
-
-            switch (object->type)
-            {
-                case TP_OBJECT_TYPE_SIMPLE:
-                {
-                    TRACE( "executing simple callback %p(%p, %p)\n",
-                           object->u.simple.callback, callback_instance, object->userdata );
-                    object->u.simple.callback( callback_instance, object->userdata );
-                    TRACE( "callback %p returned\n", object->u.simple.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_WORK:
-                {
-                    TRACE( "executing work callback %p(%p, %p, %p)\n",
-                           object->u.work.callback, callback_instance, object->userdata, object );
-                    object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
-                    TRACE( "callback %p returned\n", object->u.work.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_TIMER:
-                {
-                    TRACE( "executing timer callback %p(%p, %p, %p)\n",
-                           object->u.timer.callback, callback_instance, object->userdata, object );
-                    object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
-                    TRACE( "callback %p returned\n", object->u.timer.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_WAIT:
-                {
-                    TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
-                           object->u.wait.callback, callback_instance, object->userdata, object, wait_result );
-                    object->u.wait.callback( callback_instance, object->userdata, (TP_WAIT *)object, wait_result );
-                    TRACE( "callback %p returned\n", object->u.wait.callback );
-                    break;
-                }
-
-                default:
-                    assert(0);
-                    break;
-            }
+            tp_object_execute( object, &instance, TRUE, wait_result );
 
-            /* Execute finalization callback. */
-            if (object->finalization_callback)
-            {
-                TRACE( "executing finalization callback %p(%p, %p)\n",
-                       object->finalization_callback, callback_instance, object->userdata );
-                object->finalization_callback( callback_instance, object->userdata );
-                TRACE( "callback %p returned\n", object->finalization_callback );
-            }
-
-            /* Execute cleanup tasks. */
-            if (instance.cleanup.critical_section)
-            {
-                RtlLeaveCriticalSection( instance.cleanup.critical_section );
-            }
-            if (instance.cleanup.mutex)
-            {
-                status = NtReleaseMutant( instance.cleanup.mutex, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
-            }
-            if (instance.cleanup.semaphore)
-            {
-                status = NtReleaseSemaphore( instance.cleanup.semaphore, instance.cleanup.semaphore_count, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
-            }
-            if (instance.cleanup.event)
-            {
-                status = NtSetEvent( instance.cleanup.event, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
-            }
-            if (instance.cleanup.library)
-            {
-                LdrUnloadDll( instance.cleanup.library );
-            }
-
-        skip_cleanup:
             RtlEnterCriticalSection( &pool->cs );
-            pool->num_busy_workers--;
+            interlocked_dec( &pool->num_busy_workers );
 
             /* Simple callbacks are automatically shutdown after execution. */
             if (object->type == TP_OBJECT_TYPE_SIMPLE)
@@ -2270,19 +2546,54 @@ static void CALLBACK threadpool_worker_proc( void *param )
             tp_object_release( object );
         }
 
+        /* Process the local work queues without holding the pool lock. Items
+         * from the pool list are checked in between, so they don't starve. */
+        if (pool->num_queued)
+        {
+            RtlLeaveCriticalSection( &pool->cs );
+
+            while (!*(volatile LONG *)&pool->num_pooled &&
+                   (object = tp_object_dequeue_local( pool, home )))
+            {
+                threadpool_worker_grow( pool );
+
+                interlocked_inc( &pool->num_busy_workers );
+                tp_object_execute( object, &instance, FALSE, 0 );
+                interlocked_dec( &pool->num_busy_workers );
+
+                tp_object_prepare_shutdown( object );
+                object->shutdown = TRUE;
+                tp_object_release( object );
+            }
+
+            RtlEnterCriticalSection( &pool->cs );
+            continue;
+        }
+
         /* Shutdown worker thread if requested. */
         if (pool->shutdown)
             break;
 
+        /* Announce that this thread is about to sleep before checking the local
+         * queues a final time, see tp_object_queue_local. */
+        interlocked_inc( &pool->num_idle_workers );
+        if (*(volatile LONG *)&pool->num_queued)
+        {
+            interlocked_dec( &pool->num_idle_workers );
+            continue;
+        }
+
         /* Wait for new tasks or until the timeout expires. A thread only terminates
          * when no new tasks are available, and the number of threads can be
          * decreased without violating the min_workers limit. An exception is when
          * min_workers == 0, then objcount is used to detect if the last thread
          * can be terminated. */
         timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
-            (!pool->min_workers && !pool->objcount)))
+        status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+        interlocked_dec( &pool->num_idle_workers );
+
+        if (status == STATUS_TIMEOUT && !threadpool_get_next_item( pool ) && !pool->num_queued &&
+            (pool->num_workers > max( pool->min_workers, 1 ) || (!pool->min_workers && !pool->objcount)))
         {
             break;
         }
@@ -2785,9 +3096,9 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
-    ULONGLONG timestamp;
+    ULONGLONG timestamp, expire;
+    LARGE_INTEGER now;
 
     TRACE( "%p %p %u %u\n", timer, timeout, period, window_length );
 
@@ -2798,57 +3109,36 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
 
     /* Convert relative timeout to absolute timestamp and handle a timeout
      * of zero, which means that the timer is submitted immediately. */
+    NtQuerySystemTime( &now );
     if (timeout)
     {
         timestamp = timeout->QuadPart;
         if ((LONGLONG)timestamp < 0)
-        {
-            LARGE_INTEGER now;
-            NtQuerySystemTime( &now );
             timestamp = now.QuadPart - timestamp;
-        }
         else if (!timestamp)
         {
             if (!period)
                 timeout = NULL;
             else
-            {
-                LARGE_INTEGER now;
-                NtQuerySystemTime( &now );
                 timestamp = now.QuadPart + (ULONGLONG)period * 10000;
-            }
             submit_timer = TRUE;
         }
     }
 
     /* First remove existing timeout. */
-    if (this->u.timer.timer_pending)
-    {
-        list_remove( &this->u.timer.timer_entry );
-        this->u.timer.timer_pending = FALSE;
-    }
+    timer_wheel_remove( &this->u.timer.timer_entry );
 
-    /* If the timer was enabled, then add it back to the queue. */
+    /* If the timer was enabled, then add it back to the queue. The timer
+     * wheel uses the monotonic clock, so convert the absolute timestamp. */
     if (timeout)
     {
-        this->u.timer.timeout       = timestamp;
-        this->u.timer.period        = period;
-        this->u.timer.window_length = window_length;
-
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
-
-        /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
-            RtlWakeAllConditionVariable( &timerqueue.update_event );
+        expire = queue_current_time();
+        if (timestamp > now.QuadPart)
+            expire += (timestamp - now.QuadPart + 9999) / 10000;
 
-        this->u.timer.timer_pending = TRUE;
+        this->u.timer.period             = period;
+        this->u.timer.timer_entry.window = window_length;
+        timer_wheel_insert( &this->u.timer.timer_entry, expire );
     }
 
     RtlLeaveCriticalSection( &timerqueue.cs );
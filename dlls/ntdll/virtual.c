@@ -44,6 +44,15 @@
 #ifdef HAVE_SYS_SYSINFO_H
 # include <sys/sysinfo.h>
 #endif
+#ifdef HAVE_SYS_IOCTL_H
+# include <sys/ioctl.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#ifdef HAVE_LINUX_USERFAULTFD_H
+# include <linux/userfaultfd.h>
+#endif
 #ifdef HAVE_VALGRIND_VALGRIND_H
 # include <valgrind/valgrind.h>
 #endif
@@ -86,6 +95,52 @@ struct file_view
 #define VPROT_WRITEWATCH 0x40
 /* per-mapping protection flags */
 #define VPROT_SYSTEM     0x0200  /* system view (underlying mmap not under our control) */
+#define VPROT_KERNEL_WRITEWATCH 0x0400  /* write watches tracked by the kernel */
+
+#if defined(HAVE_LINUX_USERFAULTFD_H) && defined(__NR_userfaultfd) && defined(HAVE_SYS_IOCTL_H)
+#define USE_KERNEL_WRITEWATCH
+
+/* definitions from Linux 6.7, in case the headers are older than the kernel */
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#define UFFD_FEATURE_WP_ASYNC       (1 << 15)
+#endif
+#ifndef PAGEMAP_SCAN
+#define PAGE_IS_WRITTEN       (1 << 1)
+#define PM_SCAN_WP_MATCHING   (1 << 0)
+#define PM_SCAN_CHECK_WPASYNC (1 << 1)
+struct page_region
+{
+    ULONGLONG start;
+    ULONGLONG end;
+    ULONGLONG categories;
+};
+struct pm_scan_arg
+{
+    ULONGLONG size;
+    ULONGLONG flags;
+    ULONGLONG start;
+    ULONGLONG end;
+    ULONGLONG walk_end;
+    ULONGLONG vec;
+    ULONGLONG vec_len;
+    ULONGLONG max_pages;
+    ULONGLONG category_inverted;
+    ULONGLONG category_mask;
+    ULONGLONG category_anyof_mask;
+    ULONGLONG return_mask;
+};
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#endif
+
+static int uffd_fd = -1;     /* userfaultfd write-protecting the write watch views */
+static int pagemap_fd = -1;  /* /proc/self/pagemap, to find and reset the written pages */
+#endif
+
+static int use_kernel_writewatch = -1;  /* -1 means not checked yet */
 
 /* Conversion from VPROT_* to Win32 flags */
 static const BYTE VIRTUAL_Win32Flags[16] =
@@ -959,6 +1014,119 @@ static NTSTATUS set_protection( struct file_view *view, void *base, SIZE_T size,
 }
 
 
+/***********************************************************************
+ *           init_kernel_writewatch
+ *
+ * Check if the kernel can track write watches for us, using asynchronous
+ * userfaultfd write protection and the pagemap scan ioctl. This avoids taking
+ * a fault on the first write to every page.
+ * The csVirtual section must be held by caller.
+ */
+static BOOL init_kernel_writewatch(void)
+{
+#ifdef USE_KERNEL_WRITEWATCH
+    static const ULONGLONG features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+    struct uffdio_api api;
+    struct pm_scan_arg arg;
+
+    if (use_kernel_writewatch != -1) return use_kernel_writewatch;
+    use_kernel_writewatch = 0;
+
+    if ((uffd_fd = syscall( __NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY )) == -1)
+        goto failed;
+    memset( &api, 0, sizeof(api) );
+    api.api = UFFD_API;
+    api.features = features;
+    if (ioctl( uffd_fd, UFFDIO_API, &api ) == -1 || (api.features & features) != features) goto failed;
+
+    /* an empty scan fails if PAGEMAP_SCAN is not supported */
+    if ((pagemap_fd = open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC )) == -1) goto failed;
+    memset( &arg, 0, sizeof(arg) );
+    arg.size = sizeof(arg);
+    if (ioctl( pagemap_fd, PAGEMAP_SCAN, &arg ) == -1) goto failed;
+
+    TRACE( "using kernel write watches\n" );
+    use_kernel_writewatch = 1;
+    return TRUE;
+
+failed:
+    TRACE( "kernel write watches not supported (%s)\n", strerror(errno) );
+    if (uffd_fd != -1) close( uffd_fd );
+    if (pagemap_fd != -1) close( pagemap_fd );
+    uffd_fd = pagemap_fd = -1;
+#else
+    use_kernel_writewatch = 0;
+#endif
+    return FALSE;
+}
+
+
+#ifdef USE_KERNEL_WRITEWATCH
+
+/***********************************************************************
+ *           kernel_writewatch_scan
+ *
+ * Find the written pages in a range, and optionally write-protect them again.
+ * Returns the number of regions stored in the array.
+ */
+static int kernel_writewatch_scan( char *base, char *end, BOOL reset, struct page_region *regions,
+                                   size_t count, ULONG_PTR max_pages, char **walk_end )
+{
+    struct pm_scan_arg arg;
+    int ret;
+
+    memset( &arg, 0, sizeof(arg) );
+    arg.size = sizeof(arg);
+    arg.flags = PM_SCAN_CHECK_WPASYNC | (reset ? PM_SCAN_WP_MATCHING : 0);
+    arg.start = (UINT_PTR)base;
+    arg.end = (UINT_PTR)end;
+    arg.vec = (UINT_PTR)regions;
+    arg.vec_len = count;
+    arg.max_pages = max_pages;
+    arg.category_mask = PAGE_IS_WRITTEN;
+    arg.return_mask = regions ? PAGE_IS_WRITTEN : 0;
+    if ((ret = ioctl( pagemap_fd, PAGEMAP_SCAN, &arg )) == -1)
+    {
+        ERR( "scan of %p-%p failed: %s\n", base, end, strerror(errno) );
+        *walk_end = end;
+        return 0;
+    }
+    *walk_end = (char *)(UINT_PTR)arg.walk_end;
+    return ret;
+}
+
+#endif
+
+
+/***********************************************************************
+ *           kernel_writewatch_register
+ *
+ * Let the kernel track write watches for a range of a view.
+ * The csVirtual section must be held by caller.
+ */
+static BOOL kernel_writewatch_register( void *base, size_t size, BOOL reset )
+{
+#ifdef USE_KERNEL_WRITEWATCH
+    struct uffdio_register reg;
+    char *end;
+
+    reg.range.start = (UINT_PTR)base;
+    reg.range.len = size;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl( uffd_fd, UFFDIO_REGISTER, &reg ) == -1)
+    {
+        WARN( "failed to register %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+        return FALSE;
+    }
+    /* newly registered pages are reported as written until they are protected */
+    if (reset) kernel_writewatch_scan( base, (char *)base + size, TRUE, NULL, 0, 0, &end );
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+
 /***********************************************************************
  *           update_write_watches
  */
@@ -977,13 +1145,67 @@ static void update_write_watches( void *base, size_t size, size_t accessed_size
  *
  * Reset write watches in a memory range.
  */
-static void reset_write_watches( void *base, SIZE_T size )
+static void reset_write_watches( struct file_view *view, void *base, SIZE_T size )
 {
+#ifdef USE_KERNEL_WRITEWATCH
+    if (view->protect & VPROT_KERNEL_WRITEWATCH)
+    {
+        char *end;
+        kernel_writewatch_scan( base, (char *)base + size, TRUE, NULL, 0, 0, &end );
+        return;
+    }
+#endif
     set_page_vprot_bits( base, size, VPROT_WRITEWATCH, 0 );
     mprotect_range( base, size, 0, 0 );
 }
 
 
+/***********************************************************************
+ *           get_write_watches
+ *
+ * Retrieve the written pages of a write watch range, optionally resetting them.
+ * The csVirtual section must be held by caller.
+ */
+static void get_write_watches( struct file_view *view, char *base, char *end, void **addresses,
+                               ULONG_PTR *count, BOOL reset )
+{
+    ULONG_PTR pos = 0;
+    char *addr = base;
+
+#ifdef USE_KERNEL_WRITEWATCH
+    if (view->protect & VPROT_KERNEL_WRITEWATCH)
+    {
+        struct page_region regions[64];
+        UINT_PTR page;
+        char *walk_end;
+        int i, nb;
+
+        /* the kernel protects the pages again as it reports them, so no write can get lost */
+        while (pos < *count && addr < end)
+        {
+            nb = kernel_writewatch_scan( addr, end, reset, regions, ARRAY_SIZE(regions),
+                                         *count - pos, &walk_end );
+            for (i = 0; i < nb; i++)
+                for (page = regions[i].start; page < regions[i].end; page += page_size)
+                    addresses[pos++] = (void *)page;
+            if (walk_end <= addr) break;
+            addr = walk_end;
+        }
+        *count = pos;
+        return;
+    }
+#endif
+
+    while (pos < *count && addr < end)
+    {
+        if (!(get_page_vprot( addr ) & VPROT_WRITEWATCH)) addresses[pos++] = addr;
+        addr += page_size;
+    }
+    if (reset) reset_write_watches( view, base, addr - base );
+    *count = pos;
+}
+
+
 /***********************************************************************
  *           unmap_extra_space
  *
@@ -1282,6 +1504,45 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
 }
 
 
+#ifdef USE_KERNEL_WRITEWATCH
+/***********************************************************************
+ *           decommit_kernel_writewatch_pages
+ *
+ * Decommit some pages of a view whose write watches are tracked by the kernel.
+ * The new mapping needs to be registered again, preserving the written pages.
+ * The csVirtual section must be held by caller.
+ */
+static NTSTATUS decommit_kernel_writewatch_pages( struct file_view *view, size_t start, size_t size )
+{
+    struct page_region regions[64];
+    char *addr = (char *)view->base + start, *end = addr + size;
+    char *walk_end, *prev, *next, *dummy;
+    int i, nb;
+
+    while (addr < end)
+    {
+        nb = kernel_writewatch_scan( addr, end, FALSE, regions, ARRAY_SIZE(regions), 0, &walk_end );
+        if (walk_end <= addr) walk_end = end;
+        if (wine_anon_mmap( addr, walk_end - addr, PROT_NONE, MAP_FIXED ) == (void *)-1)
+            return FILE_GetNtStatus();
+        set_page_vprot_bits( addr, walk_end - addr, 0, VPROT_COMMITTED );
+
+        /* pages are reported as written until they are protected, so only protect
+         * the ones that were not written before */
+        kernel_writewatch_register( addr, walk_end - addr, FALSE );
+        for (i = 0, prev = addr; i <= nb; i++)
+        {
+            next = i < nb ? (char *)(UINT_PTR)regions[i].start : walk_end;
+            if (next > prev) kernel_writewatch_scan( prev, next, TRUE, NULL, 0, 0, &dummy );
+            if (i < nb) prev = (char *)(UINT_PTR)regions[i].end;
+        }
+        addr = walk_end;
+    }
+    return STATUS_SUCCESS;
+}
+#endif
+
+
 /***********************************************************************
  *           decommit_view
  *
@@ -1290,6 +1551,10 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
  */
 static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t size )
 {
+#ifdef USE_KERNEL_WRITEWATCH
+    if (view->protect & VPROT_KERNEL_WRITEWATCH)
+        return decommit_kernel_writewatch_pages( view, start, size );
+#endif
     if (wine_anon_mmap( (char *)view->base + start, size, PROT_NONE, MAP_FIXED ) != (void *)-1)
     {
         set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
@@ -1398,7 +1663,8 @@ static NTSTATUS map_pe_header( void *ptr, size_t size, int fd, BOOL *removable )
  * Map an executable (PE format) image into memory.
  */
 static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, int top_down, unsigned short zero_bits_64,
-                           pe_image_info_t *image_info, int shared_fd, BOOL removable, PVOID *addr_ptr )
+                           pe_image_info_t *image_info, int shared_fd, int layout_fd, BOOL removable,
+                           PVOID *addr_ptr )
 {
     IMAGE_DOS_HEADER *dos;
     IMAGE_NT_HEADERS *nt;
@@ -1556,14 +1822,34 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, int top_
 
         if (!sec->PointerToRawData || !file_size) continue;
 
-        /* Note: if the section is not aligned properly map_file_into_view will magically
-         *       fall back to read(), so we don't need to check anything here.
-         */
         end = file_start + file_size;
         if (sec->PointerToRawData >= st.st_size ||
             end > ((st.st_size + sector_align) & ~sector_align) ||
-            end < file_start ||
-            map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
+            end < file_start)
+        {
+            ERR_(module)( "Could not map section %.8s, file probably truncated\n", sec->Name );
+            goto error;
+        }
+
+        /* the server lays out sections with unaligned file offsets at their virtual address
+         * in a separate file, so that their pages can be shared with other processes */
+        if (layout_fd != -1 && (file_start & page_mask))
+        {
+            TRACE_(module)( "mapping section %.8s from image layout\n", sec->Name );
+            if (map_file_into_view( view, layout_fd, sec->VirtualAddress, file_size, sec->VirtualAddress,
+                                    VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
+                                    FALSE ) != STATUS_SUCCESS)
+            {
+                ERR_(module)( "Could not map section %.8s from image layout\n", sec->Name );
+                goto error;
+            }
+            continue;  /* the rest of the page is already zeroed */
+        }
+
+        /* Note: if the section is not aligned properly map_file_into_view will magically
+         *       fall back to read(), so we don't need to check anything here.
+         */
+        if (map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
                                 VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
                                 removable ) != STATUS_SUCCESS)
         {
@@ -1658,7 +1944,7 @@ NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, unsigned short zer
     int unix_handle = -1, needs_close;
     unsigned int vprot, sec_flags;
     struct file_view *view;
-    HANDLE shared_file;
+    HANDLE shared_file, layout_file;
     LARGE_INTEGER offset;
     sigset_t sigset;
 
@@ -1695,6 +1981,7 @@ NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, unsigned short zer
         sec_flags   = reply->flags;
         full_size   = reply->size;
         shared_file = wine_server_ptr_handle( reply->shared_file );
+        layout_file = wine_server_ptr_handle( reply->layout_file );
     }
     SERVER_END_REQ;
     if (res) return res;
@@ -1703,22 +1990,20 @@ NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, unsigned short zer
 
     if (sec_flags & SEC_IMAGE)
     {
-        if (shared_file)
-        {
-            int shared_fd, shared_needs_close;
+        int shared_fd = -1, shared_needs_close = 0, layout_fd = -1, layout_needs_close = 0;
 
-            if ((res = server_get_unix_fd( shared_file, FILE_READ_DATA|FILE_WRITE_DATA,
-                                           &shared_fd, &shared_needs_close, NULL, NULL ))) goto done;
-            res = map_image( handle, access, unix_handle, alloc_type & MEM_TOP_DOWN, zero_bits_64, image_info,
-                             shared_fd, needs_close, addr_ptr );
-            if (shared_needs_close) close( shared_fd );
-            close_handle( shared_file );
-        }
-        else
-        {
-            res = map_image( handle, access, unix_handle, alloc_type & MEM_TOP_DOWN, zero_bits_64, image_info,
-                             -1, needs_close, addr_ptr );
-        }
+        if (layout_file && server_get_unix_fd( layout_file, FILE_READ_DATA, &layout_fd,
+                                               &layout_needs_close, NULL, NULL ))
+            layout_fd = -1;  /* fall back to reading the sections */
+
+        if (!shared_file || !(res = server_get_unix_fd( shared_file, FILE_READ_DATA|FILE_WRITE_DATA,
+                                                        &shared_fd, &shared_needs_close, NULL, NULL )))
+            res = map_image( handle, access, unix_handle, alloc_type & MEM_TOP_DOWN, zero_bits_64,
+                             image_info, shared_fd, layout_fd, needs_close, addr_ptr );
+        if (shared_needs_close) close( shared_fd );
+        if (layout_needs_close) close( layout_fd );
+        if (shared_file) close_handle( shared_file );
+        if (layout_file) close_handle( layout_file );
         if (needs_close) close( unix_handle );
         if (res >= 0) *size_ptr = image_info->map_size;
         return res;
@@ -2217,6 +2502,28 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
 }
 
 
+/***********************************************************************
+ *           virtual_prepare_async_write
+ *
+ * Make a buffer writable for a write performed asynchronously by the kernel.
+ * Write watches can't be triggered by the write itself, so the whole range
+ * is marked as written beforehand.
+ */
+BOOL virtual_prepare_async_write( void *addr, size_t size )
+{
+    sigset_t sigset;
+    BOOL has_write_watch = FALSE, ret;
+
+    if (!size) return TRUE;
+
+    server_enter_uninterrupted_section( &csVirtual, &sigset );
+    ret = !check_write_access( addr, size, &has_write_watch );
+    if (ret && has_write_watch) update_write_watches( addr, size, size );
+    server_leave_uninterrupted_section( &csVirtual, &sigset );
+    return ret;
+}
+
+
 /***********************************************************************
  *           __wine_locked_recvmsg
  */
@@ -2659,6 +2966,15 @@ NTSTATUS virtual_alloc_aligned( PVOID *ret, unsigned short zero_bits_64, SIZE_T
             else status = map_view( &view, base, size, alignment, type & MEM_TOP_DOWN, vprot, zero_bits_64 );
 
             if (status == STATUS_SUCCESS) base = view->base;
+
+            if (!status && (vprot & VPROT_WRITEWATCH) && init_kernel_writewatch() &&
+                kernel_writewatch_register( view->base, view->size, TRUE ))
+            {
+                /* pages no longer need to be write-protected */
+                view->protect |= VPROT_KERNEL_WRITEWATCH;
+                set_page_vprot_bits( view->base, view->size, 0, VPROT_WRITEWATCH );
+                mprotect_range( view->base, view->size, 0, 0 );
+            }
         }
     }
     else if (type & MEM_RESET)
@@ -3443,6 +3759,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
 NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T size, PVOID *addresses,
                                  ULONG_PTR *count, ULONG *granularity )
 {
+    struct file_view *view;
     NTSTATUS status = STATUS_SUCCESS;
     sigset_t sigset;
 
@@ -3460,19 +3777,9 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
 
-    if (is_write_watch_range( base, size ))
+    if ((view = VIRTUAL_FindView( base, size )) && (view->protect & VPROT_WRITEWATCH))
     {
-        ULONG_PTR pos = 0;
-        char *addr = base;
-        char *end = addr + size;
-
-        while (pos < *count && addr < end)
-        {
-            if (!(get_page_vprot( addr ) & VPROT_WRITEWATCH)) addresses[pos++] = addr;
-            addr += page_size;
-        }
-        if (flags & WRITE_WATCH_FLAG_RESET) reset_write_watches( base, addr - (char *)base );
-        *count = pos;
+        get_write_watches( view, base, (char *)base + size, addresses, count, flags & WRITE_WATCH_FLAG_RESET );
         *granularity = page_size;
     }
     else status = STATUS_INVALID_PARAMETER;
@@ -3488,6 +3795,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
  */
 NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 {
+    struct file_view *view;
     NTSTATUS status = STATUS_SUCCESS;
     sigset_t sigset;
 
@@ -3500,8 +3808,8 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
 
-    if (is_write_watch_range( base, size ))
-        reset_write_watches( base, size );
+    if ((view = VIRTUAL_FindView( base, size )) && (view->protect & VPROT_WRITEWATCH))
+        reset_write_watches( view, base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
@@ -455,6 +455,7 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
  */
 DWORD WINAPI GetQueueStatus( UINT flags )
 {
+    const volatile struct queue_shm *shm;
     DWORD ret;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
@@ -465,6 +466,10 @@ DWORD WINAPI GetQueueStatus( UINT flags )
 
     check_for_events( flags );
 
+    /* nothing to clear, so the shared state can be used */
+    if ((shm = get_queue_shm( FALSE )) && !(shm->changed_bits & flags))
+        return MAKELONG( 0, shm->wake_bits & flags );
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
@@ -481,10 +486,13 @@ DWORD WINAPI GetQueueStatus( UINT flags )
  */
 BOOL WINAPI GetInputState(void)
 {
+    const volatile struct queue_shm *shm;
     DWORD ret;
 
     check_for_events( QS_INPUT );
 
+    if ((shm = get_queue_shm( FALSE ))) return shm->wake_bits & (QS_KEY | QS_MOUSEBUTTON);
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = 0;
@@ -2740,6 +2740,82 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+static const struct queue_shm *queue_shm_region;
+
+/***********************************************************************
+ *           get_queue_shm
+ *
+ * Return the state of the current thread queue in the region shared with the
+ * server, or NULL if it isn't available. The queue is only created if needed
+ * when the create flag is set.
+ */
+const volatile struct queue_shm *get_queue_shm( BOOL create )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    unsigned int index = ~0u;
+    HANDLE handle = 0;
+    void *ptr;
+
+    if (!thread_info->queue_shm_index)
+    {
+        if (!create) return NULL;
+
+        SERVER_START_REQ( get_queue_shm )
+        {
+            req->map = !queue_shm_region;
+            if (!wine_server_call( req ))
+            {
+                index  = reply->index;
+                handle = wine_server_ptr_handle( reply->handle );
+            }
+        }
+        SERVER_END_REQ;
+
+        if (handle)
+        {
+            if ((ptr = MapViewOfFile( handle, FILE_MAP_READ, 0, 0, 0 )) &&
+                InterlockedCompareExchangePointer( (void **)&queue_shm_region, ptr, NULL ))
+                UnmapViewOfFile( ptr );
+            CloseHandle( handle );
+        }
+        /* ~0u is used once we know that the state isn't available */
+        thread_info->queue_shm_index = (queue_shm_region && index != ~0u) ? index + 1 : ~0u;
+    }
+    if (thread_info->queue_shm_index == ~0u) return NULL;
+    return queue_shm_region + thread_info->queue_shm_index - 1;
+}
+
+/***********************************************************************
+ *           is_queue_idle
+ *
+ * Check from the shared queue state that a get_message request would neither
+ * return a message nor change the queue state, so that it can be skipped.
+ */
+static BOOL is_queue_idle( UINT first, UINT last, UINT flags, UINT changed_mask )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    const volatile struct queue_shm *shm;
+    UINT filter = flags >> 16, clear_bits = 0;
+
+    /* the server uses the get_message requests to detect hung applications */
+    if (GetTickCount() - thread_info->last_get_msg >= 1000) return FALSE;
+    if (!(shm = get_queue_shm( TRUE ))) return FALSE;
+
+    if (!filter) filter = QS_ALLINPUT;
+    if (filter & QS_POSTMESSAGE)
+    {
+        clear_bits |= QS_POSTMESSAGE | QS_HOTKEY | QS_TIMER;
+        if (first == 0 && last == ~0U) clear_bits |= QS_ALLPOSTMESSAGE;
+    }
+    if (filter & QS_INPUT) clear_bits |= QS_INPUT;
+    if (filter & QS_PAINT) clear_bits |= QS_PAINT;
+
+    return !(shm->wake_bits & (QS_ALLINPUT | QS_ALLPOSTMESSAGE)) &&
+           !(shm->changed_bits & clear_bits) &&
+           shm->wake_mask == (changed_mask & (QS_SENDMESSAGE | QS_SMRESULT)) &&
+           shm->changed_mask == changed_mask;
+}
+
 /***********************************************************************
  *           peek_message
  *
@@ -2757,11 +2833,18 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
     void *buffer;
     size_t buffer_size = 256;
 
-    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return -1;
-
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    if (!hwnd && is_queue_idle( first, last, flags, changed_mask ))
+    {
+        thread_info->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
+        thread_info->changed_mask = changed_mask;
+        return 0;
+    }
+
+    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return -1;
+
     for (;;)
     {
         NTSTATUS res;
@@ -2797,6 +2880,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
             else buffer_size = reply->total;
         }
         SERVER_END_REQ;
+        thread_info->last_get_msg = GetTickCount();
 
         if (res)
         {
@@ -12439,6 +12439,53 @@ static void test_PeekMessage3(void)
     flush_events();
 }
 
+static DWORD WINAPI post_thread_message_proc( void *arg )
+{
+    Sleep( 100 );
+    PostThreadMessageA( PtrToUlong(arg), WM_USER + 1, 0, 0 );
+    return 0;
+}
+
+static void test_PeekMessage_idle(void)
+{
+    DWORD start, count, status;
+    HANDLE thread;
+    BOOL ret;
+    MSG msg;
+
+    flush_events();
+
+    /* PeekMessage on an empty queue, only spin for a second when benchmarking */
+    start = GetTickCount();
+    for (count = 0; winetest_interactive ? GetTickCount() - start < 1000 : count < 100; count++)
+    {
+        ret = PeekMessageA( &msg, NULL, 0, 0, PM_REMOVE );
+        ok( !ret, "got message %04x\n", msg.message );
+        if (ret) break;
+    }
+    if (winetest_interactive)
+        trace( "%u PeekMessage calls per second on an empty queue\n", count );
+
+    status = GetQueueStatus( QS_ALLINPUT );
+    ok( !status, "got status %08x\n", status );
+
+    /* messages posted from another thread must be seen while polling */
+    thread = CreateThread( NULL, 0, post_thread_message_proc, ULongToPtr(GetCurrentThreadId()), 0, NULL );
+    start = GetTickCount();
+    while (!(ret = PeekMessageA( &msg, NULL, 0, 0, PM_NOREMOVE )) && GetTickCount() - start < 5000);
+    ok( ret && msg.message == WM_USER + 1, "got ret %d message %04x\n", ret, msg.message );
+    /* the changed bits have been cleared by PeekMessage */
+    status = GetQueueStatus( QS_POSTMESSAGE );
+    ok( status == MAKELONG( 0, QS_POSTMESSAGE ), "got status %08x\n", status );
+    ret = PeekMessageA( &msg, NULL, 0, 0, PM_REMOVE );
+    ok( ret && msg.message == WM_USER + 1, "got ret %d message %04x\n", ret, msg.message );
+    ret = PeekMessageA( &msg, NULL, 0, 0, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+}
+
 static INT_PTR CALLBACK wm_quit_dlg_proc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
 {
     struct recvd_message msg;
@@ -17797,6 +17844,7 @@ START_TEST(msg)
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_PeekMessage_idle();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
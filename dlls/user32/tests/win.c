@@ -11778,7 +11778,9 @@ static void other_process_proc(HWND hwnd)
 {
     HANDLE window_ready_event, test_done_event;
     WINDOWPLACEMENT wp;
-    DWORD ret;
+    DWORD ret, pid;
+    RECT rect;
+    LONG style;
 
     window_ready_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opw_window");
     ok(!!window_ready_event, "OpenEvent failed.\n");
@@ -11792,6 +11794,19 @@ static void other_process_proc(HWND hwnd)
     ok(ret, "Unexpected ret %#x.\n", ret);
     ok(wp.showCmd == SW_SHOWNORMAL, "Unexpected showCmd %#x.\n", wp.showCmd);
     ok(!wp.flags, "Unexpected flags %#x.\n", wp.flags);
+    ok(IsWindow(hwnd), "IsWindow failed.\n");
+    ok(IsWindow((HWND)(ULONG_PTR)LOWORD(hwnd)), "IsWindow failed for the truncated handle.\n");
+    ret = GetWindowThreadProcessId(hwnd, &pid);
+    ok(ret && ret != GetCurrentThreadId(), "Unexpected thread id %#x.\n", ret);
+    ok(pid && pid != GetCurrentProcessId(), "Unexpected process id %#x.\n", pid);
+    style = GetWindowLongA(hwnd, GWL_STYLE);
+    ok((style & (WS_POPUP | WS_VISIBLE)) == (WS_POPUP | WS_VISIBLE), "Unexpected style %#x.\n", style);
+    ok(GetAncestor(hwnd, GA_PARENT) == GetDesktopWindow(), "Unexpected parent %p.\n", GetAncestor(hwnd, GA_PARENT));
+    ok(GetAncestor(hwnd, GA_ROOT) == hwnd, "Unexpected root %p.\n", GetAncestor(hwnd, GA_ROOT));
+    ok(!GetParent(hwnd), "Unexpected parent %p.\n", GetParent(hwnd));
+    GetWindowRect(hwnd, &rect);
+    ok(rect.left == 100 && rect.top == 100 && rect.right == 200 && rect.bottom == 200,
+       "Unexpected rect %s.\n", wine_dbgstr_rect(&rect));
     SetEvent(test_done_event);
 
     /* SW_SHOWMAXIMIZED */
@@ -11810,6 +11825,9 @@ static void other_process_proc(HWND hwnd)
     ok(ret, "Unexpected ret %#x.\n", ret);
     ok(wp.showCmd == SW_SHOWMINIMIZED, "Unexpected showCmd %#x.\n", wp.showCmd);
     todo_wine ok(wp.flags == WPF_RESTORETOMAXIMIZED, "Unexpected flags %#x.\n", wp.flags);
+    style = GetWindowLongA(hwnd, GWL_STYLE);
+    ok(style & WS_MINIMIZE, "Unexpected style %#x.\n", style);
+    ok(IsIconic(hwnd), "IsIconic failed.\n");
     SetEvent(test_done_event);
 
     /* SW_RESTORE */
@@ -354,6 +354,83 @@ static HWND *list_window_children( HDESK desktop, HWND hwnd, LPCWSTR class, DWOR
 }
 
 
+/*******************************************************************
+ *           map_window_shm
+ *
+ * Map the region where the server publishes the state of all windows.
+ */
+static const struct window_shm *map_window_shm(void)
+{
+    static const struct window_shm *window_shm_region;
+    static BOOL failed;
+    HANDLE handle = 0;
+    void *ptr;
+
+    if (window_shm_region || failed) return window_shm_region;
+
+    SERVER_START_REQ( get_window_shm_region )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+
+    if (!handle || !(ptr = MapViewOfFile( handle, FILE_MAP_READ, 0, 0, 0 ))) failed = TRUE;
+    else if (InterlockedCompareExchangePointer( (void **)&window_shm_region, ptr, NULL ))
+        UnmapViewOfFile( ptr );
+    if (handle) CloseHandle( handle );
+    return window_shm_region;
+}
+
+
+/* order the reads of the window data against the reads of the sequence number;
+ * the server side uses locked increments, which are full barriers */
+static inline void shm_read_barrier(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    /* loads are not reordered with other loads on x86, only the compiler has to be stopped */
+    __asm__ __volatile__( "" : : : "memory" );
+#else
+    __sync_synchronize();
+#endif
+}
+
+
+/*******************************************************************
+ *           get_window_shm
+ *
+ * Get a consistent copy of the shared state of a window, without a server round trip.
+ * Fails if the window isn't published, in which case the server has to be asked.
+ */
+static BOOL get_window_shm( HWND hwnd, struct window_shm *ret )
+{
+    const struct window_shm *region;
+    const volatile int *src;
+    int seq, *dst = (int *)ret;
+    WORD generation = HIWORD( hwnd );
+    unsigned int i, index = USER_HANDLE_TO_INDEX( hwnd );
+
+    if (LOWORD(hwnd) < FIRST_USER_HANDLE || index >= WINDOW_SHM_MAX_WINDOWS) return FALSE;
+    if (!(region = map_window_shm())) return FALSE;
+
+    src = (const volatile int *)&region[index];
+    for (;;)
+    {
+        /* the server makes the sequence odd while the entry is being updated */
+        seq = src[0];
+        if (seq & 1) continue;
+        shm_read_barrier();
+        for (i = 1; i < sizeof(*ret) / sizeof(int); i++) dst[i] = src[i];
+        shm_read_barrier();
+        if (src[0] == seq) break;
+    }
+    ret->seq = seq;
+
+    if (!ret->handle || LOWORD(ret->handle) != LOWORD(hwnd)) return FALSE;
+    if (generation && generation != 0xffff && generation != HIWORD(ret->handle)) return FALSE;
+    return TRUE;
+}
+
+
 /*******************************************************************
  *           list_window_parents
  *
@@ -372,15 +449,24 @@ static HWND *list_window_parents( HWND hwnd )
     for (;;)
     {
         if (!(win = WIN_GetPtr( current ))) goto empty;
-        if (win == WND_OTHER_PROCESS) break;  /* need to do it the hard way */
-        if (win == WND_DESKTOP)
+        if (win == WND_OTHER_PROCESS)
+        {
+            struct window_shm shm;
+
+            if (!get_window_shm( current, &shm )) break;  /* need to do it the hard way */
+            list[pos] = current = wine_server_ptr_handle( shm.parent );
+        }
+        else if (win == WND_DESKTOP)
         {
             if (!pos) goto empty;
             list[pos] = 0;
             return list;
         }
-        list[pos] = current = win->parent;
-        WIN_ReleasePtr( win );
+        else
+        {
+            list[pos] = current = win->parent;
+            WIN_ReleasePtr( win );
+        }
         if (!current) return list;
         if (++pos == size - 1)
         {
@@ -727,6 +813,10 @@ HWND WIN_GetFullHandle( HWND hwnd )
     }
     else  /* may belong to another process */
     {
+        struct window_shm shm;
+
+        if (get_window_shm( hwnd, &shm )) return wine_server_ptr_handle( shm.handle );
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -825,6 +915,68 @@ ULONG WIN_SetStyle( HWND hwnd, ULONG set_bits, ULONG clear_bits )
 }
 
 
+/***********************************************************************
+ *           get_window_shm_rectangles
+ *
+ * Get the window and client rectangles from the shared region.
+ * Fails if the server has to be asked, for instance to scale them to another DPI.
+ */
+static BOOL get_window_shm_rectangles( HWND hwnd, enum coords_relative relative,
+                                       RECT *rectWindow, RECT *rectClient )
+{
+    struct window_shm shm, parent;
+    RECT window_rect, client_rect, rect;
+
+    if (!get_window_shm( hwnd, &shm ) || shm.dpi != get_thread_dpi()) return FALSE;
+
+    SetRect( &window_rect, shm.window_rect.left, shm.window_rect.top,
+             shm.window_rect.right, shm.window_rect.bottom );
+    SetRect( &client_rect, shm.client_rect.left, shm.client_rect.top,
+             shm.client_rect.right, shm.client_rect.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        rect = client_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (shm.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &window_rect );
+        break;
+    case COORDS_WINDOW:
+        rect = window_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (shm.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &client_rect );
+        break;
+    case COORDS_PARENT:
+        if (!shm.parent) break;
+        if (!get_window_shm( wine_server_ptr_handle( shm.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, parent.client_rect.left, parent.client_rect.top,
+                     parent.client_rect.right, parent.client_rect.bottom );
+            mirror_rect( &rect, &window_rect );
+            mirror_rect( &rect, &client_rect );
+        }
+        break;
+    case COORDS_SCREEN:
+        while (shm.parent)
+        {
+            if (!get_window_shm( wine_server_ptr_handle( shm.parent ), &shm )) return FALSE;
+            if (!shm.parent) break;  /* reached the desktop */
+            OffsetRect( &window_rect, shm.client_rect.left, shm.client_rect.top );
+            OffsetRect( &client_rect, shm.client_rect.left, shm.client_rect.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (rectWindow) *rectWindow = window_rect;
+    if (rectClient) *rectClient = client_rect;
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           WIN_GetRectangles
  *
@@ -933,6 +1085,8 @@ BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWind
     }
 
 other_process:
+    if (get_window_shm_rectangles( hwnd, relative, rectWindow, rectClient )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2348,11 +2502,23 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS)
     {
+        struct window_shm shm;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if ((offset == GWL_STYLE || offset == GWL_EXSTYLE || offset == GWLP_ID) &&
+            get_window_shm( hwnd, &shm ))
+        {
+            switch(offset)
+            {
+            case GWL_STYLE:   return shm.style;
+            case GWL_EXSTYLE: return shm.ex_style;
+            case GWLP_ID:     return shm.id;
+            }
+        }
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2997,6 +3163,7 @@ INT WINAPI GetWindowTextLengthW( HWND hwnd )
  */
 BOOL WINAPI IsWindow( HWND hwnd )
 {
+    struct window_shm shm;
     WND *ptr;
     BOOL ret;
 
@@ -3010,6 +3177,8 @@ BOOL WINAPI IsWindow( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_window_shm( hwnd, &shm )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -3025,6 +3194,7 @@ BOOL WINAPI IsWindow( HWND hwnd )
  */
 DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
 {
+    struct window_shm shm;
     WND *ptr;
     DWORD tid = 0;
 
@@ -3044,6 +3214,12 @@ DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
     }
 
     /* check other processes */
+    if (get_window_shm( hwnd, &shm ))
+    {
+        if (process) *process = shm.pid;
+        return shm.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -3074,7 +3250,16 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        struct window_shm shm;
+        LONG style;
+
+        if (get_window_shm( hwnd, &shm ))
+        {
+            if (shm.style & WS_POPUP) retvalue = wine_server_ptr_handle( shm.owner );
+            else if (shm.style & WS_CHILD) retvalue = wine_server_ptr_handle( shm.parent );
+            return retvalue;
+        }
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -3104,6 +3289,7 @@ HWND WINAPI GetParent( HWND hwnd )
  */
 HWND WINAPI GetAncestor( HWND hwnd, UINT type )
 {
+    struct window_shm shm;
     WND *win;
     HWND *list, ret = 0;
 
@@ -3121,6 +3307,7 @@ HWND WINAPI GetAncestor( HWND hwnd, UINT type )
             ret = win->parent;
             WIN_ReleasePtr( win );
         }
+        else if (get_window_shm( hwnd, &shm )) ret = wine_server_ptr_handle( shm.parent );
         else /* need to query the server */
         {
             SERVER_START_REQ( get_window_tree )
@@ -64,6 +64,12 @@
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
@@ -131,6 +137,10 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+# include <sys/epoll.h>
+# define USE_EPOLL
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -159,6 +169,7 @@
 #include "wine/exception.h"
 #include "wine/unicode.h"
 #include "wine/heap.h"
+#include "wine/list.h"
 
 #if defined(linux) && !defined(IP_UNICAST_IF)
 #define IP_UNICAST_IF 50
@@ -535,6 +546,7 @@ struct ws2_transmitfile_async
     TRANSMIT_FILE_BUFFERS buffers;
     DWORD                 flags;
     LARGE_INTEGER         offset;
+    BOOL                  use_sendfile;
     struct ws2_async      write;
 };
 
@@ -617,12 +629,21 @@ struct per_thread_data
     struct WS_protoent *pe_buffer;
     struct pollfd *fd_cache;
     unsigned int fd_count;
+#ifdef USE_EPOLL
+    struct epoll_set *epoll_set;
+    BOOL epoll_failed;
+#endif
     int he_len;
     int se_len;
     int pe_len;
     char ntoa_buffer[16]; /* 4*3 digits + 3 '.' + 1 '\0' */
 };
 
+#ifdef USE_EPOLL
+static void free_epoll_set( struct epoll_set *set );
+static void epoll_forget_socket( SOCKET s );
+#endif
+
 /* internal: routing description information */
 struct route {
     struct in_addr addr;
@@ -1356,6 +1377,9 @@ static void free_per_thread_data(void)
     HeapFree( GetProcessHeap(), 0, ptb->se_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->pe_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->fd_cache );
+#ifdef USE_EPOLL
+    if (ptb->epoll_set) free_epoll_set( ptb->epoll_set );
+#endif
 
     HeapFree( GetProcessHeap(), 0, ptb );
     NtCurrentTeb()->WinSockData = NULL;
@@ -2988,6 +3012,86 @@ static NTSTATUS WS2_ReadFile(HANDLE hFile, PIO_STATUS_BLOCK io_status, char* buf
     return status;
 }
 
+#ifdef HAVE_SYS_SENDFILE_H
+/***********************************************************************
+ *     WS2_transmitfile_can_sendfile    (INTERNAL)
+ *
+ * Check whether the file of a TransmitFile operation is a regular file with
+ * data left to send, which can be sent directly with sendfile().
+ */
+static BOOL WS2_transmitfile_can_sendfile( struct ws2_transmitfile_async *wsa )
+{
+    struct stat st;
+    off_t pos;
+    int file_fd;
+    BOOL ret = FALSE;
+
+    if (wine_server_handle_to_fd( wsa->file, FILE_READ_DATA, &file_fd, NULL )) return FALSE;
+    if (!fstat( file_fd, &st ) && S_ISREG( st.st_mode ))
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION) pos = wsa->offset.QuadPart;
+        else pos = lseek( file_fd, 0, SEEK_CUR );
+        ret = (pos != -1 && st.st_size > pos);
+    }
+    wine_server_release_fd( wsa->file, file_fd );
+    return ret;
+}
+
+/***********************************************************************
+ *     WS2_transmitfile_sendfile        (INTERNAL)
+ *
+ * Send the main file directly from the file to the socket, without copying
+ * it through the transfer buffer.
+ */
+static NTSTATUS WS2_transmitfile_sendfile( int fd, struct ws2_transmitfile_async *wsa )
+{
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+    size_t count = 0x7ffff000;
+    NTSTATUS status;
+    off_t offset;
+    ssize_t ret;
+    int file_fd;
+
+    if ((status = wine_server_handle_to_fd( wsa->file, FILE_READ_DATA, &file_fd, NULL ))) return status;
+
+    if (wsa->file_bytes != 0) count = min( count, wsa->file_bytes - wsa->file_read );
+    offset = wsa->offset.QuadPart;
+    do
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            ret = sendfile( fd, file_fd, &offset, count );
+        else
+            ret = sendfile( fd, file_fd, NULL, count );
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret > 0)
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            wsa->offset.QuadPart = offset;
+        if (iosb) iosb->Information += ret;
+        wsa->file_read += ret;
+        if (wsa->file_bytes != 0 && wsa->file_read >= wsa->file_bytes)
+            wsa->file = NULL;
+        status = STATUS_PENDING;
+    }
+    else if (!ret)
+        status = STATUS_END_OF_FILE;
+    else if (errno == EAGAIN)
+        status = STATUS_PENDING;
+    else if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)
+    {
+        /* not supported for this file or socket, fall back to reading the file */
+        wsa->use_sendfile = FALSE;
+        status = STATUS_NOT_SUPPORTED;
+    }
+    else
+        status = wsaErrStatus();
+
+    wine_server_release_fd( wsa->file, file_fd );
+    return status;
+}
+#endif
+
 /***********************************************************************
  *     WS2_transmitfile_getbuffer       (INTERNAL)
  *
@@ -3010,6 +3114,18 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
         return STATUS_PENDING;
     }
 
+#ifdef HAVE_SYS_SENDFILE_H
+    if (wsa->file && wsa->use_sendfile)
+    {
+        NTSTATUS status = WS2_transmitfile_sendfile( fd, wsa );
+
+        if (status == STATUS_END_OF_FILE)
+            wsa->file = NULL; /* continue on to the footer */
+        else if (status != STATUS_NOT_SUPPORTED)
+            return status;
+    }
+#endif
+
     /* process the main file */
     if (wsa->file)
     {
@@ -3070,12 +3186,16 @@ static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *ws
     NTSTATUS status;
 
     status = WS2_transmitfile_getbuffer( fd, wsa );
-    if (status == STATUS_PENDING)
+    if (status == STATUS_PENDING && wsa->write.first_iovec < wsa->write.n_iovecs)
     {
         IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
-        int n;
+        int n, flags = convert_flags(wsa->write.flags);
 
-        n = WS2_send( fd, &wsa->write, convert_flags(wsa->write.flags) );
+#ifdef MSG_MORE
+        /* let the header go out in the same packets as the start of the file */
+        if (wsa->file && wsa->use_sendfile) flags |= MSG_MORE;
+#endif
+        n = WS2_send( fd, &wsa->write, flags );
         if (n >= 0)
         {
             if (iosb) iosb->Information += n;
@@ -3174,6 +3294,7 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
     wsa->bytes_per_send        = bytes_per_send;
     wsa->flags                 = flags;
     wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
+    wsa->use_sendfile          = FALSE;
     wsa->write.hSocket         = SOCKET2HANDLE(s);
     wsa->write.addr            = NULL;
     wsa->write.addrlen.val     = 0;
@@ -3190,6 +3311,9 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
 
         wsa->offset.u.LowPart  = overlapped->u.s.Offset;
         wsa->offset.u.HighPart = overlapped->u.s.OffsetHigh;
+#ifdef HAVE_SYS_SENDFILE_H
+        if (h) wsa->use_sendfile = WS2_transmitfile_can_sendfile( wsa );
+#endif
         iosb->u.Status = STATUS_PENDING;
         iosb->Information = 0;
         status = register_async( ASYNC_TYPE_WRITE, SOCKET2HANDLE(s), &wsa->io,
@@ -3200,6 +3324,10 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
         return FALSE;
     }
 
+#ifdef HAVE_SYS_SENDFILE_H
+    if (h) wsa->use_sendfile = WS2_transmitfile_can_sendfile( wsa );
+#endif
+
     do
     {
         status = WS2_transmitfile_base( fd, wsa );
@@ -3450,6 +3578,9 @@ int WINAPI WS_closesocket(SOCKET s)
         if (fd >= 0)
         {
             release_sock_fd(s, fd);
+#ifdef USE_EPOLL
+            epoll_forget_socket(s);
+#endif
             if (CloseHandle(SOCKET2HANDLE(s)))
                 res = 0;
         }
@@ -5218,23 +5349,11 @@ int WINAPI WS_recvfrom(SOCKET s, char *buf, INT len, int flags,
         return n;
 }
 
-/* allocate a poll array for the corresponding fd sets */
-static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
-                                       const WS_fd_set *exceptfds, int *count_ptr )
+/* return the per-thread poll array, grown to hold at least count descriptors */
+static struct pollfd *get_poll_cache( unsigned int count )
 {
-    unsigned int i, j = 0, count = 0;
-    struct pollfd *fds;
     struct per_thread_data *ptb = get_per_thread_data();
-
-    if (readfds) count += readfds->fd_count;
-    if (writefds) count += writefds->fd_count;
-    if (exceptfds) count += exceptfds->fd_count;
-    *count_ptr = count;
-    if (!count)
-    {
-        SetLastError(WSAEINVAL);
-        return NULL;
-    }
+    struct pollfd *fds;
 
     /* check if the cache can hold all descriptors, if not do the resizing */
     if (ptb->fd_count < count)
@@ -5248,8 +5367,36 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
         ptb->fd_cache = fds;
         ptb->fd_count = count;
     }
-    else
-        fds = ptb->fd_cache;
+    return ptb->fd_cache;
+}
+
+static unsigned int fd_sets_count( const WS_fd_set *readfds, const WS_fd_set *writefds,
+                                   const WS_fd_set *exceptfds )
+{
+    unsigned int count = 0;
+
+    if (readfds) count += readfds->fd_count;
+    if (writefds) count += writefds->fd_count;
+    if (exceptfds) count += exceptfds->fd_count;
+    return count;
+}
+
+/* allocate a poll array for the corresponding fd sets */
+static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
+                                       const WS_fd_set *exceptfds, int *count_ptr )
+{
+    unsigned int i, j = 0, count;
+    struct pollfd *fds;
+
+    count = fd_sets_count( readfds, writefds, exceptfds );
+    *count_ptr = count;
+    if (!count)
+    {
+        SetLastError(WSAEINVAL);
+        return NULL;
+    }
+
+    if (!(fds = get_poll_cache( count ))) return NULL;
 
     if (readfds)
         for (i = 0; i < readfds->fd_count; i++, j++)
@@ -5363,9 +5510,27 @@ static void release_poll_fds( const WS_fd_set *readfds, const WS_fd_set *writefd
     }
 }
 
+/* return what is left in milliseconds of a timeout that started at the given time */
+static int get_remaining_timeout( const struct timeval *start, int timeout )
+{
+    struct timeval now;
+
+    gettimeofday( &now, 0 );
+
+    now.tv_sec  -= start->tv_sec;
+    now.tv_usec -= start->tv_usec;
+    if (now.tv_usec < 0)
+    {
+        now.tv_usec += 1000000;
+        now.tv_sec  -= 1;
+    }
+
+    return timeout - (now.tv_sec * 1000) - (now.tv_usec + 999) / 1000;
+}
+
 static int do_poll(struct pollfd *pollfds, int count, int timeout)
 {
-    struct timeval tv1, tv2;
+    struct timeval tv1;
     int ret, torig = timeout;
 
     if (timeout > 0) gettimeofday( &tv1, 0 );
@@ -5376,22 +5541,438 @@ static int do_poll(struct pollfd *pollfds, int count, int timeout)
         if (timeout < 0) continue;
         if (timeout == 0) return 0;
 
-        gettimeofday( &tv2, 0 );
+        timeout = get_remaining_timeout( &tv1, torig );
+        if (timeout <= 0) return 0;
+    }
+    return ret;
+}
+
+#ifdef USE_EPOLL
+
+/* select() and WSAPoll() keep the sockets they are called on registered in a
+ * per-thread epoll set, so that calling them again over the same sockets only
+ * costs a table lookup per socket instead of a server call and a poll of every fd.
+ *
+ * Each registered socket holds a private duplicate of its unix fd, which is
+ * released when the socket is closed through closesocket(). Sockets that are no
+ * longer requested stay registered and are only removed from the epoll set when
+ * they report an event.
+ *
+ * Sockets destroyed through CloseHandle() are not seen by closesocket(), so each
+ * call checks a few entries of the table against the server before waiting, and
+ * releases the duplicate fd of those whose handle is gone or was reused. Entries
+ * reporting an event that the current call didn't request are checked as well.
+ *
+ * A socket closed while another thread waits on it stays registered until that
+ * thread has reported it: the server shuts the socket down when destroying it,
+ * which wakes up the wait like it does for poll(). A socket destroyed through
+ * CloseHandle() reports a hangup the same way, so the handle of a socket that
+ * hangs up is checked against the server before the entry is trusted. */
+
+#define EPOLL_SOCKET_REGISTERED 0x01  /* fd is in the epoll set */
+#define EPOLL_SOCKET_BOUND      0x02  /* socket is bound, this can't change anymore */
+#define EPOLL_SOCKET_DGRAM      0x04  /* datagram socket */
+#define EPOLL_SOCKET_CLOSED     0x08  /* socket was closed while the current call was waiting */
+#define EPOLL_SOCKET_CHECKED    0x10  /* handle was checked during the current call */
+
+#define EPOLL_SWEEP_COUNT 64  /* number of entries checked for stale handles at each call */
+
+struct epoll_socket
+{
+    SOCKET       socket;   /* socket handle, 0 for a free slot */
+    int          fd;       /* private duplicate of the unix fd */
+    unsigned int flags;    /* EPOLL_SOCKET_* flags */
+    unsigned int serial;   /* registration serial, stored in the epoll data */
+    unsigned int call;     /* last call that requested the socket */
+    unsigned int want;     /* events requested by that call */
+    unsigned int events;   /* events registered in the epoll set */
+    unsigned int revents;  /* events reported during that call */
+};
+
+struct epoll_set
+{
+    struct list          entry;    /* entry in the epoll_sets list */
+    CRITICAL_SECTION     cs;       /* protects the table against closesocket() in other threads */
+    int                  fd;       /* epoll fd */
+    unsigned int         call;     /* serial of the current call */
+    BOOL                 waiting;  /* the current call is waiting for events */
+    unsigned int         serial;   /* serial of the last registration */
+    unsigned int         count;    /* number of sockets in the table */
+    unsigned int         size;     /* size of the table, a power of 2 */
+    unsigned int         sweep;    /* next table slot to check for stale entries */
+    struct epoll_socket *sockets;  /* hash table indexed by socket handle */
+    struct epoll_event   events[256];
+};
+
+static struct list epoll_sets = LIST_INIT( epoll_sets );
+
+static CRITICAL_SECTION epoll_cs;
+static CRITICAL_SECTION_DEBUG epoll_cs_debug =
+{
+    0, 0, &epoll_cs,
+    { &epoll_cs_debug.ProcessLocksList, &epoll_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": epoll_cs") }
+};
+static CRITICAL_SECTION epoll_cs = { &epoll_cs_debug, -1, 0, 0, 0, 0 };
+
+static inline unsigned int epoll_socket_hash( const struct epoll_set *set, SOCKET s )
+{
+    return ((ULONG_PTR)s >> 2) * 0x9e3779b1 & (set->size - 1);
+}
+
+static struct epoll_socket *epoll_find_socket( struct epoll_set *set, SOCKET s )
+{
+    unsigned int i;
+
+    if (!set->size) return NULL;
+    for (i = epoll_socket_hash( set, s ); set->sockets[i].socket; i = (i + 1) & (set->size - 1))
+        if (set->sockets[i].socket == s) return &set->sockets[i];
+    return NULL;
+}
+
+/* make room for one more socket in the table */
+static BOOL epoll_grow_set( struct epoll_set *set )
+{
+    struct epoll_socket *sockets, *old_sockets = set->sockets;
+    unsigned int i, j, old_size = set->size, size = old_size ? old_size * 2 : 64;
+
+    if ((set->count + 1) * 2 <= set->size) return TRUE;
+    if (!(sockets = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*sockets) )))
+        return FALSE;
+
+    set->sockets = sockets;
+    set->size = size;
+    for (i = 0; i < old_size; i++)
+    {
+        if (!old_sockets[i].socket) continue;
+        for (j = epoll_socket_hash( set, old_sockets[i].socket ); sockets[j].socket; j = (j + 1) & (size - 1))
+            ;
+        sockets[j] = old_sockets[i];
+    }
+    HeapFree( GetProcessHeap(), 0, old_sockets );
+    return TRUE;
+}
 
-        tv2.tv_sec  -= tv1.tv_sec;
-        tv2.tv_usec -= tv1.tv_usec;
-        if (tv2.tv_usec < 0)
+static void epoll_remove_socket( struct epoll_set *set, struct epoll_socket *sock )
+{
+    unsigned int i = sock - set->sockets, j = i, k;
+
+    if (sock->flags & EPOLL_SOCKET_REGISTERED) epoll_ctl( set->fd, EPOLL_CTL_DEL, sock->fd, NULL );
+    close( sock->fd );
+    set->count--;
+
+    /* shift back the following entries of the probe sequence */
+    for (;;)
+    {
+        set->sockets[i].socket = 0;
+        for (;;)
         {
-            tv2.tv_usec += 1000000;
-            tv2.tv_sec  -= 1;
+            j = (j + 1) & (set->size - 1);
+            if (!set->sockets[j].socket) return;
+            k = epoll_socket_hash( set, set->sockets[j].socket );
+            if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) break;
         }
+        set->sockets[i] = set->sockets[j];
+        i = j;
+    }
+}
 
-        timeout = torig - (tv2.tv_sec * 1000) - (tv2.tv_usec + 999) / 1000;
-        if (timeout <= 0) return 0;
+/* find or register a socket and reset its state if this is the first time the current call requests it */
+static struct epoll_socket *epoll_get_socket( struct epoll_set *set, SOCKET s )
+{
+    struct epoll_socket *sock;
+    int fd, dup_fd;
+    unsigned int i;
+
+    /* left over from a call that failed before reporting it */
+    if ((sock = epoll_find_socket( set, s )) && (sock->flags & EPOLL_SOCKET_CLOSED))
+    {
+        epoll_remove_socket( set, sock );
+        sock = NULL;
     }
-    return ret;
+
+    if (!sock)
+    {
+        if ((fd = get_sock_fd( s, 0, NULL )) == -1) return NULL;
+#ifdef F_DUPFD_CLOEXEC
+        dup_fd = fcntl( fd, F_DUPFD_CLOEXEC, 0 );
+#else
+        if ((dup_fd = dup( fd )) != -1) fcntl( dup_fd, F_SETFD, FD_CLOEXEC );
+#endif
+        release_sock_fd( s, fd );
+        if (dup_fd == -1)
+        {
+            SetLastError( wsaErrno() );
+            return NULL;
+        }
+        if (!epoll_grow_set( set ))
+        {
+            close( dup_fd );
+            SetLastError( WSAENOBUFS );
+            return NULL;
+        }
+
+        for (i = epoll_socket_hash( set, s ); set->sockets[i].socket; i = (i + 1) & (set->size - 1))
+            ;
+        sock = &set->sockets[i];
+        memset( sock, 0, sizeof(*sock) );
+        sock->socket = s;
+        sock->fd     = dup_fd;
+        sock->serial = ++set->serial;
+        sock->call   = set->call - 1;
+        if (_get_fd_type( dup_fd ) == SOCK_DGRAM) sock->flags |= EPOLL_SOCKET_DGRAM;
+        set->count++;
+    }
+
+    if (sock->call != set->call)
+    {
+        sock->call    = set->call;
+        sock->want    = 0;
+        sock->revents = 0;
+        sock->flags  &= ~EPOLL_SOCKET_CHECKED;
+    }
+    return sock;
 }
 
+/* check whether the handle of an entry was closed or now refers to another socket */
+static BOOL epoll_socket_stale( struct epoll_socket *sock )
+{
+    struct stat st, dup_st;
+    DWORD err = GetLastError();
+    BOOL stale;
+    int fd;
+
+    if ((fd = get_sock_fd( sock->socket, 0, NULL )) == -1)
+    {
+        SetLastError( err );
+        return TRUE;
+    }
+    stale = fstat( fd, &st ) || fstat( sock->fd, &dup_st ) ||
+            st.st_dev != dup_st.st_dev || st.st_ino != dup_st.st_ino;
+    release_sock_fd( sock->socket, fd );
+    return stale;
+}
+
+/* release the entries of sockets destroyed without closesocket(), a few of them at each call */
+static void epoll_sweep_sockets( struct epoll_set *set )
+{
+    struct epoll_socket *sock;
+    unsigned int i, checked = 0;
+
+    for (i = 0; i < set->size && checked < EPOLL_SWEEP_COUNT; i++)
+    {
+        sock = &set->sockets[set->sweep];
+        if (sock->socket)
+        {
+            checked++;
+            if ((sock->flags & EPOLL_SOCKET_CLOSED) || epoll_socket_stale( sock ))
+            {
+                TRACE( "releasing stale socket %04lx\n", sock->socket );
+                epoll_remove_socket( set, sock );
+                continue;  /* the next entry may have moved to this slot */
+            }
+        }
+        set->sweep = (set->sweep + 1) & (set->size - 1);
+    }
+}
+
+/* make sure that the handle of a socket that hung up during the current call still refers */
+/* to the registered socket; returns FALSE if it was reused, in which case the entry is removed */
+static BOOL epoll_check_socket( struct epoll_set *set, SOCKET s )
+{
+    struct epoll_socket *sock = epoll_find_socket( set, s );
+    struct stat st, dup_st;
+    BOOL same;
+    int fd;
+
+    if (!sock || sock->call != set->call || !(sock->revents & POLLHUP)) return TRUE;
+    if (sock->flags & (EPOLL_SOCKET_CLOSED | EPOLL_SOCKET_CHECKED)) return TRUE;
+    sock->flags |= EPOLL_SOCKET_CHECKED;
+
+    if ((fd = get_sock_fd( s, 0, NULL )) == -1)
+    {
+        /* closed through CloseHandle(), report it like closesocket() */
+        sock->flags |= EPOLL_SOCKET_CLOSED;
+        return TRUE;
+    }
+    same = !fstat( fd, &st ) && !fstat( sock->fd, &dup_st ) &&
+           st.st_dev == dup_st.st_dev && st.st_ino == dup_st.st_ino;
+    release_sock_fd( s, fd );
+    if (!same) epoll_remove_socket( set, sock );
+    return same;
+}
+
+/* remove a socket once the call that was waiting on it when it got closed has reported it */
+static void epoll_remove_closed( struct epoll_set *set, SOCKET s )
+{
+    struct epoll_socket *sock = epoll_find_socket( set, s );
+
+    if (sock && (sock->flags & EPOLL_SOCKET_CLOSED)) epoll_remove_socket( set, sock );
+}
+
+static BOOL epoll_socket_bound( struct epoll_socket *sock )
+{
+    if (!(sock->flags & EPOLL_SOCKET_BOUND) && is_fd_bound( sock->fd, NULL, NULL ) == 1)
+        sock->flags |= EPOLL_SOCKET_BOUND;
+    return (sock->flags & EPOLL_SOCKET_BOUND) != 0;
+}
+
+/* bring the epoll registration of a socket in line with the events requested by the current call */
+static int epoll_update_socket( struct epoll_set *set, struct epoll_socket *sock )
+{
+    struct epoll_event ev;
+
+    if (!sock->want)
+    {
+        if (sock->flags & EPOLL_SOCKET_REGISTERED)
+        {
+            epoll_ctl( set->fd, EPOLL_CTL_DEL, sock->fd, NULL );
+            sock->flags &= ~EPOLL_SOCKET_REGISTERED;
+        }
+        return 0;
+    }
+    if ((sock->flags & EPOLL_SOCKET_REGISTERED) && sock->events == sock->want) return 0;
+
+    /* epoll uses the same event bits as poll */
+    ev.events = sock->want;
+    ev.data.u64 = ((ULONG64)sock->serial << 32) | (ULONG)sock->socket;
+    if (epoll_ctl( set->fd, (sock->flags & EPOLL_SOCKET_REGISTERED) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                   sock->fd, &ev ) == -1)
+        return -1;
+    sock->flags |= EPOLL_SOCKET_REGISTERED;
+    sock->events = sock->want;
+    return 0;
+}
+
+/* record a reported event, returns TRUE if the current call is interested in it */
+static BOOL epoll_process_event( struct epoll_set *set, const struct epoll_event *ev )
+{
+    struct epoll_socket *sock = epoll_find_socket( set, (SOCKET)(ULONG)ev->data.u64 );
+
+    /* the socket was closed while we were waiting */
+    if (!sock || sock->serial != (unsigned int)(ev->data.u64 >> 32)) return FALSE;
+
+    if (sock->call == set->call && sock->want)
+    {
+        sock->revents |= ev->events;
+        return TRUE;
+    }
+
+    /* a socket destroyed through CloseHandle() reports a hangup too */
+    if (epoll_socket_stale( sock ))
+    {
+        epoll_remove_socket( set, sock );
+        return FALSE;
+    }
+
+    /* the socket is not requested anymore, stop watching it until it is */
+    epoll_ctl( set->fd, EPOLL_CTL_DEL, sock->fd, NULL );
+    sock->flags &= ~EPOLL_SOCKET_REGISTERED;
+    return FALSE;
+}
+
+/* wait for events on the requested sockets, must be called with the set lock held */
+static int epoll_wait_sockets( struct epoll_set *set, int timeout )
+{
+    unsigned int rounds = 0, max_rounds = set->count / ARRAY_SIZE(set->events) + 1;
+    int i, n, err, ret = 0, torig = timeout;
+    struct timeval tv1;
+
+    if (timeout > 0) gettimeofday( &tv1, 0 );
+
+    for (;;)
+    {
+        set->waiting = TRUE;
+        LeaveCriticalSection( &set->cs );
+        n = epoll_wait( set->fd, set->events, ARRAY_SIZE(set->events), ret ? 0 : timeout );
+        err = errno;
+        EnterCriticalSection( &set->cs );
+        set->waiting = FALSE;
+
+        if (n == -1 && err != EINTR)
+        {
+            errno = err;
+            return -1;
+        }
+        for (i = 0; i < n; i++)
+            if (epoll_process_event( set, &set->events[i] )) ret++;
+
+        /* there may be more events left */
+        if (n == ARRAY_SIZE(set->events) && ++rounds < max_rounds) continue;
+
+        if (ret || !timeout) return ret;
+        if (timeout > 0 && (timeout = get_remaining_timeout( &tv1, torig )) <= 0) return 0;
+    }
+}
+
+static struct epoll_set *get_epoll_set(void)
+{
+    struct per_thread_data *ptb = get_per_thread_data();
+    struct epoll_set *set;
+
+    if (ptb->epoll_set || ptb->epoll_failed) return ptb->epoll_set;
+
+    if (!(set = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*set) ))) return NULL;
+    if ((set->fd = epoll_create( 64 )) == -1)
+    {
+        WARN( "epoll_create failed, falling back to poll: %s\n", strerror(errno) );
+        HeapFree( GetProcessHeap(), 0, set );
+        ptb->epoll_failed = TRUE;
+        return NULL;
+    }
+    fcntl( set->fd, F_SETFD, FD_CLOEXEC );
+    InitializeCriticalSection( &set->cs );
+    set->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": epoll_set.cs");
+
+    EnterCriticalSection( &epoll_cs );
+    list_add_tail( &epoll_sets, &set->entry );
+    LeaveCriticalSection( &epoll_cs );
+
+    return ptb->epoll_set = set;
+}
+
+static void free_epoll_set( struct epoll_set *set )
+{
+    unsigned int i;
+
+    EnterCriticalSection( &epoll_cs );
+    list_remove( &set->entry );
+    LeaveCriticalSection( &epoll_cs );
+
+    for (i = 0; i < set->size; i++)
+        if (set->sockets[i].socket) close( set->sockets[i].fd );
+    close( set->fd );
+    set->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &set->cs );
+    HeapFree( GetProcessHeap(), 0, set->sockets );
+    HeapFree( GetProcessHeap(), 0, set );
+}
+
+/* drop a socket that is being closed from the epoll sets of all threads */
+static void epoll_forget_socket( SOCKET s )
+{
+    struct epoll_set *set;
+    struct epoll_socket *sock;
+
+    EnterCriticalSection( &epoll_cs );
+    LIST_FOR_EACH_ENTRY( set, &epoll_sets, struct epoll_set, entry )
+    {
+        EnterCriticalSection( &set->cs );
+        if ((sock = epoll_find_socket( set, s )))
+        {
+            /* keep it registered so that the shutdown by the server wakes up the waiting call */
+            if (set->waiting && sock->call == set->call && sock->want)
+                sock->flags |= EPOLL_SOCKET_CLOSED;
+            else
+                epoll_remove_socket( set, sock );
+        }
+        LeaveCriticalSection( &set->cs );
+    }
+    LeaveCriticalSection( &epoll_cs );
+}
+
+#endif  /* USE_EPOLL */
+
 /* map the poll results back into the Windows fd sets */
 static int get_poll_results( WS_fd_set *readfds, WS_fd_set *writefds, WS_fd_set *exceptfds,
                              const struct pollfd *fds )
@@ -5433,6 +6014,203 @@ static int get_poll_results( WS_fd_set *readfds, WS_fd_set *writefds, WS_fd_set
     return total;
 }
 
+#ifdef USE_EPOLL
+
+/* select() on the sockets of the per-thread epoll set */
+static int epoll_select( struct epoll_set *set, WS_fd_set *readfds, WS_fd_set *writefds,
+                         WS_fd_set *exceptfds, int timeout )
+{
+    const WS_fd_set *sets[3] = { readfds, writefds, exceptfds };
+    unsigned int i, j, k, count = fd_sets_count( readfds, writefds, exceptfds );
+    struct epoll_socket *sock;
+    struct pollfd *fds;
+    int oob_inlined, ret = SOCKET_ERROR;
+    socklen_t olen;
+
+    if (!count)
+    {
+        SetLastError(WSAEINVAL);
+        return SOCKET_ERROR;
+    }
+    if (!(fds = get_poll_cache( count ))) return SOCKET_ERROR;
+
+    EnterCriticalSection( &set->cs );
+    epoll_sweep_sockets( set );
+again:
+    set->call++;
+
+    for (k = j = 0; k < ARRAY_SIZE(sets); k++)
+    {
+        if (!sets[k]) continue;
+        for (i = 0; i < sets[k]->fd_count; i++, j++)
+        {
+            if (!(sock = epoll_get_socket( set, sets[k]->fd_array[i] ))) goto done;
+            fds[j].fd = -1;
+            fds[j].events = 0;
+            fds[j].revents = 0;
+            if (k == 0)
+            {
+                if (epoll_socket_bound( sock )) fds[j].events = POLLIN;
+            }
+            else if (k == 1)
+            {
+                if (epoll_socket_bound( sock ) || (sock->flags & EPOLL_SOCKET_DGRAM))
+                    fds[j].events = POLLOUT;
+            }
+            else if (epoll_socket_bound( sock ))
+            {
+                oob_inlined = 0;
+                olen = sizeof(oob_inlined);
+                fds[j].events = POLLHUP;
+                /* Check if we need to test for urgent data or not */
+                getsockopt( sock->fd, SOL_SOCKET, SO_OOBINLINE, (char *)&oob_inlined, &olen );
+                if (!oob_inlined) fds[j].events |= POLLPRI;
+            }
+            sock->want |= fds[j].events;
+        }
+    }
+
+    for (k = 0; k < ARRAY_SIZE(sets); k++)
+    {
+        if (!sets[k]) continue;
+        for (i = 0; i < sets[k]->fd_count; i++)
+        {
+            if (epoll_update_socket( set, epoll_find_socket( set, sets[k]->fd_array[i] ) ) == -1)
+            {
+                SetLastError( wsaErrno() );
+                goto done;
+            }
+        }
+    }
+
+    if (epoll_wait_sockets( set, timeout ) == -1)
+    {
+        SetLastError( wsaErrno() );
+        goto done;
+    }
+
+    /* the handle of a socket that hung up may have been reused, start over with the new socket */
+    for (k = 0; k < ARRAY_SIZE(sets); k++)
+    {
+        if (!sets[k]) continue;
+        for (i = 0; i < sets[k]->fd_count; i++)
+            if (!epoll_check_socket( set, sets[k]->fd_array[i] )) goto again;
+    }
+
+    for (k = j = 0; k < ARRAY_SIZE(sets); k++)
+    {
+        if (!sets[k]) continue;
+        for (i = 0; i < sets[k]->fd_count; i++, j++)
+        {
+            /* sockets closed while we were waiting report the shutdown done by the server */
+            if (fds[j].events && (sock = epoll_find_socket( set, sets[k]->fd_array[i] )) &&
+                sock->call == set->call)
+                fds[j].revents = sock->revents & (fds[j].events | POLLERR | POLLHUP);
+        }
+    }
+    for (k = 0; k < ARRAY_SIZE(sets); k++)
+    {
+        if (!sets[k]) continue;
+        for (i = 0; i < sets[k]->fd_count; i++) epoll_remove_closed( set, sets[k]->fd_array[i] );
+    }
+    ret = 0;
+
+done:
+    LeaveCriticalSection( &set->cs );
+    if (ret == SOCKET_ERROR) return ret;
+    return get_poll_results( readfds, writefds, exceptfds, fds );
+}
+
+/* WSAPoll() on the sockets of the per-thread epoll set */
+static int epoll_poll( struct epoll_set *set, WSAPOLLFD *wfds, ULONG count, int timeout )
+{
+    struct epoll_socket *sock;
+    struct pollfd *fds;
+    int ret = 0;
+    ULONG i;
+
+    if (!(fds = get_poll_cache( count )))
+    {
+        SetLastError(WSAENOBUFS);
+        return SOCKET_ERROR;
+    }
+
+    EnterCriticalSection( &set->cs );
+    epoll_sweep_sockets( set );
+again:
+    set->call++;
+    ret = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        fds[i].fd = -1;
+        fds[i].events = convert_poll_w2u(wfds[i].events);
+        fds[i].revents = 0;
+        if (!(sock = epoll_get_socket( set, wfds[i].fd )))
+        {
+            ret++;
+            continue;
+        }
+        fds[i].fd = 0;
+        /* like poll, always report errors and hangups */
+        sock->want |= fds[i].events | POLLERR | POLLHUP;
+    }
+
+    /* invalid sockets are reported right away, without waiting for the others */
+    if (ret)
+    {
+        for (i = 0; i < count; i++) wfds[i].revents = fds[i].fd == -1 ? WS_POLLNVAL : 0;
+        goto done;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (fds[i].fd == -1) continue;
+        if (epoll_update_socket( set, epoll_find_socket( set, wfds[i].fd ) ) == -1)
+        {
+            SetLastError( wsaErrno() );
+            ret = SOCKET_ERROR;
+            goto done;
+        }
+    }
+
+    if (epoll_wait_sockets( set, timeout ) == -1)
+    {
+        SetLastError( wsaErrno() );
+        ret = SOCKET_ERROR;
+        goto done;
+    }
+
+    /* the handle of a socket that hung up may have been reused, start over with the new socket */
+    for (i = 0; i < count; i++)
+        if (!epoll_check_socket( set, wfds[i].fd )) goto again;
+
+    for (i = 0; i < count; i++)
+    {
+        /* sockets closed while we were waiting are reported as invalid */
+        if (!(sock = epoll_find_socket( set, wfds[i].fd )) || sock->call != set->call ||
+            (sock->flags & EPOLL_SOCKET_CLOSED))
+        {
+            wfds[i].revents = WS_POLLNVAL;
+            ret++;
+            continue;
+        }
+        fds[i].revents = sock->revents & (fds[i].events | POLLERR | POLLHUP);
+        if (fds[i].revents & POLLHUP)
+            wfds[i].revents = WS_POLLHUP;
+        else
+            wfds[i].revents = convert_poll_u2w(fds[i].revents);
+        if (fds[i].revents) ret++;
+    }
+    for (i = 0; i < count; i++) epoll_remove_closed( set, wfds[i].fd );
+
+done:
+    LeaveCriticalSection( &set->cs );
+    return ret;
+}
+
+#endif  /* USE_EPOLL */
+
 /***********************************************************************
  *		select			(WS2_32.18)
  */
@@ -5442,16 +6220,24 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
 {
     struct pollfd *pollfds;
     int count, ret, timeout = -1;
+#ifdef USE_EPOLL
+    struct epoll_set *set;
+#endif
 
     TRACE("read %p, write %p, excp %p timeout %p\n",
           ws_readfds, ws_writefds, ws_exceptfds, ws_timeout);
 
-    if (!(pollfds = fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &count )))
-        return SOCKET_ERROR;
-
     if (ws_timeout)
         timeout = (ws_timeout->tv_sec * 1000) + (ws_timeout->tv_usec + 999) / 1000;
 
+#ifdef USE_EPOLL
+    if ((set = get_epoll_set()))
+        return epoll_select( set, ws_readfds, ws_writefds, ws_exceptfds, timeout );
+#endif
+
+    if (!(pollfds = fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &count )))
+        return SOCKET_ERROR;
+
     ret = do_poll(pollfds, count, timeout);
     release_poll_fds( ws_readfds, ws_writefds, ws_exceptfds, pollfds );
 
@@ -5467,6 +6253,9 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
 {
     int i, ret;
     struct pollfd *ufds;
+#ifdef USE_EPOLL
+    struct epoll_set *set;
+#endif
 
     if (!count)
     {
@@ -5479,6 +6268,10 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         return SOCKET_ERROR;
     }
 
+#ifdef USE_EPOLL
+    if ((set = get_epoll_set())) return epoll_poll( set, wfds, count, timeout );
+#endif
+
     if (!(ufds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(ufds[0]))))
     {
         SetLastError(WSAENOBUFS);
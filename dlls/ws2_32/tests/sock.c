@@ -7340,6 +7340,247 @@ todo_wine
     WaitForSingleObject (thread_handle, 1000);
     closesocket(fdRead);
 }
+
+static void test_select_many_sockets(void)
+{
+    /* a few hundred sockets check the results, the large counts are only for benchmarking */
+    const unsigned int idle_count = winetest_interactive ? 10000 : 200, active_count = 100;
+    const unsigned int loops = winetest_interactive ? 20 : 1;
+    const struct timeval timeout = {0, 0};
+    unsigned int i, count, step, total = idle_count + active_count;
+    struct sockaddr_in addr;
+    SOCKET *sockets, sender;
+    fd_set *readfds, *set;
+    WSAPOLLFD *fds;
+    DWORD start, size;
+    char buf[16];
+    int ret, len;
+
+    sender = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    ok( sender != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError() );
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr( "127.0.0.1" );
+
+    sockets = HeapAlloc( GetProcessHeap(), 0, total * sizeof(*sockets) );
+    for (count = 0; count < total; count++)
+    {
+        sockets[count] = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+        if (sockets[count] == INVALID_SOCKET) break;
+        addr.sin_port = 0;
+        if (bind( sockets[count], (struct sockaddr *)&addr, sizeof(addr) ))
+        {
+            closesocket( sockets[count] );
+            break;
+        }
+    }
+    if (count < 2 * active_count)
+    {
+        skip( "could only create %u sockets\n", count );
+        goto done;
+    }
+    if (count < total && winetest_interactive) trace( "could only create %u sockets\n", count );
+
+    step = count / active_count;
+    for (i = 0; i < active_count; i++)
+    {
+        len = sizeof(addr);
+        ret = getsockname( sockets[i * step], (struct sockaddr *)&addr, &len );
+        ok( !ret, "getsockname failed, error %d\n", WSAGetLastError() );
+        ret = sendto( sender, "x", 1, 0, (struct sockaddr *)&addr, sizeof(addr) );
+        ok( ret == 1, "sendto failed, error %d\n", WSAGetLastError() );
+    }
+
+    size = FIELD_OFFSET( fd_set, fd_array[count] );
+    readfds = HeapAlloc( GetProcessHeap(), 0, size );
+    set = HeapAlloc( GetProcessHeap(), 0, size );
+    readfds->fd_count = count;
+    memcpy( readfds->fd_array, sockets, count * sizeof(*sockets) );
+
+    start = GetTickCount();
+    for (i = 0; i < loops; i++)
+    {
+        memcpy( set, readfds, size );
+        ret = select( 0, set, NULL, NULL, &timeout );
+        ok( ret == active_count, "got %d ready sockets\n", ret );
+        ok( set->fd_count == active_count, "got %u sockets in the set\n", set->fd_count );
+    }
+    if (winetest_interactive)
+        trace( "select: %u calls over %u sockets with %u ready took %u ms\n",
+               loops, count, active_count, GetTickCount() - start );
+    ok( set->fd_array[0] == sockets[0], "got socket %#lx\n", (ULONG_PTR)set->fd_array[0] );
+    ok( set->fd_array[1] == sockets[step], "got socket %#lx\n", (ULONG_PTR)set->fd_array[1] );
+
+    /* reading the pending data makes the socket idle again */
+    ret = recv( sockets[0], buf, sizeof(buf), 0 );
+    ok( ret == 1, "recv returned %d, error %d\n", ret, WSAGetLastError() );
+    memcpy( set, readfds, size );
+    ret = select( 0, set, NULL, NULL, &timeout );
+    ok( ret == active_count - 1, "got %d ready sockets\n", ret );
+
+    /* a closed socket is no longer valid, even if its handle gets reused */
+    closesocket( sockets[step] );
+    memcpy( set, readfds, size );
+    SetLastError( 0xdeadbeef );
+    ret = select( 0, set, NULL, NULL, &timeout );
+    ok( ret == SOCKET_ERROR, "got %d\n", ret );
+    ok( WSAGetLastError() == WSAENOTSOCK, "got error %d\n", WSAGetLastError() );
+
+    sockets[step] = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    ok( sockets[step] != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError() );
+    addr.sin_port = 0;
+    ret = bind( sockets[step], (struct sockaddr *)&addr, sizeof(addr) );
+    ok( !ret, "bind failed, error %d\n", WSAGetLastError() );
+    readfds->fd_array[step] = sockets[step];
+    memcpy( set, readfds, size );
+    ret = select( 0, set, NULL, NULL, &timeout );
+    ok( ret == active_count - 2, "got %d ready sockets\n", ret );
+
+    if (pWSAPoll)
+    {
+        fds = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*fds) );
+        for (i = 0; i < count; i++)
+        {
+            fds[i].fd = sockets[i];
+            fds[i].events = POLLRDNORM;
+            fds[i].revents = 0;
+        }
+
+        start = GetTickCount();
+        for (i = 0; i < loops; i++)
+        {
+            ret = pWSAPoll( fds, count, 0 );
+            ok( ret == active_count - 2, "got %d ready sockets\n", ret );
+        }
+        if (winetest_interactive)
+            trace( "WSAPoll: %u calls over %u sockets with %u ready took %u ms\n",
+                   loops, count, active_count - 2, GetTickCount() - start );
+        ok( fds[0].revents == 0, "got events %#x\n", fds[0].revents );
+        ok( fds[2 * step].revents == POLLRDNORM, "got events %#x\n", fds[2 * step].revents );
+
+        HeapFree( GetProcessHeap(), 0, fds );
+    }
+    else
+        skip( "WSAPoll is unsupported.\n" );
+
+    HeapFree( GetProcessHeap(), 0, set );
+    HeapFree( GetProcessHeap(), 0, readfds );
+
+done:
+    for (i = 0; i < count; i++) closesocket( sockets[i] );
+    HeapFree( GetProcessHeap(), 0, sockets );
+    closesocket( sender );
+}
+
+/* sockets that select() and WSAPoll() were already called on, closed while waiting on them again */
+static void test_select_close_cached(void)
+{
+    const struct timeval timeout = {0, 0}, close_timeout = {2, 0};
+    SOCKET fdRead, fdWrite, listener;
+    struct sockaddr_in addr;
+    HANDLE thread;
+    fd_set readfds;
+    WSAPOLLFD fds;
+    DWORD id;
+    int ret, len;
+
+    ok( !tcp_socketpair( &fdRead, &fdWrite ), "creating socket pair failed\n" );
+    FD_ZERO( &readfds );
+    FD_SET( fdWrite, &readfds );
+    ret = select( 0, &readfds, NULL, NULL, &timeout );
+    ok( !ret, "got %d\n", ret );
+    thread = CreateThread( NULL, 0, SelectCloseThread, &fdWrite, 0, &id );
+    ok( thread != NULL, "CreateThread failed, error %u\n", GetLastError() );
+    FD_ZERO( &readfds );
+    FD_SET( fdWrite, &readfds );
+    ret = select( 0, &readfds, NULL, NULL, &close_timeout );
+    ok( ret == 1, "got %d\n", ret );
+    ok( FD_ISSET( fdWrite, &readfds ), "fdWrite socket is not in the set\n" );
+    WaitForSingleObject( thread, 1000 );
+    CloseHandle( thread );
+    closesocket( fdRead );
+
+    if (pWSAPoll)
+    {
+        ok( !tcp_socketpair( &fdRead, &fdWrite ), "creating socket pair failed\n" );
+        fds.fd = fdWrite;
+        fds.events = POLLRDNORM;
+        fds.revents = 0xdead;
+        ret = pWSAPoll( &fds, 1, 0 );
+        ok( !ret, "got %d\n", ret );
+        ok( !fds.revents, "got events %#x\n", fds.revents );
+        thread = CreateThread( NULL, 0, SelectCloseThread, &fdWrite, 0, &id );
+        ok( thread != NULL, "CreateThread failed, error %u\n", GetLastError() );
+        ret = pWSAPoll( &fds, 1, 2000 );
+        ok( ret == 1, "got %d\n", ret );
+        ok( fds.revents == POLLNVAL, "got events %#x\n", fds.revents );
+        WaitForSingleObject( thread, 1000 );
+        CloseHandle( thread );
+        closesocket( fdRead );
+    }
+    else
+        skip( "WSAPoll is unsupported.\n" );
+
+    /* a socket closed through CloseHandle() whose handle is reused by an idle listener */
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr( "127.0.0.1" );
+    listener = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    ok( listener != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError() );
+    ret = bind( listener, (struct sockaddr *)&addr, sizeof(addr) );
+    ok( !ret, "bind failed, error %d\n", WSAGetLastError() );
+    ret = listen( listener, 1 );
+    ok( !ret, "listen failed, error %d\n", WSAGetLastError() );
+    FD_ZERO( &readfds );
+    FD_SET( listener, &readfds );
+    ret = select( 0, &readfds, NULL, NULL, &timeout );
+    ok( !ret, "got %d\n", ret );
+    CloseHandle( (HANDLE)listener );
+
+    listener = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    ok( listener != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError() );
+    ret = bind( listener, (struct sockaddr *)&addr, sizeof(addr) );
+    ok( !ret, "bind failed, error %d\n", WSAGetLastError() );
+    ret = listen( listener, 1 );
+    ok( !ret, "listen failed, error %d\n", WSAGetLastError() );
+    FD_ZERO( &readfds );
+    FD_SET( listener, &readfds );
+    ret = select( 0, &readfds, NULL, NULL, &timeout );
+    ok( !ret, "got %d\n", ret );
+    ok( !readfds.fd_count, "got %u sockets in the set\n", readfds.fd_count );
+    closesocket( listener );
+
+    /* the port of an idle listener closed through CloseHandle() is released by the next call */
+    listener = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    ok( listener != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError() );
+    ret = bind( listener, (struct sockaddr *)&addr, sizeof(addr) );
+    ok( !ret, "bind failed, error %d\n", WSAGetLastError() );
+    len = sizeof(addr);
+    ret = getsockname( listener, (struct sockaddr *)&addr, &len );
+    ok( !ret, "getsockname failed, error %d\n", WSAGetLastError() );
+    ret = listen( listener, 1 );
+    ok( !ret, "listen failed, error %d\n", WSAGetLastError() );
+    FD_ZERO( &readfds );
+    FD_SET( listener, &readfds );
+    ret = select( 0, &readfds, NULL, NULL, &timeout );
+    ok( !ret, "got %d\n", ret );
+    CloseHandle( (HANDLE)listener );
+
+    ok( !tcp_socketpair( &fdRead, &fdWrite ), "creating socket pair failed\n" );
+    FD_ZERO( &readfds );
+    FD_SET( fdRead, &readfds );
+    ret = select( 0, &readfds, NULL, NULL, &timeout );
+    ok( !ret, "got %d\n", ret );
+    closesocket( fdRead );
+    closesocket( fdWrite );
+
+    listener = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    ok( listener != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError() );
+    ret = bind( listener, (struct sockaddr *)&addr, sizeof(addr) );
+    ok( !ret, "bind to port %u failed, error %d\n", ntohs( addr.sin_port ), WSAGetLastError() );
+    closesocket( listener );
+}
 #undef POLL_SET
 #undef POLL_ISSET
 #undef POLL_CLEAR
@@ -9095,6 +9336,130 @@ cleanup:
     closesocket(server);
 }
 
+struct transmit_recv_params
+{
+    SOCKET sock;
+    char  *buffer;
+    int    size;
+    int    received;
+};
+
+static DWORD WINAPI transmit_recv_thread( void *arg )
+{
+    struct transmit_recv_params *params = arg;
+    int ret;
+
+    while (params->received < params->size)
+    {
+        ret = recv( params->sock, params->buffer + params->received, params->size - params->received, 0 );
+        if (ret <= 0) break;
+        params->received += ret;
+    }
+    return 0;
+}
+
+static void test_TransmitFile_large(void)
+{
+    static const char header_msg[] = "header", footer_msg[] = "footer";
+    static const DWORD offset = 12345, limit = 1000000;
+    /* larger than the socket buffers; the large size is only useful for benchmarking */
+    const DWORD file_size = winetest_interactive ? 16 * 1024 * 1024 : 2 * 1024 * 1024;
+    GUID transmitFileGuid = WSAID_TRANSMITFILE;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    struct transmit_recv_params params;
+    char path[MAX_PATH], *data;
+    TRANSMIT_FILE_BUFFERS buffers;
+    DWORD i, size, start, total_sent;
+    SOCKET client, dest;
+    WSAOVERLAPPED ov;
+    HANDLE file, thread;
+    BOOL bret;
+    int iret;
+
+    if (tcp_socketpair( &client, &dest ))
+    {
+        skip( "failed to create sockets\n" );
+        return;
+    }
+    iret = WSAIoctl( client, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitFileGuid, sizeof(transmitFileGuid),
+                     &pTransmitFile, sizeof(pTransmitFile), &size, NULL, NULL );
+    if (iret)
+    {
+        skip( "WSAIoctl failed to get TransmitFile, error %d\n", WSAGetLastError() );
+        closesocket( client );
+        closesocket( dest );
+        return;
+    }
+
+    GetTempPathA( MAX_PATH, path );
+    strcat( path, "transmitfile.tmp" );
+    file = CreateFileA( path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed, error %u\n", GetLastError() );
+
+    data = HeapAlloc( GetProcessHeap(), 0, file_size + 64 );
+    for (i = 0; i < file_size; i++) data[i] = i * 7 + (i >> 12);
+    bret = WriteFile( file, data, file_size, &size, NULL );
+    ok( bret && size == file_size, "WriteFile failed, error %u\n", GetLastError() );
+
+    /* whole file with head and tail buffers */
+    memset( &params, 0, sizeof(params) );
+    params.sock = dest;
+    params.size = sizeof(header_msg) + file_size + sizeof(footer_msg);
+    params.buffer = HeapAlloc( GetProcessHeap(), 0, params.size );
+    thread = CreateThread( NULL, 0, transmit_recv_thread, &params, 0, NULL );
+
+    buffers.Head = (void *)header_msg;
+    buffers.HeadLength = sizeof(header_msg);
+    buffers.Tail = (void *)footer_msg;
+    buffers.TailLength = sizeof(footer_msg);
+    SetFilePointer( file, 0, NULL, FILE_BEGIN );
+    start = GetTickCount();
+    bret = pTransmitFile( client, file, 0, 0, NULL, &buffers, 0 );
+    ok( bret, "TransmitFile failed, error %d\n", WSAGetLastError() );
+    WaitForSingleObject( thread, 10000 );
+    if (winetest_interactive)
+        trace( "sent %u bytes with TransmitFile in %u ms\n", file_size, GetTickCount() - start );
+    CloseHandle( thread );
+
+    ok( params.received == params.size, "received %d bytes, expected %d\n", params.received, params.size );
+    ok( !memcmp( params.buffer, header_msg, sizeof(header_msg) ), "header didn't match\n" );
+    ok( !memcmp( params.buffer + sizeof(header_msg), data, file_size ), "file data didn't match\n" );
+    ok( !memcmp( params.buffer + sizeof(header_msg) + file_size, footer_msg, sizeof(footer_msg) ),
+        "footer didn't match\n" );
+    ok( SetFilePointer( file, 0, NULL, FILE_CURRENT ) == file_size, "got file position %u\n",
+        SetFilePointer( file, 0, NULL, FILE_CURRENT ) );
+
+    /* overlapped, with an offset and a size limit */
+    memset( params.buffer, 0, params.size );
+    params.size = limit;
+    params.received = 0;
+    thread = CreateThread( NULL, 0, transmit_recv_thread, &params, 0, NULL );
+
+    memset( &ov, 0, sizeof(ov) );
+    ov.hEvent = CreateEventW( NULL, FALSE, FALSE, NULL );
+    ov.Offset = offset;
+    bret = pTransmitFile( client, file, limit, 0, &ov, NULL, 0 );
+    ok( !bret, "TransmitFile succeeded unexpectedly\n" );
+    ok( WSAGetLastError() == ERROR_IO_PENDING, "got error %d\n", WSAGetLastError() );
+    iret = WaitForSingleObject( ov.hEvent, 10000 );
+    ok( iret == WAIT_OBJECT_0, "overlapped TransmitFile failed\n" );
+    WSAGetOverlappedResult( client, &ov, &total_sent, FALSE, NULL );
+    ok( total_sent == limit, "sent %u bytes, expected %u\n", total_sent, limit );
+    WaitForSingleObject( thread, 10000 );
+    CloseHandle( thread );
+
+    ok( params.received == limit, "received %d bytes, expected %u\n", params.received, limit );
+    ok( !memcmp( params.buffer, data + offset, limit ), "file data didn't match\n" );
+
+    CloseHandle( ov.hEvent );
+    HeapFree( GetProcessHeap(), 0, params.buffer );
+    HeapFree( GetProcessHeap(), 0, data );
+    CloseHandle( file );
+    closesocket( client );
+    closesocket( dest );
+}
+
 static void test_getpeername(void)
 {
     SOCKET sock;
@@ -11582,6 +11947,8 @@ START_TEST( sock )
     test_WSASendTo();
     test_WSARecv();
     test_WSAPoll();
+    test_select_many_sockets();
+    test_select_close_cached();
     test_write_watch();
     test_iocp();
 
@@ -11590,6 +11957,7 @@ START_TEST( sock )
 
     test_ipv6only();
     test_TransmitFile();
+    test_TransmitFile_large();
     test_GetAddrInfoW();
     test_GetAddrInfoExW();
     test_getaddrinfo();
@@ -50,6 +50,62 @@ struct request_max_size
     int pad[16];
 };
 
+
+
+#define BATCH_ALIGN(size) (((size) + 7) & ~7)
+
+
+struct inproc_sync
+{
+    int          state;
+    unsigned int max;
+};
+/* set while the server has threads waiting on the object; the state may then only
+ * be modified through server requests */
+#define INPROC_SYNC_WAITERS  0x80000000
+#define INPROC_SYNC_MAX_OBJECTS  65536
+
+
+struct inproc_completion_packet
+{
+    int           seq;
+    unsigned int  status;
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+};
+#define INPROC_COMPLETION_PACKETS  1024
+#define INPROC_COMPLETION_MAX_PORTS  256
+
+/* state of a completion port queue in the shared region; the packets are kept
+ * in a bounded lock-free ring that both the server and the clients can use */
+struct inproc_completion
+{
+    int           head;
+    int           tail;
+    int           futex;
+    int           waiters;
+    int           flags;
+    int           generation;
+    int           pad[2];
+    struct inproc_completion_packet packets[INPROC_COMPLETION_PACKETS];
+};
+
+#define INPROC_COMPLETION_SERVER_WAITERS  0x01
+/* set while the ring is full and the server keeps further packets in its own queue;
+ * clients then have to go through server requests */
+#define INPROC_COMPLETION_OVERFLOW        0x02
+
+
+struct queue_shm
+{
+    unsigned int wake_bits;
+    unsigned int changed_bits;
+    unsigned int wake_mask;
+    unsigned int changed_mask;
+};
+#define QUEUE_SHM_MAX_QUEUES  16384
+
 #define FIRST_USER_HANDLE 0x0020
 #define LAST_USER_HANDLE  0xffef
 
@@ -252,6 +308,24 @@ typedef struct
 } rectangle_t;
 
 
+struct window_shm
+{
+    int           seq;
+    user_handle_t handle;
+    user_handle_t parent;
+    user_handle_t owner;
+    thread_id_t   tid;
+    process_id_t  pid;
+    unsigned int  style;
+    unsigned int  ex_style;
+    unsigned int  id;
+    unsigned int  dpi;
+    rectangle_t   window_rect;
+    rectangle_t   client_rect;
+};
+#define WINDOW_SHM_MAX_WINDOWS  ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+
+
 typedef struct
 {
     obj_handle_t    handle;
@@ -1162,6 +1236,22 @@ struct close_handle_reply
 
 
 
+struct batch_request
+{
+    struct request_header __header;
+    /* VARARG(requests,bytes); */
+    char __pad_12[4];
+};
+struct batch_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    /* VARARG(replies,bytes); */
+    char __pad_12[4];
+};
+
+
+
 struct set_handle_info_request
 {
     struct request_header __header;
@@ -1476,6 +1566,58 @@ struct open_semaphore_reply
 
 
 
+struct get_inproc_sync_region_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_inproc_sync_region_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+struct get_inproc_sync_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_inproc_sync_reply
+{
+    struct reply_header __header;
+    int          type;
+    unsigned int index;
+    unsigned int access;
+    char __pad_20[4];
+};
+enum inproc_sync_type
+{
+    INPROC_SYNC_NONE,
+    INPROC_SYNC_AUTO_EVENT,
+    INPROC_SYNC_MANUAL_EVENT,
+    INPROC_SYNC_SEMAPHORE,
+    INPROC_SYNC_COMPLETION
+};
+
+
+
+struct get_inproc_completion_region_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_inproc_completion_region_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
 struct create_file_request
 {
     struct request_header __header;
@@ -2330,7 +2472,9 @@ struct get_mapping_info_reply
     mem_size_t   size;
     unsigned int flags;
     obj_handle_t shared_file;
+    obj_handle_t layout_file;
     /* VARARG(image,pe_image_info); */
+    char __pad_28[4];
 };
 
 
@@ -3087,6 +3231,22 @@ struct get_queue_status_reply
 
 
 
+struct get_queue_shm_request
+{
+    struct request_header __header;
+    int          map;
+};
+struct get_queue_shm_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    data_size_t  size;
+    unsigned int index;
+    char __pad_20[4];
+};
+
+
+
 struct get_process_idle_event_request
 {
     struct request_header __header;
@@ -3566,6 +3726,20 @@ struct get_window_info_reply
 
 
 
+struct get_window_shm_region_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_window_shm_region_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    data_size_t  size;
+};
+
+
+
 struct set_window_info_request
 {
     struct request_header __header;
@@ -5423,6 +5597,18 @@ struct add_completion_reply
 
 
 
+struct wake_completion_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+};
+struct wake_completion_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct remove_completion_request
 {
     struct request_header __header;
@@ -5809,6 +5995,7 @@ enum request
     REQ_queue_apc,
     REQ_get_apc_result,
     REQ_close_handle,
+    REQ_batch,
     REQ_set_handle_info,
     REQ_dup_handle,
     REQ_open_process,
@@ -5828,6 +6015,9 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_get_inproc_sync_region,
+    REQ_get_inproc_sync,
+    REQ_get_inproc_completion_region,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -5922,6 +6112,7 @@ enum request
     REQ_set_queue_fd,
     REQ_set_queue_mask,
     REQ_get_queue_status,
+    REQ_get_queue_shm,
     REQ_get_process_idle_event,
     REQ_send_message,
     REQ_post_quit_message,
@@ -5949,6 +6140,7 @@ enum request
     REQ_get_desktop_window,
     REQ_set_window_owner,
     REQ_get_window_info,
+    REQ_get_window_shm_region,
     REQ_set_window_info,
     REQ_set_parent,
     REQ_get_window_parents,
@@ -6059,6 +6251,7 @@ enum request
     REQ_create_completion,
     REQ_open_completion,
     REQ_add_completion,
+    REQ_wake_completion,
     REQ_remove_completion,
     REQ_query_completion,
     REQ_set_completion_info,
@@ -6113,6 +6306,7 @@ union generic_request
     struct queue_apc_request queue_apc_request;
     struct get_apc_result_request get_apc_result_request;
     struct close_handle_request close_handle_request;
+    struct batch_request batch_request;
     struct set_handle_info_request set_handle_info_request;
     struct dup_handle_request dup_handle_request;
     struct open_process_request open_process_request;
@@ -6132,6 +6326,9 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct get_inproc_sync_region_request get_inproc_sync_region_request;
+    struct get_inproc_sync_request get_inproc_sync_request;
+    struct get_inproc_completion_region_request get_inproc_completion_region_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -6226,6 +6423,7 @@ union generic_request
     struct set_queue_fd_request set_queue_fd_request;
     struct set_queue_mask_request set_queue_mask_request;
     struct get_queue_status_request get_queue_status_request;
+    struct get_queue_shm_request get_queue_shm_request;
     struct get_process_idle_event_request get_process_idle_event_request;
     struct send_message_request send_message_request;
     struct post_quit_message_request post_quit_message_request;
@@ -6253,6 +6451,7 @@ union generic_request
     struct get_desktop_window_request get_desktop_window_request;
     struct set_window_owner_request set_window_owner_request;
     struct get_window_info_request get_window_info_request;
+    struct get_window_shm_region_request get_window_shm_region_request;
     struct set_window_info_request set_window_info_request;
     struct set_parent_request set_parent_request;
     struct get_window_parents_request get_window_parents_request;
@@ -6363,6 +6562,7 @@ union generic_request
     struct create_completion_request create_completion_request;
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
+    struct wake_completion_request wake_completion_request;
     struct remove_completion_request remove_completion_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
@@ -6415,6 +6615,7 @@ union generic_reply
     struct queue_apc_reply queue_apc_reply;
     struct get_apc_result_reply get_apc_result_reply;
     struct close_handle_reply close_handle_reply;
+    struct batch_reply batch_reply;
     struct set_handle_info_reply set_handle_info_reply;
     struct dup_handle_reply dup_handle_reply;
     struct open_process_reply open_process_reply;
@@ -6434,6 +6635,9 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct get_inproc_sync_region_reply get_inproc_sync_region_reply;
+    struct get_inproc_sync_reply get_inproc_sync_reply;
+    struct get_inproc_completion_region_reply get_inproc_completion_region_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -6528,6 +6732,7 @@ union generic_reply
     struct set_queue_fd_reply set_queue_fd_reply;
     struct set_queue_mask_reply set_queue_mask_reply;
     struct get_queue_status_reply get_queue_status_reply;
+    struct get_queue_shm_reply get_queue_shm_reply;
     struct get_process_idle_event_reply get_process_idle_event_reply;
     struct send_message_reply send_message_reply;
     struct post_quit_message_reply post_quit_message_reply;
@@ -6555,6 +6760,7 @@ union generic_reply
     struct get_desktop_window_reply get_desktop_window_reply;
     struct set_window_owner_reply set_window_owner_reply;
     struct get_window_info_reply get_window_info_reply;
+    struct get_window_shm_region_reply get_window_shm_region_reply;
     struct set_window_info_reply set_window_info_reply;
     struct set_parent_reply set_parent_reply;
     struct get_window_parents_reply get_window_parents_reply;
@@ -6665,6 +6871,7 @@ union generic_reply
     struct create_completion_reply create_completion_reply;
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
+    struct wake_completion_reply wake_completion_reply;
     struct remove_completion_reply remove_completion_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
@@ -6691,6 +6898,6 @@ union generic_reply
     struct resume_process_reply resume_process_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 588
+#define SERVER_PROTOCOL_VERSION 594
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
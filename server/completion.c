@@ -46,13 +46,17 @@
 
 struct completion
 {
-    struct object  obj;
-    struct list    queue;
-    unsigned int   depth;
+    struct object            obj;
+    struct list              queue;
+    unsigned int             depth;
+    struct inproc_completion *shm;   /* queue in the shared region, if clients use it */
+    struct inproc_region *region;    /* shared region holding the queue */
 };
 
 static void completion_dump( struct object*, int );
 static struct object_type *completion_get_type( struct object *obj );
+static int completion_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void completion_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int completion_signaled( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int completion_map_access( struct object *obj, unsigned int access );
 static void completion_destroy( struct object * );
@@ -62,8 +66,8 @@ static const struct object_ops completion_ops =
     sizeof(struct completion), /* size */
     completion_dump,           /* dump */
     completion_get_type,       /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    completion_add_queue,      /* add_queue */
+    completion_remove_queue,   /* remove_queue */
     completion_signaled,       /* signaled */
     no_satisfied,              /* satisfied */
     no_signal,                 /* signal */
@@ -89,6 +93,139 @@ struct comp_msg
     unsigned int  status;
 };
 
+/* number of packets in the shared ring */
+static unsigned int shared_queue_depth( const struct inproc_completion *shm )
+{
+    int depth = (unsigned int)shm->tail - (unsigned int)shm->head;
+    return depth > 0 ? depth : 0;
+}
+
+/* check whether the packet at the head of the shared ring has been fully added */
+static int shared_queue_ready( const struct inproc_completion *shm )
+{
+    unsigned int pos = shm->head;
+    return shm->packets[pos & (INPROC_COMPLETION_PACKETS - 1)].seq == pos + 1;
+}
+
+/* add a packet to the shared ring, using the same protocol as the clients; fails if the ring is full */
+static int push_shared_packet( struct inproc_completion *shm, apc_param_t ckey, apc_param_t cvalue,
+                               unsigned int status, apc_param_t information )
+{
+    struct inproc_completion_packet *packet;
+    unsigned int pos = shm->tail, prev, retries;
+    int diff;
+
+    /* the ring is writable by the client, so don't spin forever if it got corrupted */
+    for (retries = 0; ; retries++)
+    {
+        if (retries > INPROC_COMPLETION_PACKETS) return 0;
+        packet = &shm->packets[pos & (INPROC_COMPLETION_PACKETS - 1)];
+        diff = packet->seq - pos;
+        if (!diff)
+        {
+            if ((prev = interlocked_cmpxchg( &shm->tail, pos + 1, pos )) == pos) break;
+            pos = prev;
+        }
+        else if (diff < 0) return 0;
+        else pos = shm->tail;
+    }
+    packet->ckey        = ckey;
+    packet->cvalue      = cvalue;
+    packet->status      = status;
+    packet->information = information;
+    interlocked_xchg( &packet->seq, pos + 1 );
+    return 1;
+}
+
+/* remove a packet from the shared ring; fails if it is empty */
+static int pop_shared_packet( struct inproc_completion *shm, struct remove_completion_reply *reply )
+{
+    struct inproc_completion_packet *packet;
+    unsigned int pos = shm->head, prev, retries;
+    int diff;
+
+    for (retries = 0; ; retries++)
+    {
+        if (retries > INPROC_COMPLETION_PACKETS) return 0;
+        packet = &shm->packets[pos & (INPROC_COMPLETION_PACKETS - 1)];
+        diff = packet->seq - (pos + 1);
+        if (!diff)
+        {
+            if ((prev = interlocked_cmpxchg( &shm->head, pos + 1, pos )) == pos) break;
+            pos = prev;
+        }
+        else if (diff < 0) return 0;
+        else pos = shm->head;
+    }
+    reply->ckey        = packet->ckey;
+    reply->cvalue      = packet->cvalue;
+    reply->status      = packet->status;
+    reply->information = packet->information;
+    interlocked_xchg( &packet->seq, pos + INPROC_COMPLETION_PACKETS );
+    return 1;
+}
+
+/* atomically set or clear some flags of the shared queue */
+static void set_shared_queue_flags( struct inproc_completion *shm, int set, int clear )
+{
+    int old;
+
+    do old = shm->flags;
+    while (interlocked_cmpxchg( &shm->flags, (old & ~clear) | set, old ) != old);
+}
+
+/* wake up a client thread waiting for packets on the shared queue */
+static void wake_shared_queue( struct inproc_completion *shm, int count )
+{
+    interlocked_xchg_add( &shm->futex, 1 );
+    if (shm->waiters) inproc_futex_wake( &shm->futex, count );
+}
+
+/* move as many packets as possible from the server queue to the shared ring */
+static void fill_shared_queue( struct completion *completion )
+{
+    struct comp_msg *msg, *next;
+    int count = 0;
+
+    LIST_FOR_EACH_ENTRY_SAFE( msg, next, &completion->queue, struct comp_msg, queue_entry )
+    {
+        if (!push_shared_packet( completion->shm, msg->ckey, msg->cvalue, msg->status, msg->information ))
+            break;
+        list_remove( &msg->queue_entry );
+        completion->depth--;
+        free( msg );
+        count++;
+    }
+    if (list_empty( &completion->queue )) set_shared_queue_flags( completion->shm, 0, INPROC_COMPLETION_OVERFLOW );
+    if (count) wake_shared_queue( completion->shm, count );
+}
+
+/* move the completion queue to the shared region */
+int get_completion_inproc_sync( struct object *obj, unsigned int *index )
+{
+    struct completion *completion = (struct completion *)obj;
+
+    if (obj->ops != &completion_ops) return INPROC_SYNC_NONE;
+    if (!completion->shm)
+    {
+        if (!(completion->shm = alloc_inproc_completion( current->process, &completion->region )))
+        {
+            clear_error();
+            return INPROC_SYNC_NONE;
+        }
+        if (!list_empty( &obj->wait_queue ))
+            set_shared_queue_flags( completion->shm, INPROC_COMPLETION_SERVER_WAITERS, 0 );
+        if (!list_empty( &completion->queue ))
+        {
+            set_shared_queue_flags( completion->shm, INPROC_COMPLETION_OVERFLOW, 0 );
+            fill_shared_queue( completion );
+        }
+    }
+    if (!get_inproc_completion_index( completion->region, completion->shm, index ))
+        return INPROC_SYNC_NONE;
+    return INPROC_SYNC_COMPLETION;
+}
+
 static void completion_destroy( struct object *obj)
 {
     struct completion *completion = (struct completion *) obj;
@@ -98,6 +235,7 @@ static void completion_destroy( struct object *obj)
     {
         free( tmp );
     }
+    if (completion->shm) free_inproc_completion( completion->region, completion->shm );
 }
 
 static void completion_dump( struct object *obj, int verbose )
@@ -105,7 +243,8 @@ static void completion_dump( struct object *obj, int verbose )
     struct completion *completion = (struct completion *) obj;
 
     assert( obj->ops == &completion_ops );
-    fprintf( stderr, "Completion depth=%u\n", completion->depth );
+    fprintf( stderr, "Completion depth=%u\n", completion->depth +
+             (completion->shm ? shared_queue_depth( completion->shm ) : 0) );
 }
 
 static struct object_type *completion_get_type( struct object *obj )
@@ -115,10 +254,32 @@ static struct object_type *completion_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int completion_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct completion *completion = (struct completion *)obj;
+
+    /* the flag is set before the queue is checked, so that clients adding packets
+     * in-process either get seen or see the flag and wake us up */
+    if (completion->shm && list_empty( &obj->wait_queue ))
+        set_shared_queue_flags( completion->shm, INPROC_COMPLETION_SERVER_WAITERS, 0 );
+    return add_queue( obj, entry );
+}
+
+static void completion_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct completion *completion = (struct completion *)obj;
+
+    if (completion->shm && list_head( &obj->wait_queue ) == &entry->entry &&
+        list_tail( &obj->wait_queue ) == &entry->entry)
+        set_shared_queue_flags( completion->shm, 0, INPROC_COMPLETION_SERVER_WAITERS );
+    remove_queue( obj, entry );
+}
+
 static int completion_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct completion *completion = (struct completion *)obj;
 
+    if (completion->shm && shared_queue_ready( completion->shm )) return 1;
     return !list_empty( &completion->queue );
 }
 
@@ -143,6 +304,8 @@ static struct completion *create_completion( struct object *root, const struct u
         {
             list_init( &completion->queue );
             completion->depth = 0;
+            completion->shm = NULL;
+            completion->region = NULL;
         }
     }
 
@@ -157,9 +320,17 @@ struct completion *get_completion_obj( struct process *process, obj_handle_t han
 void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
                      unsigned int status, apc_param_t information )
 {
-    struct comp_msg *msg = mem_alloc( sizeof( *msg ) );
+    struct comp_msg *msg;
+
+    if (completion->shm && list_empty( &completion->queue ) &&
+        push_shared_packet( completion->shm, ckey, cvalue, status, information ))
+    {
+        wake_shared_queue( completion->shm, 1 );
+        wake_up( &completion->obj, 1 );
+        return;
+    }
 
-    if (!msg)
+    if (!(msg = mem_alloc( sizeof( *msg ) )))
         return;
 
     msg->ckey = ckey;
@@ -169,6 +340,12 @@ void add_completion( struct completion *completion, apc_param_t ckey, apc_param_
 
     list_add_tail( &completion->queue, &msg->queue_entry );
     completion->depth++;
+    if (completion->shm)
+    {
+        /* the ring is full, clients have to go through the server until it is drained */
+        set_shared_queue_flags( completion->shm, INPROC_COMPLETION_OVERFLOW, 0 );
+        wake_shared_queue( completion->shm, 1 );
+    }
     wake_up( &completion->obj, 1 );
 }
 
@@ -223,8 +400,11 @@ DECL_HANDLER(remove_completion)
 
     if (!completion) return;
 
-    entry = list_head( &completion->queue );
-    if (!entry)
+    if (completion->shm && pop_shared_packet( completion->shm, reply ))
+    {
+        if (!list_empty( &completion->queue )) fill_shared_queue( completion );
+    }
+    else if (!(entry = list_head( &completion->queue )))
         set_error( STATUS_PENDING );
     else
     {
@@ -236,11 +416,24 @@ DECL_HANDLER(remove_completion)
         reply->status = msg->status;
         reply->information = msg->information;
         free( msg );
+        if (completion->shm) fill_shared_queue( completion );
     }
 
     release_object( completion );
 }
 
+/* wake the threads waiting on a completion port */
+DECL_HANDLER(wake_completion)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+
+    if (!completion) return;
+
+    wake_up( &completion->obj, 0 );
+
+    release_object( completion );
+}
+
 /* get queue depth for completion port */
 DECL_HANDLER(query_completion)
 {
@@ -249,6 +442,7 @@ DECL_HANDLER(query_completion)
     if (!completion) return;
 
     reply->depth = completion->depth;
+    if (completion->shm) reply->depth += shared_queue_depth( completion->shm );
 
     release_object( completion );
 }
@@ -41,24 +41,29 @@ struct event
     struct object  obj;             /* object header */
     struct list    kernel_object;   /* list of kernel object pointers */
     int            manual_reset;    /* is it a manual reset event? */
-    int            signaled;        /* event has been signaled */
+    struct inproc_sync *sync;       /* signaled state, possibly in the shared region */
+    struct inproc_sync  state;      /* signaled state when not in the shared region */
+    struct inproc_region *region;   /* shared region holding the state, if any */
 };
 
 static void event_dump( struct object *obj, int verbose );
 static struct object_type *event_get_type( struct object *obj );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
 static struct list *event_get_kernel_obj_list( struct object *obj );
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -72,7 +77,7 @@ static const struct object_ops event_ops =
     no_open_file,              /* open_file */
     event_get_kernel_obj_list, /* get_kernel_obj_list */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -123,7 +128,10 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             /* initialize it if it didn't already exist */
             list_init( &event->kernel_object );
             event->manual_reset = manual_reset;
-            event->signaled     = initial_state;
+            event->state.state  = initial_state ? 1 : 0;
+            event->state.max    = 1;
+            event->sync         = &event->state;
+            event->region       = NULL;
         }
     }
     return event;
@@ -136,22 +144,33 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
 
 void pulse_event( struct event *event )
 {
-    event->signaled = 1;
+    inproc_sync_set_value( event->sync, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
-    event->signaled = 0;
+    inproc_sync_set_value( event->sync, 0 );
 }
 
 void set_event( struct event *event )
 {
-    event->signaled = 1;
+    inproc_sync_set_value( event->sync, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
 }
 
 void reset_event( struct event *event )
 {
-    event->signaled = 0;
+    inproc_sync_set_value( event->sync, 0 );
+}
+
+/* move the event state to the shared region and return its type */
+int get_event_inproc_sync( struct object *obj, unsigned int *index )
+{
+    struct event *event = (struct event *)obj;
+
+    if (obj->ops != &event_ops) return INPROC_SYNC_NONE;
+    if (!get_inproc_sync_index( &event->sync, &event->state, &event->region, index ))
+        return INPROC_SYNC_NONE;
+    return event->manual_reset ? INPROC_SYNC_MANUAL_EVENT : INPROC_SYNC_AUTO_EVENT;
 }
 
 static void event_dump( struct object *obj, int verbose )
@@ -159,7 +178,7 @@ static void event_dump( struct object *obj, int verbose )
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     fprintf( stderr, "Event manual=%d signaled=%d\n",
-             event->manual_reset, event->signaled );
+             event->manual_reset, inproc_sync_value( event->sync ) );
 }
 
 static struct object_type *event_get_type( struct object *obj )
@@ -169,11 +188,25 @@ static struct object_type *event_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    return inproc_sync_add_queue( obj, entry, event->sync );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    inproc_sync_remove_queue( obj, entry, event->sync );
+}
+
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    return inproc_sync_value( event->sync );
 }
 
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -181,7 +214,7 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset) inproc_sync_set_value( event->sync, 0 );
 }
 
 static unsigned int event_map_access( struct object *obj, unsigned int access )
@@ -213,6 +246,13 @@ static struct list *event_get_kernel_obj_list( struct object *obj )
     return &event->kernel_object;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->sync != &event->state) free_inproc_sync( event->region, event->sync );
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -322,7 +362,7 @@ DECL_HANDLER(event_op)
     struct event *event;
 
     if (!(event = get_event_obj( current->process, req->handle, EVENT_MODIFY_STATE ))) return;
-    reply->state = event->signaled;
+    reply->state = inproc_sync_value( event->sync );
     switch(req->op)
     {
     case PULSE_EVENT:
@@ -349,7 +389,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = inproc_sync_value( event->sync );
 
     release_object( event );
 }
@@ -152,12 +152,14 @@ extern mode_t sd_to_mode( const struct security_descriptor *sd, const SID *owner
 
 /* file mapping functions */
 
+extern int create_temp_file( file_pos_t size );
 extern struct mapping *get_mapping_obj( struct process *process, obj_handle_t handle,
                                         unsigned int access );
 extern struct file *get_mapping_file( struct process *process, client_ptr_t base,
                                       unsigned int access, unsigned int sharing );
 extern void free_mapped_views( struct process *process );
 extern int get_page_size(void);
+extern struct object *create_shared_mapping( mem_size_t size, void **ptr );
 
 /* device functions */
 
@@ -178,6 +180,7 @@ extern struct dir *get_dir_obj( struct process *process, obj_handle_t handle, un
 extern struct completion *get_completion_obj( struct process *process, obj_handle_t handle, unsigned int access );
 extern void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
                             unsigned int status, apc_param_t information );
+extern int get_completion_inproc_sync( struct object *obj, unsigned int *index );
 
 /* serial port functions */
 
@@ -0,0 +1,317 @@
+/*
+ * Server-side support for in-process synchronization objects
+ *
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The state of events and semaphores that clients want to access directly is
+ * kept in a memory region shared between the server and the client process.
+ * Clients update the state with atomic operations as long as the server has no
+ * thread waiting on the object; once a thread is queued on the object the
+ * server sets the INPROC_SYNC_WAITERS flag, and clients then fall back to
+ * server requests so that waiters get woken up.
+ *
+ * Completion port queues live in a separate region, as rings of packets that
+ * clients add to and remove from without server requests, waiting on a futex
+ * in the shared state when a queue is empty.
+ *
+ * Each process gets its own regions, so that a process can't corrupt the
+ * objects of another one. An object is moved to the regions of the first
+ * process that asks for it; other processes that have a handle to it keep
+ * going through server requests.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "process.h"
+#include "thread.h"
+#include "request.h"
+
+struct inproc_region
+{
+    unsigned int refcount;       /* one for the owning process, plus one per allocated entry */
+    int          fd;             /* fd of the region, sent to the owning process */
+    void        *base;           /* server mapping of the region */
+    size_t       size;           /* size of the region */
+    unsigned int next_index;     /* first never used index */
+    unsigned int free_index;     /* first index in the free list */
+};
+
+#define INPROC_SYNC_REGION_SIZE (INPROC_SYNC_MAX_OBJECTS * sizeof(struct inproc_sync))
+#define INPROC_COMPLETION_REGION_SIZE (INPROC_COMPLETION_MAX_PORTS * sizeof(struct inproc_completion))
+
+/* retrieve a region of a process, creating it on first use */
+static struct inproc_region *get_inproc_region( struct inproc_region **region, size_t size )
+{
+    struct inproc_region *ret;
+    void *ptr;
+    int fd;
+
+    if (*region) return *region;
+    if (!(ret = mem_alloc( sizeof(*ret) ))) return NULL;
+    if ((fd = create_temp_file( size )) == -1)
+    {
+        free( ret );
+        return NULL;
+    }
+    if ((ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        close( fd );
+        free( ret );
+        return NULL;
+    }
+    ret->refcount   = 1;
+    ret->fd         = fd;
+    ret->base       = ptr;
+    ret->size       = size;
+    ret->next_index = 0;
+    ret->free_index = ~0u;
+    return *region = ret;
+}
+
+/* release a reference to a region */
+void release_inproc_region( struct inproc_region *region )
+{
+    if (!region || --region->refcount) return;
+    munmap( region->base, region->size );
+    close( region->fd );
+    free( region );
+}
+
+/* allocate an entry in the sync region of a process, initialized from an existing state */
+struct inproc_sync *alloc_inproc_sync( struct process *process, const struct inproc_sync *init,
+                                       struct inproc_region **ret_region )
+{
+    struct inproc_region *region;
+    struct inproc_sync *sync, *base;
+
+    if (!(region = get_inproc_region( &process->inproc_sync, INPROC_SYNC_REGION_SIZE ))) return NULL;
+    base = region->base;
+
+    if (region->free_index != ~0u)
+    {
+        sync = base + region->free_index;
+        region->free_index = sync->max;  /* the free list is chained through the max field */
+    }
+    else if (region->next_index < INPROC_SYNC_MAX_OBJECTS) sync = base + region->next_index++;
+    else
+    {
+        set_error( STATUS_NO_MEMORY );
+        return NULL;
+    }
+    *sync = *init;
+    region->refcount++;
+    *ret_region = region;
+    return sync;
+}
+
+/* return an entry to the free list of its region */
+void free_inproc_sync( struct inproc_region *region, struct inproc_sync *sync )
+{
+    struct inproc_sync *base = region->base;
+
+    assert( sync >= base && sync < base + INPROC_SYNC_MAX_OBJECTS );
+    sync->state = 0;
+    sync->max = region->free_index;
+    region->free_index = sync - base;
+    release_inproc_region( region );
+}
+
+/* move an object state to the sync region of the current process on first use, and return
+ * its index in the region; fails if the state is in the region of another process */
+int get_inproc_sync_index( struct inproc_sync **sync, struct inproc_sync *state,
+                           struct inproc_region **region, unsigned int *index )
+{
+    struct inproc_sync *shared;
+
+    if (*sync == state)
+    {
+        if (!(shared = alloc_inproc_sync( current->process, state, region )))
+        {
+            clear_error();
+            return 0;
+        }
+        *sync = shared;
+    }
+    else if (*region != current->process->inproc_sync) return 0;
+
+    *index = *sync - (struct inproc_sync *)(*region)->base;
+    return 1;
+}
+
+/* allocate an empty completion port queue in the completion region of a process */
+struct inproc_completion *alloc_inproc_completion( struct process *process, struct inproc_region **ret_region )
+{
+    struct inproc_region *region;
+    struct inproc_completion *port, *base;
+    unsigned int i;
+
+    if (!(region = get_inproc_region( &process->inproc_completion, INPROC_COMPLETION_REGION_SIZE )))
+        return NULL;
+    base = region->base;
+
+    if (region->free_index != ~0u)
+    {
+        port = base + region->free_index;
+        region->free_index = port->head;  /* the free list is chained through the head field */
+    }
+    else if (region->next_index < INPROC_COMPLETION_MAX_PORTS) port = base + region->next_index++;
+    else
+    {
+        set_error( STATUS_NO_MEMORY );
+        return NULL;
+    }
+    port->head = port->tail = 0;
+    port->waiters = 0;
+    port->flags = 0;
+    for (i = 0; i < INPROC_COMPLETION_PACKETS; i++) port->packets[i].seq = i;
+    region->refcount++;
+    *ret_region = region;
+    return port;
+}
+
+/* return a completion port queue to the free list, waking up the clients still waiting on it */
+void free_inproc_completion( struct inproc_region *region, struct inproc_completion *port )
+{
+    struct inproc_completion *base = region->base;
+
+    assert( port >= base && port < base + INPROC_COMPLETION_MAX_PORTS );
+    interlocked_xchg_add( &port->generation, 1 );
+    interlocked_xchg_add( &port->futex, 1 );
+    inproc_futex_wake( &port->futex, INT_MAX );
+    port->head = region->free_index;
+    region->free_index = port - base;
+    release_inproc_region( region );
+}
+
+/* return the index of a completion port queue in its region; fails if the
+ * queue is in the region of another process than the current one */
+int get_inproc_completion_index( struct inproc_region *region, const struct inproc_completion *port,
+                                 unsigned int *index )
+{
+    if (region != current->process->inproc_completion) return 0;
+    *index = port - (const struct inproc_completion *)region->base;
+    return 1;
+}
+
+/* wake up client threads waiting on a futex in one of the shared regions */
+void inproc_futex_wake( int *addr, int count )
+{
+#ifdef __linux__
+    syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, count, NULL, 0, 0 );
+#endif
+}
+
+/* atomically set the value of the state, preserving the flags; return the previous value */
+int inproc_sync_set_value( struct inproc_sync *sync, int value )
+{
+    int old;
+
+    do old = sync->state;
+    while (interlocked_cmpxchg( &sync->state, (old & INPROC_SYNC_WAITERS) | value, old ) != old);
+    return old & ~INPROC_SYNC_WAITERS;
+}
+
+/* atomically set or clear the waiters flag */
+void inproc_sync_set_waiters( struct inproc_sync *sync, int waiters )
+{
+    int old, new;
+
+    do
+    {
+        old = sync->state;
+        new = waiters ? (old | INPROC_SYNC_WAITERS) : (old & ~INPROC_SYNC_WAITERS);
+    } while (interlocked_cmpxchg( &sync->state, new, old ) != old);
+}
+
+/* update the waiters flag before a thread gets added to an object wait queue */
+int inproc_sync_add_queue( struct object *obj, struct wait_queue_entry *entry, struct inproc_sync *sync )
+{
+    if (list_empty( &obj->wait_queue )) inproc_sync_set_waiters( sync, 1 );
+    return add_queue( obj, entry );
+}
+
+/* update the waiters flag when a thread gets removed from an object wait queue */
+void inproc_sync_remove_queue( struct object *obj, struct wait_queue_entry *entry, struct inproc_sync *sync )
+{
+    if (list_head( &obj->wait_queue ) == &entry->entry && list_tail( &obj->wait_queue ) == &entry->entry)
+        inproc_sync_set_waiters( sync, 0 );
+    remove_queue( obj, entry );
+}
+
+/* retrieve the shared memory region of the current process */
+DECL_HANDLER(get_inproc_sync_region)
+{
+    struct inproc_region *region;
+
+    if (!(region = get_inproc_region( &current->process->inproc_sync, INPROC_SYNC_REGION_SIZE ))) return;
+    reply->size = region->size;
+    send_client_fd( current->process, region->fd, 0 );
+}
+
+/* retrieve the completion ports region of the current process */
+DECL_HANDLER(get_inproc_completion_region)
+{
+    struct inproc_region *region;
+
+    if (!(region = get_inproc_region( &current->process->inproc_completion, INPROC_COMPLETION_REGION_SIZE )))
+        return;
+    reply->size = region->size;
+    send_client_fd( current->process, region->fd, 0 );
+}
+
+/* retrieve the in-process synchronization state of an object */
+DECL_HANDLER(get_inproc_sync)
+{
+    struct object *obj;
+    unsigned int index = 0;
+    int type;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if ((type = get_event_inproc_sync( obj, &index )) == INPROC_SYNC_NONE &&
+        (type = get_semaphore_inproc_sync( obj, &index )) == INPROC_SYNC_NONE)
+        type = get_completion_inproc_sync( obj, &index );
+
+    reply->type   = type;
+    reply->index  = index;
+    reply->access = get_handle_access( current->process, req->handle );
+    release_object( obj );
+}
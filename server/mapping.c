@@ -89,6 +89,7 @@ struct shared_map
     struct fd      *fd;              /* file descriptor of the mapped PE file */
     struct file    *file;            /* temp file holding the shared data */
     struct list     entry;           /* entry in global shared maps list */
+    time_t          mtime;           /* modification time of the PE file (for image layouts) */
 };
 
 static void shared_map_dump( struct object *obj, int verbose );
@@ -118,6 +119,7 @@ static const struct object_ops shared_map_ops =
 };
 
 static struct list shared_map_list = LIST_INIT( shared_map_list );
+static struct list image_layout_list = LIST_INIT( image_layout_list );
 
 /* memory view mapped in client address space */
 struct memory_view
@@ -126,6 +128,7 @@ struct memory_view
     struct fd      *fd;              /* fd for mapped file */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct shared_map *layout;       /* temp file for laid out PE image */
     unsigned int    flags;           /* SEC_* flags */
     client_ptr_t    base;            /* view base address (in process addr space) */
     mem_size_t      size;            /* view size */
@@ -141,6 +144,7 @@ struct mapping
     pe_image_info_t image;           /* image info (for PE image mapping) */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct shared_map *layout;       /* temp file for laid out PE image */
 };
 
 static void mapping_dump( struct object *obj, int verbose );
@@ -262,7 +266,7 @@ static int check_current_dir_for_exec(void)
 }
 
 /* create a temp file for anonymous mappings */
-static int create_temp_file( file_pos_t size )
+int create_temp_file( file_pos_t size )
 {
     static int temp_dir_fd = -1;
     char tmpfn[] = "anonmap.XXXXXX";
@@ -316,6 +320,7 @@ static void free_memory_view( struct memory_view *view )
     if (view->fd) release_object( view->fd );
     if (view->committed) release_object( view->committed );
     if (view->shared) release_object( view->shared );
+    if (view->layout) release_object( view->layout );
     list_remove( &view->entry );
     free( view );
 }
@@ -340,6 +345,17 @@ static struct shared_map *get_shared_file( struct fd *fd )
     return NULL;
 }
 
+/* find the laid out image file for a given mapping */
+static struct shared_map *get_image_layout( struct fd *fd, time_t mtime )
+{
+    struct shared_map *ptr;
+
+    LIST_FOR_EACH_ENTRY( ptr, &image_layout_list, struct shared_map, entry )
+        if (is_same_file_fd( ptr->fd, fd ) && ptr->mtime == mtime)
+            return (struct shared_map *)grab_object( ptr );
+    return NULL;
+}
+
 /* return the size of the memory mapping and file range of a given section */
 static inline void get_section_sizes( const IMAGE_SECTION_HEADER *sec, size_t *map_size,
                                       off_t *file_start, size_t *file_size )
@@ -514,6 +530,7 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
     if (!(shared = alloc_object( &shared_map_ops ))) goto error;
     shared->fd = (struct fd *)grab_object( mapping->fd );
     shared->file = file;
+    shared->mtime = 0;
     list_add_head( &shared_map_list, &shared->entry );
     mapping->shared = shared;
     free( buffer );
@@ -525,6 +542,83 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
     return 0;
 }
 
+/* check if a section has to be read from a laid out copy of the image because its
+ * file offset is not page-aligned */
+static int needs_image_layout( const IMAGE_SECTION_HEADER *sec, mem_size_t total_size )
+{
+    size_t file_size, map_size;
+    off_t file_start;
+
+    if ((sec->Characteristics & IMAGE_SCN_MEM_SHARED) &&
+        (sec->Characteristics & IMAGE_SCN_MEM_WRITE)) return 0;  /* handled by the shared mapping */
+    get_section_sizes( sec, &map_size, &file_start, &file_size );
+    if (!sec->PointerToRawData || !file_size) return 0;
+    if (!(file_start & page_mask)) return 0;
+    if (sec->VirtualAddress & page_mask) return 0;
+    return sec->VirtualAddress < total_size && file_size <= total_size - sec->VirtualAddress;
+}
+
+/* allocate and fill a temp file holding the sections of a PE image at their virtual
+ * addresses, so that sections with unaligned file offsets can be mapped from the page
+ * cache instead of being read into private memory by every process */
+static void build_image_layout( struct mapping *mapping, int fd,
+                                IMAGE_SECTION_HEADER *sec, unsigned int nb_sec )
+{
+    struct shared_map *layout;
+    struct file *file;
+    struct stat st;
+    unsigned int i;
+    size_t file_size, map_size, max_size;
+    off_t read_pos;
+    char *buffer = NULL;
+    int layout_fd;
+    long res;
+
+    if (mapping->image.image_flags & IMAGE_FLAGS_ImageMappedFlat) return;
+
+    max_size = 0;
+    for (i = 0; i < nb_sec; i++)
+    {
+        if (!needs_image_layout( &sec[i], mapping->image.map_size )) continue;
+        get_section_sizes( &sec[i], &map_size, &read_pos, &file_size );
+        if (file_size > max_size) max_size = file_size;
+    }
+    if (!max_size) return;  /* nothing to do */
+
+    if (fstat( fd, &st ) == -1) return;
+    if ((mapping->layout = get_image_layout( mapping->fd, st.st_mtime ))) return;
+
+    /* create a temp file for the layout, failures are not fatal since the client
+     * can still read the sections into private memory */
+
+    if ((layout_fd = create_temp_file( mapping->image.map_size )) == -1) return;
+    if (!(file = create_file_for_fd( layout_fd, FILE_GENERIC_READ, 0 ))) return;
+
+    if (!(buffer = malloc( max_size ))) goto error;
+
+    for (i = 0; i < nb_sec; i++)
+    {
+        if (!needs_image_layout( &sec[i], mapping->image.map_size )) continue;
+        get_section_sizes( &sec[i], &map_size, &read_pos, &file_size );
+        /* a truncated section is detected by the client, the rest is left zeroed */
+        if ((res = pread( fd, buffer, file_size, read_pos )) <= 0) continue;
+        if (pwrite( layout_fd, buffer, res, sec[i].VirtualAddress ) != res) goto error;
+    }
+
+    if (!(layout = alloc_object( &shared_map_ops ))) goto error;
+    layout->fd = (struct fd *)grab_object( mapping->fd );
+    layout->file = file;
+    layout->mtime = st.st_mtime;
+    list_add_head( &image_layout_list, &layout->entry );
+    mapping->layout = layout;
+    free( buffer );
+    return;
+
+ error:
+    release_object( file );
+    free( buffer );
+}
+
 /* load the CLR header from its section */
 static int load_clr_header( IMAGE_COR20_HEADER *hdr, size_t va, size_t size, int unix_fd,
                             IMAGE_SECTION_HEADER *sec, unsigned int nb_sec )
@@ -739,6 +833,7 @@ static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_s
     if (!build_shared_mapping( mapping, unix_fd, sec, nt.FileHeader.NumberOfSections ))
         return STATUS_INVALID_FILE_FOR_SECTION;
 
+    build_image_layout( mapping, unix_fd, sec, nt.FileHeader.NumberOfSections );
     return STATUS_SUCCESS;
 }
 
@@ -800,6 +895,7 @@ static struct object *create_mapping( struct object *root, const struct unicode_
     mapping->size        = size;
     mapping->fd          = NULL;
     mapping->shared      = NULL;
+    mapping->layout      = NULL;
     mapping->committed   = NULL;
 
     if (!(mapping->flags = get_mapping_flags( handle, flags ))) goto error;
@@ -896,9 +992,9 @@ static void mapping_dump( struct object *obj, int verbose )
 {
     struct mapping *mapping = (struct mapping *)obj;
     assert( obj->ops == &mapping_ops );
-    fprintf( stderr, "Mapping size=%08x%08x flags=%08x fd=%p shared=%p\n",
+    fprintf( stderr, "Mapping size=%08x%08x flags=%08x fd=%p shared=%p layout=%p\n",
              (unsigned int)(mapping->size >> 32), (unsigned int)mapping->size,
-             mapping->flags, mapping->fd, mapping->shared );
+             mapping->flags, mapping->fd, mapping->shared, mapping->layout );
 }
 
 static struct object_type *mapping_get_type( struct object *obj )
@@ -930,6 +1026,7 @@ static void mapping_destroy( struct object *obj )
     if (mapping->fd) release_object( mapping->fd );
     if (mapping->committed) release_object( mapping->committed );
     if (mapping->shared) release_object( mapping->shared );
+    if (mapping->layout) release_object( mapping->layout );
 }
 
 static enum server_fd_type mapping_get_fd_type( struct fd *fd )
@@ -943,6 +1040,29 @@ int get_page_size(void)
     return page_mask + 1;
 }
 
+/* create an anonymous mapping that is also mapped read-write in the server */
+struct object *create_shared_mapping( mem_size_t size, void **ptr )
+{
+    struct mapping *mapping;
+    int unix_fd;
+
+    if (!(mapping = (struct mapping *)create_mapping( NULL, NULL, 0, size, SEC_COMMIT, 0, 0, NULL )))
+        return NULL;
+
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1)
+    {
+        release_object( mapping );
+        return NULL;
+    }
+    if ((*ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, unix_fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        release_object( mapping );
+        return NULL;
+    }
+    return &mapping->obj;
+}
+
 /* create a file mapping */
 DECL_HANDLER(create_mapping)
 {
@@ -998,6 +1118,8 @@ DECL_HANDLER(get_mapping_info)
     if (mapping->shared)
         reply->shared_file = alloc_handle( current->process, mapping->shared->file,
                                            GENERIC_READ|GENERIC_WRITE, 0 );
+    if (mapping->layout)
+        reply->layout_file = alloc_handle( current->process, mapping->layout->file, GENERIC_READ, 0 );
     release_object( mapping );
 }
 
@@ -1049,6 +1171,7 @@ DECL_HANDLER(map_view)
         view->fd        = !is_fd_removable( mapping->fd ) ? (struct fd *)grab_object( mapping->fd ) : NULL;
         view->committed = mapping->committed ? (struct ranges *)grab_object( mapping->committed ) : NULL;
         view->shared    = mapping->shared ? (struct shared_map *)grab_object( mapping->shared ) : NULL;
+        view->layout    = mapping->layout ? (struct shared_map *)grab_object( mapping->layout ) : NULL;
         list_add_tail( &current->process->views, &view->entry );
     }
 
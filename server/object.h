@@ -189,6 +189,39 @@ extern struct keyed_event *get_keyed_event_obj( struct process *process, obj_han
 extern void pulse_event( struct event *event );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
+extern int get_event_inproc_sync( struct object *obj, unsigned int *index );
+
+/* semaphore functions */
+
+extern int get_semaphore_inproc_sync( struct object *obj, unsigned int *index );
+
+/* in-process synchronization functions */
+
+struct inproc_region;
+
+extern void release_inproc_region( struct inproc_region *region );
+extern struct inproc_sync *alloc_inproc_sync( struct process *process, const struct inproc_sync *init,
+                                              struct inproc_region **region );
+extern void free_inproc_sync( struct inproc_region *region, struct inproc_sync *sync );
+extern int get_inproc_sync_index( struct inproc_sync **sync, struct inproc_sync *state,
+                                  struct inproc_region **region, unsigned int *index );
+extern int inproc_sync_set_value( struct inproc_sync *sync, int value );
+extern void inproc_sync_set_waiters( struct inproc_sync *sync, int waiters );
+extern int inproc_sync_add_queue( struct object *obj, struct wait_queue_entry *entry,
+                                  struct inproc_sync *sync );
+extern void inproc_sync_remove_queue( struct object *obj, struct wait_queue_entry *entry,
+                                      struct inproc_sync *sync );
+extern struct inproc_completion *alloc_inproc_completion( struct process *process,
+                                                          struct inproc_region **region );
+extern void free_inproc_completion( struct inproc_region *region, struct inproc_completion *port );
+extern int get_inproc_completion_index( struct inproc_region *region, const struct inproc_completion *port,
+                                        unsigned int *index );
+extern void inproc_futex_wake( int *addr, int count );
+
+static inline int inproc_sync_value( const struct inproc_sync *sync )
+{
+    return sync->state & ~INPROC_SYNC_WAITERS;
+}
 
 /* mutex functions */
 
@@ -529,6 +529,8 @@ struct process *create_process( int fd, struct process *parent, int inherit_all,
     process->trace_data      = 0;
     process->rawinput_mouse  = NULL;
     process->rawinput_kbd    = NULL;
+    process->inproc_sync     = NULL;
+    process->inproc_completion = NULL;
     list_init( &process->kernel_object );
     list_init( &process->thread_list );
     list_init( &process->locks );
@@ -626,6 +628,8 @@ static void process_destroy( struct object *obj )
     if (process->exe_file) release_object( process->exe_file );
     if (process->id) free_ptid( process->id );
     if (process->token) release_object( process->token );
+    release_inproc_region( process->inproc_sync );
+    release_inproc_region( process->inproc_completion );
     free( process->dir_cache );
 }
 
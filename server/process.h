@@ -98,6 +98,8 @@ struct process
     const struct rawinput_device *rawinput_mouse; /* rawinput mouse device, if any */
     const struct rawinput_device *rawinput_kbd;   /* rawinput keyboard device, if any */
     struct list          kernel_object;   /* list of kernel object pointers */
+    struct inproc_region*inproc_sync;     /* region of in-process synchronization objects */
+    struct inproc_region*inproc_completion; /* region of in-process completion ports */
 };
 
 struct process_snapshot
@@ -120,10 +120,8 @@ struct msg_queue
 {
     struct object          obj;             /* object header */
     struct fd             *fd;              /* optional file descriptor to poll */
-    unsigned int           wake_bits;       /* wakeup bits */
-    unsigned int           wake_mask;       /* wakeup mask */
-    unsigned int           changed_bits;    /* changed wakeup bits */
-    unsigned int           changed_mask;    /* changed wakeup mask */
+    struct queue_shm      *shm;             /* wakeup bits and masks, in the shared region if possible */
+    struct queue_shm       local_shm;       /* storage for the wakeup bits if they can't be shared */
     int                    paint_count;     /* pending paint messages count */
     int                    hotkey_count;    /* pending hotkey messages count */
     int                    quit_message;    /* is there a pending quit message? */
@@ -270,6 +268,57 @@ static struct thread_input *create_thread_input( struct thread *thread )
     return input;
 }
 
+/* the wakeup bits of the queues are kept in a region that the clients can map read-only,
+ * so that they can check for pending messages without a server call */
+static struct object *queue_shm_mapping;   /* mapping of the shared region */
+static struct queue_shm *queue_shm_region; /* server view of the shared region */
+static unsigned int queue_shm_next;        /* first never used index */
+static unsigned int queue_shm_free = ~0u;  /* first index in the free list */
+
+#define QUEUE_SHM_REGION_SIZE (QUEUE_SHM_MAX_QUEUES * sizeof(struct queue_shm))
+
+/* allocate the state of a queue in the shared region, or use the local storage on failure */
+static struct queue_shm *alloc_queue_shm( struct queue_shm *local )
+{
+    struct queue_shm *shm = local;
+
+    if (!queue_shm_mapping)
+    {
+        void *ptr;
+
+        if (!(queue_shm_mapping = create_shared_mapping( QUEUE_SHM_REGION_SIZE, &ptr )))
+        {
+            clear_error();
+            queue_shm_next = QUEUE_SHM_MAX_QUEUES;  /* don't try again */
+        }
+        else
+        {
+            make_object_static( queue_shm_mapping );
+            queue_shm_region = ptr;
+        }
+    }
+
+    if (queue_shm_free != ~0u)
+    {
+        shm = queue_shm_region + queue_shm_free;
+        queue_shm_free = shm->wake_bits;  /* the free list is chained through the wake_bits field */
+    }
+    else if (queue_shm_next < QUEUE_SHM_MAX_QUEUES) shm = queue_shm_region + queue_shm_next++;
+
+    memset( shm, 0, sizeof(*shm) );
+    return shm;
+}
+
+/* return the state of a queue to the free list */
+static void free_queue_shm( struct queue_shm *shm )
+{
+    if (!queue_shm_region || shm < queue_shm_region || shm >= queue_shm_region + QUEUE_SHM_MAX_QUEUES)
+        return;
+    shm->wake_mask = shm->changed_mask = shm->changed_bits = 0;
+    shm->wake_bits = queue_shm_free;
+    queue_shm_free = shm - queue_shm_region;
+}
+
 /* create a message queue object */
 static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_input *input )
 {
@@ -286,10 +335,7 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
     if ((queue = alloc_object( &msg_queue_ops )))
     {
         queue->fd              = NULL;
-        queue->wake_bits       = 0;
-        queue->wake_mask       = 0;
-        queue->changed_bits    = 0;
-        queue->changed_mask    = 0;
+        queue->shm             = alloc_queue_shm( &queue->local_shm );
         queue->paint_count     = 0;
         queue->hotkey_count    = 0;
         queue->quit_message    = 0;
@@ -445,22 +491,23 @@ void set_queue_hooks( struct thread *thread, struct hook_table *hooks )
 /* check the queue status */
 static inline int is_signaled( struct msg_queue *queue )
 {
-    return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
+    return ((queue->shm->wake_bits & queue->shm->wake_mask) ||
+            (queue->shm->changed_bits & queue->shm->changed_mask));
 }
 
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
-    queue->wake_bits |= bits;
-    queue->changed_bits |= bits;
+    queue->shm->wake_bits |= bits;
+    queue->shm->changed_bits |= bits;
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
 /* clear some queue bits */
 static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
-    queue->wake_bits &= ~bits;
-    queue->changed_bits &= ~bits;
+    queue->shm->wake_bits &= ~bits;
+    queue->shm->changed_bits &= ~bits;
 }
 
 /* check whether msg is a keyboard message */
@@ -924,7 +971,7 @@ static int msg_queue_add_queue( struct object *obj, struct wait_queue_entry *ent
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
-    if (process->idle_event && !(queue->wake_mask & QS_SMRESULT)) set_event( process->idle_event );
+    if (process->idle_event && !(queue->shm->wake_mask & QS_SMRESULT)) set_event( process->idle_event );
 
     if (queue->fd && list_empty( &obj->wait_queue ))  /* first on the queue */
         set_fd_events( queue->fd, POLLIN );
@@ -945,7 +992,7 @@ static void msg_queue_dump( struct object *obj, int verbose )
 {
     struct msg_queue *queue = (struct msg_queue *)obj;
     fprintf( stderr, "Msg queue bits=%x mask=%x\n",
-             queue->wake_bits, queue->wake_mask );
+             queue->shm->wake_bits, queue->shm->wake_mask );
 }
 
 static int msg_queue_signaled( struct object *obj, struct wait_queue_entry *entry )
@@ -968,8 +1015,8 @@ static int msg_queue_signaled( struct object *obj, struct wait_queue_entry *entr
 static void msg_queue_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct msg_queue *queue = (struct msg_queue *)obj;
-    queue->wake_mask = 0;
-    queue->changed_mask = 0;
+    queue->shm->wake_mask = 0;
+    queue->shm->changed_mask = 0;
 }
 
 static void msg_queue_destroy( struct object *obj )
@@ -1008,6 +1055,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    free_queue_shm( queue->shm );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -2215,14 +2263,14 @@ DECL_HANDLER(set_queue_mask)
 
     if (queue)
     {
-        queue->wake_mask    = req->wake_mask;
-        queue->changed_mask = req->changed_mask;
-        reply->wake_bits    = queue->wake_bits;
-        reply->changed_bits = queue->changed_bits;
+        queue->shm->wake_mask    = req->wake_mask;
+        queue->shm->changed_mask = req->changed_mask;
+        reply->wake_bits    = queue->shm->wake_bits;
+        reply->changed_bits = queue->shm->changed_bits;
         if (is_signaled( queue ))
         {
             /* if skip wait is set, do what would have been done in the subsequent wait */
-            if (req->skip_wait) queue->wake_mask = queue->changed_mask = 0;
+            if (req->skip_wait) queue->shm->wake_mask = queue->shm->changed_mask = 0;
             else wake_up( &queue->obj, 0 );
         }
     }
@@ -2235,14 +2283,30 @@ DECL_HANDLER(get_queue_status)
     struct msg_queue *queue = current->queue;
     if (queue)
     {
-        reply->wake_bits    = queue->wake_bits;
-        reply->changed_bits = queue->changed_bits;
-        queue->changed_bits &= ~req->clear_bits;
+        reply->wake_bits    = queue->shm->wake_bits;
+        reply->changed_bits = queue->shm->changed_bits;
+        queue->shm->changed_bits &= ~req->clear_bits;
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
 
 
+/* retrieve the location of the current queue state in the shared region */
+DECL_HANDLER(get_queue_shm)
+{
+    struct msg_queue *queue = get_current_queue();
+
+    reply->index = ~0u;
+    if (!queue || queue->shm == &queue->local_shm) return;
+
+    if (req->map &&
+        !(reply->handle = alloc_handle( current->process, queue_shm_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 )))
+        return;
+    reply->size  = QUEUE_SHM_REGION_SIZE;
+    reply->index = queue->shm - queue_shm_region;
+}
+
+
 /* send a message to a thread queue */
 DECL_HANDLER(send_message)
 {
@@ -2415,11 +2479,11 @@ DECL_HANDLER(get_message)
     /* clear changed bits so we can wait on them if we don't find a message */
     if (filter & QS_POSTMESSAGE)
     {
-        queue->changed_bits &= ~(QS_POSTMESSAGE | QS_HOTKEY | QS_TIMER);
-        if (req->get_first == 0 && req->get_last == ~0U) queue->changed_bits &= ~QS_ALLPOSTMESSAGE;
+        queue->shm->changed_bits &= ~(QS_POSTMESSAGE | QS_HOTKEY | QS_TIMER);
+        if (req->get_first == 0 && req->get_last == ~0U) queue->shm->changed_bits &= ~QS_ALLPOSTMESSAGE;
     }
-    if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
-    if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    if (filter & QS_INPUT) queue->shm->changed_bits &= ~QS_INPUT;
+    if (filter & QS_PAINT) queue->shm->changed_bits &= ~QS_PAINT;
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -2472,8 +2536,8 @@ DECL_HANDLER(get_message)
     }
 
     if (get_win == -1 && current->process->idle_event) set_event( current->process->idle_event );
-    queue->wake_mask = req->wake_mask;
-    queue->changed_mask = req->changed_mask;
+    queue->shm->wake_mask = req->wake_mask;
+    queue->shm->changed_mask = req->changed_mask;
     set_error( STATUS_PENDING );  /* FIXME */
 }
 
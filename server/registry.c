@@ -35,6 +35,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -75,8 +78,12 @@ struct key
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    struct subkey_index *subkey_index; /* hash index of the subkeys, for keys with many subkeys */
+    struct value_index *value_index;   /* hash index of the values, for keys with many values */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
+    unsigned int      hash;        /* hash of the key name */
+    struct key       *hash_next;   /* next key in the same bucket of the parent subkey index */
     struct list       notify_list; /* list of notifications */
 };
 
@@ -87,6 +94,7 @@ struct key
 #define KEY_SYMLINK  0x0008  /* key is a symbolic link */
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
+#define KEY_MODIFIED 0x0040  /* key itself has been modified since the last save */
 
 /* a key value */
 struct key_value
@@ -100,6 +108,34 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_INDEXED  64  /* min. number of subkeys or values to build a hash index */
+
+/*
+ * Keys with many subkeys or values get a hash index to look them up. New
+ * entries of indexed keys are appended at the end of the array instead of
+ * being inserted in name order, and only get sorted when the array order is
+ * needed for enumeration or saving.
+ */
+
+/* hash index of the subkeys of a key, chained through the subkeys */
+struct subkey_index
+{
+    int               sorted;   /* number of subkeys at the start of the array sorted by name */
+    unsigned int      mask;     /* number of buckets - 1 */
+    struct key      **buckets;  /* first subkey of each bucket */
+};
+
+/* hash index of the values of a key, chained through the values array indices */
+struct value_index
+{
+    int               sorted;   /* number of values at the start of the array sorted by name */
+    int               count;    /* number of values */
+    int               size;     /* allocated size of the entry arrays */
+    unsigned int      mask;     /* number of buckets - 1 */
+    int              *buckets;  /* first entry of each bucket, -1 if empty */
+    int              *next;     /* next entry in the same bucket, -1 at the end of the chain */
+    unsigned int     *hashes;   /* hash of the name of each entry */
+};
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -120,17 +156,43 @@ static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_va
 static void set_periodic_save_timer(void);
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
 
+/* a key deleted since the last save of its branch */
+struct deleted_key
+{
+    struct list  entry;       /* entry in the branch list of deleted keys */
+    data_size_t  len;         /* length of the path */
+    WCHAR        path[1];     /* path of the key relative to the branch */
+};
+
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    struct list  deleted;      /* keys deleted since the last save */
+    size_t       file_size;    /* size of the last full save */
+    size_t       journal_size; /* size of the journal of changes since the last full save */
+    void        *map;          /* mapping of the binary hive the branch was loaded from */
+    size_t       map_size;     /* size of the binary hive mapping */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
 
+/* free the data of a value, unless it still points into a binary hive mapping */
+static void free_value_data( void *data )
+{
+    int i;
+
+    for (i = 0; i < save_branch_count; i++)
+    {
+        const char *map = save_branch_info[i].map;
+        if ((const char *)data >= map && (const char *)data < map + save_branch_info[i].map_size) return;
+    }
+    free( data );
+}
+
 
 /* information about a file being loaded */
 struct file_load_info
@@ -142,6 +204,7 @@ struct file_load_info
     int         line;     /* current input line */
     WCHAR      *tmp;      /* temp buffer to use while parsing input */
     size_t      tmplen;   /* length of temp buffer */
+    int         journal;  /* loading a journal, keys replace existing ones */
 };
 
 
@@ -182,6 +245,261 @@ static inline int is_wow6432node( const WCHAR *name, unsigned int len )
             !memicmpW( name, wow6432node, ARRAY_SIZE( wow6432node )));
 }
 
+/* compute the case-insensitive hash of a key or value name */
+static unsigned int hash_name( const WCHAR *name, data_size_t len )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < len / sizeof(WCHAR); i++) hash = hash * 33 + tolowerW( name[i] );
+    return hash ^ (hash >> 15);
+}
+
+/* compare two key or value names, in the order used for enumeration */
+static int compare_names( const WCHAR *name1, data_size_t len1, const WCHAR *name2, data_size_t len2 )
+{
+    int res = memicmpW( name1, name2, min( len1, len2 ) / sizeof(WCHAR) );
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+static int compare_subkeys( const void *ptr1, const void *ptr2 )
+{
+    const struct key *key1 = *(struct key * const *)ptr1;
+    const struct key *key2 = *(struct key * const *)ptr2;
+    return compare_names( key1->name, key1->namelen, key2->name, key2->namelen );
+}
+
+static int compare_values( const void *ptr1, const void *ptr2 )
+{
+    const struct key_value *value1 = ptr1, *value2 = ptr2;
+    return compare_names( value1->name, value1->namelen, value2->name, value2->namelen );
+}
+
+/* link an entry into the chain of its bucket */
+static void value_index_link( struct value_index *index, int entry )
+{
+    unsigned int bucket = index->hashes[entry] & index->mask;
+
+    index->next[entry] = index->buckets[bucket];
+    index->buckets[bucket] = entry;
+}
+
+/* rebuild the bucket chains, resizing the buckets array if possible */
+static void value_index_rehash( struct value_index *index, unsigned int nb_buckets )
+{
+    int i, *buckets;
+
+    if (nb_buckets != index->mask + 1 && (buckets = malloc( nb_buckets * sizeof(*buckets) )))
+    {
+        free( index->buckets );
+        index->buckets = buckets;
+        index->mask = nb_buckets - 1;
+    }
+    for (i = 0; i <= index->mask; i++) index->buckets[i] = -1;
+    for (i = 0; i < index->count; i++) value_index_link( index, i );
+}
+
+/* allocate an index for count entries, the caller has to fill the hashes and link them */
+static struct value_index *alloc_value_index( int count )
+{
+    struct value_index *index;
+    unsigned int nb_buckets = MIN_INDEXED;
+
+    while (nb_buckets < count) nb_buckets *= 2;
+    if (!(index = malloc( sizeof(*index) ))) return NULL;
+    index->sorted  = count;
+    index->count   = count;
+    index->size    = nb_buckets;
+    index->mask    = nb_buckets - 1;
+    index->buckets = malloc( nb_buckets * sizeof(*index->buckets) );
+    index->next    = malloc( nb_buckets * sizeof(*index->next) );
+    index->hashes  = malloc( nb_buckets * sizeof(*index->hashes) );
+    if (!index->buckets || !index->next || !index->hashes)
+    {
+        free( index->buckets );
+        free( index->next );
+        free( index->hashes );
+        free( index );
+        return NULL;
+    }
+    return index;
+}
+
+static void free_value_index( struct value_index *index )
+{
+    if (!index) return;
+    free( index->buckets );
+    free( index->next );
+    free( index->hashes );
+    free( index );
+}
+
+/* add an entry at the end of an index; return 0 on error */
+static int value_index_add( struct value_index *index, unsigned int hash )
+{
+    if (index->count == index->size)
+    {
+        int size = index->size * 2, *next;
+        unsigned int *hashes;
+
+        if (!(next = realloc( index->next, size * sizeof(*next) ))) goto failed;
+        index->next = next;
+        if (!(hashes = realloc( index->hashes, size * sizeof(*hashes) ))) goto failed;
+        index->hashes = hashes;
+        index->size = size;
+    }
+    index->hashes[index->count] = hash;
+    value_index_link( index, index->count++ );
+    /* keep at most one entry per bucket on average */
+    if (index->count > index->mask + 1) value_index_rehash( index, (index->mask + 1) * 2 );
+    return 1;
+
+failed:
+    set_error( STATUS_NO_MEMORY );
+    return 0;
+}
+
+/* remove an entry from an index, renumbering the following entries */
+static void value_index_remove( struct value_index *index, int entry )
+{
+    int i, *ptr;
+
+    for (ptr = &index->buckets[index->hashes[entry] & index->mask]; *ptr != entry; ptr = &index->next[*ptr]) ;
+    *ptr = index->next[entry];
+
+    index->count--;
+    if (entry < index->sorted) index->sorted--;
+    if (entry == index->count) return;  /* last entry, nothing to renumber */
+    memmove( index->next + entry, index->next + entry + 1, (index->count - entry) * sizeof(*index->next) );
+    memmove( index->hashes + entry, index->hashes + entry + 1, (index->count - entry) * sizeof(*index->hashes) );
+    for (i = 0; i <= index->mask; i++) if (index->buckets[i] > entry) index->buckets[i]--;
+    for (i = 0; i < index->count; i++) if (index->next[i] > entry) index->next[i]--;
+}
+
+/* sort the unsorted entries at the end of an array, and merge them with the sorted ones */
+static void sort_entries( void *base, int sorted, int count, size_t size,
+                          int (*compare)(const void *, const void *) )
+{
+    char *array = base, *merged, *ptr, *a, *b, *end_a, *end_b;
+
+    qsort( array + sorted * size, count - sorted, size, compare );
+    if (!sorted) return;
+    if (!(merged = malloc( count * size )))
+    {
+        qsort( array, count, size, compare );
+        return;
+    }
+    a = array;
+    b = end_a = array + sorted * size;
+    end_b = array + count * size;
+    for (ptr = merged; a < end_a && b < end_b; ptr += size)
+    {
+        if (compare( b, a ) < 0)
+        {
+            memcpy( ptr, b, size );
+            b += size;
+        }
+        else
+        {
+            memcpy( ptr, a, size );
+            a += size;
+        }
+    }
+    memcpy( ptr, a, end_a - a );
+    memcpy( ptr + (end_a - a), b, end_b - b );
+    memcpy( array, merged, count * size );
+    free( merged );
+}
+
+/* link a subkey into the chain of its bucket */
+static void subkey_index_link( struct subkey_index *index, struct key *key )
+{
+    struct key **bucket = &index->buckets[key->hash & index->mask];
+
+    key->hash_next = *bucket;
+    *bucket = key;
+}
+
+/* resize the buckets of the subkey index of a key, and relink all the subkeys */
+static int subkey_index_rehash( struct key *key, unsigned int nb_buckets )
+{
+    struct subkey_index *index = key->subkey_index;
+    struct key **buckets;
+    int i;
+
+    if (!(buckets = calloc( nb_buckets, sizeof(*buckets) ))) return 0;
+    free( index->buckets );
+    index->buckets = buckets;
+    index->mask = nb_buckets - 1;
+    for (i = 0; i <= key->last_subkey; i++) subkey_index_link( index, key->subkeys[i] );
+    return 1;
+}
+
+/* build the hash index of the subkeys of a key */
+static void index_subkeys( struct key *key )
+{
+    unsigned int nb_buckets = MIN_INDEXED;
+
+    while (nb_buckets < key->last_subkey + 1) nb_buckets *= 2;
+    if (!(key->subkey_index = malloc( sizeof(*key->subkey_index) ))) return;
+    key->subkey_index->sorted  = key->last_subkey + 1;
+    key->subkey_index->buckets = NULL;
+    if (!subkey_index_rehash( key, nb_buckets ))
+    {
+        free( key->subkey_index );
+        key->subkey_index = NULL;
+    }
+}
+
+/* remove a subkey from the index of its parent */
+static void subkey_index_remove( struct key *parent, struct key *key, int index )
+{
+    struct key **ptr = &parent->subkey_index->buckets[key->hash & parent->subkey_index->mask];
+
+    while (*ptr != key) ptr = &(*ptr)->hash_next;
+    *ptr = key->hash_next;
+    if (index < parent->subkey_index->sorted) parent->subkey_index->sorted--;
+}
+
+static void free_subkey_index( struct subkey_index *index )
+{
+    if (!index) return;
+    free( index->buckets );
+    free( index );
+}
+
+/* build the hash index of the values of a key */
+static void index_values( struct key *key )
+{
+    int i;
+
+    if (!(key->value_index = alloc_value_index( key->last_value + 1 ))) return;
+    for (i = 0; i <= key->last_value; i++)
+        key->value_index->hashes[i] = hash_name( key->values[i].name, key->values[i].namelen );
+    value_index_rehash( key->value_index, key->value_index->mask + 1 );
+}
+
+/* sort the subkeys appended to an indexed key, so that they are enumerated in name order */
+static void sort_subkeys( struct key *key )
+{
+    struct subkey_index *index = key->subkey_index;
+
+    if (!index || index->sorted == key->last_subkey + 1) return;
+    sort_entries( key->subkeys, index->sorted, key->last_subkey + 1, sizeof(*key->subkeys), compare_subkeys );
+    index->sorted = key->last_subkey + 1;
+}
+
+/* sort the values appended to an indexed key, so that they are enumerated in name order */
+static void sort_values( struct key *key )
+{
+    struct value_index *index = key->value_index;
+
+    if (!index || index->sorted == index->count) return;
+    sort_entries( key->values, index->sorted, index->count, sizeof(*key->values), compare_values );
+    free_value_index( index );
+    index_values( key );
+}
+
 /*
  * The registry text file format v2 used by this code is similar to the one
  * used by REGEDIT import/export functionality, with the following differences:
@@ -189,6 +507,15 @@ static inline int is_wow6432node( const WCHAR *name, unsigned int len )
  * - key names use escapes too in order to support Unicode
  * - the modification time optionally follows the key name
  * - REG_EXPAND_SZ and REG_MULTI_SZ are saved as strings instead of hex
+ *
+ * Between full saves, the periodic save only appends the modified keys to a
+ * journal file (e.g. system.reg.log) in the same format, keys replacing the
+ * existing ones, and deleted keys written as -[name]. The journal starts with
+ * a #base= line identifying the text file it applies to.
+ *
+ * If WINEREGBIN is set, a binary copy of the branch (e.g. system.reg.bin) is
+ * also written on full saves; it is mapped at startup instead of parsing the
+ * text file when it is up to date with it.
  */
 
 /* dump the full path of a key */
@@ -256,32 +583,51 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* save a key and its values to a text file */
+static void save_key( struct key *key, const struct key *base, FILE *f )
+{
+    int i;
+
+    sort_values( key );
+    fprintf( f, "\n[" );
+    if (key != base) dump_path( key, base, f );
+    fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+    if (key->class)
+    {
+        fprintf( f, "#class=\"" );
+        dump_strW( key->class, key->classlen / sizeof(WCHAR), f, "\"\"" );
+        fprintf( f, "\"\n" );
+    }
+    if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+    for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+}
+
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
-    {
-        fprintf( f, "\n[" );
-        if (key != base) dump_path( key, base, f );
-        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
-        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
-        if (key->class)
-        {
-            fprintf( f, "#class=\"" );
-            dump_strW( key->class, key->classlen / sizeof(WCHAR), f, "\"\"" );
-            fprintf( f, "\"\n" );
-        }
-        if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
-        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
-    }
+        save_key( key, base, f );
     for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
 }
 
+/* save the keys modified since the last save to a journal file */
+static void save_modified_keys( struct key *key, const struct key *base, FILE *f )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(key->flags & KEY_DIRTY)) return;
+    if (key->flags & KEY_MODIFIED) save_key( key, base, f );
+    for (i = 0; i <= key->last_subkey; i++) save_modified_keys( key->subkeys[i], base, f );
+}
+
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
 {
     fprintf( stderr, "%s key ", op );
@@ -416,7 +762,7 @@ static void key_destroy( struct object *obj )
     for (i = 0; i <= key->last_value; i++)
     {
         free( key->values[i].name );
-        free( key->values[i].data );
+        free_value_data( key->values[i].data );
     }
     free( key->values );
     for (i = 0; i <= key->last_subkey; i++)
@@ -425,6 +771,8 @@ static void key_destroy( struct object *obj )
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free_subkey_index( key->subkey_index );
+    free_value_index( key->value_index );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -491,7 +839,11 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->subkey_index = NULL;
+        key->value_index  = NULL;
         key->modif       = modif;
+        key->hash        = hash_name( name->str, name->len );
+        key->hash_next   = NULL;
         key->parent      = NULL;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
@@ -503,9 +855,10 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
-/* mark a key and all its parents as dirty (modified) */
+/* mark a key as modified and all its parents as dirty */
 static void make_dirty( struct key *key )
 {
+    if (!(key->flags & KEY_VOLATILE)) key->flags |= KEY_MODIFIED;
     while (key)
     {
         if (key->flags & (KEY_DIRTY|KEY_VOLATILE)) return;  /* nothing to do */
@@ -521,7 +874,7 @@ static void make_clean( struct key *key )
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    key->flags &= ~(KEY_DIRTY | KEY_MODIFIED);
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
@@ -596,16 +949,71 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     }
     if ((key = alloc_key( name, modif )) != NULL)
     {
+        /* indexed keys get new subkeys at the end, they are sorted later */
+        if (parent->subkey_index) index = parent->last_subkey + 1;
         key->parent = parent;
         for (i = ++parent->last_subkey; i > index; i--)
             parent->subkeys[i] = parent->subkeys[i-1];
         parent->subkeys[index] = key;
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
+        if (parent->subkey_index)
+        {
+            subkey_index_link( parent->subkey_index, key );
+            /* keep at most one subkey per bucket on average */
+            if (parent->last_subkey > parent->subkey_index->mask)
+                subkey_index_rehash( parent, (parent->subkey_index->mask + 1) * 2 );
+        }
+        else if (parent->last_subkey + 1 >= MIN_INDEXED) index_subkeys( parent );
     }
     return key;
 }
 
+/* remember the deletion of a key, to write it to the journal of its branch */
+static void record_deleted_key( const struct key *key )
+{
+    struct deleted_key *deleted;
+    const struct key *base = NULL, *k;
+    data_size_t len = 0;
+    WCHAR *p;
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+
+    for (k = key; k->parent && !base; k = k->parent)
+    {
+        len += k->namelen + sizeof(WCHAR);
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == k->parent) base = k->parent;
+    }
+    if (!base) return;  /* not part of a saved branch */
+    for (i = 0; save_branch_info[i].key != base; i++) ;
+
+    len -= sizeof(WCHAR);  /* no separator before the first element */
+    if (!(deleted = malloc( offsetof( struct deleted_key, path[len / sizeof(WCHAR)] )))) return;
+    deleted->len = len;
+    p = deleted->path + len / sizeof(WCHAR);
+    for (k = key; k != base; k = k->parent)
+    {
+        p -= k->namelen / sizeof(WCHAR);
+        memcpy( p, k->name, k->namelen );
+        if (k->parent != base) *--p = '\\';
+    }
+    list_add_tail( &save_branch_info[i].deleted, &deleted->entry );
+}
+
+/* free the list of deleted keys of a branch */
+static void free_deleted_keys( struct save_branch_info *info )
+{
+    struct deleted_key *deleted, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( deleted, next, &info->deleted, struct deleted_key, entry )
+    {
+        list_remove( &deleted->entry );
+        free( deleted );
+    }
+}
+
 /* free a subkey of a given key */
 static void free_subkey( struct key *parent, int index )
 {
@@ -616,8 +1024,10 @@ static void free_subkey( struct key *parent, int index )
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
+    record_deleted_key( key );
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
+    if (parent->subkey_index) subkey_index_remove( parent, key, index );
     key->flags |= KEY_DELETED;
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
@@ -642,6 +1052,22 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_index)
+    {
+        unsigned int hash = hash_name( name->str, name->len );
+        struct key *subkey;
+
+        /* the index is only returned when not found, it's the end of the array */
+        *index = key->last_subkey + 1;
+        subkey = key->subkey_index->buckets[hash & key->subkey_index->mask];
+        for ( ; subkey; subkey = subkey->hash_next)
+        {
+            if (subkey->hash != hash || subkey->namelen != name->len) continue;
+            if (!memicmpW( subkey->name, name->str, name->len / sizeof(WCHAR) )) return subkey;
+        }
+        return NULL;
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -817,7 +1243,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 
     if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
     if (options & REG_OPTION_VOLATILE) key->flags |= KEY_VOLATILE;
-    else key->flags |= KEY_DIRTY;
+    else key->flags |= KEY_DIRTY | KEY_MODIFIED;
 
     if (sd) default_set_sd( &key->obj, sd, OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION |
                             DACL_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION );
@@ -878,7 +1304,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 }
 
 /* query information about a key or a subkey */
-static void enum_key( const struct key *key, int index, int info_class,
+static void enum_key( struct key *key, int index, int info_class,
                       struct enum_key_reply *reply )
 {
     static const WCHAR backslash[] = { '\\' };
@@ -896,6 +1322,7 @@ static void enum_key( const struct key *key, int index, int info_class,
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -1049,6 +1476,22 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_index)
+    {
+        const struct value_index *hash_index = key->value_index;
+        unsigned int hash = hash_name( name->str, name->len );
+
+        for (i = hash_index->buckets[hash & hash_index->mask]; i != -1; i = hash_index->next[i])
+        {
+            if (hash_index->hashes[i] != hash || key->values[i].namelen != name->len) continue;
+            if (memicmpW( key->values[i].name, name->str, name->len / sizeof(WCHAR) )) continue;
+            *index = i;
+            return &key->values[i];
+        }
+        *index = key->last_value + 1;
+        return NULL;
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1086,12 +1529,23 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         if (!grow_values( key )) return NULL;
     }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
+    if (key->value_index)
+    {
+        /* indexed keys get new values at the end, they are sorted later */
+        index = key->last_value + 1;
+        if (!value_index_add( key->value_index, hash_name( name->str, name->len ) ))
+        {
+            free( new_name );
+            return NULL;
+        }
+    }
     for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
     value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (!key->value_index && key->last_value + 1 >= MIN_INDEXED) index_values( key );
     return value;
 }
 
@@ -1134,7 +1588,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
             return;
         }
     }
-    else free( value->data ); /* already existing, free previous data */
+    else free_value_data( value->data ); /* already existing, free previous data */
 
     value->type  = type;
     value->len   = len;
@@ -1174,6 +1628,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_values( key );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1227,9 +1682,10 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
     free( value->name );
-    free( value->data );
+    free_value_data( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
+    if (key->value_index) value_index_remove( key->value_index, index );
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
@@ -1452,7 +1908,8 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
             else if (*p >= 'a' && *p <= 'f') modif = (modif << 4) | (*p - 'a' + 10);
             else break;
         }
-        update_key_time( key, modif );
+        if (info->journal) key->modif = modif;
+        else update_key_time( key, modif );
     }
     if (!strncmp( buffer, "#class=", 7 ))
     {
@@ -1580,7 +2037,7 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     if (!len) newptr = NULL;
     else if (!(newptr = memdup( ptr, len ))) return 0;
 
-    free( value->data );
+    free_value_data( value->data );
     value->data = newptr;
     value->len  = len;
     value->type = type;
@@ -1588,7 +2045,7 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
 
  error:
     file_read_error( "Malformed value", info );
-    free( value->data );
+    free_value_data( value->data );
     value->data = NULL;
     value->len  = 0;
     value->type = REG_NONE;
@@ -1622,9 +2079,60 @@ static int get_prefix_len( struct key *key, const char *name, struct file_load_i
     return res;
 }
 
+/* remove all the values of a key */
+static void clear_values( struct key *key )
+{
+    int i;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free_value_data( key->values[i].data );
+    }
+    key->last_value = -1;
+    free_value_index( key->value_index );
+    key->value_index = NULL;
+}
+
+/* delete a key listed in a journal file, if it exists */
+static void load_deleted_key( struct key *base, const char *buffer, struct file_load_info *info )
+{
+    struct unicode_str name, token;
+    struct key *key = base;
+    data_size_t len;
+    int index;
+
+    if (!get_file_tmp_space( info, strlen(buffer) * sizeof(WCHAR) )) return;
+
+    len = info->tmplen;
+    if (parse_strW( info->tmp, &len, buffer, ']' ) == -1)
+    {
+        file_read_error( "Malformed key", info );
+        return;
+    }
+    name.str = info->tmp;
+    name.len = len - sizeof(WCHAR);
+    token.str = NULL;
+    if (!get_path_token( &name, &token )) return;
+    while (token.len)
+    {
+        if (!(key = find_subkey( key, &token, &index ))) return;  /* already gone */
+        get_path_token( &name, &token );
+    }
+    if (key != base)
+    {
+        /* the parent time is restored by its own record if it was modified too */
+        struct key *parent = key->parent;
+        timeout_t modif = parent->modif;
+
+        if (delete_key( key, 1 ) != -1) parent->modif = modif;
+    }
+}
+
 /* load all the keys from the input file */
 /* prefix_len is the number of key name prefixes to skip, or -1 for autodetection */
-static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len )
+/* in journal mode, loaded keys replace the existing ones and deletions are allowed */
+static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len, int journal )
 {
     struct key *subkey = NULL;
     struct file_load_info info;
@@ -1636,6 +2144,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     info.len    = 4;
     info.tmplen = 4;
     info.line   = 0;
+    info.journal = journal;
     if (!(info.buffer = mem_alloc( info.len ))) return;
     if (!(info.tmp = mem_alloc( info.tmplen )))
     {
@@ -1665,6 +2174,28 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
             if (prefix_len == -1) prefix_len = get_prefix_len( key, p + 1, &info );
             if (!(subkey = load_key( key, p + 1, prefix_len, &info, &modif )))
                 file_read_error( "Error creating key", &info );
+            else if (journal)
+            {
+                clear_values( subkey );
+                free( subkey->class );
+                subkey->class = NULL;
+                subkey->classlen = 0;
+                subkey->modif = modif;
+            }
+            break;
+        case '-':   /* deleted key */
+            if (!journal || p[1] != '[')
+            {
+                file_read_error( "Unrecognized input", &info );
+                break;
+            }
+            if (subkey)
+            {
+                update_key_time( subkey, modif );
+                release_object( subkey );
+                subkey = NULL;
+            }
+            load_deleted_key( key, p + 2, &info );
             break;
         case '@':   /* default value */
         case '\"':  /* value */
@@ -1708,35 +2239,255 @@ static void load_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "r" );
         if (f)
         {
-            load_keys( key, NULL, f, -1 );
+            load_keys( key, NULL, f, -1, 0 );
             fclose( f );
         }
         else file_set_error();
     }
 }
 
+/* binary hive header */
+struct bin_hive_header
+{
+    char             magic[8];    /* BIN_HIVE_MAGIC */
+    unsigned int     version;     /* BIN_HIVE_VERSION */
+    unsigned int     prefix;      /* prefix type */
+    unsigned __int64 text_size;   /* identity of the text file the hive was generated from */
+    unsigned __int64 text_mtime;
+    unsigned __int64 text_ino;
+};
+
+/* binary hive key record, followed by the name and class, the values and the subkeys */
+struct bin_key
+{
+    timeout_t        modif;       /* last modification time */
+    unsigned int     flags;       /* key flags (only KEY_SYMLINK) */
+    unsigned int     nb_subkeys;  /* number of subkeys */
+    unsigned int     nb_values;   /* number of values */
+    unsigned short   namelen;     /* length of key name */
+    unsigned short   classlen;    /* length of class name */
+};
+
+/* binary hive value record, followed by the name and the data */
+struct bin_value
+{
+    unsigned int     type;        /* value type */
+    data_size_t      len;         /* value data length in bytes */
+    unsigned short   namelen;     /* length of value name */
+    unsigned short   reserved[3];
+};
+
+#define BIN_HIVE_MAGIC   "WINEHIVE"
+#define BIN_HIVE_VERSION 1
+#define BIN_ALIGN(len)   (((len) + 7) & ~7)
+
+/* build the name of a file associated to a registry branch file */
+static char *get_branch_file_name( const char *path, const char *suffix )
+{
+    char *ret;
+
+    if ((ret = malloc( strlen(path) + strlen(suffix) + 1 )))
+    {
+        strcpy( ret, path );
+        strcat( ret, suffix );
+    }
+    return ret;
+}
+
+/* get the identity of the text file of a branch, to check that its journal or binary hive matches it */
+static void get_branch_file_identity( const char *path, unsigned __int64 *size,
+                                      unsigned __int64 *mtime, unsigned __int64 *ino )
+{
+    struct stat st;
+
+    if (stat( path, &st ) == -1) memset( &st, 0, sizeof(st) );
+    *size  = st.st_size;
+    *mtime = st.st_mtime;
+    *ino   = st.st_ino;
+}
+
+/* format the journal line identifying the text file of a branch */
+static void get_journal_base( const char *path, char *buffer )
+{
+    unsigned __int64 size, mtime, ino;
+
+    get_branch_file_identity( path, &size, &mtime, &ino );
+    sprintf( buffer, "#base=%x%08x,%x%08x,%x%08x\n",
+             (unsigned int)(size >> 32), (unsigned int)size,
+             (unsigned int)(mtime >> 32), (unsigned int)mtime,
+             (unsigned int)(ino >> 32), (unsigned int)ino );
+}
+
+/* load a key and its subkeys from a binary hive; return a pointer past the key data, or NULL if invalid */
+static const char *load_bin_key( struct key *key, const char *ptr, const char *end )
+{
+    const struct bin_key *bin_key = (const struct bin_key *)ptr, *bin_subkey;
+    const struct bin_value *bin_value;
+    struct unicode_str name;
+    struct key_value *value;
+    struct key *subkey;
+    unsigned int i;
+    int index;
+
+    if (end - ptr < sizeof(*bin_key)) return NULL;
+    ptr += sizeof(*bin_key);
+    if (end - ptr < BIN_ALIGN( bin_key->namelen + bin_key->classlen )) return NULL;
+    key->modif = bin_key->modif;
+    key->flags |= bin_key->flags & KEY_SYMLINK;
+    if (bin_key->classlen && !key->class)
+    {
+        if ((key->class = memdup( ptr + bin_key->namelen, bin_key->classlen )))
+            key->classlen = bin_key->classlen;
+    }
+    ptr += BIN_ALIGN( bin_key->namelen + bin_key->classlen );
+
+    for (i = 0; i < bin_key->nb_values; i++)
+    {
+        bin_value = (const struct bin_value *)ptr;
+        if (end - ptr < sizeof(*bin_value)) return NULL;
+        ptr += sizeof(*bin_value);
+        if (bin_value->namelen % sizeof(WCHAR)) return NULL;
+        if (end - ptr < BIN_ALIGN( bin_value->namelen )) return NULL;
+        name.str = (const WCHAR *)ptr;
+        name.len = bin_value->namelen;
+        ptr += BIN_ALIGN( bin_value->namelen );
+        if (bin_value->len > end - ptr || end - ptr < BIN_ALIGN( bin_value->len )) return NULL;
+
+        if (!(value = find_value( key, &name, &index )) && !(value = insert_value( key, &name, index )))
+            return NULL;
+        /* the data is not copied, it is paged in from the hive when accessed */
+        free_value_data( value->data );
+        value->type = bin_value->type;
+        value->len  = bin_value->len;
+        value->data = bin_value->len ? (void *)ptr : NULL;
+        ptr += BIN_ALIGN( bin_value->len );
+    }
+
+    for (i = 0; i < bin_key->nb_subkeys; i++)
+    {
+        bin_subkey = (const struct bin_key *)ptr;
+        if (end - ptr < sizeof(*bin_subkey)) return NULL;
+        if (end - ptr < sizeof(*bin_subkey) + bin_subkey->namelen) return NULL;
+        if (!bin_subkey->namelen || bin_subkey->namelen % sizeof(WCHAR)) return NULL;
+        name.str = (const WCHAR *)(bin_subkey + 1);
+        name.len = bin_subkey->namelen;
+        if (!(subkey = find_subkey( key, &name, &index )) &&
+            !(subkey = alloc_subkey( key, &name, index, bin_subkey->modif )))
+            return NULL;
+        if (!(ptr = load_bin_key( subkey, ptr, end ))) return NULL;
+    }
+    return ptr;
+}
+
+/* load a registry branch from its binary hive, if it is up to date with the text file */
+static int load_bin_registry( struct save_branch_info *info, struct key *key )
+{
+    const struct bin_hive_header *header;
+    unsigned __int64 size, mtime, ino;
+    char *path;
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (!(path = get_branch_file_name( info->path, ".bin" ))) return 0;
+    fd = open( path, O_RDONLY );
+    free( path );
+    if (fd == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) ||
+        (map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    close( fd );
+
+    header = map;
+    get_branch_file_identity( info->path, &size, &mtime, &ino );
+    if (memcmp( header->magic, BIN_HIVE_MAGIC, sizeof(header->magic) ) ||
+        header->version != BIN_HIVE_VERSION ||
+        header->text_size != size || header->text_mtime != mtime || header->text_ino != ino ||
+        (header->prefix != PREFIX_32BIT && header->prefix != PREFIX_64BIT) ||
+        (prefix_type != PREFIX_UNKNOWN && header->prefix != prefix_type))
+    {
+        munmap( map, st.st_size );
+        return 0;
+    }
+
+    /* the mapping is kept as long as values point into it */
+    info->map = map;
+    info->map_size = st.st_size;
+    if (!load_bin_key( key, (const char *)(header + 1), (const char *)map + st.st_size ))
+    {
+        fprintf( stderr, "%s.bin: invalid binary registry file, using the text file\n", info->path );
+        clear_error();
+        return 0;
+    }
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->prefix;
+    return 1;
+}
+
+/* replay the journal of the changes made to a branch since its last full save */
+static void load_journal( struct save_branch_info *info, struct key *key )
+{
+    char *path, base[80], buffer[80];
+    struct stat st;
+    FILE *f;
+
+    if (!(path = get_branch_file_name( info->path, ".log" ))) return;
+    if ((f = fopen( path, "r" )))
+    {
+        /* ignore a journal left over from before the last full save */
+        get_journal_base( info->path, base );
+        if (fgets( buffer, sizeof(buffer), f ) && fgets( buffer, sizeof(buffer), f ) &&
+            !strcmp( buffer, base ))
+        {
+            rewind( f );
+            load_keys( key, path, f, 0, 1 );
+            if (!fstat( fileno(f), &st )) info->journal_size = st.st_size;
+            make_clean( key );
+            free_deleted_keys( info );
+            clear_error();
+        }
+        fclose( f );
+        if (!info->journal_size) unlink( path );
+    }
+    free( path );
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *info;
+    struct stat st;
     FILE *f;
+    int ret = 0;
+
+    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+
+    info = &save_branch_info[save_branch_count++];
+    memset( info, 0, sizeof(*info) );
+    info->path = filename;
+    list_init( &info->deleted );
 
-    if ((f = fopen( filename, "r" )))
+    if (load_bin_registry( info, key )) ret = 1;
+    else if ((f = fopen( filename, "r" )))
     {
-        load_keys( key, filename, f, 0 );
+        load_keys( key, filename, f, 0, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
+            /* don't overwrite it, the branch is left without a key */
             fprintf( stderr, "%s is not a valid registry file\n", filename );
             return 1;
         }
+        ret = 1;
     }
+    if (!stat( filename, &st )) info->file_size = st.st_size;
+    load_journal( info, key );
 
-    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
-
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    info->key = (struct key *)grab_object( key );
     make_object_static( &key->obj );
-    return (f != NULL);
+    return ret;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1925,15 +2676,109 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* pad a block of data written to a binary hive to the alignment */
+static void write_bin_padding( size_t len, FILE *f )
+{
+    static const char padding[8];
+
+    if (BIN_ALIGN( len ) != len) fwrite( padding, BIN_ALIGN( len ) - len, 1, f );
+}
+
+/* write a block of data to a binary hive, padded to the alignment */
+static void write_bin_data( const void *data, size_t len, FILE *f )
+{
+    if (len) fwrite( data, len, 1, f );
+    write_bin_padding( len, f );
+}
+
+/* save a key and its subkeys to a binary hive */
+static void save_bin_key( struct key *key, FILE *f )
+{
+    struct bin_key bin_key;
+    struct bin_value bin_value;
+    int i;
+
+    sort_subkeys( key );
+    sort_values( key );
+    memset( &bin_key, 0, sizeof(bin_key) );
+    bin_key.modif     = key->modif;
+    bin_key.flags     = key->flags & KEY_SYMLINK;
+    bin_key.nb_values = key->last_value + 1;
+    bin_key.namelen   = key->namelen;
+    bin_key.classlen  = key->classlen;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) bin_key.nb_subkeys++;
+    fwrite( &bin_key, sizeof(bin_key), 1, f );
+    if (key->namelen) fwrite( key->name, key->namelen, 1, f );
+    if (key->classlen) fwrite( key->class, key->classlen, 1, f );
+    write_bin_padding( key->namelen + key->classlen, f );
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        const struct key_value *value = &key->values[i];
+
+        memset( &bin_value, 0, sizeof(bin_value) );
+        bin_value.type    = value->type;
+        bin_value.len     = value->len;
+        bin_value.namelen = value->namelen;
+        fwrite( &bin_value, sizeof(bin_value), 1, f );
+        write_bin_data( value->name, value->namelen, f );
+        write_bin_data( value->data, value->len, f );
+    }
+
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) save_bin_key( key->subkeys[i], f );
+}
+
+/* save a registry branch to a binary hive matching its newly saved text file */
+static void save_bin_branch( struct save_branch_info *info )
+{
+    struct bin_hive_header header;
+    char *path, *tmp = NULL;
+    int fd, ret;
+    FILE *f;
+
+    if (!getenv( "WINEREGBIN" )) return;
+    if (!(path = get_branch_file_name( info->path, ".bin" ))) return;
+    if (!(tmp = get_branch_file_name( path, ".tmp" ))) goto done;
+    if ((fd = open( tmp, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) == -1) goto done;
+    if (!(f = fdopen( fd, "w" )))
+    {
+        close( fd );
+        unlink( tmp );
+        goto done;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, BIN_HIVE_MAGIC, sizeof(header.magic) );
+    header.version = BIN_HIVE_VERSION;
+    header.prefix  = prefix_type;
+    get_branch_file_identity( info->path, &header.text_size, &header.text_mtime, &header.text_ino );
+    fwrite( &header, sizeof(header), 1, f );
+    save_bin_key( info->key, f );
+
+    ret = !ferror( f );
+    if (fclose( f )) ret = 0;
+    if (ret) ret = !rename( tmp, path );
+    if (!ret) unlink( tmp );
+
+done:
+    free( tmp );
+    free( path );
+}
+
 /* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+static int save_branch( struct save_branch_info *info )
 {
+    struct key *key = info->key;
+    const char *path = info->path;
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
+    long size = 0;
     FILE *f;
 
-    if (!(key->flags & KEY_DIRTY))
+    if (!(key->flags & KEY_DIRTY) && !info->journal_size)
     {
         if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
         return 1;
@@ -1984,6 +2829,7 @@ static int save_branch( struct key *key, const char *path )
     }
 
     save_all_subkeys( key, f );
+    size = ftell( f );
     ret = !fclose(f);
 
     if (tmp)
@@ -1995,7 +2841,81 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    if (ret)
+    {
+        make_clean( key );
+        free_deleted_keys( info );
+        info->file_size = size;
+        if (info->journal_size && (tmp = get_branch_file_name( path, ".log" )))
+        {
+            unlink( tmp );
+            free( tmp );
+        }
+        info->journal_size = 0;
+        save_bin_branch( info );
+    }
+    return ret;
+}
+
+/* append the changes made to a registry branch since the last save to its journal */
+static int save_branch_journal( struct save_branch_info *info )
+{
+    struct deleted_key *deleted;
+    char *path, base[80];
+    int fd, ret = 0;
+    long size;
+    FILE *f;
+
+    if (!(info->key->flags & KEY_DIRTY) && list_empty( &info->deleted ))
+    {
+        if (debug_level > 1) dump_operation( info->key, NULL, "Not journaling clean" );
+        return 1;
+    }
+
+    if (!(path = get_branch_file_name( info->path, ".log" ))) return 0;
+    if ((fd = open( path, O_CREAT | O_WRONLY, 0666 )) == -1) goto done;
+    if (!(f = fdopen( fd, "w" )))
+    {
+        close( fd );
+        goto done;
+    }
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", path );
+        dump_operation( info->key, NULL, "journaling" );
+    }
+
+    if (!info->journal_size)
+    {
+        /* start a new journal, tied to the current text file */
+        ftruncate( fd, 0 );
+        get_journal_base( info->path, base );
+        fprintf( f, "WINE REGISTRY Version 2\n%s", base );
+    }
+    else fseek( f, info->journal_size, SEEK_SET );
+
+    LIST_FOR_EACH_ENTRY( deleted, &info->deleted, struct deleted_key, entry )
+    {
+        fprintf( f, "\n-[" );
+        dump_strW( deleted->path, deleted->len / sizeof(WCHAR), f, "[]" );
+        fprintf( f, "]\n" );
+    }
+    save_modified_keys( info->key, info->key, f );
+
+    size = ftell( f );
+    ret = !ferror( f );
+    if (fclose( f )) ret = 0;
+    if (ret)
+    {
+        info->journal_size = size;
+        make_clean( info->key );
+        free_deleted_keys( info );
+    }
+    /* on failure, a partially written record is overwritten by the next attempt */
+
+done:
+    free( path );
     return ret;
 }
 
@@ -2007,7 +2927,14 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    {
+        struct save_branch_info *info = &save_branch_info[i];
+
+        if (!info->key) continue;
+        /* only append the changes to the journal, unless it has grown too large */
+        if (info->journal_size > info->file_size / 2 || !save_branch_journal( info ))
+            save_branch( info );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2027,7 +2954,8 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch_info[i].key) continue;
+        if (!save_branch( &save_branch_info[i] ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -329,6 +329,97 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* check if a request can be executed as part of a batch */
+/* only requests that never block and never kill the current thread are allowed */
+static int is_batch_request( enum request req )
+{
+    switch (req)
+    {
+    case REQ_close_handle:
+    case REQ_open_key:
+    case REQ_enum_key:
+    case REQ_get_key_value:
+    case REQ_enum_key_value:
+    case REQ_set_key_value:
+    case REQ_delete_key_value:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* execute several independent requests in a single round-trip */
+DECL_HANDLER(batch)
+{
+    const union generic_request batch_req = current->req;
+    void *batch_data = current->req_data;
+    const char *ptr = get_req_data();
+    data_size_t size, left = get_req_data_size();
+    data_size_t max_size = get_reply_max_size(), pos = 0;
+    unsigned int error = STATUS_SUCCESS, count = 0;
+    union generic_reply sub_reply;
+    char *replies = NULL;
+
+    if (max_size && !(replies = mem_alloc( max_size ))) return;
+
+    while (left)
+    {
+        const union generic_request *sub_req = (const union generic_request *)ptr;
+        enum request sub = sub_req->request_header.req;
+
+        if (left < sizeof(*sub_req) || sub_req->request_header.request_size > left - sizeof(*sub_req))
+        {
+            error = STATUS_INVALID_PARAMETER;
+            break;
+        }
+        if (max_size - pos < sizeof(sub_reply) ||
+            sub_req->request_header.reply_size > max_size - pos - sizeof(sub_reply))
+        {
+            error = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+
+        current->req        = *sub_req;
+        current->req_data   = (void *)(sub_req + 1);
+        current->reply_size = 0;
+        current->reply_data = NULL;
+        clear_error();
+        memset( &sub_reply, 0, sizeof(sub_reply) );
+
+        if (debug_level) trace_request();
+
+        if (sub < REQ_NB_REQUESTS && is_batch_request( sub ))
+            req_handlers[sub]( &current->req, &sub_reply );
+        else
+            set_error( STATUS_NOT_SUPPORTED );
+
+        sub_reply.reply_header.error = current->error;
+        sub_reply.reply_header.reply_size = current->reply_size;
+        if (debug_level) trace_reply( sub, &sub_reply );
+
+        memcpy( replies + pos, &sub_reply, sizeof(sub_reply) );
+        if (current->reply_size)
+            memcpy( replies + pos + sizeof(sub_reply), current->reply_data, current->reply_size );
+        free( current->reply_data );
+        pos += min( BATCH_ALIGN( sizeof(sub_reply) + current->reply_size ), max_size - pos );
+
+        size = min( BATCH_ALIGN( sizeof(*sub_req) + sub_req->request_header.request_size ), left );
+        ptr  += size;
+        left -= size;
+        count++;
+    }
+
+    current->req        = batch_req;
+    current->req_data   = batch_data;
+    current->reply_data = NULL;
+    current->reply_size = 0;
+    set_error( error );
+
+    reply->count = count;
+    if (pos) set_reply_data_ptr( replies, pos );
+    else free( replies );
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
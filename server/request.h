@@ -135,6 +135,7 @@ DECL_HANDLER(unload_dll);
 DECL_HANDLER(queue_apc);
 DECL_HANDLER(get_apc_result);
 DECL_HANDLER(close_handle);
+DECL_HANDLER(batch);
 DECL_HANDLER(set_handle_info);
 DECL_HANDLER(dup_handle);
 DECL_HANDLER(open_process);
@@ -154,6 +155,9 @@ DECL_HANDLER(create_semaphore);
 DECL_HANDLER(release_semaphore);
 DECL_HANDLER(query_semaphore);
 DECL_HANDLER(open_semaphore);
+DECL_HANDLER(get_inproc_sync_region);
+DECL_HANDLER(get_inproc_sync);
+DECL_HANDLER(get_inproc_completion_region);
 DECL_HANDLER(create_file);
 DECL_HANDLER(open_file_object);
 DECL_HANDLER(alloc_file_handle);
@@ -248,6 +252,7 @@ DECL_HANDLER(get_msg_queue);
 DECL_HANDLER(set_queue_fd);
 DECL_HANDLER(set_queue_mask);
 DECL_HANDLER(get_queue_status);
+DECL_HANDLER(get_queue_shm);
 DECL_HANDLER(get_process_idle_event);
 DECL_HANDLER(send_message);
 DECL_HANDLER(post_quit_message);
@@ -275,6 +280,7 @@ DECL_HANDLER(destroy_window);
 DECL_HANDLER(get_desktop_window);
 DECL_HANDLER(set_window_owner);
 DECL_HANDLER(get_window_info);
+DECL_HANDLER(get_window_shm_region);
 DECL_HANDLER(set_window_info);
 DECL_HANDLER(set_parent);
 DECL_HANDLER(get_window_parents);
@@ -385,6 +391,7 @@ DECL_HANDLER(get_token_statistics);
 DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
+DECL_HANDLER(wake_completion);
 DECL_HANDLER(remove_completion);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
@@ -438,6 +445,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_queue_apc,
     (req_handler)req_get_apc_result,
     (req_handler)req_close_handle,
+    (req_handler)req_batch,
     (req_handler)req_set_handle_info,
     (req_handler)req_dup_handle,
     (req_handler)req_open_process,
@@ -457,6 +465,9 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_release_semaphore,
     (req_handler)req_query_semaphore,
     (req_handler)req_open_semaphore,
+    (req_handler)req_get_inproc_sync_region,
+    (req_handler)req_get_inproc_sync,
+    (req_handler)req_get_inproc_completion_region,
     (req_handler)req_create_file,
     (req_handler)req_open_file_object,
     (req_handler)req_alloc_file_handle,
@@ -551,6 +562,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_queue_fd,
     (req_handler)req_set_queue_mask,
     (req_handler)req_get_queue_status,
+    (req_handler)req_get_queue_shm,
     (req_handler)req_get_process_idle_event,
     (req_handler)req_send_message,
     (req_handler)req_post_quit_message,
@@ -578,6 +590,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_desktop_window,
     (req_handler)req_set_window_owner,
     (req_handler)req_get_window_info,
+    (req_handler)req_get_window_shm_region,
     (req_handler)req_set_window_info,
     (req_handler)req_set_parent,
     (req_handler)req_get_window_parents,
@@ -688,6 +701,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_create_completion,
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
+    (req_handler)req_wake_completion,
     (req_handler)req_remove_completion,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
@@ -896,6 +910,9 @@ C_ASSERT( FIELD_OFFSET(struct get_apc_result_reply, result) == 8 );
 C_ASSERT( sizeof(struct get_apc_result_reply) == 48 );
 C_ASSERT( FIELD_OFFSET(struct close_handle_request, handle) == 12 );
 C_ASSERT( sizeof(struct close_handle_request) == 16 );
+C_ASSERT( sizeof(struct batch_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct batch_reply, count) == 8 );
+C_ASSERT( sizeof(struct batch_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, flags) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, mask) == 20 );
@@ -1009,6 +1026,18 @@ C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, rootdir) == 20 );
 C_ASSERT( sizeof(struct open_semaphore_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_reply, handle) == 8 );
 C_ASSERT( sizeof(struct open_semaphore_reply) == 16 );
+C_ASSERT( sizeof(struct get_inproc_sync_region_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_inproc_sync_region_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_inproc_sync_region_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_inproc_sync_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_inproc_sync_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_inproc_sync_reply, type) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_inproc_sync_reply, index) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_inproc_sync_reply, access) == 16 );
+C_ASSERT( sizeof(struct get_inproc_sync_reply) == 24 );
+C_ASSERT( sizeof(struct get_inproc_completion_region_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_inproc_completion_region_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_inproc_completion_region_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, sharing) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, create) == 20 );
@@ -1302,7 +1331,8 @@ C_ASSERT( sizeof(struct get_mapping_info_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, size) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, flags) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, shared_file) == 20 );
-C_ASSERT( sizeof(struct get_mapping_info_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, layout_file) == 24 );
+C_ASSERT( sizeof(struct get_mapping_info_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct map_view_request, mapping) == 12 );
 C_ASSERT( FIELD_OFFSET(struct map_view_request, access) == 16 );
 C_ASSERT( FIELD_OFFSET(struct map_view_request, base) == 24 );
@@ -1536,6 +1566,12 @@ C_ASSERT( sizeof(struct get_queue_status_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_queue_status_reply, wake_bits) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_queue_status_reply, changed_bits) == 12 );
 C_ASSERT( sizeof(struct get_queue_status_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_request, map) == 12 );
+C_ASSERT( sizeof(struct get_queue_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_reply, size) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_reply, index) == 16 );
+C_ASSERT( sizeof(struct get_queue_shm_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct get_process_idle_event_request, handle) == 12 );
 C_ASSERT( sizeof(struct get_process_idle_event_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_process_idle_event_reply, event) == 8 );
@@ -1704,6 +1740,10 @@ C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, is_unicode) == 28 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, dpi) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, awareness) == 36 );
 C_ASSERT( sizeof(struct get_window_info_reply) == 40 );
+C_ASSERT( sizeof(struct get_window_shm_region_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_window_shm_region_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_window_shm_region_reply, size) == 12 );
+C_ASSERT( sizeof(struct get_window_shm_region_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, flags) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, is_unicode) == 14 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, handle) == 16 );
@@ -2339,6 +2379,8 @@ C_ASSERT( FIELD_OFFSET(struct add_completion_request, cvalue) == 24 );
 C_ASSERT( FIELD_OFFSET(struct add_completion_request, information) == 32 );
 C_ASSERT( FIELD_OFFSET(struct add_completion_request, status) == 40 );
 C_ASSERT( sizeof(struct add_completion_request) == 48 );
+C_ASSERT( FIELD_OFFSET(struct wake_completion_request, handle) == 12 );
+C_ASSERT( sizeof(struct wake_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct remove_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, ckey) == 8 );
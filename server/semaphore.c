@@ -38,25 +38,29 @@
 
 struct semaphore
 {
-    struct object  obj;    /* object header */
-    unsigned int   count;  /* current count */
-    unsigned int   max;    /* maximum possible count */
+    struct object       obj;    /* object header */
+    struct inproc_sync *sync;   /* current and maximum count, possibly in the shared region */
+    struct inproc_sync  state;  /* count when not in the shared region, and maximum count */
+    struct inproc_region *region; /* shared region holding the count, if any */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -70,7 +74,7 @@ static const struct object_ops semaphore_ops =
     no_open_file,                  /* open_file */
     no_kernel_obj_list,            /* get_kernel_obj_list */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -90,8 +94,10 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            sem->count = initial;
-            sem->max   = max;
+            sem->state.state = initial;
+            sem->state.max   = max;
+            sem->sync        = &sem->state;
+            sem->region      = NULL;
         }
     }
     return sem;
@@ -100,30 +106,43 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
-    if (prev) *prev = sem->count;
-    if (sem->count + count < sem->count || sem->count + count > sem->max)
-    {
-        set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
-        return 0;
-    }
-    else if (sem->count)
-    {
-        /* there cannot be any thread to wake up if the count is != 0 */
-        sem->count += count;
-    }
-    else
+    unsigned int current;
+    int old;
+
+    /* clients may update the count concurrently as long as there are no waiters */
+    do
     {
-        sem->count = count;
-        wake_up( &sem->obj, count );
-    }
+        old = sem->sync->state;
+        current = old & ~INPROC_SYNC_WAITERS;
+        if (prev) *prev = current;
+        if (current + count < current || current + count > sem->state.max)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+    } while (interlocked_cmpxchg( &sem->sync->state, old + count, old ) != old);
+
+    /* there cannot be any thread to wake up if the count was != 0 */
+    if (!current) wake_up( &sem->obj, count );
     return 1;
 }
 
+/* move the semaphore state to the shared region and return its type */
+int get_semaphore_inproc_sync( struct object *obj, unsigned int *index )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+
+    if (obj->ops != &semaphore_ops) return INPROC_SYNC_NONE;
+    if (!get_inproc_sync_index( &sem->sync, &sem->state, &sem->region, index ))
+        return INPROC_SYNC_NONE;
+    return INPROC_SYNC_SEMAPHORE;
+}
+
 static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d\n", inproc_sync_value( sem->sync ), sem->state.max );
 }
 
 static struct object_type *semaphore_get_type( struct object *obj )
@@ -133,19 +152,34 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    return inproc_sync_add_queue( obj, entry, sem->sync );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    inproc_sync_remove_queue( obj, entry, sem->sync );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    return (inproc_sync_value( sem->sync ) > 0);
 }
 
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    assert( sem->count );
-    sem->count--;
+    assert( inproc_sync_value( sem->sync ));
+    /* the waiters flag is set, so clients can't modify the count concurrently */
+    sem->sync->state--;
 }
 
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access )
@@ -170,6 +204,13 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->sync != &sem->state) free_inproc_sync( sem->region, sem->sync );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -224,8 +265,8 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
-        reply->max = sem->max;
+        reply->current = inproc_sync_value( sem->sync );
+        reply->max = sem->state.max;
         release_object( sem );
     }
 }
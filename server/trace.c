@@ -1520,6 +1520,17 @@ static void dump_close_handle_request( const struct close_handle_request *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_batch_request( const struct batch_request *req )
+{
+    dump_varargs_bytes( " requests=", cur_size );
+}
+
+static void dump_batch_reply( const struct batch_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_bytes( ", replies=", cur_size );
+}
+
 static void dump_set_handle_info_request( const struct set_handle_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1757,6 +1768,36 @@ static void dump_open_semaphore_reply( const struct open_semaphore_reply *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_inproc_sync_region_request( const struct get_inproc_sync_region_request *req )
+{
+}
+
+static void dump_get_inproc_sync_region_reply( const struct get_inproc_sync_region_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_inproc_sync_request( const struct get_inproc_sync_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_inproc_sync_reply( const struct get_inproc_sync_reply *req )
+{
+    fprintf( stderr, " type=%d", req->type );
+    fprintf( stderr, ", index=%08x", req->index );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
+static void dump_get_inproc_completion_region_request( const struct get_inproc_completion_region_request *req )
+{
+}
+
+static void dump_get_inproc_completion_region_reply( const struct get_inproc_completion_region_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
 static void dump_create_file_request( const struct create_file_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -2308,6 +2349,7 @@ static void dump_get_mapping_info_reply( const struct get_mapping_info_reply *re
     dump_uint64( " size=", &req->size );
     fprintf( stderr, ", flags=%08x", req->flags );
     fprintf( stderr, ", shared_file=%04x", req->shared_file );
+    fprintf( stderr, ", layout_file=%04x", req->layout_file );
     dump_varargs_pe_image_info( ", image=", cur_size );
 }
 
@@ -2799,6 +2841,18 @@ static void dump_get_queue_status_reply( const struct get_queue_status_reply *re
     fprintf( stderr, ", changed_bits=%08x", req->changed_bits );
 }
 
+static void dump_get_queue_shm_request( const struct get_queue_shm_request *req )
+{
+    fprintf( stderr, " map=%d", req->map );
+}
+
+static void dump_get_queue_shm_reply( const struct get_queue_shm_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", size=%u", req->size );
+    fprintf( stderr, ", index=%08x", req->index );
+}
+
 static void dump_get_process_idle_event_request( const struct get_process_idle_event_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -3109,6 +3163,16 @@ static void dump_get_window_info_reply( const struct get_window_info_reply *req
     fprintf( stderr, ", awareness=%d", req->awareness );
 }
 
+static void dump_get_window_shm_region_request( const struct get_window_shm_region_request *req )
+{
+}
+
+static void dump_get_window_shm_region_reply( const struct get_window_shm_region_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", size=%u", req->size );
+}
+
 static void dump_set_window_info_request( const struct set_window_info_request *req )
 {
     fprintf( stderr, " flags=%04x", req->flags );
@@ -4396,6 +4460,11 @@ static void dump_add_completion_request( const struct add_completion_request *re
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_wake_completion_request( const struct wake_completion_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_remove_completion_request( const struct remove_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4620,6 +4689,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_request,
     (dump_func)dump_get_apc_result_request,
     (dump_func)dump_close_handle_request,
+    (dump_func)dump_batch_request,
     (dump_func)dump_set_handle_info_request,
     (dump_func)dump_dup_handle_request,
     (dump_func)dump_open_process_request,
@@ -4639,6 +4709,9 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_request,
     (dump_func)dump_query_semaphore_request,
     (dump_func)dump_open_semaphore_request,
+    (dump_func)dump_get_inproc_sync_region_request,
+    (dump_func)dump_get_inproc_sync_request,
+    (dump_func)dump_get_inproc_completion_region_request,
     (dump_func)dump_create_file_request,
     (dump_func)dump_open_file_object_request,
     (dump_func)dump_alloc_file_handle_request,
@@ -4733,6 +4806,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_queue_fd_request,
     (dump_func)dump_set_queue_mask_request,
     (dump_func)dump_get_queue_status_request,
+    (dump_func)dump_get_queue_shm_request,
     (dump_func)dump_get_process_idle_event_request,
     (dump_func)dump_send_message_request,
     (dump_func)dump_post_quit_message_request,
@@ -4760,6 +4834,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_desktop_window_request,
     (dump_func)dump_set_window_owner_request,
     (dump_func)dump_get_window_info_request,
+    (dump_func)dump_get_window_shm_region_request,
     (dump_func)dump_set_window_info_request,
     (dump_func)dump_set_parent_request,
     (dump_func)dump_get_window_parents_request,
@@ -4870,6 +4945,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_completion_request,
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
+    (dump_func)dump_wake_completion_request,
     (dump_func)dump_remove_completion_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
@@ -4920,6 +4996,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_reply,
     (dump_func)dump_get_apc_result_reply,
     NULL,
+    (dump_func)dump_batch_reply,
     (dump_func)dump_set_handle_info_reply,
     (dump_func)dump_dup_handle_reply,
     (dump_func)dump_open_process_reply,
@@ -4939,6 +5016,9 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_reply,
     (dump_func)dump_query_semaphore_reply,
     (dump_func)dump_open_semaphore_reply,
+    (dump_func)dump_get_inproc_sync_region_reply,
+    (dump_func)dump_get_inproc_sync_reply,
+    (dump_func)dump_get_inproc_completion_region_reply,
     (dump_func)dump_create_file_reply,
     (dump_func)dump_open_file_object_reply,
     (dump_func)dump_alloc_file_handle_reply,
@@ -5033,6 +5113,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_set_queue_mask_reply,
     (dump_func)dump_get_queue_status_reply,
+    (dump_func)dump_get_queue_shm_reply,
     (dump_func)dump_get_process_idle_event_reply,
     NULL,
     NULL,
@@ -5060,6 +5141,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_desktop_window_reply,
     (dump_func)dump_set_window_owner_reply,
     (dump_func)dump_get_window_info_reply,
+    (dump_func)dump_get_window_shm_region_reply,
     (dump_func)dump_set_window_info_reply,
     (dump_func)dump_set_parent_reply,
     (dump_func)dump_get_window_parents_reply,
@@ -5170,6 +5252,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_completion_reply,
     (dump_func)dump_open_completion_reply,
     NULL,
+    NULL,
     (dump_func)dump_remove_completion_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
@@ -5220,6 +5303,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "queue_apc",
     "get_apc_result",
     "close_handle",
+    "batch",
     "set_handle_info",
     "dup_handle",
     "open_process",
@@ -5239,6 +5323,9 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "release_semaphore",
     "query_semaphore",
     "open_semaphore",
+    "get_inproc_sync_region",
+    "get_inproc_sync",
+    "get_inproc_completion_region",
     "create_file",
     "open_file_object",
     "alloc_file_handle",
@@ -5333,6 +5420,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_queue_fd",
     "set_queue_mask",
     "get_queue_status",
+    "get_queue_shm",
     "get_process_idle_event",
     "send_message",
     "post_quit_message",
@@ -5360,6 +5448,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_desktop_window",
     "set_window_owner",
     "get_window_info",
+    "get_window_shm_region",
     "set_window_info",
     "set_parent",
     "get_window_parents",
@@ -5470,6 +5559,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "create_completion",
     "open_completion",
     "add_completion",
+    "wake_completion",
     "remove_completion",
     "query_completion",
     "set_completion_info",
@@ -33,6 +33,8 @@
 #include "winternl.h"
 
 #include "object.h"
+#include "file.h"
+#include "handle.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -187,6 +189,71 @@ static unsigned int get_monitor_dpi( struct window *win )
     return win->dpi ? win->dpi : USER_DEFAULT_SCREEN_DPI;
 }
 
+/* the state of the windows is published in a region that the clients can map read-only,
+ * so that they can query windows of other processes without a server call */
+static struct object *window_shm_mapping;   /* mapping of the shared region */
+static struct window_shm *window_shm_region; /* server view of the shared region */
+static int window_shm_failed;                /* creating the region failed */
+
+#define WINDOW_SHM_REGION_SIZE (WINDOW_SHM_MAX_WINDOWS * sizeof(struct window_shm))
+
+/* create the shared region on first use */
+static int init_window_shm(void)
+{
+    void *ptr;
+
+    if (window_shm_region) return 1;
+    if (window_shm_failed) return 0;
+    if (!(window_shm_mapping = create_shared_mapping( WINDOW_SHM_REGION_SIZE, &ptr )))
+    {
+        clear_error();
+        window_shm_failed = 1;
+        return 0;
+    }
+    make_object_static( window_shm_mapping );
+    window_shm_region = ptr;
+    return 1;
+}
+
+/* get the entry of a window handle in the shared region */
+static struct window_shm *get_window_shm( user_handle_t handle )
+{
+    if (!init_window_shm()) return NULL;
+    return window_shm_region + (((handle & 0xffff) - FIRST_USER_HANDLE) >> 1);
+}
+
+/* publish the state of a window in the shared region */
+static void update_window_shm( struct window *win )
+{
+    struct window_shm *shm = get_window_shm( win->handle );
+
+    if (!shm) return;
+    interlocked_xchg_add( &shm->seq, 1 );
+    shm->handle      = win->handle;
+    shm->parent      = win->parent ? win->parent->handle : 0;
+    shm->owner       = win->owner;
+    shm->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->style       = win->style;
+    shm->ex_style    = win->ex_style;
+    shm->id          = win->id;
+    shm->dpi         = win->dpi;
+    shm->window_rect = win->window_rect;
+    shm->client_rect = win->client_rect;
+    interlocked_xchg_add( &shm->seq, 1 );
+}
+
+/* remove a window from the shared region before its handle is freed */
+static void clear_window_shm( struct window *win )
+{
+    struct window_shm *shm = get_window_shm( win->handle );
+
+    if (!shm) return;
+    interlocked_xchg_add( &shm->seq, 1 );
+    shm->handle = 0;
+    interlocked_xchg_add( &shm->seq, 1 );
+}
+
 /* link a window at the right place in the siblings list */
 static void link_window( struct window *win, struct window *previous )
 {
@@ -240,6 +307,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -420,6 +488,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -546,6 +615,7 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    update_window_shm( win );
     return win;
 
 failed:
@@ -1714,8 +1784,10 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->surface_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
+    update_window_shm( win );
 
     /* reset cursor clip rectangle when the desktop changes size */
     if (win == win->desktop->top_window) win->desktop->cursor.clip = *window_rect;
@@ -1899,6 +1971,7 @@ void destroy_window( struct window *win )
     if (win == taskman_window) taskman_window = NULL;
     free_hotkeys( win->desktop, win->handle );
     cleanup_clipboard_window( win->desktop, win->handle );
+    clear_window_shm( win );
     free_user_handle( win->handle );
     destroy_properties( win );
     list_remove( &win->entry );
@@ -1963,6 +2036,7 @@ DECL_HANDLER(create_window)
         win->dpi_awareness = req->awareness;
         win->dpi = req->dpi;
     }
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -1990,6 +2064,7 @@ DECL_HANDLER(set_parent)
     reply->old_parent  = win->parent->handle;
     reply->full_parent = parent ? parent->handle : 0;
     set_parent_window( win, parent );
+    update_window_shm( win );
     reply->dpi       = win->dpi;
     reply->awareness = win->dpi_awareness;
 }
@@ -2025,6 +2100,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2037,6 +2113,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2072,6 +2149,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2097,6 +2175,20 @@ DECL_HANDLER(get_window_info)
 }
 
 
+/* retrieve the shared memory region holding the state of the windows */
+DECL_HANDLER(get_window_shm_region)
+{
+    if (!init_window_shm())
+    {
+        set_error( STATUS_NOT_SUPPORTED );
+        return;
+    }
+    if (!(reply->handle = alloc_handle( current->process, window_shm_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 )))
+        return;
+    reply->size = WINDOW_SHM_REGION_SIZE;
+}
+
+
 /* set some information in a window */
 DECL_HANDLER(set_window_info)
 {
@@ -2146,6 +2238,7 @@ DECL_HANDLER(set_window_info)
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE | SET_WIN_ID)) update_window_shm( win );
 }
 
 